@@ -0,0 +1,240 @@
+// Compares frustum culling by testing every object's box, as Model::renderAllModels did through
+// Geometry::render, against querying an AABBTree and against the packed CullBatch kernels, scalar
+// and SIMD. Also times keeping the tree current while a part of the objects moves every frame
+// and answers sphere queries both ways.
+// Usage: cullbench [objectCount] [iterations], without a count it runs 10k, 50k and 100k objects
+
+#include <cstdio>
+#include <cstdlib>
+#include <chrono>
+#include <vector>
+#include <bitset>
+
+#include "../src/aabbtree.h"
+#include "../src/cullbatch.h"
+
+namespace
+{
+	typedef std::chrono::high_resolution_clock Clock;
+
+	const float WORLD_SIZE  = 1000.f; // Objects are spread over a cube this wide around the origin
+	const float MOVED_SHARE = 0.1f;   // Part of the objects moved every iteration
+	const int   SPHERES     = 64;     // Sphere queries per iteration
+
+	std::vector<BoundingBox> boxes;
+	std::vector<int>         leaves;
+	std::vector<Frustum>     frustums; // One per iteration, the camera turns around the origin
+	std::vector<int32_t>     results;
+	CullBounds               packed;
+	std::vector<uint32_t>    visibility;
+	std::vector<uint32_t>    scalarVisibility;
+
+	float randomFloat(float min, float max)
+	{
+		return min + (max - min) * ((float)rand() / (float)RAND_MAX);
+	}
+
+	// Same extraction as Camera::updateFrustum
+	Frustum makeFrustum(const Mat4& viewProj)
+	{
+		Frustum frustum;
+		for(int i = 0; i < 3; i++)
+		{
+			for(int column = 0; column < 4; column++)
+			{
+				frustum.planes[i * 2][column]     = viewProj[column][3] + viewProj[column][i];
+				frustum.planes[i * 2 + 1][column] = viewProj[column][3] - viewProj[column][i];
+			}
+		}
+		for(int i = 0; i < 6; i++) frustum.planes[i] /= glm::length(Vec3(frustum.planes[i]));
+		return frustum;
+	}
+
+	// Matches BoundingVolume::isIntersecting for a box already in world space
+	bool isVisible(const Frustum& frustum, const BoundingBox& box)
+	{
+		Vec3 center  = (box.max + box.min) / 2.f;
+		Vec3 halfExt = (box.max - box.min) / 2.f;
+		for(int i = 0; i < 6; i++)
+		{
+			Vec3  normal(frustum.planes[i]);
+			float d = glm::dot(normal, center);
+			float r = glm::dot(halfExt, glm::abs(normal));
+			if(d + r < -frustum.planes[i].w) return false;
+		}
+		return true;
+	}
+
+	bool overlapsSphere(const BoundingBox& box, const Vec3& center, float radius)
+	{
+		Vec3 offset = glm::min(glm::max(center, box.min), box.max) - center;
+		return glm::dot(offset, offset) <= radius * radius;
+	}
+
+	size_t countVisible(const std::vector<uint32_t>& words)
+	{
+		size_t visible = 0;
+		for(uint32_t word : words) visible += std::bitset<32>(word).count();
+		return visible;
+	}
+
+	BoundingBox randomBox()
+	{
+		Vec3 center(randomFloat(-WORLD_SIZE, WORLD_SIZE) / 2.f,
+					randomFloat(-WORLD_SIZE, WORLD_SIZE) / 20.f,
+					randomFloat(-WORLD_SIZE, WORLD_SIZE) / 2.f);
+		Vec3 halfExt(randomFloat(0.25f, 2.f), randomFloat(0.25f, 2.f), randomFloat(0.25f, 2.f));
+		BoundingBox box;
+		box.min = center - halfExt;
+		box.max = center + halfExt;
+		return box;
+	}
+
+	template<typename Func>
+	double measure(const char* name, int iterations, Func func)
+	{
+		Clock::time_point start = Clock::now();
+		size_t found = 0;
+		for(int i = 0; i < iterations; i++) found += func(i);
+		double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count() / iterations;
+		printf("    %-28s %10.3f ms/iteration %10zu results/iteration\n", name, ms, found / iterations);
+		return ms;
+	}
+
+	void run(int count, int iterations)
+	{
+		srand(1234);
+		boxes.resize(count);
+		for(int i = 0; i < count; i++) boxes[i] = randomBox();
+		printf("%d objects, %d iterations\n", count, iterations);
+
+		AABBTree tree;
+		leaves.resize(count);
+		Clock::time_point start = Clock::now();
+		for(int i = 0; i < count; i++) leaves[i] = tree.insert(boxes[i], i);
+		double buildMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+		printf("    %-28s %10.3f ms, height %d\n", "build", buildMs, tree.getHeight());
+
+		double linear = measure("linear frustum", iterations, [](int iteration) {
+			size_t visible = 0;
+			for(const BoundingBox& box : boxes)
+				if(isVisible(frustums[iteration], box)) visible++;
+			return visible;
+		});
+		double queried = measure("tree frustum", iterations, [&tree](int iteration) {
+			results.clear();
+			tree.query(frustums[iteration], &results);
+			return results.size();
+		});
+
+		CullBatch::resize(&packed, count);
+		for(int i = 0; i < count; i++) CullBatch::set(&packed, i, boxes[i], glm::length(boxes[i].max - boxes[i].min) * 0.5f);
+		double packedScalar = measure("packed scalar frustum", iterations, [](int iteration) {
+			CullBatch::cullScalar(frustums[iteration], packed, false, &visibility);
+			return countVisible(visibility);
+		});
+		double packedSimd = measure("packed simd frustum", iterations, [](int iteration) {
+			CullBatch::cull(frustums[iteration], packed, false, &visibility);
+			return countVisible(visibility);
+		});
+		double sphereScalar = measure("packed scalar spheres", iterations, [](int iteration) {
+			CullBatch::cullScalar(frustums[iteration], packed, true, &visibility);
+			return countVisible(visibility);
+		});
+		double sphereSimd = measure("packed simd spheres", iterations, [](int iteration) {
+			CullBatch::cull(frustums[iteration], packed, true, &visibility);
+			return countVisible(visibility);
+		});
+
+		// Both visit the same boxes with the same test, so the counts have to agree
+		size_t mismatches = 0;
+		for(int i = 0; i < iterations; i++)
+		{
+			size_t visible = 0;
+			for(const BoundingBox& box : boxes)
+				if(isVisible(frustums[i], box)) visible++;
+			results.clear();
+			tree.query(frustums[i], &results);
+			if(results.size() != visible) mismatches++;
+			// The kernels have to agree bit for bit, with the linear test on the count
+			for(int spheres = 0; spheres < 2; spheres++)
+			{
+				CullBatch::cull(frustums[i], packed, spheres != 0, &visibility);
+				CullBatch::cullScalar(frustums[i], packed, spheres != 0, &scalarVisibility);
+				if(visibility != scalarVisibility) mismatches++;
+				if(!spheres && countVisible(visibility) != visible) mismatches++;
+			}
+		}
+
+		double linearSpheres = measure("linear spheres", iterations, [count](int iteration) {
+			size_t found = 0;
+			srand(iteration);
+			for(int i = 0; i < SPHERES; i++)
+			{
+				Vec3 center = (boxes[rand() % count].min + boxes[rand() % count].max) / 2.f;
+				for(const BoundingBox& box : boxes)
+					if(overlapsSphere(box, center, 20.f)) found++;
+			}
+			return found;
+		});
+		double treeSpheres = measure("tree spheres", iterations, [&tree, count](int iteration) {
+			results.clear();
+			srand(iteration);
+			for(int i = 0; i < SPHERES; i++)
+			{
+				Vec3 center = (boxes[rand() % count].min + boxes[rand() % count].max) / 2.f;
+				tree.query(center, 20.f, &results);
+			}
+			return results.size();
+		});
+
+		int moved = (int)(count * MOVED_SHARE);
+		int reinserted = 0;
+		measure("tree move", iterations, [&tree, &reinserted, moved, count](int) {
+			for(int i = 0; i < moved; i++)
+			{
+				int  index  = rand() % count;
+				Vec3 offset = Vec3(randomFloat(-0.1f, 0.1f), randomFloat(-0.1f, 0.1f), randomFloat(-0.1f, 0.1f));
+				boxes[index].min += offset;
+				boxes[index].max += offset;
+				if(tree.move(leaves[index], boxes[index])) reinserted++;
+			}
+			return (size_t)moved;
+		});
+
+		printf("    frustum speedup %.2fx, sphere speedup %.2fx, %d of %d moves reinserted, %zu mismatches\n",
+			   linear / queried, linearSpheres / treeSpheres, reinserted, moved * iterations, mismatches);
+		printf("    packed simd over linear %.2fx, over packed scalar %.2fx (boxes) %.2fx (spheres), over tree %.2fx\n",
+			   linear / packedSimd, packedScalar / packedSimd, sphereScalar / sphereSimd, queried / packedSimd);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	int count      = argc > 1 ? atoi(argv[1]) : 0;
+	int iterations = argc > 2 ? atoi(argv[2]) : 100;
+	if(count < 0 || iterations <= 0)
+	{
+		printf("Usage: %s [objectCount] [iterations]\n", argv[0]);
+		return 1;
+	}
+
+	Mat4 projection = glm::perspective(glm::radians(75.f), 4.f / 3.f, 0.1f, 1000.f);
+	for(int i = 0; i < iterations; i++)
+	{
+		float angle = (float)i / iterations * 2.f * 3.14159265f;
+		Mat4  view  = glm::lookAt(Vec3(0.f, 10.f, 0.f), Vec3(cosf(angle), 10.f, sinf(angle)), Vec3(0.f, 1.f, 0.f));
+		frustums.push_back(makeFrustum(projection * view));
+	}
+
+	if(count > 0)
+	{
+		run(count, iterations);
+	}
+	else
+	{
+		const int counts[] = {10000, 50000, 100000};
+		for(int objects : counts) run(objects, iterations);
+	}
+	return 0;
+}
@@ -0,0 +1,117 @@
+// Compares the per transform matrix rebuild used before Transform::flush was batched
+// against TransformBatch::compose on one thread and spread over the WorkerPool.
+// Usage: transformbench [transformCount] [iterations]
+
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <chrono>
+#include <vector>
+#include <algorithm>
+
+#include "../src/transformbatch.h"
+#include "../src/workerpool.h"
+
+namespace
+{
+	typedef std::chrono::high_resolution_clock Clock;
+
+	std::vector<Vec3> positions;
+	std::vector<Quat> rotations;
+	std::vector<Vec3> scales;
+	std::vector<Mat4> worldMatrices;
+	std::vector<Mat4> referenceMatrices;
+	std::vector<int>  indices;
+
+	float randomFloat(float min, float max)
+	{
+		return min + (max - min) * ((float)rand() / (float)RAND_MAX);
+	}
+
+	// Matches what Transform::updateTransformMatrix did for every set call
+	void composeReference(int index, Mat4* out)
+	{
+		Mat4 translationMat = glm::translate(Mat4(1.0f), positions[index]);
+		Mat4 scaleMat       = glm::scale(Mat4(1.0f), scales[index]);
+		Mat4 rotationMat    = glm::toMat4(glm::normalize(rotations[index]));
+		out[index]          = translationMat * rotationMat * scaleMat;
+	}
+
+	template<typename Func>
+	double measure(const char* name, int count, int iterations, Func func)
+	{
+		func(); // Warm up caches and wake the workers
+		Clock::time_point start = Clock::now();
+		for(int i = 0; i < iterations; i++) func();
+		double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+		double rate    = ((double)count * iterations) / seconds;
+		printf("%-24s %10.3f ms/iteration %14.0f matrices/s\n", name, seconds * 1000.0 / iterations, rate);
+		return rate;
+	}
+
+	float maxError()
+	{
+		float error = 0.f;
+		for(int index : indices)
+			for(int column = 0; column < 4; column++)
+				for(int row = 0; row < 4; row++)
+					error = std::max(error, std::fabs(worldMatrices[index][column][row] - referenceMatrices[index][column][row]));
+		return error;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	int count      = argc > 1 ? atoi(argv[1]) : 100000;
+	int iterations = argc > 2 ? atoi(argv[2]) : 100;
+	if(count <= 0 || iterations <= 0)
+	{
+		printf("Usage: %s [transformCount] [iterations]\n", argv[0]);
+		return 1;
+	}
+
+	srand(1234);
+	positions.resize(count);
+	rotations.resize(count);
+	scales.resize(count);
+	worldMatrices.resize(count);
+	referenceMatrices.resize(count);
+	for(int i = 0; i < count; i++)
+	{
+		positions[i] = Vec3(randomFloat(-100.f, 100.f), randomFloat(-100.f, 100.f), randomFloat(-100.f, 100.f));
+		rotations[i] = Quat(randomFloat(-1.f, 1.f), randomFloat(-1.f, 1.f), randomFloat(-1.f, 1.f), randomFloat(-1.f, 1.f));
+		scales[i]    = Vec3(randomFloat(0.1f, 4.f), randomFloat(0.1f, 4.f), randomFloat(0.1f, 4.f));
+		// Dirty lists are in modification order, so shuffle instead of walking memory linearly
+		indices.push_back(i);
+	}
+	for(int i = count - 1; i > 0; i--) std::swap(indices[i], indices[rand() % (i + 1)]);
+
+	WorkerPool::initialize();
+	printf("%d transforms, %d iterations, %d workers + main thread\n",
+		   count, iterations, WorkerPool::getThreadCount());
+
+	double reference = measure("updateTransformMatrix", count, iterations, [] {
+		for(int index : indices) composeReference(index, referenceMatrices.data());
+	});
+	double batched = measure("batched", count, iterations, [count] {
+		TransformBatch::compose(positions.data(), rotations.data(), scales.data(), worldMatrices.data(), indices.data(), count);
+	});
+	float batchedError = maxError();
+	double parallel = measure("batched + workers", count, iterations, [count] {
+		WorkerPool::parallelFor(count, 256, [] (int begin, int end) {
+			TransformBatch::compose(positions.data(),
+									rotations.data(),
+									scales.data(),
+									worldMatrices.data(),
+									&indices[begin],
+									end - begin);
+		});
+	});
+	float parallelError = maxError();
+
+	printf("batched speedup %.2fx, batched + workers speedup %.2fx\n", batched / reference, parallel / reference);
+	printf("max abs error vs reference: batched %g, batched + workers %g\n", batchedError, parallelError);
+
+	WorkerPool::cleanup();
+	return 0;
+}
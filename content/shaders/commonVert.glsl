@@ -1,6 +1,6 @@
 
 // Common inputs and outputs
-in vec3 vPosition;
+in vec3 vPosition; // Quantized to the mesh bounds, use decodePosition
 in vec3 vNormal;
 in vec2 vUV;
 
@@ -15,18 +15,26 @@ uniform mat4 modelMat;
 uniform mat4 viewMat;
 uniform mat4 mvp;
 uniform mat4 lightVPMat;
+uniform vec3 positionScale; // Set per mesh from Geometry::getPositionDecode
+uniform vec3 positionBias;
+
+vec3 decodePosition()
+{
+	return vPosition * positionScale + positionBias;
+}
 
 vec4 transformPosition(vec3 position)
 {
-	return mvp * vec4(vPosition, 1.0);
+	return mvp * vec4(position, 1.0);
 }
 
 void setOutputs()
 {
+	vec3 position = decodePosition();
 	uv = vUV;
 	//Normal and vertex sent to the fragment shader should be in the same space!
-	normal = vec4(modelMat * vec4(vNormal, 0.0)).xyz;
-	vertex = vec4(modelMat * vec4(vPosition, 1.0)).xyz;
-	vertCamSpace   = vec4(viewMat * vec4(vPosition, 1.0)).xyz;
-	vertLightSpace = vec4((lightVPMat * modelMat) * vec4(vPosition, 1.0));
+	normal = vec4(modelMat * vec4(normalize(vNormal), 0.0)).xyz;
+	vertex = vec4(modelMat * vec4(position, 1.0)).xyz;
+	vertCamSpace   = vec4(viewMat * vec4(position, 1.0)).xyz;
+	vertLightSpace = vec4((lightVPMat * modelMat) * vec4(position, 1.0));
 }
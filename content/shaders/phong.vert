@@ -2,7 +2,7 @@
 
 void main()
 {
-    gl_Position = transformPosition(vPosition);
+    gl_Position = transformPosition(decodePosition());
 	setOutputs();
 }
 
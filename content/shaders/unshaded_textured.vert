@@ -2,6 +2,6 @@
 
 void main()
 {
-	gl_Position = transformPosition(vPosition);
+	gl_Position = transformPosition(decodePosition());
 	setOutputs();
 }
@@ -0,0 +1,416 @@
+#include "aabbtree.h"
+
+#include <algorithm>
+
+namespace
+{
+	const float FAT_MARGIN = 0.1f;  // Added on every side, in world units
+	const float FAT_SCALE  = 0.1f;  // Plus this much of the box's size so large objects get room too
+
+	inline BoundingBox combine(const BoundingBox& a, const BoundingBox& b)
+	{
+		BoundingBox box;
+		box.min = glm::min(a.min, b.min);
+		box.max = glm::max(a.max, b.max);
+		return box;
+	}
+
+	inline float surfaceArea(const BoundingBox& box)
+	{
+		Vec3 size = box.max - box.min;
+		return 2.f * (size.x * size.y + size.y * size.z + size.z * size.x);
+	}
+
+	inline bool contains(const BoundingBox& outer, const BoundingBox& inner)
+	{
+		return outer.min.x <= inner.min.x && outer.min.y <= inner.min.y && outer.min.z <= inner.min.z &&
+			   outer.max.x >= inner.max.x && outer.max.y >= inner.max.y && outer.max.z >= inner.max.z;
+	}
+
+	inline bool overlaps(const BoundingBox& a, const BoundingBox& b)
+	{
+		return a.min.x <= b.max.x && a.max.x >= b.min.x &&
+			   a.min.y <= b.max.y && a.max.y >= b.min.y &&
+			   a.min.z <= b.max.z && a.max.z >= b.min.z;
+	}
+
+	inline bool overlaps(const BoundingBox& box, const Vec3& center, float radiusSquared)
+	{
+		Vec3 closest = glm::min(glm::max(center, box.min), box.max);
+		Vec3 offset  = closest - center;
+		return glm::dot(offset, offset) <= radiusSquared;
+	}
+
+	// Same plane test as BoundingVolume::isIntersecting, on a box that is already in world space
+	inline int classify(const Frustum& frustum, const BoundingBox& box)
+	{
+		Vec3 center  = (box.max + box.min) * 0.5f;
+		Vec3 halfExt = (box.max - box.min) * 0.5f;
+		int  result  = IT_INSIDE;
+		for(int i = 0; i < 6; i++)
+		{
+			Vec3  normal(frustum.planes[i]);
+			float distance = glm::dot(normal, center) + frustum.planes[i].w;
+			float radius   = glm::dot(halfExt, glm::abs(normal));
+			if(distance + radius < 0.f) return IT_OUTSIDE;
+			if(distance - radius < 0.f) result = IT_INTERSECT;
+		}
+		return result;
+	}
+
+	// Slab test, returns false if the ray misses the box or enters it beyond maxDistance
+	inline bool intersectRay(const BoundingBox& box,
+							 const Vec3&        origin,
+							 const Vec3&        inverseDirection,
+							 float              maxDistance,
+							 float*             entry)
+	{
+		float tMin = 0.f;
+		float tMax = maxDistance;
+		for(int i = 0; i < 3; i++)
+		{
+			float t1 = (box.min[i] - origin[i]) * inverseDirection[i];
+			float t2 = (box.max[i] - origin[i]) * inverseDirection[i];
+			if(t1 > t2) std::swap(t1, t2);
+			// NaN from a ray lying in a slab plane fails both comparisons and leaves the range alone
+			if(t1 > tMin) tMin = t1;
+			if(t2 < tMax) tMax = t2;
+			if(tMin > tMax) return false;
+		}
+		*entry = tMin;
+		return true;
+	}
+}
+
+int AABBTree::insert(const BoundingBox& box, int32_t userData)
+{
+	int leaf = allocateNode();
+	boxes[leaf]          = box;
+	nodes[leaf].userData = userData;
+	nodes[leaf].height   = 0;
+	fatten(leaf);
+	insertLeaf(leaf);
+	leafCount++;
+	return leaf;
+}
+
+void AABBTree::remove(int leaf)
+{
+	if(leaf < 0 || leaf >= (int)nodes.size() || !nodes[leaf].isLeaf() || nodes[leaf].height != 0) return;
+	removeLeaf(leaf);
+	freeNode(leaf);
+	leafCount--;
+}
+
+bool AABBTree::move(int leaf, const BoundingBox& box)
+{
+	boxes[leaf] = box;
+	if(contains(nodes[leaf].fatBox, box)) return false;
+	removeLeaf(leaf);
+	fatten(leaf);
+	insertLeaf(leaf);
+	return true;
+}
+
+void AABBTree::clear()
+{
+	nodes.clear();
+	boxes.clear();
+	root      = NULL_NODE;
+	freeList  = NULL_NODE;
+	leafCount = 0;
+}
+
+void AABBTree::query(const Frustum& frustum, std::vector<int32_t>* results) const
+{
+	if(root == NULL_NODE) return;
+	// Subtrees found to be completely inside are pushed complemented and taken without testing
+	stack.clear();
+	stack.push_back(root);
+	while(!stack.empty())
+	{
+		int32_t entry  = stack.back();
+		stack.pop_back();
+		bool    inside = entry < 0;
+		int32_t index  = inside ? ~entry : entry;
+		const TreeNode& node = nodes[index];
+		if(!inside)
+		{
+			int intersection = classify(frustum, node.isLeaf() ? boxes[index] : node.fatBox);
+			if(intersection == IT_OUTSIDE) continue;
+			inside = intersection == IT_INSIDE;
+		}
+		if(node.isLeaf())
+		{
+			results->push_back(node.userData);
+		}
+		else
+		{
+			stack.push_back(inside ? ~node.child1 : node.child1);
+			stack.push_back(inside ? ~node.child2 : node.child2);
+		}
+	}
+}
+
+void AABBTree::query(const BoundingBox& box, std::vector<int32_t>* results) const
+{
+	if(root == NULL_NODE) return;
+	stack.clear();
+	stack.push_back(root);
+	while(!stack.empty())
+	{
+		int32_t         index = stack.back();
+		const TreeNode& node  = nodes[index];
+		stack.pop_back();
+		if(!overlaps(node.isLeaf() ? boxes[index] : node.fatBox, box)) continue;
+		if(node.isLeaf())
+		{
+			results->push_back(node.userData);
+		}
+		else
+		{
+			stack.push_back(node.child1);
+			stack.push_back(node.child2);
+		}
+	}
+}
+
+void AABBTree::query(const Vec3& center, float radius, std::vector<int32_t>* results) const
+{
+	if(root == NULL_NODE || radius < 0.f) return;
+	float radiusSquared = radius * radius;
+	stack.clear();
+	stack.push_back(root);
+	while(!stack.empty())
+	{
+		int32_t         index = stack.back();
+		const TreeNode& node  = nodes[index];
+		stack.pop_back();
+		if(!overlaps(node.isLeaf() ? boxes[index] : node.fatBox, center, radiusSquared)) continue;
+		if(node.isLeaf())
+		{
+			results->push_back(node.userData);
+		}
+		else
+		{
+			stack.push_back(node.child1);
+			stack.push_back(node.child2);
+		}
+	}
+}
+
+int32_t AABBTree::raycast(const Vec3& origin, const Vec3& direction, float maxDistance, float* distance) const
+{
+	int32_t closest = -1;
+	float   best    = maxDistance;
+	if(root == NULL_NODE) return closest;
+
+	Vec3 inverseDirection(1.f / direction.x, 1.f / direction.y, 1.f / direction.z);
+	stack.clear();
+	stack.push_back(root);
+	while(!stack.empty())
+	{
+		int32_t         index = stack.back();
+		const TreeNode& node  = nodes[index];
+		stack.pop_back();
+		float entry = 0.f;
+		// Anything entered past the closest hit so far can't be closer
+		if(!intersectRay(node.isLeaf() ? boxes[index] : node.fatBox, origin, inverseDirection, best, &entry)) continue;
+		if(node.isLeaf())
+		{
+			if(closest == -1 || entry < best)
+			{
+				best    = entry;
+				closest = node.userData;
+			}
+		}
+		else
+		{
+			stack.push_back(node.child1);
+			stack.push_back(node.child2);
+		}
+	}
+	if(distance && closest != -1) *distance = best;
+	return closest;
+}
+
+int AABBTree::allocateNode()
+{
+	int node = freeList;
+	if(node != NULL_NODE)
+	{
+		freeList = nodes[node].parent;
+		nodes[node] = TreeNode();
+	}
+	else
+	{
+		node = (int)nodes.size();
+		nodes.push_back(TreeNode());
+		boxes.push_back(BoundingBox());
+	}
+	return node;
+}
+
+void AABBTree::freeNode(int node)
+{
+	nodes[node].parent = freeList;
+	nodes[node].child1 = NULL_NODE;
+	nodes[node].child2 = NULL_NODE;
+	nodes[node].height = -1;
+	freeList = node;
+}
+
+void AABBTree::fatten(int leaf)
+{
+	const BoundingBox& box    = boxes[leaf];
+	Vec3               margin = Vec3(FAT_MARGIN) + (box.max - box.min) * FAT_SCALE;
+	nodes[leaf].fatBox.min = box.min - margin;
+	nodes[leaf].fatBox.max = box.max + margin;
+}
+
+void AABBTree::insertLeaf(int leaf)
+{
+	if(root == NULL_NODE)
+	{
+		root = leaf;
+		nodes[leaf].parent = NULL_NODE;
+		return;
+	}
+
+	// Walk down to the sibling that makes the tree's total surface area grow the least. Every
+	// ancestor grows by the same amount whichever way is taken, that part is the inherited cost.
+	BoundingBox leafBox = nodes[leaf].fatBox;
+	int         index   = root;
+	while(!nodes[index].isLeaf())
+	{
+		int   child1       = nodes[index].child1;
+		int   child2       = nodes[index].child2;
+		float area         = surfaceArea(nodes[index].fatBox);
+		float combinedArea = surfaceArea(combine(nodes[index].fatBox, leafBox));
+		float cost         = 2.f * combinedArea;              // New parent for this node and the leaf
+		float inheritance  = 2.f * (combinedArea - area);
+
+		float cost1 = surfaceArea(combine(nodes[child1].fatBox, leafBox)) + inheritance;
+		if(!nodes[child1].isLeaf()) cost1 -= surfaceArea(nodes[child1].fatBox);
+		float cost2 = surfaceArea(combine(nodes[child2].fatBox, leafBox)) + inheritance;
+		if(!nodes[child2].isLeaf()) cost2 -= surfaceArea(nodes[child2].fatBox);
+
+		if(cost < cost1 && cost < cost2) break;
+		index = cost1 < cost2 ? child1 : child2;
+	}
+
+	int sibling   = index;
+	int oldParent = nodes[sibling].parent;
+	int newParent = allocateNode(); // May grow nodes, so only indices are held across it
+	nodes[newParent].parent = oldParent;
+	nodes[newParent].fatBox = combine(leafBox, nodes[sibling].fatBox);
+	nodes[newParent].height = nodes[sibling].height + 1;
+	nodes[newParent].child1 = sibling;
+	nodes[newParent].child2 = leaf;
+	nodes[sibling].parent   = newParent;
+	nodes[leaf].parent      = newParent;
+	if(oldParent == NULL_NODE)
+	{
+		root = newParent;
+	}
+	else
+	{
+		if(nodes[oldParent].child1 == sibling)
+			nodes[oldParent].child1 = newParent;
+		else
+			nodes[oldParent].child2 = newParent;
+	}
+
+	// Refit the ancestors, rotating wherever one side got too deep
+	index = nodes[leaf].parent;
+	while(index != NULL_NODE)
+	{
+		index = balance(index);
+		int child1 = nodes[index].child1;
+		int child2 = nodes[index].child2;
+		nodes[index].height = 1 + std::max(nodes[child1].height, nodes[child2].height);
+		nodes[index].fatBox = combine(nodes[child1].fatBox, nodes[child2].fatBox);
+		index = nodes[index].parent;
+	}
+}
+
+void AABBTree::removeLeaf(int leaf)
+{
+	if(leaf == root)
+	{
+		root = NULL_NODE;
+		return;
+	}
+
+	// The parent goes away and the sibling takes its place
+	int parent      = nodes[leaf].parent;
+	int grandParent = nodes[parent].parent;
+	int sibling     = nodes[parent].child1 == leaf ? nodes[parent].child2 : nodes[parent].child1;
+	if(grandParent == NULL_NODE)
+	{
+		root = sibling;
+		nodes[sibling].parent = NULL_NODE;
+		freeNode(parent);
+		return;
+	}
+
+	if(nodes[grandParent].child1 == parent)
+		nodes[grandParent].child1 = sibling;
+	else
+		nodes[grandParent].child2 = sibling;
+	nodes[sibling].parent = grandParent;
+	freeNode(parent);
+
+	int index = grandParent;
+	while(index != NULL_NODE)
+	{
+		index = balance(index);
+		int child1 = nodes[index].child1;
+		int child2 = nodes[index].child2;
+		nodes[index].fatBox = combine(nodes[child1].fatBox, nodes[child2].fatBox);
+		nodes[index].height = 1 + std::max(nodes[child1].height, nodes[child2].height);
+		index = nodes[index].parent;
+	}
+}
+
+// If one child of a is more than one level deeper than the other, the deeper child c takes a's
+// place and a gets c's shallower child. Returns the node now at a's position.
+int AABBTree::balance(int a)
+{
+	if(nodes[a].isLeaf() || nodes[a].height < 2) return a;
+
+	int b = nodes[a].child1;
+	int c = nodes[a].child2;
+	int difference = nodes[c].height - nodes[b].height;
+	if(difference >= -1 && difference <= 1) return a;
+	if(difference < 0) std::swap(b, c); // c is the deeper child from here on
+
+	int f = nodes[c].child1;
+	int g = nodes[c].child2;
+
+	// c replaces a under a's parent
+	nodes[c].child1 = a;
+	nodes[c].parent = nodes[a].parent;
+	nodes[a].parent = c;
+	if(nodes[c].parent == NULL_NODE)
+		root = c;
+	else if(nodes[nodes[c].parent].child1 == a)
+		nodes[nodes[c].parent].child1 = c;
+	else
+		nodes[nodes[c].parent].child2 = c;
+
+	// The deeper of c's children stays with c, the other replaces c under a
+	if(nodes[f].height < nodes[g].height) std::swap(f, g);
+	nodes[c].child2 = f;
+	if(nodes[a].child1 == c)
+		nodes[a].child1 = g;
+	else
+		nodes[a].child2 = g;
+	nodes[g].parent = a;
+
+	nodes[a].fatBox = combine(nodes[b].fatBox, nodes[g].fatBox);
+	nodes[a].height = 1 + std::max(nodes[b].height, nodes[g].height);
+	nodes[c].fatBox = combine(nodes[a].fatBox, nodes[f].fatBox);
+	nodes[c].height = 1 + std::max(nodes[a].height, nodes[f].height);
+	return c;
+}
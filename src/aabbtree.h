@@ -0,0 +1,70 @@
+#ifndef aabbtree_H
+#define aabbtree_H
+
+#include <vector>
+#include <cinttypes>
+
+#include "boundingvolumes.h"
+
+// Dynamic bounding volume hierarchy over world space boxes. Leaves keep the exact box they were
+// given and a fattened copy that the tree is built from, so objects moving a little inside their
+// fat box cost nothing and only larger moves reinsert the leaf. Inserts pick the sibling that
+// grows the tree's surface area the least and rotations keep it balanced. Queries descend by the
+// fat boxes and test leaves against the exact ones, results are the user data of every hit leaf.
+// Only depends on the math types so tools and benchmarks can use it without the engine.
+class AABBTree
+{
+public:
+	AABBTree() {}
+
+	int     insert(const BoundingBox& box, int32_t userData); // Returns the leaf
+	void    remove(int leaf);
+	bool    move(int leaf, const BoundingBox& box);           // True if the leaf had to be reinserted
+	void    clear();
+	int32_t getUserData(int leaf) const      { return nodes[leaf].userData; }
+	const BoundingBox& getBox(int leaf) const { return boxes[leaf];          }
+	int     getLeafCount() const             { return leafCount;            }
+	int     getHeight() const                { return root != NULL_NODE ? nodes[root].height : 0; }
+
+	// Results are appended, nothing is cleared
+	void    query(const Frustum& frustum, std::vector<int32_t>* results) const;
+	void    query(const BoundingBox& box, std::vector<int32_t>* results) const;
+	void    query(const Vec3& center, float radius, std::vector<int32_t>* results) const;
+	// Closest leaf box hit within maxDistance along the normalized direction, -1 for none.
+	// distance is set to where the ray enters the box, 0 if it starts inside.
+	int32_t raycast(const Vec3& origin, const Vec3& direction, float maxDistance, float* distance = NULL) const;
+
+private:
+	static const int NULL_NODE = -1;
+
+	struct TreeNode
+	{
+		BoundingBox fatBox;               // Encloses both children for internal nodes
+		int32_t     parent   = NULL_NODE; // Next free node while on the free list
+		int32_t     child1   = NULL_NODE;
+		int32_t     child2   = NULL_NODE;
+		int32_t     height   = 0;         // 0 for leaves, -1 while free
+		int32_t     userData = -1;
+
+		bool isLeaf() const { return child1 == NULL_NODE; }
+	};
+
+	AABBTree(const AABBTree&);
+	AABBTree& operator=(const AABBTree&);
+
+	int  allocateNode();
+	void freeNode(int node);
+	void insertLeaf(int leaf);
+	void removeLeaf(int leaf);
+	int  balance(int node);
+	void fatten(int leaf);
+
+	std::vector<TreeNode>        nodes;
+	std::vector<BoundingBox>     boxes;     // Exact box of every leaf, apart so traversal touches less memory
+	mutable std::vector<int32_t> stack;     // Traversal scratch, queries are not thread safe
+	int32_t                      root      = NULL_NODE;
+	int32_t                      freeList  = NULL_NODE;
+	int                          leafCount = 0;
+};
+
+#endif
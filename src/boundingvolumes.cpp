@@ -3,13 +3,16 @@
 
 namespace BoundingVolume
 {
+	// The local box is moved with the transform's world matrix, rotated objects are tested with
+	// the world box around their rotated bounds
 	int isIntersecting(Frustum* frustum, BoundingBox* box, CTransform* transform)
 	{
-		Vec3 min = (box->min + transform->position) * transform->scale;
-		Vec3 max = (box->max + transform->position) * transform->scale;
-		Vec3 size = max - min;
-		Vec3 center = (max + min) / 2.f;
-		Vec3 halfExt = size / 2.f;
+		const Mat4& worldMatrix = Transform::getWorldMatrix(transform);
+		Vec3 center  = Vec3(worldMatrix * Vec4((box->max + box->min) / 2.f, 1.f));
+		Vec3 localHalfExt = (box->max - box->min) / 2.f;
+		Vec3 halfExt = glm::abs(Vec3(worldMatrix[0])) * localHalfExt.x +
+			           glm::abs(Vec3(worldMatrix[1])) * localHalfExt.y +
+			           glm::abs(Vec3(worldMatrix[2])) * localHalfExt.z;
 		for(int i = 0; i < 6; i++)
 		{
 			glm::vec3 normal(frustum->planes[i]);
@@ -27,7 +30,8 @@ namespace BoundingVolume
 	int isIntersecting(Frustum* frustum, BoundingSphere* sphere, CTransform* transform)
 	{
 		int intersectionType = IT_INSIDE;
-		Vec3 center = (sphere->center + transform->position) * transform->scale;	
+		// Only the center moves with the transform, the radius is in world units (a light's range)
+		Vec3 center = Vec3(Transform::getWorldMatrix(transform) * Vec4(sphere->center, 1.f));
 		for(int i = 0; i < 6; i++)
 		{
 			Vec3 planeNormal = Vec3(frustum->planes[i]);
@@ -4,13 +4,13 @@
 #include "gameobject.h"
 #include "scenemanager.h"
 #include "passert.h"
+#include "componentpool.h"
 
 namespace
 {
-	std::vector<Node>    cameras;
-	std::vector<CCamera> cameraList;
-	std::vector<int>     emptyIndices;
-	int                  activeCameraIndex;
+	std::vector<Node>      cameras;
+	ComponentPool<CCamera> cameraList;
+	ComponentHandle        activeCamera = -1; // Goes stale by itself when the camera is removed
 }
 	
 namespace Camera
@@ -23,30 +23,22 @@ namespace Camera
 
 	void initialize()
 	{
-		activeCameraIndex = -1;
+		activeCamera = -1;
 	}
 
 	CCamera* getActiveCamera()
 	{
-		return getCameraAtIndex(activeCameraIndex);
+		return cameraList.resolve(activeCamera);
 	}
 		
 	void setActiveCamera(CCamera* camera)
 	{
+		activeCamera = -1;
 		if(camera)
 		{
-			for(int i = 0; i < (int)cameraList.size(); i++)
-			{
-				if(camera->node == cameraList[i].node)
-				{
-					activeCameraIndex = i;
-					break;
-				}
-			}
-		}
-		else
-		{
-			activeCameraIndex = -1;
+			GameObject* gameObject = SceneManager::find(camera->node);
+			if(gameObject && GO::hasComponent(gameObject, Component::CAMERA))
+				activeCamera = cameraList.getHandle(gameObject->compIndices[Component::CAMERA]);
 		}
 	}
 		
@@ -54,24 +46,28 @@ namespace Camera
 	{
 		camera->farZ = farZ;
 		updateProjection(camera);
+		SceneManager::markDirty(camera->node);
 	}
 
 	void setNearZ(CCamera* camera, float nearZ)
 	{
 		camera->nearZ = nearZ;
 		updateProjection(camera);
+		SceneManager::markDirty(camera->node);
 	}
 
 	void setFov(CCamera* camera, float fov)
 	{
 		camera->fov = fov;
 		updateProjection(camera);
+		SceneManager::markDirty(camera->node);
 	}
 
 	void setAspectRatio(CCamera* camera, float aspectRatio)
 	{
 		camera->aspectRatio = aspectRatio;
 		updateProjection(camera);
+		SceneManager::markDirty(camera->node);
 	}		
 
 	void generateBindings()
@@ -135,7 +131,7 @@ namespace Camera
 	CCamera* getCameraAtIndex(int cameraIndex)
 	{
 		CCamera* camera = NULL;
-		if(cameraIndex >= 0 && cameraIndex < (int)cameraList.size())
+		if(cameraIndex >= 0 && cameraIndex < cameraList.size())
 			camera = &cameraList[cameraIndex];
 		// else
 		// 	Log::error("Camera::getCameraAtIndex", "Invalid cameraIndex " + std::to_string(cameraIndex));
@@ -145,8 +141,8 @@ namespace Camera
 	void updateAllCamerasAspectRatio(float aspectRatio)
 	{
 		if(aspectRatio <= 0.f) aspectRatio = 4.f / 3.f;
-		for(CCamera& camera : cameraList)
-			setAspectRatio(&camera, aspectRatio);
+		for(int cameraIndex : cameraList.getLive())
+			setAspectRatio(&cameraList[cameraIndex], aspectRatio);
 	}
 
 	void updateProjection(CCamera* camera)
@@ -215,9 +211,9 @@ namespace Camera
 		PA_ASSERT(camera);
 		GameObject* gameObject = SceneManager::find(camera->node);
 		CTransform* transform  = GO::getTransform(gameObject);
-		camera->viewMat = glm::lookAt(transform->position,
-									  transform->lookAt,
-									  transform->up);
+		camera->viewMat = glm::lookAt(Transform::getWorldPosition(transform),
+									  Transform::getWorldLookAt(transform),
+									  Transform::getWorldUp(transform));
 		updateViewProjection(camera);
 	}
 		
@@ -228,47 +224,33 @@ namespace Camera
 		newCamera.node = gameObject->node;
 		updateView(&newCamera);
 		updateProjection(&newCamera);			
-		int index = -1;
-		if(emptyIndices.empty())
-		{
-			cameraList.push_back(newCamera);
-			index = cameraList.size() - 1;
-		}
-		else
-		{
-			index = emptyIndices.back();
-			emptyIndices.pop_back();
-			cameraList[index] = newCamera;
-		}
+		int index = cameraList.create();
+		cameraList[index] = newCamera;
 		return index;
 	}
 
 	bool remove(int cameraIndex)
 	{
-		bool alreadyRemoved = false;
-		for(unsigned int i = 0; i < emptyIndices.size(); i++)
-		{
-			if(emptyIndices[i] == cameraIndex)
-			{
-				alreadyRemoved = true;
-				break;
-			}
-		}
+		bool alreadyRemoved = !cameraList.isValid(cameraIndex);
 		if(!alreadyRemoved)
 		{
-			emptyIndices.push_back(cameraIndex);
 			cameraList[cameraIndex].node = -1;
-			if(cameraIndex == activeCameraIndex) activeCameraIndex = -1;
+			cameraList.remove(cameraIndex);
 		}
 		else
 			Log::warning("Camera at index " + std::to_string(cameraIndex) + " already removed!");
 		return alreadyRemoved ? false : true;
 	}
 
+	void reserve(int count)
+	{
+		cameraList.reserve(count);
+	}
+
 	void cleanup()
 	{
 		cameraList.clear();
-		emptyIndices.clear();
+		activeCamera = -1;
 	}
 
 	bool writeToJSON(CCamera* camera, rapidjson::Writer<rapidjson::StringBuffer>& writer)
@@ -287,6 +269,35 @@ namespace Camera
 		return success;
 	}
 
+	void writeToBinary(CCamera* camera, SceneFormat::CameraRecord* record)
+	{
+		PA_ASSERT(camera);
+		PA_ASSERT(record);
+		CCamera* activeCamera  = getActiveCamera();
+		record->nearZ          = camera->nearZ;
+		record->farZ           = camera->farZ;
+		record->fov            = camera->fov;
+		record->aspectRatio    = camera->aspectRatio;
+		record->isOrthographic = camera->isOrthographic ? 1 : 0;
+		record->isActive       = activeCamera && camera->node == activeCamera->node ? 1 : 0;
+	}
+
+	bool createFromBinary(CCamera* camera, const SceneFormat::CameraRecord& record)
+	{
+		PA_ASSERT(camera);
+		bool success = true;
+		if(record.nearZ       > 0) camera->nearZ       = record.nearZ;       else success = false;
+		if(record.farZ        > 0) camera->farZ        = record.farZ;        else success = false;
+		if(record.fov         > 0) camera->fov         = record.fov;         else success = false;
+		if(record.aspectRatio > 0) camera->aspectRatio = record.aspectRatio; else success = false;
+		setOrthographic(camera, record.isOrthographic != 0);
+		if(record.isActive) setActiveCamera(camera);
+		updateView(camera);
+		updateProjection(camera);
+		if(!success) Log::error("Camera::createFromBinary", "Invalid value in a field");
+		return success;
+	}
+
 	bool createFromJSON(CCamera* camera, const rapidjson::Value& value)
     {
 		using namespace rapidjson;
@@ -390,5 +401,6 @@ namespace Camera
 		PA_ASSERT(camera);
 		camera->isOrthographic = ortho;
 		updateProjection(camera);
+		SceneManager::markDirty(camera->node);
 	}
 }
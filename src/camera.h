@@ -7,6 +7,7 @@
 #include "datatypes.h"
 #include "boundingvolumes.h"
 #include "jsondefs.h"
+#include "sceneformat.h"
 
 struct GameObject;
 struct CTransform;
@@ -39,6 +40,7 @@ namespace Camera
 	void     updateViewProjection(CCamera* camera);
 	void     updateFrustum(CCamera* camera);
 	bool     remove(int cameraIndex);
+	void     reserve(int count); // Makes room for count more cameras
 	void     cleanup();
 	void     updateAllCamerasAspectRatio(float aspectRatio);		
 	CCamera* getCameraAtIndex(int cameraIndex);
@@ -47,6 +49,8 @@ namespace Camera
 	void     setActiveCamera(CCamera* camera); // Pass camera as NULL to reset active camera to none
 	bool     createFromJSON(CCamera* camera, const rapidjson::Value& value);
 	bool     writeToJSON(CCamera* camera, rapidjson::Writer<rapidjson::StringBuffer>& writer);
+	bool     createFromBinary(CCamera* camera, const SceneFormat::CameraRecord& record);
+	void     writeToBinary(CCamera* camera, SceneFormat::CameraRecord* record);
 	void     setOrthographic(CCamera* camera, bool ortho);
 }
 
@@ -175,6 +175,8 @@ CollisionMesh::CollisionMesh(const char* filename, bool isTriMesh)
 
 void CollisionMesh::initialize()
 {
+	// Geometry drops the CPU copies of meshes after uploading them, keep them while building the shape
+	bool retained = Geometry::retainCPUData(geometryIndex);
 	const std::vector<Vec3>*         vertices = Geometry::getVertices(geometryIndex);
 	const std::vector<unsigned int>* indices  = Geometry::getIndices(geometryIndex);
 	if(vertices && vertices->size() > 3)
@@ -197,10 +199,9 @@ void CollisionMesh::initialize()
 		{
 			for(int i = 0; i < (int)indices->size(); i += 3)
 			{
-				unsigned int index = indices->at(i);
-				Vec3 vert1 = vertices->at(index);
-				Vec3 vert2 = vertices->at(index + 1);
-				Vec3 vert3 = vertices->at(index + 2);
+				Vec3 vert1 = vertices->at(indices->at(i));
+				Vec3 vert2 = vertices->at(indices->at(i + 1));
+				Vec3 vert3 = vertices->at(indices->at(i + 2));
 				btVector3 v1(Utils::toBullet(vert1));
 				btVector3 v2(Utils::toBullet(vert2));
 				btVector3 v3(Utils::toBullet(vert3));
@@ -222,10 +223,12 @@ void CollisionMesh::initialize()
 			delete tempConShape;
 		}
 		Physics::addCollisionShape(this);
+		if(retained) Geometry::releaseCPUData(geometryIndex);
 		Geometry::remove(geometryIndex);
 	}
 	else
 	{
+		if(retained) Geometry::releaseCPUData(geometryIndex);
 		Log::warning("CollisionMesh::Initialize : Model provided for collision mesh is Invalid");
 		valid = false;
 	}
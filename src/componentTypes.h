@@ -1,6 +1,8 @@
 #ifndef COMPONENTTYPES_H
 #define COMPONENTTYPES_H
 
+#include <cinttypes>
+
 enum Component : int
 {
     EMPTY          = -1,
@@ -12,4 +14,23 @@ enum Component : int
 	NUM_COMPONENTS =  6
 };
 
+// One bit per component type, a GameObject's signature has the bits of every component it has
+typedef uint32_t ComponentMask;
+
+inline constexpr ComponentMask componentBit(Component type)
+{
+	return (ComponentMask)1 << type;
+}
+
+inline constexpr ComponentMask componentMask()
+{
+	return 0;
+}
+
+template<typename... Types>
+inline constexpr ComponentMask componentMask(Component type, Types... rest)
+{
+	return componentBit(type) | componentMask(rest...);
+}
+
 #endif // COMPONENTTYPES_H
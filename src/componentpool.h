@@ -0,0 +1,143 @@
+#ifndef _componentpool_H
+#define _componentpool_H
+
+#include <vector>
+#include <algorithm>
+#include <cinttypes>
+
+// Handle to a pool slot that stays checkable after the slot is freed. Same layout as a
+// Node, low bits are the index and the high bits the generation of the slot.
+// Handles are opt-in, only code that keeps a component past the frame without going through
+// its object needs one, so far Camera's active camera. GameObject::compIndices stay plain
+// indices: GO resets them whenever it removes a component, and whoever keeps an object
+// (MotionState, scripts) holds its Node, which SceneManager::find checks the generation of.
+// Component pointers given to scripts are not checked, they must not be kept once the
+// component is removed.
+typedef int32_t ComponentHandle;
+
+// Storage for components of one type. Items live in fixed size chunks that are never
+// moved, so pointers to them stay valid while the pool grows. Freed slots are reused
+// before new ones, a dense list of live indices allows iterating without gaps.
+template<typename T, int CHUNK_BITS = 10>
+class ComponentPool
+{
+public:
+	static const int      CHUNK_SIZE        = 1 << CHUNK_BITS;
+	static const int32_t  HANDLE_INDEX_BITS = 20;
+	static const int32_t  HANDLE_INDEX_MASK = (1 << HANDLE_INDEX_BITS) - 1;
+	static const uint32_t GENERATION_MASK   = 0x7FF;
+
+	ComponentPool() {}
+	~ComponentPool() { clear(); }
+
+	// Returns the index of a default constructed item
+	int create()
+	{
+		int index = -1;
+		if(!freeIndices.empty())
+		{
+			index = freeIndices.back();
+			freeIndices.pop_back();
+		}
+		else
+		{
+			index = slotCount++;
+			if(index >= (int)chunks.size() * CHUNK_SIZE) chunks.push_back(new T[CHUNK_SIZE]);
+			generations.push_back(0);
+			livePositions.push_back(-1);
+		}
+		(*this)[index]       = T();
+		livePositions[index] = (int32_t)live.size();
+		live.push_back(index);
+		return index;
+	}
+
+	// Returns false if the slot was already free
+	bool remove(int index)
+	{
+		if(!isValid(index)) return false;
+		int position = livePositions[index];
+		int moved    = live.back();
+		live[position]       = moved;
+		livePositions[moved] = position;
+		live.pop_back();
+		livePositions[index] = -1;
+		generations[index]   = (generations[index] + 1) & GENERATION_MASK;
+		freeIndices.push_back(index);
+		return true;
+	}
+
+	// Makes room for count more items so creating them allocates nothing
+	void reserve(int count)
+	{
+		int newSlots = count - (int)freeIndices.size();
+		if(newSlots <= 0) return;
+		int capacity = slotCount + newSlots;
+		while((int)chunks.size() * CHUNK_SIZE < capacity) chunks.push_back(new T[CHUNK_SIZE]);
+		if(capacity <= (int)generations.capacity()) return;
+		// At least double so many small reservations don't copy the bookkeeping every time
+		capacity = std::max(capacity, (int)generations.capacity() * 2);
+		generations.reserve(capacity);
+		livePositions.reserve(capacity);
+		freeIndices.reserve(capacity);
+		live.reserve(capacity);
+	}
+
+	void clear()
+	{
+		for(T* chunk : chunks) delete[] chunk;
+		chunks.clear();
+		generations.clear();
+		livePositions.clear();
+		freeIndices.clear();
+		live.clear();
+		slotCount = 0;
+	}
+
+	bool isValid(int index) const
+	{
+		return index >= 0 && index < slotCount && livePositions[index] != -1;
+	}
+
+	// No checks, for indices known to be valid
+	T&       operator[](int index)       { return chunks[index >> CHUNK_BITS][index & (CHUNK_SIZE - 1)]; }
+	const T& operator[](int index) const { return chunks[index >> CHUNK_BITS][index & (CHUNK_SIZE - 1)]; }
+
+	// NULL if the index is out of range or free
+	T* get(int index)
+	{
+		return isValid(index) ? &(*this)[index] : NULL;
+	}
+
+	ComponentHandle getHandle(int index) const
+	{
+		if(!isValid(index)) return -1;
+		return (ComponentHandle)((generations[index] & GENERATION_MASK) << HANDLE_INDEX_BITS) | index;
+	}
+
+	// NULL if the item the handle was made for has been removed, even if the slot is in use again
+	T* resolve(ComponentHandle handle)
+	{
+		if(handle < 0) return NULL;
+		int      index      = handle & HANDLE_INDEX_MASK;
+		uint32_t generation = ((uint32_t)handle >> HANDLE_INDEX_BITS) & GENERATION_MASK;
+		return isValid(index) && generations[index] == generation ? &(*this)[index] : NULL;
+	}
+
+	int                     size() const      { return slotCount;         } // Highest index handed out + 1
+	int                     capacity() const  { return (int)chunks.size() * CHUNK_SIZE; }
+	const std::vector<int>& getLive() const   { return live;              } // Order changes when items are removed
+
+private:
+	ComponentPool(const ComponentPool&);
+	ComponentPool& operator=(const ComponentPool&);
+
+	std::vector<T*>       chunks;
+	std::vector<uint32_t> generations;
+	std::vector<int32_t>  livePositions; // Location in live, -1 if the slot is free
+	std::vector<int>      freeIndices;
+	std::vector<int>      live;
+	int                   slotCount = 0;
+};
+
+#endif
@@ -0,0 +1,214 @@
+#include "cullbatch.h"
+#include "passert.h"
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define PA_CULL_SSE
+#include <xmmintrin.h>
+#endif
+
+#ifdef __AVX__
+#define PA_CULL_AVX
+#include <immintrin.h>
+#endif
+
+namespace CullBatch
+{
+	namespace
+	{
+		// Negative enough that the box or sphere is behind every normalized plane, finite so no
+		// lane turns into a NaN that compares as visible
+		const float EMPTY_EXTENT = -1e30f;
+
+		// Every plane component broadcast once per call instead of once per entry
+		struct Planes
+		{
+			float x[6], y[6], z[6], w[6];
+			float absX[6], absY[6], absZ[6];
+		};
+
+		Planes getPlanes(const Frustum& frustum)
+		{
+			Planes planes;
+			for(int i = 0; i < 6; i++)
+			{
+				planes.x[i]    = frustum.planes[i].x;
+				planes.y[i]    = frustum.planes[i].y;
+				planes.z[i]    = frustum.planes[i].z;
+				planes.w[i]    = frustum.planes[i].w;
+				planes.absX[i] = glm::abs(planes.x[i]);
+				planes.absY[i] = glm::abs(planes.y[i]);
+				planes.absZ[i] = glm::abs(planes.z[i]);
+			}
+			return planes;
+		}
+
+		int getPaddedCount(int count)
+		{
+			return (count + LANES - 1) / LANES * LANES;
+		}
+
+		void prepareVisibility(const CullBounds& bounds, std::vector<uint32_t>* visibility)
+		{
+			PA_ASSERT(visibility);
+			visibility->assign((getPaddedCount(bounds.count) + 31) / 32, 0u);
+		}
+
+		// Same plane test as BoundingVolume::isIntersecting, projected extent is the radius for boxes
+		inline bool isVisibleOne(const Planes& planes, const CullBounds& bounds, bool spheres, int index)
+		{
+			const float x = bounds.centerX[index];
+			const float y = bounds.centerY[index];
+			const float z = bounds.centerZ[index];
+			for(int i = 0; i < 6; i++)
+			{
+				float distance = planes.x[i] * x + planes.y[i] * y + planes.z[i] * z + planes.w[i];
+				float radius   = spheres ? bounds.radius[index]
+					                     : planes.absX[i] * bounds.extentX[index] +
+					                       planes.absY[i] * bounds.extentY[index] +
+					                       planes.absZ[i] * bounds.extentZ[index];
+				if(distance + radius < 0.f) return false;
+			}
+			return true;
+		}
+
+#ifdef PA_CULL_SSE
+		// Lane i is entry index + i, returns their visibility in the low four bits
+		inline uint32_t cullFour(const Planes& planes, const CullBounds& bounds, bool spheres, int index)
+		{
+			const __m128 x    = _mm_loadu_ps(&bounds.centerX[index]);
+			const __m128 y    = _mm_loadu_ps(&bounds.centerY[index]);
+			const __m128 z    = _mm_loadu_ps(&bounds.centerZ[index]);
+			const __m128 zero = _mm_setzero_ps();
+			__m128 extentX, extentY, extentZ, sphereRadius;
+			if(spheres)
+				sphereRadius = _mm_loadu_ps(&bounds.radius[index]);
+			else
+			{
+				extentX = _mm_loadu_ps(&bounds.extentX[index]);
+				extentY = _mm_loadu_ps(&bounds.extentY[index]);
+				extentZ = _mm_loadu_ps(&bounds.extentZ[index]);
+			}
+			__m128 outside = zero;
+			for(int i = 0; i < 6; i++)
+			{
+				__m128 distance = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(planes.x[i]), x),
+																   _mm_mul_ps(_mm_set1_ps(planes.y[i]), y)),
+														_mm_mul_ps(_mm_set1_ps(planes.z[i]), z)),
+											 _mm_set1_ps(planes.w[i]));
+				__m128 radius = spheres ? sphereRadius
+					                    : _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(planes.absX[i]), extentX),
+					                                            _mm_mul_ps(_mm_set1_ps(planes.absY[i]), extentY)),
+					                                 _mm_mul_ps(_mm_set1_ps(planes.absZ[i]), extentZ));
+				outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(distance, radius), zero));
+			}
+			return (uint32_t)(~_mm_movemask_ps(outside) & 0xF);
+		}
+#endif
+
+#ifdef PA_CULL_AVX
+		// Lane i is entry index + i, returns their visibility in the low eight bits
+		inline uint32_t cullEight(const Planes& planes, const CullBounds& bounds, bool spheres, int index)
+		{
+			const __m256 x    = _mm256_loadu_ps(&bounds.centerX[index]);
+			const __m256 y    = _mm256_loadu_ps(&bounds.centerY[index]);
+			const __m256 z    = _mm256_loadu_ps(&bounds.centerZ[index]);
+			const __m256 zero = _mm256_setzero_ps();
+			__m256 extentX, extentY, extentZ, sphereRadius;
+			if(spheres)
+				sphereRadius = _mm256_loadu_ps(&bounds.radius[index]);
+			else
+			{
+				extentX = _mm256_loadu_ps(&bounds.extentX[index]);
+				extentY = _mm256_loadu_ps(&bounds.extentY[index]);
+				extentZ = _mm256_loadu_ps(&bounds.extentZ[index]);
+			}
+			__m256 outside = zero;
+			for(int i = 0; i < 6; i++)
+			{
+				__m256 distance = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(planes.x[i]), x),
+																			_mm256_mul_ps(_mm256_set1_ps(planes.y[i]), y)),
+															  _mm256_mul_ps(_mm256_set1_ps(planes.z[i]), z)),
+												_mm256_set1_ps(planes.w[i]));
+				__m256 radius = spheres ? sphereRadius
+					                    : _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(planes.absX[i]), extentX),
+					                                                  _mm256_mul_ps(_mm256_set1_ps(planes.absY[i]), extentY)),
+					                                    _mm256_mul_ps(_mm256_set1_ps(planes.absZ[i]), extentZ));
+				outside = _mm256_or_ps(outside, _mm256_cmp_ps(_mm256_add_ps(distance, radius), zero, _CMP_LT_OQ));
+			}
+			return (uint32_t)(~_mm256_movemask_ps(outside) & 0xFF);
+		}
+#endif
+	}
+
+	void resize(CullBounds* bounds, int count)
+	{
+		PA_ASSERT(bounds);
+		PA_ASSERT(count >= 0);
+		const int padded = getPaddedCount(count);
+		bounds->centerX.resize(padded, 0.f);
+		bounds->centerY.resize(padded, 0.f);
+		bounds->centerZ.resize(padded, 0.f);
+		bounds->extentX.resize(padded, EMPTY_EXTENT);
+		bounds->extentY.resize(padded, EMPTY_EXTENT);
+		bounds->extentZ.resize(padded, EMPTY_EXTENT);
+		bounds->radius.resize(padded, EMPTY_EXTENT);
+		// Entries dropped while shrinking may still be in the padding
+		for(int index = count; index < bounds->count && index < padded; index++) clear(bounds, index);
+		bounds->count = count;
+	}
+
+	void set(CullBounds* bounds, int index, const BoundingBox& box, float radius)
+	{
+		PA_ASSERT(bounds);
+		PA_ASSERT(index >= 0 && index < bounds->count);
+		const Vec3 center = (box.min + box.max) * 0.5f;
+		const Vec3 extent = (box.max - box.min) * 0.5f;
+		bounds->centerX[index] = center.x;
+		bounds->centerY[index] = center.y;
+		bounds->centerZ[index] = center.z;
+		bounds->extentX[index] = extent.x;
+		bounds->extentY[index] = extent.y;
+		bounds->extentZ[index] = extent.z;
+		bounds->radius[index]  = radius;
+	}
+
+	void clear(CullBounds* bounds, int index)
+	{
+		PA_ASSERT(bounds);
+		PA_ASSERT(index >= 0 && index < (int)bounds->radius.size());
+		bounds->centerX[index] = 0.f;
+		bounds->centerY[index] = 0.f;
+		bounds->centerZ[index] = 0.f;
+		bounds->extentX[index] = EMPTY_EXTENT;
+		bounds->extentY[index] = EMPTY_EXTENT;
+		bounds->extentZ[index] = EMPTY_EXTENT;
+		bounds->radius[index]  = EMPTY_EXTENT;
+	}
+
+	void cull(const Frustum& frustum, const CullBounds& bounds, bool spheres, std::vector<uint32_t>* visibility)
+	{
+		prepareVisibility(bounds, visibility);
+		const Planes planes = getPlanes(frustum);
+		const int    padded = getPaddedCount(bounds.count);
+		uint32_t*    words  = visibility->data();
+		int          index  = 0;
+		// Groups never straddle a word, LANES divides 32
+#if defined(PA_CULL_AVX)
+		for(; index < padded; index += 8)
+			words[index >> 5] |= cullEight(planes, bounds, spheres, index) << (index & 31);
+#elif defined(PA_CULL_SSE)
+		for(; index < padded; index += 4)
+			words[index >> 5] |= cullFour(planes, bounds, spheres, index) << (index & 31);
+#endif
+		for(; index < bounds.count; index++)
+			if(isVisibleOne(planes, bounds, spheres, index)) words[index >> 5] |= 1u << (index & 31);
+	}
+
+	void cullScalar(const Frustum& frustum, const CullBounds& bounds, bool spheres, std::vector<uint32_t>* visibility)
+	{
+		prepareVisibility(bounds, visibility);
+		const Planes planes = getPlanes(frustum);
+		for(int index = 0; index < bounds.count; index++)
+			if(isVisibleOne(planes, bounds, spheres, index)) (*visibility)[index >> 5] |= 1u << (index & 31);
+	}
+}
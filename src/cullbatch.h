@@ -0,0 +1,45 @@
+#ifndef cullbatch_H
+#define cullbatch_H
+
+#include <vector>
+#include <cinttypes>
+
+#include "boundingvolumes.h"
+
+// World space bounds of many objects as structure of arrays, so one instruction loads the same
+// coordinate of several objects. Boxes are a center and half extents, the spheres share the
+// center. Arrays are padded to a multiple of CullBatch::LANES, entries that were never set or
+// were cleared are empty and never visible.
+struct CullBounds
+{
+	std::vector<float> centerX;
+	std::vector<float> centerY;
+	std::vector<float> centerZ;
+	std::vector<float> extentX;
+	std::vector<float> extentY;
+	std::vector<float> extentZ;
+	std::vector<float> radius;
+	int                count = 0;
+};
+
+namespace CullBatch
+{
+	const int LANES = 8; // Entries per iteration of the widest kernel
+
+	void resize(CullBounds* bounds, int count); // New entries are empty
+	void set(CullBounds* bounds, int index, const BoundingBox& box, float radius);
+	void clear(CullBounds* bounds, int index);
+
+	// Sets bit index % 32 of visibility[index / 32] for every entry that is not completely behind
+	// one of the planes, testing the boxes or the spheres. Uses AVX eight and SSE four entries at a
+	// time when available. cullScalar tests one at a time with the same arithmetic, for comparison.
+	void cull(const Frustum& frustum, const CullBounds& bounds, bool spheres, std::vector<uint32_t>* visibility);
+	void cullScalar(const Frustum& frustum, const CullBounds& bounds, bool spheres, std::vector<uint32_t>* visibility);
+
+	inline bool isVisible(const std::vector<uint32_t>& visibility, int index)
+	{
+		return (visibility[index >> 5] >> (index & 31)) & 1;
+	}
+}
+
+#endif
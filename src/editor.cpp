@@ -19,6 +19,8 @@
 #include "utilities.h"
 #include "input.h"
 #include "scriptengine.h"
+#include "settings.h"
+#include "spatialindex.h"
 
 namespace Editor
 {
@@ -37,6 +39,8 @@ namespace Editor
 	void displayDebugTextures();
 	void checkKeys();
 	void displayScripts();
+	void pickObject();
+	void selectGameObject(GameObject* gameObject);
 	
 	struct DebugInt
 	{
@@ -74,6 +78,7 @@ namespace Editor
 		bool showDebugTextures    = false;
 		bool showSceneSave        = false;
 		bool showSceneLoad        = false;
+		float autosaveInterval    = 60.f; // Seconds, applied when a binary scene is saved
 		
 		const float OPACITY  = 1.f;
 		const int   BUF_SIZE = 128;
@@ -106,6 +111,15 @@ namespace Editor
 		std::vector<DebugInt> debugInts;
 		std::vector<DebugFloat> debugFloats;
 		std::vector<DebugTexture> debugTextures;;
+
+		// Scenes are saved and loaded as .pascene when the filename asks for it, json otherwise
+		bool isBinaryScene(const char* filename)
+		{
+			const char*  extension       = ".pascene";
+			const size_t extensionLength = strlen(extension);
+			size_t       length          = strlen(filename);
+			return length > extensionLength && strcmp(filename + length - extensionLength, extension) == 0;
+		}
 	}
 	
 	void initialize()
@@ -271,6 +285,8 @@ namespace Editor
 		CTransform* transform  = GO::getTransform(selectedGO);
 		if(ImGui::CollapsingHeader("Transform", "TransformComponent", true, true))
 		{
+			GameObject* parent = GO::getParent(selectedGO);
+			ImGui::Text("Parent: %s", parent ? parent->name.c_str() : "None");
 			static Transform::Space space = Transform::TS_WORLD;
 			ImGui::Text("Space"); ImGui::SameLine();
 			ImGui::RadioButton("World", (int*)&space, Transform::TS_WORLD); ImGui::SameLine();
@@ -281,20 +297,20 @@ namespace Editor
 			// Position
 			ImGui::PushID("Position");
 			ImGui::Text("Position");
-			Vec3 position = transform->position;
+			Vec3 position = Transform::getPosition(transform);
 			if(ImGui::InputFloat("X", &position.x, step, stepFast))
 			{
-				float translation = position.x - transform->position.x;
+				float translation = position.x - Transform::getPosition(transform).x;
 				Transform::translate(transform, Vec3(translation, 0, 0), space);
 			}
 			if(ImGui::InputFloat("Y", &position.y, step, stepFast))
 			{
-				float translation = position.y - transform->position.y;
+				float translation = position.y - Transform::getPosition(transform).y;
 				Transform::translate(transform, Vec3(0, translation, 0), space);
 			}
 			if(ImGui::InputFloat("Z", &position.z, step, stepFast))
 			{
-				float translation = position.z - transform->position.z;
+				float translation = position.z - Transform::getPosition(transform).z;
 				Transform::translate(transform, Vec3(0, 0, translation), space);
 			}
 			if(ImGui::Button("Reset")) Transform::setPosition(transform, Vec3(0.f));
@@ -304,13 +320,13 @@ namespace Editor
 				CCamera* camera = Camera::getActiveCamera();
 				GameObject* cameraGO = SceneManager::find(camera->node);
 				CTransform* cameraTransform = GO::getTransform(cameraGO);
-				Transform::setPosition(transform, cameraTransform->position);
+				Transform::setWorldPosition(transform, Transform::getWorldPosition(cameraTransform));
 			}
 			ImGui::Separator();
 			ImGui::PopID();
 
 			// Rotation
-			Vec3 eulerAngles = glm::eulerAngles(transform->rotation);
+			Vec3 eulerAngles = glm::eulerAngles(Transform::getRotation(transform));
 			Vec3 currentRot  = eulerAngles;
 			eulerAngles = glm::degrees(eulerAngles);
 			currentRot  = glm::degrees(currentRot);
@@ -338,19 +354,20 @@ namespace Editor
 				CCamera* camera = Camera::getActiveCamera();
 				GameObject* cameraGO = SceneManager::find(camera->node);
 				CTransform* cameraTransform = GO::getTransform(cameraGO);
-				Transform::setRotation(transform, cameraTransform->rotation);
+				Transform::setWorldRotation(transform, Transform::getWorldRotation(cameraTransform));
 			}
 			ImGui::Separator();
 			ImGui::PopID();
 
 			// Scale
 			bool updateScale = false;
+			Vec3 scale       = Transform::getScale(transform);
 			ImGui::PushID("Scale");
 			ImGui::Text("Scale");
-			if(ImGui::InputFloat("X", &transform->scale.x, step, stepFast))	updateScale = true;
-			if(ImGui::InputFloat("Y", &transform->scale.y, step, stepFast))	updateScale = true;
-			if(ImGui::InputFloat("Z", &transform->scale.z, step, stepFast)) updateScale = true;
-			if(updateScale)	Transform::setScale(transform, transform->scale);
+			if(ImGui::InputFloat("X", &scale.x, step, stepFast))	updateScale = true;
+			if(ImGui::InputFloat("Y", &scale.y, step, stepFast))	updateScale = true;
+			if(ImGui::InputFloat("Z", &scale.z, step, stepFast)) updateScale = true;
+			if(updateScale)	Transform::setScale(transform, scale);
 			if(ImGui::Button("Reset")) Transform::setScale(transform, Vec3(1.f));
 			ImGui::PopID();
 		}
@@ -540,7 +557,10 @@ namespace Editor
 					if(Utils::fileExists(&inputSceneLoad[0]))
 					{
 						SceneManager::cleanup();
-						SceneManager::loadScene(&inputSceneLoad[0]);
+						if(isBinaryScene(&inputSceneLoad[0]))
+							SceneManager::loadSceneBinary(&inputSceneLoad[0]);
+						else
+							SceneManager::loadScene(&inputSceneLoad[0]);
 					}
 					else
 					{
@@ -556,10 +576,25 @@ namespace Editor
 		{
 			if(ImGui::InputText("Save Scene as", &inputSceneSave[0], BUF_SIZE, ImGuiInputTextFlags_EnterReturnsTrue))
 			{
-				if(strlen(&inputSceneSave[0]) > 0) SceneManager::saveScene(&inputSceneSave[0]);
+				if(strlen(&inputSceneSave[0]) > 0)
+				{
+					// Binary scenes are written in the background and only with what changed since the
+					// last save to the same file, autosave keeps going to that file from then on
+					if(isBinaryScene(&inputSceneSave[0]))
+					{
+						if(!SceneManager::autosave(&inputSceneSave[0]))
+							Log::warning("Previous save is still being written, try again");
+						SceneManager::setAutosave(&inputSceneSave[0], autosaveInterval);
+					}
+					else
+					{
+						SceneManager::saveScene(&inputSceneSave[0]);
+					}
+				}
 				memset(&inputSceneSave[0], '\0', BUF_SIZE);
 				showSceneSave = false;
 			}
+			ImGui::InputFloat("Autosave every (s)", &autosaveInterval, 10.f, 60.f);
 		}
 		
 		std::vector<Node>* gameObjectNodes = SceneManager::getSceneObjects();
@@ -575,17 +610,7 @@ namespace Editor
 					ImGui::PushID(gameObject->node);
 					bool selected = selectedGONode == gameObject->node ? true : false;
 					if(ImGui::Selectable(gameObject->name.c_str(), selected))
-					{
-						// Selected gameobject changed so update all pointers
-						showSelectedGO = true;
-						selectedGONode = gameObject->node;
-						memset(&inputName[0], '\0', BUF_SIZE);
-						int copySize = gameObject->name.size() > BUF_SIZE ? BUF_SIZE : gameObject->name.size();
-						memcpy(&inputName[0], &gameObject->name[0], copySize);
-						copySize = gameObject->tag.size() > BUF_SIZE ? BUF_SIZE : gameObject->tag.size();
-						memcpy(&inputTag[0], &gameObject->tag[0], copySize);
-						updateComponentViewers();
-					}
+						selectGameObject(gameObject);
 					ImGui::PopID();
 				}
 			}
@@ -631,10 +656,10 @@ namespace Editor
 			GameObject* selectedGO = SceneManager::find(selectedGONode);
 			ImGui::Begin(selectedGO->name.c_str(), &showSelectedGO, Vec2(450, 400), OPACITY);
 			if(ImGui::InputText("Name", &inputName[0], BUF_SIZE, ImGuiInputTextFlags_EnterReturnsTrue))
-				selectedGO->name = inputName;
+				SceneManager::rename(selectedGO, inputName);
 
 			if(ImGui::InputText("Tag", &inputTag[0], BUF_SIZE, ImGuiInputTextFlags_EnterReturnsTrue))
-				selectedGO->tag = inputTag;
+				SceneManager::setTag(selectedGO, inputTag);
 
 			displayScripts();
 			ImGui::Separator();
@@ -709,7 +734,9 @@ namespace Editor
 			if(GO::hasComponent(selectedGO, Component::LIGHT))	   displayLight(selectedGONode);
 			if(GO::hasComponent(selectedGO, Component::MODEL))     displayModel(selectedGONode);
 			if(GO::hasComponent(selectedGO, Component::CAMERA))	   displayCamera(selectedGONode);				
-			if(GO::hasComponent(selectedGO, Component::RIGIDBODY)) displayRigidBody(selectedGONode);				
+			if(GO::hasComponent(selectedGO, Component::RIGIDBODY)) displayRigidBody(selectedGONode);
+			// The fields above are written in place, anything being edited may have changed the object
+			if(ImGui::IsAnyItemActive()) SceneManager::markDirty(selectedGONode);
 			ImGui::End();
 		}
 	}
@@ -760,6 +787,8 @@ namespace Editor
 		ImGui::Text("Fps    : %.1f", ImGui::GetIO().Framerate);
 		ImGui::Text("Update : %.2f", updateTime);
 		ImGui::Text("Draw   : %.2f", drawTime);
+		if(SceneManager::isLoading())
+			ImGui::Text("Loading: %.0f%%", SceneManager::getLoadProgress() * 100.f);
 		ImGui::End();
 	}
 
@@ -868,6 +897,8 @@ namespace Editor
 		ImGui::End();
 
 		checkKeys();
+		if(Input::isReleased(Input::M_LEFT) && Input::isCursorVisible() && !ImGui::GetIO().WantCaptureMouse)
+			pickObject();
 		// Selectable list of gameobjects currently in the scene
 		if(showSceneObjects)     displaySceneObjects();
 		if(showRendererSettings) displayRendererSettings();
@@ -882,6 +913,40 @@ namespace Editor
 		debugTextures.clear();
 	}
 	
+	// Selects the closest object whose bounds are under the mouse. The ray starts on the near
+	// plane so the active camera's own object, which sits behind it, is never hit.
+	void pickObject()
+	{
+		CCamera* camera = Camera::getActiveCamera();
+		if(!camera) return;
+		float x = (2.f * Input::getMouseX()) / Settings::getWindowWidth() - 1.f;
+		float y = 1.f - (2.f * Input::getMouseY()) / Settings::getWindowHeight();
+		Mat4 inverseViewProj = glm::inverse(camera->viewProjMat);
+		Vec4 nearPoint       = inverseViewProj * Vec4(x, y, -1.f, 1.f);
+		Vec4 farPoint        = inverseViewProj * Vec4(x, y,  1.f, 1.f);
+		Vec3 origin          = Vec3(nearPoint) / nearPoint.w;
+		Vec3 direction       = Vec3(farPoint) / farPoint.w - origin;
+		GameObject* gameObject = SceneManager::find(SpatialIndex::raycast(origin, direction, glm::length(direction)));
+		if(gameObject)
+		{
+			showSceneObjects = true;
+			selectGameObject(gameObject);
+		}
+	}
+
+	void selectGameObject(GameObject* gameObject)
+	{
+		// Selected gameobject changed so update all pointers
+		showSelectedGO = true;
+		selectedGONode = gameObject->node;
+		memset(&inputName[0], '\0', BUF_SIZE);
+		int copySize = gameObject->name.size() > BUF_SIZE ? BUF_SIZE : gameObject->name.size();
+		memcpy(&inputName[0], &gameObject->name[0], copySize);
+		copySize = gameObject->tag.size() > BUF_SIZE ? BUF_SIZE : gameObject->tag.size();
+		memcpy(&inputTag[0], &gameObject->tag[0], copySize);
+		updateComponentViewers();
+	}
+	
 	void cleanup()
 	{
 		debugInts.clear();
@@ -29,7 +29,7 @@ Game::Game(const char* path)
 	System::initialize();
 	Gui::initialize();
 	
-	SceneManager::loadScene("../content/scenes/testsave.json");
+	SceneManager::loadSceneAsync("../content/scenes/testsave.json");
 }
 
 Game::~Game()
@@ -8,15 +8,31 @@
 #include "passert.h"
 #include "motionstate.h"
 #include "rigidbody.h"
+#include "scenemanager.h"
+#include "spatialindex.h"
 
 namespace GO
 {
+	namespace
+	{
+		// Every change of a component index goes through here to keep the signature, the
+		// packed copy in SceneManager and, for the components bounds come from, the spatial index up to date
+		void setComponentIndex(GameObject* gameObject, Component type, int index)
+		{
+			gameObject->compIndices[type] = index;
+			if(index != EMPTY_INDEX)
+				gameObject->signature |= componentBit(type);
+			else
+				gameObject->signature &= ~componentBit(type);
+			SceneManager::updateSignature(gameObject);
+			SceneManager::markDirty(gameObject->node);
+			if(type == Component::TRANSFORM || type == Component::MODEL) SpatialIndex::update(gameObject);
+		}
+	}
+
     bool hasComponent(GameObject* gameObject, Component type)
 	{
-		if(gameObject->compIndices[(int)type] == -1)
-			return false;
-		else
-			return true;
+		return (gameObject->signature & componentBit(type)) != 0;
 	}
 	
 	void generateBindings()
@@ -32,12 +48,43 @@ namespace GO
 		
 		rc = engine->RegisterObjectType("GameObject", sizeof(GameObject), asOBJ_REF | asOBJ_NOCOUNT);
 		PA_ASSERT(rc >= 0);
-		rc = engine->RegisterObjectProperty("GameObject", "string name", asOFFSET(GameObject, name));
+		// Name and tag are read-only in scripts so renames go through SceneManager and keep its lookup tables valid
+		rc = engine->RegisterObjectProperty("GameObject", "const string name", asOFFSET(GameObject, name));
+		PA_ASSERT(rc >= 0);
+		rc = engine->RegisterObjectProperty("GameObject", "const string tag", asOFFSET(GameObject, tag));
+		PA_ASSERT(rc >= 0);
+		rc = engine->RegisterObjectMethod("GameObject",
+										  "void setName(const string &in)",
+										  asFUNCTION(SceneManager::rename),
+										  asCALL_CDECL_OBJFIRST);
 		PA_ASSERT(rc >= 0);
-		rc = engine->RegisterObjectProperty("GameObject", "string tag", asOFFSET(GameObject, tag));
+		rc = engine->RegisterObjectMethod("GameObject",
+										  "void setTag(const string &in)",
+										  asFUNCTION(SceneManager::setTag),
+										  asCALL_CDECL_OBJFIRST);
 		PA_ASSERT(rc >= 0);
 		rc = engine->RegisterObjectProperty("GameObject", "int32 node", asOFFSET(GameObject, node));
 		PA_ASSERT(rc >= 0);
+		rc = engine->RegisterObjectMethod("GameObject",
+										  "bool setParent(GameObject@)",
+										  asFUNCTION(setParent),
+										  asCALL_CDECL_OBJFIRST);
+		PA_ASSERT(rc >= 0);
+		rc = engine->RegisterObjectMethod("GameObject",
+										  "GameObject@ getParent()",
+										  asFUNCTION(getParent),
+										  asCALL_CDECL_OBJFIRST);
+		PA_ASSERT(rc >= 0);
+		rc = engine->RegisterObjectMethod("GameObject",
+										  "int getChildCount()",
+										  asFUNCTION(getChildCount),
+										  asCALL_CDECL_OBJFIRST);
+		PA_ASSERT(rc >= 0);
+		rc = engine->RegisterObjectMethod("GameObject",
+										  "GameObject@ getChild(int)",
+										  asFUNCTION(getChild),
+										  asCALL_CDECL_OBJFIRST);
+		PA_ASSERT(rc >= 0);
 		rc = engine->RegisterObjectMethod("GameObject",
 										  "Transform@ getTransform()",
 										  asFUNCTION(getTransform),
@@ -121,7 +168,7 @@ namespace GO
 		{
 			int index = Transform::create(gameObject->node);
 			
-			gameObject->compIndices[(int)Component::TRANSFORM] = index;
+			setComponentIndex(gameObject, Component::TRANSFORM, index);
 			Log::message("Transform added to " + gameObject->name);
 			newTransform = Transform::getTransformAtIndex(index);
 		}
@@ -140,7 +187,7 @@ namespace GO
 		{
 			int index = Light::create(gameObject->node);
 			
-			gameObject->compIndices[(int)Component::LIGHT] = index;
+			setComponentIndex(gameObject, Component::LIGHT, index);
 			Log::message("Light added to " + gameObject->name);
 			newLight = Light::getLightAtIndex(index);
 			newLight->color = color;
@@ -159,7 +206,7 @@ namespace GO
 		if(!hasComponent(gameObject, Component::CAMERA))
 		{
 			int index = Camera::create(gameObject);
-			gameObject->compIndices[(int)Component::CAMERA] = index;
+			setComponentIndex(gameObject, Component::CAMERA, index);
 			Log::message("Camera added to " + gameObject->name);
 			newCamera = Camera::getCameraAtIndex(index);
 		}
@@ -180,7 +227,7 @@ namespace GO
 			int index = Model::create(filename.c_str());
 			if(index != -1)
 			{
-				gameObject->compIndices[Component::MODEL] = index;
+				setComponentIndex(gameObject, Component::MODEL, index);
 				Log::message("Model added to " + gameObject->name);
 				newModel = Model::getModelAtIndex(index);
 				newModel->node = gameObject->node;
@@ -199,6 +246,29 @@ namespace GO
 		return newModel;
 	}
 
+	CModel* addModelCopy(GameObject* gameObject, const CModel* source)
+	{
+		PA_ASSERT(gameObject);
+		CModel* newModel = NULL;
+		if(hasComponent(gameObject, Component::MODEL))
+		{
+			Log::warning("Removing existing Model from " + gameObject->name);
+			removeComponent(gameObject, Component::MODEL);
+		}
+		int index = Model::createFromTemplate(source);
+		if(index != -1)
+		{
+			setComponentIndex(gameObject, Component::MODEL, index);
+			newModel = Model::getModelAtIndex(index);
+			newModel->node = gameObject->node;
+		}
+		else
+		{
+			Log::error("GO::addModelCopy", "Model component not added to " + gameObject->name);
+		}
+		return newModel;
+	}
+
 	CRigidBody addRigidbody(GameObject* gameObject, CollisionShape* shape, float mass, float restitution)
 	{
 		PA_ASSERT(gameObject);
@@ -207,7 +277,7 @@ namespace GO
 		{
 			MotionState* motionState = new MotionState(gameObject);
 			rigidbody = RigidBody::create(gameObject, shape, motionState, mass, restitution);
-			gameObject->compIndices[Component::RIGIDBODY] = rigidbody;
+			setComponentIndex(gameObject, Component::RIGIDBODY, rigidbody);
 			Log::message("Rigidbody added to " + gameObject->name);
 		}
 		else
@@ -278,7 +348,7 @@ namespace GO
 		if(hasComponent(gameObject, type))
 		{
 			int index = gameObject->compIndices[type];
-			gameObject->compIndices[type] = EMPTY_INDEX;
+			setComponentIndex(gameObject, type, EMPTY_INDEX);
 			
 			switch(type)
 			{
@@ -307,6 +377,72 @@ namespace GO
 		}
 	}
 
+	void removeComponents(const std::vector<GameObject*>& gameObjects, Component type)
+	{
+		// Transforms and models have batch removal, the rest are few enough to go one by one
+		if(type != Component::TRANSFORM && type != Component::MODEL)
+		{
+			for(GameObject* gameObject : gameObjects) removeComponent(gameObject, type);
+			return;
+		}
+
+		std::vector<int> indices;
+		indices.reserve(gameObjects.size());
+		for(GameObject* gameObject : gameObjects)
+		{
+			PA_ASSERT(gameObject);
+			if(hasComponent(gameObject, type))
+			{
+				indices.push_back(gameObject->compIndices[type]);
+				setComponentIndex(gameObject, type, EMPTY_INDEX);
+			}
+		}
+		if(indices.empty()) return;
+		if(type == Component::TRANSFORM)
+			Transform::remove(indices);
+		else
+			Model::remove(indices);
+	}
+
+	bool setParent(GameObject* gameObject, GameObject* parent)
+	{
+		PA_ASSERT(gameObject);
+		CTransform* transform       = getTransform(gameObject);
+		CTransform* parentTransform = parent ? getTransform(parent) : NULL;
+		if(!transform || (parent && !parentTransform)) return false;
+		return Transform::setParent(transform, parentTransform);
+	}
+
+	GameObject* getParent(GameObject* gameObject)
+	{
+		PA_ASSERT(gameObject);
+		GameObject* parent    = NULL;
+		CTransform* transform = getTransform(gameObject);
+		CTransform* parentTransform = transform ? Transform::getParent(transform) : NULL;
+		if(parentTransform) parent = SceneManager::find(Transform::getNode(parentTransform));
+		return parent;
+	}
+
+	int getChildCount(GameObject* gameObject)
+	{
+		PA_ASSERT(gameObject);
+		CTransform* transform = getTransform(gameObject);
+		return transform ? Transform::getChildCount(transform) : 0;
+	}
+
+	GameObject* getChild(GameObject* gameObject, int childIndex)
+	{
+		PA_ASSERT(gameObject);
+		GameObject* child     = NULL;
+		CTransform* transform = getTransform(gameObject);
+		CTransform* childTransform = transform ? Transform::getChild(transform, childIndex) : NULL;
+		if(childTransform)
+			child = SceneManager::find(Transform::getNode(childTransform));
+		else
+			Log::error("GO::getChild", "Invalid child index for " + gameObject->name);
+		return child;
+	}
+
 	void syncComponents(GameObject* gameObject, bool syncPhysics)
 	{
 		PA_ASSERT(gameObject);
@@ -322,8 +458,10 @@ namespace GO
 		{
 			CRigidBody  rigidbody = getRigidBody(gameObject);
 			CTransform* transform = getTransform(gameObject);
-			RigidBody::setTransform(rigidbody, transform->transMat);
+			RigidBody::setTransform(rigidbody, Transform::getWorldMatrix(transform));
 			RigidBody::setActivation(rigidbody, true);
 		}
+		SpatialIndex::update(gameObject);
+		SceneManager::markDirty(gameObject->node);
 	}
 }
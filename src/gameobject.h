@@ -25,6 +25,7 @@ struct GameObject
 	bool        remove = false;
 	int         scriptIndex = -1;
 	int compIndices[6] = {-1, -1, -1, -1, -1, -1};
+	ComponentMask signature = 0; // componentBit of every entry in compIndices that is set
 	void (*collisionCallback)(GameObject*, const CollisionData*) = NULL; // Function called at collision
 };
 
@@ -34,11 +35,20 @@ namespace GO
 	void generateBindings();
 	void processCollision(GameObject* gameObject, const CollisionData* collisionData);
 	void removeComponent(GameObject* gameObject, Component type);
+	void removeComponents(const std::vector<GameObject*>& gameObjects, Component type); // Same type from many objects at once
 	void syncComponents(GameObject* gameObject, bool syncPhysics);
 
+	// Links are kept by the transforms, parent can be NULL to detach. The child keeps its
+	// current world transform. Returns false if the link would create a cycle.
+	bool        setParent(GameObject* gameObject, GameObject* parent);
+	GameObject* getParent(GameObject* gameObject);
+	int         getChildCount(GameObject* gameObject);
+	GameObject* getChild(GameObject* gameObject, int childIndex);
+
 	CTransform* addTransform(GameObject* gameObject);
 	CCamera*    addCamera(GameObject* gameObject);
 	CModel*     addModel(GameObject* gameObject, const std::string& filename);
+	CModel*     addModelCopy(GameObject* gameObject, const CModel* source);
 	CLight*     addLight(GameObject* gameObject, Vec4 color = Vec4(1.f));
 	CRigidBody  addRigidbody(GameObject*     gameObject,
 							 CollisionShape* shape,
@@ -1,5 +1,8 @@
 #include <GL/glew.h>
 #include <GL/gl.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
 
 #include "geometry.h"
 #include "log.h"
@@ -7,6 +10,13 @@
 #include "renderer.h"
 #include "boundingvolumes.h"
 #include "editor.h"
+#include "loadprofiler.h"
+#include "geometryarena.h"
+#include "meshoptimizer.h"
+#include "meshformat.h"
+#include "utilities.h"
+#include "resourceregistry.h"
+#include "settings.h"
 
 namespace Geometry
 {
@@ -14,20 +24,24 @@ namespace Geometry
 	
 	struct GeometryData
 	{
-		std::string               filename    = "UNDEFINED";
 		bool                      drawIndexed = false;
 		std::vector<Vec3>         vertices;
 		std::vector<Vec3>         vertexColors;
 		std::vector<Vec3>         normals;
 		std::vector<Vec2>         uvs;
 		std::vector<unsigned int> indices;
-		unsigned int              vao;
-		unsigned int              vertexVBO;
-		unsigned int              uvVBO;
-		unsigned int              normalVBO;
-		unsigned int              colorVBO;
-		unsigned int              indexVBO;
-		unsigned int              refCount;
+		int                       allocation  = -1; // In GeometryArena, attributes interleaved, see upload
+		unsigned int              indexType   = GL_UNSIGNED_INT;
+		uint32_t                  vertexCount = 0;  // Uploaded, the vectors may be empty
+		uint32_t                  indexCount  = 0;
+		int                       lodCount    = 1;  // Levels after the full mesh share its vertices and follow its indices
+		uint32_t                  lodIndexOffsets[MAX_LODS] = {0}; // In bytes from the mesh's first index
+		uint32_t                  lodIndexCounts[MAX_LODS]  = {0};
+		bool                      hasSource   = false; // Loaded from a file, so CPU copies can be dropped and reloaded
+		int                       cpuRetainCount = 0;
+		bool                      quantizePositions = false;
+		Vec3                      positionScale     = Vec3(1.f); // Decodes stored positions, (1, 1, 1) and (0, 0, 0) for floats
+		Vec3                      positionBias      = Vec3(0.f);
 		BoundingBox               boundingBox;
 		BoundingSphere            boundingSphere;
 	};
@@ -38,6 +52,114 @@ namespace Geometry
 		std::vector<uint32_t>     emptyIndices;
 		char*                     geometryPath;
 		int                       cullingMode = CM_BOX;
+		bool                      quantizePositions = true;
+		bool                      optimizeOnLoad    = true; // Read by loader threads, only set it during startup
+		bool                      keepCPUData       = false;
+
+		const int POSITION_SIZE_QUANTIZED = 4 * sizeof(uint16_t); // unorm16 xyz and padding
+		const int POSITION_SIZE_FLOAT     = 3 * sizeof(float);
+		const int NORMAL_SIZE             = sizeof(uint32_t);     // snorm 10-10-10-2 or snorm8 xyz and padding
+		const int UV_SIZE                 = sizeof(uint32_t);     // Two half floats, tiling uvs go past unorm range
+		const int COLOR_SIZE              = sizeof(uint32_t);     // unorm8 rgb and padding
+		// Projected diameter of the bounding sphere over the viewport height below which the
+		// first simplified level is drawn, halving for every further level. Matches the error
+		// MeshOptimizer::generateLods allows, which doubles per level.
+		const float LOD_SCREEN_SIZE       = 0.25f;
+
+		inline int32_t toSnorm(float value, float range)
+		{
+			return (int32_t)roundf(glm::clamp(value, -1.f, 1.f) * range);
+		}
+
+		uint32_t packNormal(const Vec3& normal, bool packed1010102)
+		{
+			if(packed1010102)
+			{
+				return ((uint32_t)toSnorm(normal.x, 511.f) & 0x3FF)       |
+					   ((uint32_t)toSnorm(normal.y, 511.f) & 0x3FF) << 10 |
+					   ((uint32_t)toSnorm(normal.z, 511.f) & 0x3FF) << 20;
+			}
+			return ((uint32_t)toSnorm(normal.x, 127.f) & 0xFF)      |
+				   ((uint32_t)toSnorm(normal.y, 127.f) & 0xFF) << 8 |
+				   ((uint32_t)toSnorm(normal.z, 127.f) & 0xFF) << 16;
+		}
+
+		uint32_t packColor(const Vec3& color)
+		{
+			Vec3 clamped = glm::clamp(color, 0.f, 1.f) * 255.f;
+			return (uint32_t)roundf(clamped.x) | (uint32_t)roundf(clamped.y) << 8 | (uint32_t)roundf(clamped.z) << 16;
+		}
+
+		// What upload reads, the vectors of a mesh or the pages of a mapped cooked file
+		struct Streams
+		{
+			const Vec3*     vertices     = NULL;
+			const Vec3*     normals      = NULL;
+			const Vec2*     uvs          = NULL;
+			const Vec3*     vertexColors = NULL;
+			const uint32_t* indices      = NULL;
+			size_t          vertexCount  = 0;
+			size_t          normalCount  = 0;
+			size_t          uvCount      = 0;
+			size_t          colorCount   = 0;
+			size_t          indexCount   = 0;
+			const uint32_t* lodIndices   = NULL;
+			int             lodCount     = 0;
+			uint32_t        lodIndexCounts[MAX_LODS - 1] = {0};
+		};
+
+		void setLods(Streams* streams, const uint32_t* lodIndices, const uint32_t* lodIndexCounts, size_t lodCount)
+		{
+			streams->lodIndices = lodIndices;
+			streams->lodCount   = (int)std::min(lodCount, (size_t)MAX_LODS - 1);
+			for(int i = 0; i < streams->lodCount; i++) streams->lodIndexCounts[i] = lodIndexCounts[i];
+		}
+
+		Streams getStreams(const GeometryData& geometry)
+		{
+			Streams streams;
+			streams.vertices     = geometry.vertices.data();
+			streams.normals      = geometry.normals.data();
+			streams.uvs          = geometry.uvs.data();
+			streams.vertexColors = geometry.vertexColors.data();
+			streams.indices      = geometry.indices.data();
+			streams.vertexCount  = geometry.vertices.size();
+			streams.normalCount  = geometry.normals.size();
+			streams.uvCount      = geometry.uvs.size();
+			streams.colorCount   = geometry.vertexColors.size();
+			streams.indexCount   = geometry.indices.size();
+			return streams;
+		}
+
+		Streams getStreams(const MeshFormat::MeshView& view)
+		{
+			Streams streams;
+			streams.vertices    = view.vertices;
+			streams.normals     = view.normals;
+			streams.uvs         = view.uvs;
+			streams.indices     = view.indices;
+			streams.vertexCount = view.header->vertexCount;
+			streams.normalCount = view.header->normalCount;
+			streams.uvCount     = view.header->uvCount;
+			streams.indexCount  = view.header->indexCount;
+			setLods(&streams, view.lodIndices, view.header->lodIndexCounts, view.header->lodCount);
+			return streams;
+		}
+
+		template<typename T>
+		void freeVector(std::vector<T>* values)
+		{
+			std::vector<T>().swap(*values);
+		}
+
+		void dropCPUData(GeometryData* geometry)
+		{
+			freeVector(&geometry->vertices);
+			freeVector(&geometry->normals);
+			freeVector(&geometry->uvs);
+			freeVector(&geometry->vertexColors);
+			freeVector(&geometry->indices);
+		}
 	}
 
 	int createNewIndex()
@@ -63,186 +185,304 @@ namespace Geometry
 
 	int find(const char* filename)
 	{
-		int index = -1;
-		for(int i = 0; i < (int)geometryList.size(); i++)
+		return ResourceRegistry::find<ResourceRegistry::RT_GEOMETRY>(filename).slot;
+	}
+
+	void generateBoundingBox(GeometryData* geometry)
+	{
+		MeshFormat::computeBounds(geometry->vertices,
+								  &geometry->boundingBox.min,
+								  &geometry->boundingBox.max,
+								  &geometry->boundingSphere.center,
+								  &geometry->boundingSphere.radius);
+	}
+
+	// A cooked file next to the source is used unless the source changed after cooking,
+	// it is optimized and has its bounds already. Otherwise the source is read and prepared here.
+	bool readFile(const char* filename, GeometryFileData* data)
+	{
+		PA_ASSERT(filename);
+		PA_ASSERT(data);
+		LoadProfiler::ScopedTimer timer(LoadProfiler::LP_GEOMETRY, filename);
+		// Called from loader threads, so no logging here. geometryPath is only written by initialize.
+		std::string fullPath   = std::string(geometryPath) + filename;
+		std::string cookedPath = MeshFormat::getCookedPath(fullPath.c_str());
+		if(MeshFormat::isCookedCurrent(cookedPath.c_str(), fullPath.c_str()))
 		{
-			if(strcmp(geometryList[i].filename.c_str(), filename) == 0)
+			size_t                size    = 0;
+			const void*           mapping = Utils::mapFile(cookedPath.c_str(), &size, false);
+			MeshFormat::MeshView  view;
+			std::string           error;
+			if(mapping && MeshFormat::read(mapping, size, &view, &error))
 			{
-				index = i;
-				break;
+				const MeshFormat::Header* header = view.header;
+				data->mapping      = mapping;
+				data->mappingSize  = size;
+				data->boundsMin    = Vec3(header->boundsMin[0], header->boundsMin[1], header->boundsMin[2]);
+				data->boundsMax    = Vec3(header->boundsMax[0], header->boundsMax[1], header->boundsMax[2]);
+				data->sphereCenter = Vec3(header->sphereCenter[0], header->sphereCenter[1], header->sphereCenter[2]);
+				data->sphereRadius = header->sphereRadius;
+				data->hasBounds    = true;
+				return true;
 			}
+			Utils::unmapFile(mapping, size);
 		}
-		return index;
+
+		bool success = MeshFormat::readSource(fullPath.c_str(), data);
+		// The exporter writes a vertex for every triangle corner, weld and reorder them
+		if(success && optimizeOnLoad)
+		{
+			MeshOptimizer::optimize(data);
+			MeshOptimizer::generateLods(data);
+		}
+		return success;
+	}
+
+	void freeFileData(GeometryFileData* data)
+	{
+		PA_ASSERT(data);
+		Utils::unmapFile(data->mapping, data->mappingSize);
+		data->mapping     = NULL;
+		data->mappingSize = 0;
 	}
 
-	void generateBoundingBox(int index)
+	// Moves the contents of a mapped file into the vectors
+	bool copyMapping(GeometryFileData* data)
 	{
-		BoundingBox*    boundingBox    = &geometryList[index].boundingBox;
-		BoundingSphere* boundingSphere = &geometryList[index].boundingSphere;
-		for(Vec3& vertex : geometryList[index].vertices)
+		MeshFormat::MeshView view;
+		std::string          error;
+		bool success = MeshFormat::read(data->mapping, data->mappingSize, &view, &error);
+		if(success) MeshFormat::copy(view, data);
+		freeFileData(data);
+		return success;
+	}
+
+	void upload(GeometryData* geometry, const Streams& streams);
+
+	// Takes the contents of data and uploads them, the CPU copies are kept only when asked for
+	bool setFromFileData(GeometryData* geometry, const char* filename, GeometryFileData* data)
+	{
+		geometry->drawIndexed       = true;
+		geometry->hasSource         = true;
+		geometry->quantizePositions = quantizePositions;
+		if(data->hasBounds)
 		{
-			if(vertex.x > boundingBox->max.x) boundingBox->max.x = vertex.x;
-			if(vertex.y > boundingBox->max.y) boundingBox->max.y = vertex.y;
-			if(vertex.z > boundingBox->max.z) boundingBox->max.z = vertex.z;
+			geometry->boundingBox.min       = data->boundsMin;
+			geometry->boundingBox.max       = data->boundsMax;
+			geometry->boundingSphere.center = data->sphereCenter;
+			geometry->boundingSphere.radius = data->sphereRadius;
+		}
 
-			if(vertex.x < boundingBox->min.x) boundingBox->min.x = vertex.x;
-			if(vertex.y < boundingBox->min.y) boundingBox->min.y = vertex.y;
-			if(vertex.z < boundingBox->min.z) boundingBox->min.z = vertex.z;
+		const bool mapped = data->mapping != NULL;
+		if(mapped)
+		{
+			MeshFormat::MeshView view;
+			std::string          error;
+			if(!MeshFormat::read(data->mapping, data->mappingSize, &view, &error))
+			{
+				Log::error("Geometry::setFromFileData", std::string(filename) + " : " + error);
+				freeFileData(data);
+				return false;
+			}
+			// Straight from the mapped pages, nothing is copied to the heap first
+			upload(geometry, getStreams(view));
+			if(keepCPUData) MeshFormat::copy(view, data);
+			freeFileData(data);
 		}
-		boundingSphere->center = (boundingBox->max + boundingBox->min) / 2.f;
-		boundingSphere->radius = glm::abs(glm::length(boundingBox->max - boundingSphere->center));
+		geometry->indices.swap(data->indices);
+		geometry->vertices.swap(data->vertices);
+		geometry->normals.swap(data->normals);
+		geometry->uvs.swap(data->uvs);
+		if(!data->hasBounds) generateBoundingBox(geometry);
+		if(!mapped)
+		{
+			Streams streams = getStreams(*geometry);
+			setLods(&streams, data->lodIndices.data(), data->lodIndexCounts.data(), data->lodIndexCounts.size());
+			upload(geometry, streams);
+		}
+		freeVector(&data->lodIndices);
+		freeVector(&data->lodIndexCounts);
+		if(!keepCPUData)     dropCPUData(geometry);
+		return true;
 	}
 
 	bool loadFromFile(GeometryData* geometry, const char* filename)
 	{
-		PA_ASSERT(filename);
-		bool success = true;
-		char* fullPath = (char *)malloc(sizeof(char) * (strlen(geometryPath) + strlen(filename)) + 1);
-		strcpy(fullPath, geometryPath);
-		strcat(fullPath, filename);
-			
-		FILE* file = fopen(fullPath, "rb");
-		free(fullPath);
-		if(file)
-		{				
-			const uint32_t INDEX_SIZE = sizeof(uint32_t);
-			const uint32_t VEC3_SIZE  = sizeof(Vec3);
-			const uint32_t VEC2_SIZE  = sizeof(Vec2);
-			uint32_t header[4];
-			size_t bytesRead = 0;
-			if((bytesRead = fread(header, INDEX_SIZE, 4, file)) <= 0)
+		GeometryFileData data;
+		bool success = readFile(filename, &data) && setFromFileData(geometry, filename, &data);
+		if(!success)
+			Log::error("Geometry::loadFromFile", "Could not read " + std::string(filename));
+		return success;
+	}
+
+	// Interleaves the vertices into the arena of their format. Positions are unorm16 scaled to
+	// the bounding box unless quantization was off when the mesh was created, normals are
+	// signed 10 bit, uvs half floats and colors unorm8. Shaders get the position decode from
+	// positionScale and positionBias, see commonVert.glsl. About half the size of float streams.
+	void upload(GeometryData* geometry, const Streams& streams)
+	{
+		PA_ASSERT(geometry);
+		const size_t vertexCount    = streams.vertexCount;
+		const bool   hasNormals     = streams.normalCount > 0;
+		const bool   hasUVs         = streams.uvCount > 0;
+		const bool   hasColors      = streams.colorCount > 0;
+		const bool   packed1010102  = GLEW_VERSION_3_3 || GLEW_ARB_vertex_type_2_10_10_10_rev;
+
+		GeometryArena::VertexFormat format;
+		if(geometry->quantizePositions)
+			format.add(0, 3, GL_UNSIGNED_SHORT, true, POSITION_SIZE_QUANTIZED);
+		else
+			format.add(0, 3, GL_FLOAT, false, POSITION_SIZE_FLOAT);
+		const int normalOffset = format.stride;
+		if(hasNormals)
+		{
+			if(packed1010102)
+				format.add(1, 4, GL_INT_2_10_10_10_REV, true, NORMAL_SIZE);
+			else
+				format.add(1, 3, GL_BYTE, true, NORMAL_SIZE);
+		}
+		const int uvOffset = format.stride;
+		if(hasUVs) format.add(2, 2, GL_HALF_FLOAT, false, UV_SIZE);
+		const int colorOffset = format.stride;
+		if(hasColors) format.add(3, 3, GL_UNSIGNED_BYTE, true, COLOR_SIZE);
+		const int stride = format.stride;
+
+		Vec3 invScale(0.f);
+		if(geometry->quantizePositions)
+		{
+			const BoundingBox& box  = geometry->boundingBox;
+			geometry->positionBias  = box.min;
+			geometry->positionScale = box.max - box.min;
+			for(int i = 0; i < 3; i++)
+				if(geometry->positionScale[i] > 0.f) invScale[i] = 65535.f / geometry->positionScale[i];
+		}
+
+		// Shorter normal, uv and color lists than vertices, like the renderer's quad, are padded with zero
+		std::vector<uint8_t> vertexData(vertexCount * stride, 0);
+		for(size_t i = 0; i < vertexCount; i++)
+		{
+			uint8_t*    vertex   = &vertexData[i * stride];
+			const Vec3& position = streams.vertices[i];
+			if(geometry->quantizePositions)
 			{
-				Log::error("Geometry::loadFromFile", "Read failed");
-				success = false;
+				uint16_t quantized[4] = {0, 0, 0, 0};
+				for(int axis = 0; axis < 3; axis++)
+				{
+					float value = (position[axis] - geometry->positionBias[axis]) * invScale[axis];
+					quantized[axis] = (uint16_t)roundf(glm::clamp(value, 0.f, 65535.f));
+				}
+				memcpy(vertex, quantized, POSITION_SIZE_QUANTIZED);
 			}
 			else
 			{
-				uint32_t indicesCount  = header[0];
-				uint32_t verticesCount = header[1];
-				uint32_t normalsCount  = header[2];
-				uint32_t uvsCount      = header[3];
-				// Indices
-				geometry->indices.reserve(indicesCount);
-				geometry->indices.insert(geometry->indices.begin(), indicesCount, 0);				
-				fread(&geometry->indices[0], INDEX_SIZE, indicesCount, file);
-				// Vertices
-				geometry->vertices.reserve(verticesCount);
-				geometry->vertices.insert(geometry->vertices.begin(), verticesCount, Vec3(0.f));
-				fread(&geometry->vertices[0], VEC3_SIZE, verticesCount, file);
-				// Normals
-				geometry->normals.reserve(normalsCount);
-				geometry->normals.insert(geometry->normals.begin(), normalsCount, Vec3(0.f));				
-				fread(&geometry->normals[0], VEC3_SIZE, normalsCount, file);
-				// UVs
-				geometry->uvs.reserve(uvsCount);
-				geometry->uvs.insert(geometry->uvs.begin(), uvsCount, Vec2(0.f));				
-				fread(&geometry->uvs[0], VEC2_SIZE, uvsCount, file);					
+				memcpy(vertex, &position[0], POSITION_SIZE_FLOAT);
+			}
+
+			if(hasNormals && i < streams.normalCount)
+			{
+				uint32_t normal = packNormal(streams.normals[i], packed1010102);
+				memcpy(vertex + normalOffset, &normal, NORMAL_SIZE);
+			}
+			if(hasUVs && i < streams.uvCount)
+			{
+				uint32_t uv = glm::packHalf2x16(streams.uvs[i]);
+				memcpy(vertex + uvOffset, &uv, UV_SIZE);
+			}
+			if(hasColors && i < streams.colorCount)
+			{
+				uint32_t color = packColor(streams.vertexColors[i]);
+				memcpy(vertex + colorOffset, &color, COLOR_SIZE);
 			}
-			fclose(file);
-			geometry->filename    = filename;
-			geometry->drawIndexed = true;
-			geometry->refCount++;
 		}
-		else
+
+		// LODs follow the full mesh's indices in the same allocation
+		size_t totalIndexCount = streams.indexCount;
+		for(int i = 0; i < streams.lodCount; i++) totalIndexCount += streams.lodIndexCounts[i];
+		std::vector<uint32_t> allIndices;
+		const uint32_t*       indices = streams.indices;
+		if(streams.lodCount > 0)
 		{
-			success = false;
+			allIndices.reserve(totalIndexCount);
+			allIndices.assign(streams.indices, streams.indices + streams.indexCount);
+			allIndices.insert(allIndices.end(), streams.lodIndices, streams.lodIndices + (totalIndexCount - streams.indexCount));
+			indices = allIndices.data();
 		}
-		
-		return success;
-	}
 
-	void createVAO(GeometryData* geometry)
-	{
-		// TODO : Add support for different model formats and interleaving VBO
-		PA_ASSERT(geometry);
+		// Indices are narrowed to 16 bit whenever every vertex can be addressed with them
+		std::vector<uint16_t> shortIndices;
+		const void*           indexData  = indices;
+		uint32_t              indexSize  = sizeof(uint32_t);
+		geometry->indexType = GL_UNSIGNED_INT;
+		if(vertexCount <= 65536)
+		{
+			shortIndices.assign(indices, indices + totalIndexCount);
+			indexData           = shortIndices.data();
+			indexSize           = sizeof(uint16_t);
+			geometry->indexType = GL_UNSIGNED_SHORT;
+		}
+		const uint32_t indexBytes = (uint32_t)(totalIndexCount * indexSize);
+
+		geometry->lodCount           = 1 + streams.lodCount;
+		geometry->lodIndexOffsets[0] = 0;
+		geometry->lodIndexCounts[0]  = (uint32_t)streams.indexCount;
+		for(int i = 1; i < geometry->lodCount; i++)
+		{
+			geometry->lodIndexOffsets[i] = geometry->lodIndexOffsets[i - 1] + geometry->lodIndexCounts[i - 1] * indexSize;
+			geometry->lodIndexCounts[i]  = streams.lodIndexCounts[i - 1];
+		}
 
-		glGenVertexArrays(1, &geometry->vao);
-		glBindVertexArray(geometry->vao);
-
-		glGenBuffers(1, &geometry->vertexVBO);
-		glBindBuffer(GL_ARRAY_BUFFER, geometry->vertexVBO);
-		glBufferData(GL_ARRAY_BUFFER,
-					 geometry->vertices.size() * sizeof(Vec3),
-					 geometry->vertices.data(),
-					 GL_STATIC_DRAW);
-		Renderer::checkGLError("Geometry::createVBO::vertex");
-		glEnableVertexAttribArray(0);
-		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, 0);
-
-		if(geometry->normals.size() > 0)
-		{
-			glGenBuffers(1, &geometry->normalVBO);
-			glBindBuffer(GL_ARRAY_BUFFER, geometry->normalVBO);
-			glBufferData(GL_ARRAY_BUFFER,
-						 geometry->normals.size() * sizeof(Vec3),
-						 geometry->normals.data(),
-						 GL_STATIC_DRAW);
-			Renderer::checkGLError("Geometry::createVBO::normal");
-			glEnableVertexAttribArray(1);
-			glVertexAttribPointer(1, 3, GL_FLOAT, GL_TRUE, 0, 0);
-		}
-
-		if(geometry->uvs.size() > 0)
-		{
-			glGenBuffers(1, &geometry->uvVBO);
-			glBindBuffer(GL_ARRAY_BUFFER, geometry->uvVBO);
-			glBufferData(GL_ARRAY_BUFFER,
-						 geometry->uvs.size() * sizeof(Vec2),
-						 geometry->uvs.data(),
-						 GL_STATIC_DRAW);
-			Renderer::checkGLError("Geometry::createVBO::uv");
-			glEnableVertexAttribArray(2);
-			glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 0, 0);
-		}
-
-		if(geometry->vertexColors.size() > 0)
-		{
-			glGenBuffers(1, &geometry->colorVBO);
-			glBindBuffer(GL_ARRAY_BUFFER, geometry->colorVBO);
-			glBufferData(GL_ARRAY_BUFFER,
-						 geometry->vertexColors.size() * sizeof(Vec3),
-						 geometry->vertexColors.data(),
-						 GL_STATIC_DRAW);
-			Renderer::checkGLError("Geometry::createVBO::color");
-			glEnableVertexAttribArray(3);
-			glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, 0, 0);
-		}
-
-		if(geometry->indices.size() > 0)
-		{
-			glGenBuffers(1, &geometry->indexVBO);
-			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, geometry->indexVBO);
-			glBufferData(GL_ELEMENT_ARRAY_BUFFER,
-						 geometry->indices.size() * sizeof(GLuint),
-						 geometry->indices.data(),
-						 GL_STATIC_DRAW);
-			geometry->drawIndexed = true;
-		}
-		glBindVertexArray(0);
+		geometry->drawIndexed = streams.indexCount > 0;
+		geometry->vertexCount = (uint32_t)vertexCount;
+		geometry->indexCount  = (uint32_t)streams.indexCount;
+		geometry->allocation  = GeometryArena::allocate(GeometryArena::findFormat(format),
+														vertexData.data(),
+														(uint32_t)vertexCount,
+														indexData,
+														indexBytes);
 	}
 	
 	int create(const char* filename)
 	{
-		// check if exists
-		int index = find(filename);
-		if(index == -1)
+		LoadProfiler::ScopedTimer timer(LoadProfiler::LP_GEOMETRY, filename);
+		ResourceRegistry::GeometryHandle handle = ResourceRegistry::find<ResourceRegistry::RT_GEOMETRY>(filename);
+		if(handle.isValid())
 		{
-			index = createNewIndex();
-			GeometryData* newGeo = &geometryList[index];
-			if(loadFromFile(newGeo, filename))
-			{
-				createVAO(newGeo);
-				generateBoundingBox(index);
-			}
-			else
-			{
-				geometryList.pop_back();
-				index = -1;
-			}
+			ResourceRegistry::addRef(ResourceRegistry::RT_GEOMETRY, handle.slot);
+			return handle.slot;
+		}
+		int index = createNewIndex();
+		if(loadFromFile(&geometryList[index], filename))
+		{
+			ResourceRegistry::insert(ResourceRegistry::RT_GEOMETRY, index, filename);
 		}
 		else
 		{
-			geometryList[index].refCount++;
+			emptyIndices.push_back(index);
+			index = -1;
+		}
+		return index;
+	}
+
+	int create(const char* filename, GeometryFileData* data)
+	{
+		PA_ASSERT(data);
+		LoadProfiler::ScopedTimer timer(LoadProfiler::LP_GEOMETRY, filename);
+		ResourceRegistry::GeometryHandle handle = ResourceRegistry::find<ResourceRegistry::RT_GEOMETRY>(filename);
+		if(handle.isValid())
+		{
+			ResourceRegistry::addRef(ResourceRegistry::RT_GEOMETRY, handle.slot);
+			freeFileData(data);
+			return handle.slot;
+		}
+		int index = createNewIndex();
+		if(setFromFileData(&geometryList[index], filename, data))
+		{
+			ResourceRegistry::insert(ResourceRegistry::RT_GEOMETRY, index, filename);
+		}
+		else
+		{
+			emptyIndices.push_back(index);
+			index = -1;
 		}
 		return index;
 	}
@@ -250,7 +490,11 @@ namespace Geometry
 	unsigned int getVAO(int index)
 	{
 		unsigned int vao = 0;
-		if(index >= 0 && index < (int)geometryList.size()) vao = geometryList[index].vao;
+		if(index >= 0 && index < (int)geometryList.size())
+		{
+			const GeometryArena::Allocation* allocation = GeometryArena::get(geometryList[index].allocation);
+			if(allocation) vao = GeometryArena::getVAO(allocation->format);
+		}
 		return vao;
 	}
 	
@@ -265,32 +509,69 @@ namespace Geometry
 		free(geometryPath);
 		geometryList.clear();
 		emptyIndices.clear();
+		ResourceRegistry::clear(ResourceRegistry::RT_GEOMETRY);
+		GeometryArena::cleanup();
 	}
 	
 	void remove(int index)
 	{
 		if(index >= 0 && index < (int)geometryList.size())
 		{
-			if(--geometryList[index].refCount == 0)
+			if(ResourceRegistry::release(ResourceRegistry::RT_GEOMETRY, index) == 0)
 			{
+				ResourceRegistry::remove(ResourceRegistry::RT_GEOMETRY, index);
 				emptyIndices.push_back(index);
-				glDeleteBuffers(1, &geometryList[index].vertexVBO);
-				glDeleteBuffers(1, &geometryList[index].normalVBO);
-				glDeleteBuffers(1, &geometryList[index].colorVBO);
-				glDeleteBuffers(1, &geometryList[index].uvVBO);
-				glDeleteBuffers(1, &geometryList[index].indexVBO);
-				glDeleteVertexArrays(1, &geometryList[index].vao);
-				geometryList[index].vertices.clear();
-				geometryList[index].indices.clear();
-				geometryList[index].normals.clear();
-				geometryList[index].uvs.clear();
-				geometryList[index].vertexColors.clear();
-				geometryList[index].filename.clear();
+				GeometryArena::release(geometryList[index].allocation);
+				dropCPUData(&geometryList[index]);
+				geometryList[index].allocation     = -1;
+				geometryList[index].vertexCount    = 0;
+				geometryList[index].indexCount     = 0;
+				geometryList[index].lodCount       = 1;
+				geometryList[index].hasSource      = false;
+				geometryList[index].cpuRetainCount = 0;
 			}
 		}
 	}
 
-	int render(int index, Frustum* frustum, CTransform* transform)
+	void increaseRefCount(int index)
+	{
+		if(index >= 0 && index < (int)geometryList.size())
+			ResourceRegistry::addRef(ResourceRegistry::RT_GEOMETRY, index);
+		else
+			Log::error("Geometry::increaseRefCount", "Invalid geometry index " + std::to_string(index));
+	}
+
+	// Indices are relative to the mesh, the base vertex moves them to where it sits in the arena
+	int draw(GeometryData* geometry, int lod)
+	{
+		const GeometryArena::Allocation* allocation = GeometryArena::get(geometry->allocation);
+		if(!allocation) return 0;
+		GeometryArena::bind(allocation->format);
+		int vertCount = 0;
+		if(geometry->drawIndexed)
+		{
+			lod       = glm::clamp(lod, 0, geometry->lodCount - 1);
+			vertCount = (int)geometry->lodIndexCounts[lod];
+			glDrawElementsBaseVertex(GL_TRIANGLES,
+									 vertCount,
+									 geometry->indexType,
+									 (void*)(intptr_t)(allocation->indexOffset + geometry->lodIndexOffsets[lod]),
+									 allocation->firstVertex);
+		}
+		else
+		{
+			vertCount = (int)geometry->vertexCount;
+			glDrawArrays(GL_TRIANGLES, allocation->firstVertex, vertCount);
+		}
+		return vertCount;
+	}
+
+	void unbind()
+	{
+		GeometryArena::unbind();
+	}
+
+	int render(int index, Frustum* frustum, CTransform* transform, int lod)
 	{
 		int vertCount = 0;
 		if(index >= 0 && index < (int)geometryList.size())
@@ -302,46 +583,133 @@ namespace Geometry
 			else if(cullingMode == CM_SPHERE)
 				intersection = BoundingVolume::isIntersecting(frustum, &geometry->boundingSphere, transform);
 			if(intersection == IT_INTERSECT || intersection == IT_INSIDE)
-			{
-				glBindVertexArray(geometry->vao);
-				if(geometry->drawIndexed)
-				{
-					glDrawElements(GL_TRIANGLES, geometry->indices.size(), GL_UNSIGNED_INT, (void*)0);
-					vertCount = geometry->indices.size();
-				}
-				else
-				{
-					glDrawArrays(GL_TRIANGLES, 0, geometry->vertices.size());
-					vertCount = geometry->vertices.size();
-				}
-				glBindVertexArray(0);
-			}
+				vertCount = draw(geometry, lod);
 		}
 		return vertCount;
 	}
 
-	void render(int index)
+	int render(int index, int lod)
 	{
+		int vertCount = 0;
 		if(index >= 0 && index < (int)geometryList.size())
-		{
-			GeometryData* geometry = &geometryList[index];
-			glBindVertexArray(geometry->vao);
-			if(geometry->drawIndexed)
-				glDrawElements(GL_TRIANGLES, geometry->indices.size(), GL_UNSIGNED_INT, (void*)0);
-			else
-				glDrawArrays(GL_TRIANGLES, 0, geometry->vertices.size());
-			glBindVertexArray(0);
-		}
+			vertCount = draw(&geometryList[index], lod);
+		return vertCount;
+	}
+
+	int getLodCount(int index)
+	{
+		return index >= 0 && index < (int)geometryList.size() ? geometryList[index].lodCount : 0;
+	}
+
+	// Coarser levels are only taken once the size is a band below their threshold and finer ones
+	// a band above, so meshes sitting at a threshold don't switch back and forth every frame
+	int selectLod(int index, float screenSize, int currentLod)
+	{
+		const int lodCount = getLodCount(index);
+		if(lodCount <= 1) return 0;
+		const float band  = glm::clamp(Settings::getLodHysteresis(), 0.f, 0.9f);
+		const float scale = exp2f(Settings::getLodBias()); // Each step of bias moves the thresholds by a level
+		auto threshold = [scale](int level) { return LOD_SCREEN_SIZE * scale / (float)(1 << (level - 1)); };
+
+		int lod = glm::clamp(currentLod, 0, lodCount - 1);
+		while(lod + 1 < lodCount && screenSize < threshold(lod + 1) * (1.f - band)) lod++;
+		while(lod > 0 && screenSize > threshold(lod) * (1.f + band)) lod--;
+		return lod;
+	}
+
+	const BoundingBox* getBoundingBox(int index)
+	{
+		const BoundingBox* boundingBox = NULL;
+		if(index >= 0 && index < (int)geometryList.size())
+			boundingBox = &geometryList[index].boundingBox;
+		return boundingBox;
 	}
 	
-	const std::string getName(int index)
+	const BoundingSphere* getBoundingSphere(int index)
 	{
-		std::string filename;
+		const BoundingSphere* boundingSphere = NULL;
 		if(index >= 0 && index < (int)geometryList.size())
-			filename = geometryList[index].filename;
-		return filename;
+			boundingSphere = &geometryList[index].boundingSphere;
+		return boundingSphere;
+	}
+
+	const std::string getName(int index)
+	{
+		const char* filename = ResourceRegistry::getPath(ResourceRegistry::RT_GEOMETRY, index);
+		return filename ? filename : "";
 	}
 	
+	bool retainCPUData(int index)
+	{
+		if(index < 0 || index >= (int)geometryList.size())
+		{
+			Log::error("Geometry::retainCPUData", "Invalid geometry index " + std::to_string(index));
+			return false;
+		}
+		GeometryData* geometry = &geometryList[index];
+		if(geometry->cpuRetainCount++ > 0 || !geometry->hasSource || !geometry->vertices.empty())
+			return true;
+
+		// Dropped after uploading, read the file again. It gives the same order the arena has.
+		const std::string filename = getName(index);
+		GeometryFileData  data;
+		bool success = readFile(filename.c_str(), &data);
+		if(success && data.mapping) success = copyMapping(&data);
+		if(success && (data.vertices.size() != geometry->vertexCount || data.indices.size() != geometry->indexCount))
+		{
+			Log::error("Geometry::retainCPUData", filename + " changed since it was uploaded");
+			success = false;
+		}
+		else if(!success)
+		{
+			Log::error("Geometry::retainCPUData", "Could not read " + filename);
+		}
+
+		if(success)
+		{
+			geometry->vertices.swap(data.vertices);
+			geometry->normals.swap(data.normals);
+			geometry->uvs.swap(data.uvs);
+			geometry->indices.swap(data.indices);
+		}
+		else
+		{
+			geometry->cpuRetainCount--;
+		}
+		return success;
+	}
+
+	void releaseCPUData(int index)
+	{
+		if(index < 0 || index >= (int)geometryList.size())
+		{
+			Log::error("Geometry::releaseCPUData", "Invalid geometry index " + std::to_string(index));
+			return;
+		}
+		GeometryData* geometry = &geometryList[index];
+		if(geometry->cpuRetainCount > 0 && --geometry->cpuRetainCount == 0 && geometry->hasSource && !keepCPUData)
+			dropCPUData(geometry);
+	}
+
+	void setKeepCPUData(bool enable)
+	{
+		keepCPUData = enable;
+	}
+
+	size_t getCPUBytes()
+	{
+		size_t bytes = 0;
+		for(const GeometryData& geometry : geometryList)
+		{
+			bytes += geometry.vertices.capacity()     * sizeof(Vec3) +
+					 geometry.normals.capacity()      * sizeof(Vec3) +
+					 geometry.uvs.capacity()          * sizeof(Vec2) +
+					 geometry.vertexColors.capacity() * sizeof(Vec3) +
+					 geometry.indices.capacity()      * sizeof(uint32_t);
+		}
+		return bytes;
+	}
+
 	const std::vector<Vec3>* getVertices(int index)
 	{
 		const std::vector<Vec3>* vertices = NULL;
@@ -403,9 +771,11 @@ namespace Geometry
 		newGeo->indices.reserve(indices->size());
 		newGeo->indices = std::vector<unsigned int>(*indices);
 		
-		newGeo->filename = name;
-		createVAO(newGeo);
-		generateBoundingBox(index);
+		// Generated meshes like the renderer's quad feed shaders that take positions as they are
+		newGeo->quantizePositions = false;
+		generateBoundingBox(newGeo);
+		upload(newGeo, getStreams(*newGeo));
+		ResourceRegistry::insert(ResourceRegistry::RT_GEOMETRY, index, name);
 		return index;
 	}
 
@@ -413,4 +783,24 @@ namespace Geometry
 	{
 		return cullingMode;
 	}
+
+	void setPositionQuantization(bool enable)
+	{
+		quantizePositions = enable;
+	}
+
+	void setOptimizeOnLoad(bool enable)
+	{
+		optimizeOnLoad = enable;
+	}
+
+	bool getPositionDecode(int index, Vec3* scale, Vec3* bias)
+	{
+		PA_ASSERT(scale);
+		PA_ASSERT(bias);
+		bool valid = index >= 0 && index < (int)geometryList.size();
+		*scale = valid ? geometryList[index].positionScale : Vec3(1.f);
+		*bias  = valid ? geometryList[index].positionBias  : Vec3(0.f);
+		return valid;
+	}
 }
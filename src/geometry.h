@@ -8,6 +8,8 @@
 
 struct CTransform;
 struct Frustum;
+struct BoundingBox;
+struct BoundingSphere;
 
 enum CullingMode
 {
@@ -18,17 +20,62 @@ enum CullingMode
 
 namespace Geometry
 {
+	const int MAX_LODS = 4; // The full mesh and up to three simplified levels
+
+	// Contents of a geometry file, filled by readFile without touching GL or shared state
+	struct GeometryFileData
+	{
+		std::vector<Vec3>         vertices;
+		std::vector<Vec3>         normals;
+		std::vector<Vec2>         uvs;
+		std::vector<unsigned int> indices;
+		bool                      hasBounds    = false; // Cooked files come with their bounds
+		Vec3                      boundsMin    = Vec3(0.f);
+		Vec3                      boundsMax    = Vec3(0.f);
+		Vec3                      sphereCenter = Vec3(0.f);
+		float                     sphereRadius = 0.f;
+		// Simplified levels one after another, each indexing the vertices above, see MeshOptimizer::generateLods
+		std::vector<unsigned int> lodIndices;
+		std::vector<uint32_t>     lodIndexCounts;
+		// Cooked files are mapped instead of read into the vectors, create uploads straight from
+		// the mapping and unmaps it. Data that is never created needs freeFileData.
+		const void*               mapping      = NULL;
+		size_t                    mappingSize  = 0;
+	};
+
 	int                          create(const char* filename);
+	int                          create(const char* filename, GeometryFileData* data); // Uploads data read earlier, takes its contents
+	bool                         readFile(const char* filename, GeometryFileData* data); // Safe to call from any thread
+	void                         freeFileData(GeometryFileData* data);
 	int                          find(const char* filename);
 	void                         initialize(const char* path);
 	void                         cleanup();
 	void                         remove(int index);
+	void                         increaseRefCount(int index);
 	void                         setCullingMode(CullingMode mode);
 	int                          getCullingMode();
-	int                          render(int index, Frustum* frustum, CTransform* transform);
-	void                         render(int index);
+	void                         setPositionQuantization(bool enable); // For meshes loaded afterwards, on by default
+	void                         setOptimizeOnLoad(bool enable); // Runs MeshOptimizer in readFile and makes LODs, on by default
+	bool                         getPositionDecode(int index, Vec3* scale, Vec3* bias); // stored * scale + bias is model space
+	// Draws leave their arena's VAO bound so the next mesh of the same format skips the bind,
+	// call unbind once a batch of draws is done
+	int                          render(int index, Frustum* frustum, CTransform* transform, int lod = 0);
+	int                          render(int index, int lod = 0); // No culling, returns the vertex count like the culled version
+	void                         unbind();
+	int                          getLodCount(int index); // Including the full mesh, 0 for an invalid index
+	// Level to draw for a mesh whose bounding sphere covers screenSize of the viewport height,
+	// currentLod is what was drawn last. Uses the LOD bias and hysteresis from Settings.
+	int                          selectLod(int index, float screenSize, int currentLod);
+	const BoundingBox*           getBoundingBox(int index); // In model space, NULL for an invalid index
+	const BoundingSphere*        getBoundingSphere(int index);
 	unsigned int                 getVAO(int index);
 	const std::string            getName(int index);
+	// Meshes loaded from files drop their CPU copies once uploaded, the getters below return
+	// empty lists for them unless the copies are retained. Retaining reloads them if needed.
+	bool                         retainCPUData(int index);
+	void                         releaseCPUData(int index);
+	void                         setKeepCPUData(bool enable); // Keeps the copies of meshes loaded afterwards, off by default
+	size_t                       getCPUBytes();               // Held by all meshes
 	const std::vector<Vec3>*     getVertices(int index);
 	const std::vector<Vec3>*     getNormals(int index);
 	const std::vector<Vec3>*     getVertexColors(int index);
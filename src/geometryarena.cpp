@@ -0,0 +1,433 @@
+#include <GL/glew.h>
+#include <GL/gl.h>
+#include <algorithm>
+#include <vector>
+
+#include "geometryarena.h"
+#include "renderer.h"
+#include "log.h"
+#include "passert.h"
+
+namespace GeometryArena
+{
+	namespace
+	{
+		const uint32_t INITIAL_VERTICES    = 1 << 16;
+		const uint32_t INITIAL_INDEX_BYTES = 1 << 18;
+		const float    DEFRAGMENT_SHARE    = 0.25f; // Part of an arena in holes before defragment compacts it
+
+		struct Range
+		{
+			uint32_t offset;
+			uint32_t size;
+		};
+
+		// Free ranges of one buffer sorted by offset, first fit, freed neighbours merge
+		struct RangeList
+		{
+			std::vector<Range> freeRanges;
+			uint32_t           capacity = 0;
+
+			bool allocate(uint32_t size, uint32_t* offset)
+			{
+				if(size == 0)
+				{
+					*offset = 0;
+					return true;
+				}
+				for(size_t i = 0; i < freeRanges.size(); i++)
+				{
+					Range& range = freeRanges[i];
+					if(range.size < size) continue;
+					*offset       = range.offset;
+					range.offset += size;
+					range.size   -= size;
+					if(range.size == 0) freeRanges.erase(freeRanges.begin() + i);
+					return true;
+				}
+				return false;
+			}
+
+			void release(uint32_t offset, uint32_t size)
+			{
+				if(size == 0) return;
+				Range range = {offset, size};
+				std::vector<Range>::iterator it = std::lower_bound(freeRanges.begin(), freeRanges.end(), range,
+																	[](const Range& a, const Range& b) { return a.offset < b.offset; });
+				it = freeRanges.insert(it, range);
+				if(it + 1 != freeRanges.end() && it->offset + it->size == (it + 1)->offset)
+				{
+					it->size += (it + 1)->size;
+					freeRanges.erase(it + 1);
+				}
+				if(it != freeRanges.begin() && (it - 1)->offset + (it - 1)->size == it->offset)
+				{
+					(it - 1)->size += it->size;
+					freeRanges.erase(it);
+				}
+			}
+
+			void grow(uint32_t newCapacity)
+			{
+				release(capacity, newCapacity - capacity);
+				capacity = newCapacity;
+			}
+
+			uint32_t getFree() const
+			{
+				uint32_t free = 0;
+				for(const Range& range : freeRanges) free += range.size;
+				return free;
+			}
+
+			// Free space anywhere but at the end, which compacting would win back
+			uint32_t getHoles() const
+			{
+				uint32_t holes = getFree();
+				if(!freeRanges.empty() && freeRanges.back().offset + freeRanges.back().size == capacity)
+					holes -= freeRanges.back().size;
+				return holes;
+			}
+		};
+
+		struct Arena
+		{
+			VertexFormat format;
+			unsigned int vao          = 0;
+			unsigned int vertexBuffer = 0;
+			unsigned int indexBuffer  = 0;
+			RangeList    vertices;    // Counted in vertices
+			RangeList    indices;     // Counted in bytes
+		};
+
+		std::vector<Arena>      arenas;
+		std::vector<Allocation> allocations;
+		std::vector<int>        freeAllocations;
+		int                     boundFormat = -1;
+		int                     bindCount   = 0;
+
+		inline uint32_t alignIndexBytes(uint32_t bytes)
+		{
+			return (bytes + 3) & ~3u;
+		}
+
+		// Copy targets leave the array and element bindings, which belong to the bound VAO, alone
+		void resizeBuffer(unsigned int* buffer, size_t oldBytes, size_t newBytes)
+		{
+			unsigned int newBuffer = 0;
+			glGenBuffers(1, &newBuffer);
+			glBindBuffer(GL_COPY_WRITE_BUFFER, newBuffer);
+			glBufferData(GL_COPY_WRITE_BUFFER, newBytes, NULL, GL_STATIC_DRAW);
+			if(*buffer != 0)
+			{
+				if(oldBytes > 0)
+				{
+					glBindBuffer(GL_COPY_READ_BUFFER, *buffer);
+					glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, oldBytes);
+					glBindBuffer(GL_COPY_READ_BUFFER, 0);
+				}
+				glDeleteBuffers(1, buffer);
+			}
+			glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+			*buffer = newBuffer;
+		}
+
+		void setupVAO(Arena* arena)
+		{
+			if(arena->vao == 0) glGenVertexArrays(1, &arena->vao);
+			glBindVertexArray(arena->vao);
+			glBindBuffer(GL_ARRAY_BUFFER, arena->vertexBuffer);
+			const VertexFormat& format = arena->format;
+			for(int i = 0; i < format.attributeCount; i++)
+			{
+				const VertexAttribute& attribute = format.attributes[i];
+				glEnableVertexAttribArray(attribute.location);
+				glVertexAttribPointer(attribute.location,
+									  attribute.size,
+									  attribute.type,
+									  attribute.normalized ? GL_TRUE : GL_FALSE,
+									  format.stride,
+									  (void*)(intptr_t)attribute.offset);
+			}
+			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, arena->indexBuffer);
+			glBindVertexArray(0);
+			glBindBuffer(GL_ARRAY_BUFFER, 0);
+			boundFormat = -1;
+			Renderer::checkGLError("GeometryArena::setupVAO");
+		}
+
+		void growVertices(Arena* arena, uint32_t needed)
+		{
+			uint32_t capacity = std::max(arena->vertices.capacity * 2, arena->vertices.capacity + needed);
+			capacity = std::max(capacity, INITIAL_VERTICES);
+			resizeBuffer(&arena->vertexBuffer,
+						 (size_t)arena->vertices.capacity * arena->format.stride,
+						 (size_t)capacity * arena->format.stride);
+			arena->vertices.grow(capacity);
+			setupVAO(arena);
+		}
+
+		void growIndices(Arena* arena, uint32_t needed)
+		{
+			uint32_t capacity = std::max(arena->indices.capacity * 2, arena->indices.capacity + needed);
+			capacity = std::max(capacity, INITIAL_INDEX_BYTES);
+			resizeBuffer(&arena->indexBuffer, arena->indices.capacity, capacity);
+			arena->indices.grow(capacity);
+			setupVAO(arena);
+		}
+
+		struct LiveRange
+		{
+			uint32_t* offset;
+			uint32_t  size;
+		};
+
+		// Copies the live ranges to the front of a new buffer of the same size, keeping their order
+		void compact(unsigned int* buffer, RangeList* ranges, size_t unitBytes, std::vector<LiveRange>* live)
+		{
+			std::sort(live->begin(), live->end(), [](const LiveRange& a, const LiveRange& b) { return *a.offset < *b.offset; });
+			unsigned int newBuffer = 0;
+			glGenBuffers(1, &newBuffer);
+			glBindBuffer(GL_COPY_WRITE_BUFFER, newBuffer);
+			glBufferData(GL_COPY_WRITE_BUFFER, ranges->capacity * unitBytes, NULL, GL_STATIC_DRAW);
+			glBindBuffer(GL_COPY_READ_BUFFER, *buffer);
+			uint32_t cursor = 0;
+			for(LiveRange& range : *live)
+			{
+				if(range.size == 0) continue;
+				glCopyBufferSubData(GL_COPY_READ_BUFFER,
+									GL_COPY_WRITE_BUFFER,
+									*range.offset * unitBytes,
+									cursor * unitBytes,
+									range.size * unitBytes);
+				*range.offset = cursor;
+				cursor       += range.size;
+			}
+			glBindBuffer(GL_COPY_READ_BUFFER, 0);
+			glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+			glDeleteBuffers(1, buffer);
+			*buffer = newBuffer;
+
+			ranges->freeRanges.clear();
+			if(cursor < ranges->capacity)
+			{
+				Range tail = {cursor, ranges->capacity - cursor};
+				ranges->freeRanges.push_back(tail);
+			}
+		}
+
+		void defragmentArena(int formatIndex)
+		{
+			Arena* arena = &arenas[formatIndex];
+			std::vector<LiveRange> liveVertices;
+			std::vector<LiveRange> liveIndices;
+			for(Allocation& allocation : allocations)
+			{
+				if(allocation.format != formatIndex) continue;
+				LiveRange vertexRange = {&allocation.firstVertex, allocation.vertexCount};
+				LiveRange indexRange  = {&allocation.indexOffset, alignIndexBytes(allocation.indexBytes)};
+				liveVertices.push_back(vertexRange);
+				liveIndices.push_back(indexRange);
+			}
+			compact(&arena->vertexBuffer, &arena->vertices, arena->format.stride, &liveVertices);
+			compact(&arena->indexBuffer,  &arena->indices,  1,                    &liveIndices);
+			setupVAO(arena);
+		}
+	}
+
+	void VertexFormat::add(int location, int size, unsigned int type, bool normalized, int byteSize)
+	{
+		PA_ASSERT(attributeCount < MAX_ATTRIBUTES);
+		VertexAttribute& attribute = attributes[attributeCount++];
+		attribute.location   = location;
+		attribute.size       = size;
+		attribute.type       = type;
+		attribute.normalized = normalized;
+		attribute.offset     = stride;
+		stride += byteSize;
+	}
+
+	bool VertexFormat::operator==(const VertexFormat& other) const
+	{
+		if(attributeCount != other.attributeCount || stride != other.stride) return false;
+		for(int i = 0; i < attributeCount; i++)
+		{
+			const VertexAttribute& a = attributes[i];
+			const VertexAttribute& b = other.attributes[i];
+			if(a.location != b.location || a.size != b.size || a.type != b.type ||
+			   a.normalized != b.normalized || a.offset != b.offset)
+				return false;
+		}
+		return true;
+	}
+
+	int findFormat(const VertexFormat& format)
+	{
+		PA_ASSERT(format.stride > 0);
+		for(int i = 0; i < (int)arenas.size(); i++)
+		{
+			if(arenas[i].format == format) return i;
+		}
+		arenas.push_back(Arena());
+		Arena* arena  = &arenas.back();
+		arena->format = format;
+		growVertices(arena, 0);
+		growIndices(arena, 0);
+		return (int)arenas.size() - 1;
+	}
+
+	int allocate(int format, const void* vertices, uint32_t vertexCount, const void* indices, uint32_t indexBytes)
+	{
+		if(format < 0 || format >= (int)arenas.size())
+		{
+			Log::error("GeometryArena::allocate", "Invalid format " + std::to_string(format));
+			return -1;
+		}
+		Arena*     arena = &arenas[format];
+		Allocation allocation;
+		allocation.format      = format;
+		allocation.vertexCount = vertexCount;
+		allocation.indexBytes  = indexBytes;
+		if(!arena->vertices.allocate(vertexCount, &allocation.firstVertex))
+		{
+			growVertices(arena, vertexCount);
+			arena->vertices.allocate(vertexCount, &allocation.firstVertex);
+		}
+		uint32_t indexSize = alignIndexBytes(indexBytes);
+		if(!arena->indices.allocate(indexSize, &allocation.indexOffset))
+		{
+			growIndices(arena, indexSize);
+			arena->indices.allocate(indexSize, &allocation.indexOffset);
+		}
+
+		if(vertexCount > 0)
+		{
+			glBindBuffer(GL_COPY_WRITE_BUFFER, arena->vertexBuffer);
+			glBufferSubData(GL_COPY_WRITE_BUFFER,
+							(size_t)allocation.firstVertex * arena->format.stride,
+							(size_t)vertexCount * arena->format.stride,
+							vertices);
+		}
+		if(indexBytes > 0)
+		{
+			glBindBuffer(GL_COPY_WRITE_BUFFER, arena->indexBuffer);
+			glBufferSubData(GL_COPY_WRITE_BUFFER, allocation.indexOffset, indexBytes, indices);
+		}
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+		Renderer::checkGLError("GeometryArena::allocate");
+
+		int handle = -1;
+		if(freeAllocations.empty())
+		{
+			handle = (int)allocations.size();
+			allocations.push_back(allocation);
+		}
+		else
+		{
+			handle = freeAllocations.back();
+			freeAllocations.pop_back();
+			allocations[handle] = allocation;
+		}
+		return handle;
+	}
+
+	void release(int allocation)
+	{
+		if(allocation < 0 || allocation >= (int)allocations.size() || allocations[allocation].format == -1)
+		{
+			Log::error("GeometryArena::release", "Invalid allocation " + std::to_string(allocation));
+			return;
+		}
+		Allocation& entry = allocations[allocation];
+		Arena&      arena = arenas[entry.format];
+		arena.vertices.release(entry.firstVertex, entry.vertexCount);
+		arena.indices.release(entry.indexOffset, alignIndexBytes(entry.indexBytes));
+		entry = Allocation();
+		freeAllocations.push_back(allocation);
+	}
+
+	const Allocation* get(int allocation)
+	{
+		const Allocation* entry = NULL;
+		if(allocation >= 0 && allocation < (int)allocations.size() && allocations[allocation].format != -1)
+			entry = &allocations[allocation];
+		return entry;
+	}
+
+	void bind(int format)
+	{
+		if(format == boundFormat) return;
+		glBindVertexArray(arenas[format].vao);
+		boundFormat = format;
+		bindCount++;
+	}
+
+	void unbind()
+	{
+		if(boundFormat == -1) return;
+		glBindVertexArray(0);
+		boundFormat = -1;
+	}
+
+	unsigned int getVAO(int format)
+	{
+		unsigned int vao = 0;
+		if(format >= 0 && format < (int)arenas.size()) vao = arenas[format].vao;
+		return vao;
+	}
+
+	int getBindCount()
+	{
+		return bindCount;
+	}
+
+	void resetBindCount()
+	{
+		bindCount = 0;
+	}
+
+	void defragment(bool force)
+	{
+		for(int i = 0; i < (int)arenas.size(); i++)
+		{
+			const Arena& arena = arenas[i];
+			bool fragmented = arena.vertices.getHoles() > arena.vertices.capacity * DEFRAGMENT_SHARE ||
+							  arena.indices.getHoles()  > arena.indices.capacity  * DEFRAGMENT_SHARE;
+			if(force || fragmented) defragmentArena(i);
+		}
+	}
+
+	size_t getUsedBytes()
+	{
+		size_t bytes = 0;
+		for(const Arena& arena : arenas)
+		{
+			bytes += (size_t)(arena.vertices.capacity - arena.vertices.getFree()) * arena.format.stride;
+			bytes += arena.indices.capacity - arena.indices.getFree();
+		}
+		return bytes;
+	}
+
+	size_t getCapacityBytes()
+	{
+		size_t bytes = 0;
+		for(const Arena& arena : arenas)
+			bytes += (size_t)arena.vertices.capacity * arena.format.stride + arena.indices.capacity;
+		return bytes;
+	}
+
+	void cleanup()
+	{
+		unbind();
+		for(Arena& arena : arenas)
+		{
+			glDeleteBuffers(1, &arena.vertexBuffer);
+			glDeleteBuffers(1, &arena.indexBuffer);
+			glDeleteVertexArrays(1, &arena.vao);
+		}
+		arenas.clear();
+		allocations.clear();
+		freeAllocations.clear();
+		bindCount = 0;
+	}
+}
@@ -0,0 +1,64 @@
+#ifndef geometryarena_H
+#define geometryarena_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Shared vertex and index buffers for all meshes. Every vertex format gets one arena with a
+// single VAO, meshes are sub-allocated from it and drawn with a base vertex so switching
+// between meshes of the same format needs no VAO bind. Freed ranges are reused first-fit,
+// the buffers grow when nothing fits and defragment compacts them when holes add up.
+namespace GeometryArena
+{
+	struct VertexAttribute
+	{
+		int          location;
+		int          size;
+		unsigned int type;
+		bool         normalized;
+		int          offset;
+	};
+
+	struct VertexFormat
+	{
+		static const int MAX_ATTRIBUTES = 4;
+		VertexAttribute attributes[MAX_ATTRIBUTES];
+		int             attributeCount = 0;
+		int             stride         = 0;
+
+		void add(int location, int size, unsigned int type, bool normalized, int byteSize);
+		bool operator==(const VertexFormat& other) const;
+	};
+
+	// Where a mesh lives inside its arena. Defragmenting moves meshes, so look it up by
+	// handle every time instead of keeping a copy.
+	struct Allocation
+	{
+		int      format      = -1;
+		uint32_t firstVertex = 0;
+		uint32_t vertexCount = 0;
+		uint32_t indexOffset = 0; // In bytes, indices are relative to firstVertex
+		uint32_t indexBytes  = 0;
+	};
+
+	int               findFormat(const VertexFormat& format); // Creates the arena on first use
+	// Copies the data into the arena of format, returns the allocation handle or -1
+	int               allocate(int format, const void* vertices, uint32_t vertexCount, const void* indices, uint32_t indexBytes);
+	void              release(int allocation);
+	const Allocation* get(int allocation);
+
+	// Binds the arena's VAO unless it already is. Draws leave it bound for the next one,
+	// call unbind after a batch so code with VAOs of its own starts from a known state.
+	void              bind(int format);
+	void              unbind();
+	unsigned int      getVAO(int format);
+	int               getBindCount(); // VAO binds since the last resetBindCount
+	void              resetBindCount();
+
+	void              defragment(bool force = false); // Without force only arenas with enough space in holes
+	size_t            getUsedBytes();
+	size_t            getCapacityBytes();
+	void              cleanup();
+}
+
+#endif
@@ -7,6 +7,7 @@
 #include "scenemanager.h"
 #include "texture.h"
 #include "gameobject.h"
+#include "componentpool.h"
 
 namespace Light
 {
@@ -14,9 +15,7 @@ namespace Light
 	
 	namespace
 	{
-		std::vector<CLight>   lightList;
-		std::vector<uint32_t> activeLights;
-		std::vector<uint32_t> emptyIndices;
+		ComponentPool<CLight> lightList; // Active lights are the pool's live list
 	}
 	
 	void initialize()
@@ -26,41 +25,31 @@ namespace Light
 		
 	void cleanup()
 	{
-		for(uint i = 0; i < activeLights.size(); i++)
-			remove(activeLights[i]);
+		while(!lightList.getLive().empty())
+			remove(lightList.getLive().back());
 
-		activeLights.clear();
 		lightList.clear();
-		emptyIndices.clear();
 	}
 
-	std::vector<uint32_t>* getActiveLights()
+	const std::vector<int>* getActiveLights()
 	{
-		return &activeLights;
+		return &lightList.getLive();
+	}
+
+	void reserve(int count)
+	{
+		lightList.reserve(count);
 	}
 		
 	void remove(uint32_t index)
 	{
-		if(index < lightList.size())
+		if(index < (uint32_t)lightList.size())
 		{
-			bool alreadyEmpty = true;
-			uint indexToErase = 0;
-			for(uint i = 0; i < activeLights.size(); i++)
+			if(lightList.isValid(index))
 			{
-				if(activeLights[i] == index)
-				{
-					alreadyEmpty = false;
-					indexToErase = i;
-					break;
-				}
-			}
-
-			if(!alreadyEmpty)
-			{
-				emptyIndices.push_back(index);
 				lightList[index].valid = false;
 				removeShadowMaps(&lightList[index]);
-				activeLights.erase(activeLights.begin() + indexToErase);
+				lightList.remove(index);
 			}
 			else
 			{
@@ -71,7 +60,7 @@ namespace Light
 		
 	CLight* getLightAtIndex(uint32_t index)
 	{
-		if(index < lightList.size())
+		if(index < (uint32_t)lightList.size())
 		{
 			return &lightList[index];
 		}
@@ -84,21 +73,8 @@ namespace Light
 		
 	int create(Node node)
 	{
-		int index = -1;
-		if(emptyIndices.empty())
-		{
-			lightList.push_back(CLight());
-			index = lightList.size() - 1;
-		}
-		else
-		{
-			index = emptyIndices.back();
-			emptyIndices.pop_back();
-			lightList[index] = CLight();
-		}
-
+		int index = lightList.create();
 		lightList[index].node = node;
-		activeLights.push_back(index);
 		setRadius(&lightList[index], lightList[index].radius);
 		return index;
 	}
@@ -191,6 +167,44 @@ namespace Light
 		return success;
 	}
 
+	void writeToBinary(CLight* light, SceneFormat::LightRecord* record)
+	{
+		PA_ASSERT(light);
+		PA_ASSERT(record);
+		record->type       = light->type;
+		record->innerAngle = light->innerAngle;
+		record->outerAngle = light->outerAngle;
+		record->falloff    = light->falloff;
+		record->radius     = (float)light->radius;
+		record->intensity  = light->intensity;
+		record->depthBias  = light->depthBias;
+		record->castShadow = light->castShadow ? 1 : 0;
+		record->pcfEnabled = light->pcfEnabled ? 1 : 0;
+		for(int i = 0; i < 4; i++) record->color[i] = light->color[i];
+	}
+
+	bool createFromBinary(CLight* light, const SceneFormat::LightRecord& record)
+	{
+		PA_ASSERT(light);
+		bool success = true;
+		for(int i = 0; i < 4; i++) light->color[i] = record.color[i];
+		if(record.type >= 0 && record.type <= 2)
+			setType(light, (LightType)record.type);
+		else
+			success = false;
+		if(record.innerAngle >= 0) light->innerAngle = record.innerAngle; else success = false;
+		if(record.outerAngle >= 0) setOuterAngle(light, record.outerAngle); else success = false;
+		if(record.depthBias  >= 0) light->depthBias  = record.depthBias;  else success = false;
+		if(record.falloff    >= 0) light->falloff    = record.falloff;    else success = false;
+		if(record.radius     >= 0) setRadius(light, record.radius);       else success = false;
+		light->intensity  = glm::clamp(record.intensity, 0.f, 10.f);
+		light->castShadow = record.castShadow != 0;
+		setCastShadow(light, light->castShadow);
+		light->pcfEnabled = record.pcfEnabled != 0;
+		if(!success) Log::error("Light::createFromBinary", "Invalid value in a field");
+		return success;
+	}
+
 	bool createFromJSON(CLight* light, const rapidjson::Value& value)
 	{
 		using namespace rapidjson;
@@ -357,6 +371,7 @@ namespace Light
 		PA_ASSERT(light);
 		light->radius = radius;
 		light->boundingSphere.radius = radius;
+		SceneManager::markDirty(light->node);
 		if(light->castShadow)
 		{
 			GameObject* gameobject = SceneManager::find(light->node);
@@ -370,6 +385,7 @@ namespace Light
 	{
 		PA_ASSERT(light);
 		light->type = type;
+		SceneManager::markDirty(light->node);
 		if(light->castShadow)
 		{
 			GameObject* gameobject = SceneManager::find(light->node);
@@ -384,6 +400,7 @@ namespace Light
 	{
 		PA_ASSERT(light);
 		light->outerAngle = outerAngle;
+		SceneManager::markDirty(light->node);
 		if(light->castShadow)
 		{
 			GameObject* gameobject = SceneManager::find(light->node);
@@ -397,24 +414,28 @@ namespace Light
 	{
 		PA_ASSERT(light);
 		light->innerAngle = innerAngle;
+		SceneManager::markDirty(light->node);
 	}
 	
 	void setFalloff(CLight* light, float falloff)
 	{
 		PA_ASSERT(light);
 		light->falloff = falloff;
+		SceneManager::markDirty(light->node);
 	}
 	
 	void setIntensity(CLight* light, float intensity)
 	{
 		PA_ASSERT(light);
 		light->intensity = glm::clamp(intensity, 0.f, 10.f);
+		SceneManager::markDirty(light->node);
 	}
 	
 	void setCastShadow(CLight* light, bool castShadow)
 	{
 		PA_ASSERT(light);
 		light->castShadow = castShadow;
+		SceneManager::markDirty(light->node);
 		if(castShadow && light->shadowMap[0] == -1)
 		{
 			int shadowMaps = light->type == LT_DIR ? MAX_SHADOWMAPS : 1;
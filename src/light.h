@@ -7,6 +7,7 @@
 #include "datatypes.h"
 #include "boundingvolumes.h"
 #include "jsondefs.h"
+#include "sceneformat.h"
 
 #define MAX_SHADOWMAPS 4
 
@@ -44,6 +45,7 @@ namespace Light
 	void                   generateBindings();		
 	void                   cleanup();
 	void                   remove(uint32_t index);
+	void                   reserve(int count); // Makes room for count more lights
 	CLight*                getLightAtIndex(uint32_t index);
 	void                   setRadius(CLight* light, float radius);
 	void                   setType(CLight* light, LightType type);
@@ -53,7 +55,9 @@ namespace Light
 	void                   setIntensity(CLight* light, float intensity);
 	void                   setCastShadow(CLight* light, bool castShadow);
 	bool                   writeToJSON(CLight* light, rapidjson::Writer<rapidjson::StringBuffer>& writer);
-	std::vector<uint32_t>* getActiveLights();
+	bool                   createFromBinary(CLight* light, const SceneFormat::LightRecord& record);
+	void                   writeToBinary(CLight* light, SceneFormat::LightRecord* record);
+	const std::vector<int>* getActiveLights();
 }
 
 
@@ -0,0 +1,233 @@
+#include "loadprofiler.h"
+#include "log.h"
+#include "jsondefs.h"
+
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include <algorithm>
+#include <cstdio>
+
+namespace LoadProfiler
+{
+	namespace
+	{
+		typedef std::chrono::steady_clock Clock;
+
+		struct Stat
+		{
+			double   time  = 0.0; // Milliseconds
+			uint32_t count = 0;
+		};
+
+		const char* phaseNames[LP_COUNT] = {"Parse", "Geometry", "Texture", "Shader", "Script", "Objects"};
+
+		std::mutex        mutex;            // Guards everything below, timers finish on worker threads
+		int               depth     = 0;
+		std::string       profileName;
+		Clock::time_point profileStart;
+		Stat              phases[LP_COUNT];
+		std::unordered_map<std::string, Stat> assets[LP_COUNT];
+		std::string       dumpFile  = "loadprofile.json";
+
+		thread_local ScopedTimer* currentTimer = NULL;
+
+		struct AssetStat
+		{
+			Phase       phase;
+			std::string name;
+			Stat        stat;
+		};
+
+		double toMilliseconds(Clock::duration duration)
+		{
+			return std::chrono::duration<double, std::milli>(duration).count();
+		}
+
+		std::string formatTime(double ms)
+		{
+			char buffer[32];
+			snprintf(buffer, sizeof(buffer), "%.2f ms", ms);
+			return buffer;
+		}
+
+		std::vector<AssetStat> sortedAssets(Phase phase)
+		{
+			std::vector<AssetStat> sorted;
+			sorted.reserve(assets[phase].size());
+			for(auto& it : assets[phase])
+			{
+				AssetStat asset;
+				asset.phase = phase;
+				asset.name  = it.first;
+				asset.stat  = it.second;
+				sorted.push_back(asset);
+			}
+			std::sort(sorted.begin(), sorted.end(), [](const AssetStat& a, const AssetStat& b) {
+				return a.stat.time > b.stat.time;
+			});
+			return sorted;
+		}
+
+		void report(double totalTime)
+		{
+			Log::message("Load profile of " + profileName + " : " + formatTime(totalTime));
+			std::vector<AssetStat> slowest;
+			for(int i = 0; i < LP_COUNT; ++i)
+			{
+				if(phases[i].count == 0)
+					continue;
+				Log::message("    " + std::string(phaseNames[i]) + " : " + formatTime(phases[i].time) +
+							 " in " + std::to_string(phases[i].count) + " calls");
+				std::vector<AssetStat> sorted = sortedAssets((Phase)i);
+				slowest.insert(slowest.end(), sorted.begin(), sorted.end());
+			}
+
+			const size_t SLOWEST_COUNT = 5;
+			std::sort(slowest.begin(), slowest.end(), [](const AssetStat& a, const AssetStat& b) {
+				return a.stat.time > b.stat.time;
+			});
+			if(slowest.size() > SLOWEST_COUNT)
+				slowest.resize(SLOWEST_COUNT);
+			if(!slowest.empty())
+				Log::message("    Slowest assets :");
+			for(const AssetStat& asset : slowest)
+				Log::message("        " + asset.name + " (" + phaseNames[asset.phase] + ") : " + formatTime(asset.stat.time));
+		}
+
+		void writeDump(double totalTime)
+		{
+			using namespace rapidjson;
+			StringBuffer buffer;
+			PrettyWriter<StringBuffer> writer(buffer);
+
+			writer.StartObject();
+			writer.Key("Name");
+			writer.String(profileName.c_str());
+			writer.Key("TotalMs");
+			writer.Double(totalTime);
+			writer.Key("Phases");
+			writer.StartArray();
+			for(int i = 0; i < LP_COUNT; ++i)
+			{
+				writer.StartObject();
+				writer.Key("Phase");
+				writer.String(phaseNames[i]);
+				writer.Key("Ms");
+				writer.Double(phases[i].time);
+				writer.Key("Count");
+				writer.Uint(phases[i].count);
+				writer.Key("Assets");
+				writer.StartArray();
+				for(const AssetStat& asset : sortedAssets((Phase)i))
+				{
+					writer.StartObject();
+					writer.Key("Asset");
+					writer.String(asset.name.c_str());
+					writer.Key("Ms");
+					writer.Double(asset.stat.time);
+					writer.Key("Count");
+					writer.Uint(asset.stat.count);
+					writer.EndObject();
+				}
+				writer.EndArray();
+				writer.EndObject();
+			}
+			writer.EndArray();
+			writer.EndObject();
+
+			FILE* file = fopen(dumpFile.c_str(), "w");
+			if(!file)
+			{
+				Log::error("LoadProfiler::end", "Could not open " + dumpFile + " for writing");
+				return;
+			}
+			if(fwrite(buffer.GetString(), buffer.GetSize(), 1, file) != 1)
+				Log::error("LoadProfiler::end", "Could not write " + dumpFile);
+			fclose(file);
+		}
+	}
+
+	void begin(const std::string& name)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if(depth++ > 0)
+			return;
+
+		profileName  = name;
+		profileStart = Clock::now();
+		for(int i = 0; i < LP_COUNT; ++i)
+		{
+			phases[i] = Stat();
+			assets[i].clear();
+		}
+	}
+
+	void end()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if(depth == 0)
+		{
+			Log::error("LoadProfiler::end", "No profile to end");
+			return;
+		}
+		if(--depth > 0)
+			return;
+
+		double totalTime = toMilliseconds(Clock::now() - profileStart);
+		report(totalTime);
+		if(!dumpFile.empty())
+			writeDump(totalTime);
+	}
+
+	bool isActive()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return depth > 0;
+	}
+
+	void setDumpFile(const std::string& filename)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		dumpFile = filename;
+	}
+
+	ScopedTimer::ScopedTimer(Phase phase, const char* asset)
+		: phase(phase),
+		  active(isActive())
+	{
+		if(!active)
+			return;
+
+		if(asset)
+			this->asset = asset;
+		parent       = currentTimer;
+		currentTimer = this;
+		start        = Clock::now();
+	}
+
+	ScopedTimer::~ScopedTimer()
+	{
+		if(!active)
+			return;
+
+		double elapsed = toMilliseconds(Clock::now() - start);
+		currentTimer   = parent;
+		if(parent)
+			parent->childTime += elapsed;
+
+		std::lock_guard<std::mutex> lock(mutex);
+		if(depth == 0)
+			return; // The profile ended while this was running
+
+		double selfTime = elapsed - childTime;
+		phases[phase].time += selfTime;
+		phases[phase].count++;
+		if(!asset.empty())
+		{
+			Stat& stat = assets[phase][asset];
+			stat.time += selfTime;
+			stat.count++;
+		}
+	}
+}
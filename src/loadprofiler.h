@@ -0,0 +1,53 @@
+#ifndef loadprofiler_H
+#define loadprofiler_H
+
+#include <string>
+#include <chrono>
+
+// Times the phases of scene and prefab loading. A profile runs from begin to the matching end and
+// every ScopedTimer alive in between adds its time to a phase and, when given one, to an asset.
+// Time spent in a nested timer only counts for the innermost one, so on a single thread the phases
+// add up to the time of the load. Timers work on any thread, outside of a profile they do nothing.
+// Ending a profile logs a report to the console and writes the same numbers as json.
+namespace LoadProfiler
+{
+	enum Phase
+	{
+		LP_PARSE = 0, // Reading scene and prefab files
+		LP_GEOMETRY,
+		LP_TEXTURE,
+		LP_SHADER,
+		LP_SCRIPT,    // Module builds included
+		LP_OBJECTS,   // Creating gameobjects and components, minus the phases above
+		LP_COUNT
+	};
+
+	void begin(const std::string& name); // Profiles nest, only the outermost one reports
+	void end();
+	bool isActive();
+	void setDumpFile(const std::string& filename); // Default loadprofile.json, empty turns the dump off
+
+	class ScopedTimer
+	{
+	public:
+		ScopedTimer(Phase phase, const char* asset = NULL);
+		~ScopedTimer();
+	private:
+		typedef std::chrono::steady_clock Clock;
+		Phase             phase;
+		bool              active;
+		std::string       asset;
+		Clock::time_point start;
+		double            childTime = 0.0; // Milliseconds
+		ScopedTimer*      parent    = NULL;
+	};
+
+	class ScopedProfile
+	{
+	public:
+		ScopedProfile(const std::string& name) { begin(name); }
+		~ScopedProfile()                       { end();       }
+	};
+}
+
+#endif
@@ -3,6 +3,7 @@
 #include <GL/gl.h>
 
 #include <stdio.h>  /* defines FILENAME_MAX */
+#include <algorithm>
 #ifdef WINDOWS
     #include <direct.h>
     #define GetCurrentDir _getcwd
@@ -43,14 +44,21 @@ int main(int argc, char** args)
     {
         //Event handler
         SDL_Event event;
-        float current, previous, deltaTime;
-		current = previous = deltaTime = 0.f;
-		
+        // Physics runs in fixed steps of its own, every frame is drawn and gets the
+        // measured frame time. The performance counter avoids the millisecond steps of
+        // SDL_GetTicks, which show as jitter at high frame rates, and long stalls like
+        // loading are cut so they don't turn into a burst of simulation steps.
+        const float maxDeltaTime = 0.25f;
+        const double frequency = (double)SDL_GetPerformanceFrequency();
+        Uint64 current = SDL_GetPerformanceCounter();
+        Uint64 previous;
+        float deltaTime;
+
         while(!quit)
         {
             previous = current;
-            current = SDL_GetTicks();
-            deltaTime = (current - previous) / 1000.f;
+            current = SDL_GetPerformanceCounter();
+            deltaTime = std::min((float)((current - previous) / frequency), maxDeltaTime);
 
             //Handle events on a queue
             handleEvents(&event, &quit);
@@ -1,6 +1,7 @@
 #include <GL/glew.h>
 #include <GL/gl.h>
 #include <vector>
+#include <algorithm>
 
 #include "material.h"
 #include "shader.h"
@@ -20,6 +21,7 @@ Mat_Uniforms& Mat_Uniforms::operator=(const Mat_Uniforms& other)
 		this->diffuse          = other.diffuse;
 		this->specular         = other.specular;
 		this->specularStrength = other.specularStrength;
+		this->castShadow       = other.castShadow;
 		if(this->texture != -1)
 			Texture::decreaseRefCount(this->texture);
 		if(other.texture != -1)
@@ -76,6 +78,11 @@ namespace Material
 		// if node is already registered, return false otherwise true
 		return exists ? false : true;
 	}
+
+	void registerNewModel(int modelIndex, Mat_Type material)
+	{
+		getRegisteredModels(material)->push_back(modelIndex);
+	}
 	
 
 	int getShaderIndex(Mat_Type material)
@@ -94,24 +101,29 @@ namespace Material
 		return shaderIndex;
 	}
 
+	// Searched from the back, models that were just created and are moved to another material
+	// right away, as scenes do while loading, are found at once
 	bool unRegisterModel(int modelIndex, Mat_Type material)
 	{
-		int  index = -1;
-		bool found = false;
 		std::vector<int>* registeredNodes = getRegisteredModels(material);
-
-		for(int registeredNode : *registeredNodes)
+		auto found = std::find(registeredNodes->rbegin(), registeredNodes->rend(), modelIndex);
+		if(found == registeredNodes->rend()) return false;
+		registeredNodes->erase(std::next(found).base());
+		return true;
+	}
+	
+	void unRegisterModels(const std::vector<bool>& removedModels)
+	{
+		for(Mat_Type material : MATERIAL_LIST)
 		{
-			index++;
-			if(registeredNode == modelIndex)
-			{
-				found = true;
-				break;
-			}
+			std::vector<int>* registeredNodes = getRegisteredModels(material);
+			registeredNodes->erase(std::remove_if(registeredNodes->begin(),
+												  registeredNodes->end(),
+												  [&removedModels] (int modelIndex) {
+													  return modelIndex < (int)removedModels.size() && removedModels[modelIndex];
+												  }),
+								   registeredNodes->end());
 		}
-		if(found)
-			registeredNodes->erase(registeredNodes->begin() + index);
-		return found;
 	}
 	
 	std::vector<int>* getRegisteredModels(Mat_Type material)
@@ -39,7 +39,9 @@ namespace Material
 	std::vector<int>* getRegisteredModels(Mat_Type material);
     int               getShaderIndex(Mat_Type material);
 	bool              registerModel(int modelIndex, Mat_Type material);
+	void              registerNewModel(int modelIndex, Mat_Type material); // No duplicate check, for freshly created models
 	bool              unRegisterModel(int modelIndex, Mat_Type material);
+	void              unRegisterModels(const std::vector<bool>& removedModels); // Drops every model whose index is set
 	void              setMaterialUniforms(const Mat_Uniforms* materialUniforms, Mat_Type material);
 	void              removeMaterialUniforms(const Mat_Uniforms* materialUniforms, Mat_Type material);
 }
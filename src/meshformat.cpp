@@ -0,0 +1,339 @@
+#include <stdio.h>
+#include <string.h>
+#include <stddef.h>
+#include <algorithm>
+#include <sys/stat.h>
+
+#include "meshformat.h"
+
+namespace MeshFormat
+{
+	namespace
+	{
+		const uint32_t HORDE3D_VERSION = 5;
+
+		static_assert(sizeof(Header) % ALIGNMENT == 0, "Streams start right after the header");
+
+		inline uint64_t align(uint64_t offset)
+		{
+			return (offset + ALIGNMENT - 1) & ~(uint64_t)(ALIGNMENT - 1);
+		}
+
+		template<typename T>
+		bool readValues(FILE* file, T* values, size_t count)
+		{
+			return count == 0 || fread(values, sizeof(T), count, file) == count;
+		}
+
+		bool endsWith(const char* str, const char* suffix)
+		{
+			size_t length = strlen(str), suffixLength = strlen(suffix);
+			return length >= suffixLength && strcmp(str + length - suffixLength, suffix) == 0;
+		}
+
+		uint64_t getFileSize(FILE* file)
+		{
+			fseek(file, 0L, SEEK_END);
+			long size = ftell(file);
+			rewind(file);
+			return size > 0 ? (uint64_t)size : 0;
+		}
+
+		// Counts are checked against the file size before anything is allocated for them
+		bool readExported(FILE* file, Geometry::GeometryFileData* data)
+		{
+			uint32_t header[4];
+			uint64_t size = getFileSize(file);
+			if(!readValues(file, header, 4)) return false;
+			uint64_t expected = sizeof(header) + (uint64_t)header[0] * sizeof(uint32_t) +
+								(uint64_t)header[1] * sizeof(Vec3) + (uint64_t)header[2] * sizeof(Vec3) +
+								(uint64_t)header[3] * sizeof(Vec2);
+			if(expected > size) return false;
+			data->indices.assign(header[0], 0);
+			data->vertices.assign(header[1], Vec3(0.f));
+			data->normals.assign(header[2], Vec3(0.f));
+			data->uvs.assign(header[3], Vec2(0.f));
+			return readValues(file, data->indices.data(), data->indices.size())   &&
+				   readValues(file, data->vertices.data(), data->vertices.size()) &&
+				   readValues(file, data->normals.data(), data->normals.size())   &&
+				   readValues(file, data->uvs.data(), data->uvs.size());
+		}
+
+		// Positions, normals, the first uv set and the indices, joints and morph targets are skipped
+		bool readHorde3D(FILE* file, Geometry::GeometryFileData* data)
+		{
+			char     magic[4];
+			uint32_t version, jointCount, streamCount, vertexCount;
+			uint64_t size = getFileSize(file);
+			if(!readValues(file, magic, 4) || strncmp(magic, "H3DG", 4) != 0) return false;
+			if(!readValues(file, &version, 1) || version != HORDE3D_VERSION) return false;
+			if(!readValues(file, &jointCount, 1) || (uint64_t)jointCount * 16 * sizeof(float) > size) return false;
+			if(fseek(file, (long)jointCount * 16 * sizeof(float), SEEK_CUR) != 0) return false;
+			if(!readValues(file, &streamCount, 1) || !readValues(file, &vertexCount, 1)) return false;
+
+			data->vertices.clear();
+			data->normals.clear();
+			data->uvs.clear();
+			for(uint32_t i = 0; i < streamCount; i++)
+			{
+				uint32_t id, elementSize;
+				if(!readValues(file, &id, 1) || !readValues(file, &elementSize, 1)) return false;
+				if((uint64_t)elementSize * vertexCount > size) return false;
+				if(id == 0 && elementSize == sizeof(Vec3))
+				{
+					data->vertices.resize(vertexCount);
+					if(!readValues(file, data->vertices.data(), vertexCount)) return false;
+				}
+				else if(id == 1 && elementSize == 3 * sizeof(int16_t))
+				{
+					std::vector<int16_t> normals(vertexCount * 3);
+					if(!readValues(file, normals.data(), normals.size())) return false;
+					data->normals.resize(vertexCount);
+					for(uint32_t v = 0; v < vertexCount; v++)
+						data->normals[v] = Vec3(normals[v * 3], normals[v * 3 + 1], normals[v * 3 + 2]) / 32767.f;
+				}
+				else if(id == 6 && elementSize == sizeof(Vec2))
+				{
+					data->uvs.resize(vertexCount);
+					if(!readValues(file, data->uvs.data(), vertexCount)) return false;
+				}
+				else if(fseek(file, (long)elementSize * vertexCount, SEEK_CUR) != 0)
+				{
+					return false;
+				}
+			}
+
+			uint32_t indexCount;
+			if(!readValues(file, &indexCount, 1) || (uint64_t)indexCount * sizeof(uint32_t) > size) return false;
+			data->indices.assign(indexCount, 0);
+			return readValues(file, data->indices.data(), indexCount);
+		}
+
+		bool writeStream(FILE* file, const void* values, uint64_t size, uint64_t* offset)
+		{
+			static const char zeros[ALIGNMENT] = {0};
+			uint64_t padding = align(*offset) - *offset;
+			if(padding > 0 && fwrite(zeros, 1, (size_t)padding, file) != padding) return false;
+			*offset += padding + size;
+			return size == 0 || fwrite(values, (size_t)size, 1, file) == 1;
+		}
+
+		inline bool isValidStream(uint64_t offset, uint64_t size, size_t fileSize)
+		{
+			return offset % sizeof(float) == 0 && offset >= sizeof(Header) && offset <= fileSize && size <= fileSize - offset;
+		}
+	}
+
+	bool readSource(const char* filename, Geometry::GeometryFileData* data)
+	{
+		FILE* file = fopen(filename, "rb");
+		if(!file) return false;
+		bool success = endsWith(filename, ".geo") ? readHorde3D(file, data) : readExported(file, data);
+		fclose(file);
+		for(size_t i = 0; success && i < data->indices.size(); i++)
+			if(data->indices[i] >= data->vertices.size()) success = false;
+		data->hasBounds = false;
+		return success;
+	}
+
+	void computeBounds(const std::vector<Vec3>& vertices, Vec3* min, Vec3* max, Vec3* center, float* radius)
+	{
+		*min = Vec3(0.f);
+		*max = Vec3(0.f);
+		for(const Vec3& vertex : vertices)
+		{
+			if(vertex.x > max->x) max->x = vertex.x;
+			if(vertex.y > max->y) max->y = vertex.y;
+			if(vertex.z > max->z) max->z = vertex.z;
+
+			if(vertex.x < min->x) min->x = vertex.x;
+			if(vertex.y < min->y) min->y = vertex.y;
+			if(vertex.z < min->z) min->z = vertex.z;
+		}
+		*center = (*max + *min) / 2.f;
+		*radius = glm::abs(glm::length(*max - *center));
+	}
+
+	uint64_t hash(const void* data, size_t size, uint64_t seed)
+	{
+		const uint8_t* bytes = (const uint8_t*)data;
+		uint64_t value = seed;
+		for(size_t i = 0; i < size; i++)
+		{
+			value ^= bytes[i];
+			value *= 0x100000001b3ULL;
+		}
+		return value;
+	}
+
+	std::string getCookedPath(const char* source)
+	{
+		std::string path(source);
+		size_t extension = path.find_last_of('.');
+		size_t directory = path.find_last_of("/\\");
+		if(extension != std::string::npos && (directory == std::string::npos || extension > directory))
+			path.erase(extension);
+		return path + COOKED_EXTENSION;
+	}
+
+	bool isCookedCurrent(const char* cooked, const char* source)
+	{
+		struct stat cookedStat, sourceStat;
+		if(stat(cooked, &cookedStat) != 0) return false;
+		return stat(source, &sourceStat) != 0 || sourceStat.st_mtime <= cookedStat.st_mtime;
+	}
+
+	bool write(const Geometry::GeometryFileData& data, uint32_t flags, uint64_t contentHash, const char* filename, std::string* error)
+	{
+		Header header;
+		header.flags       = flags;
+		header.contentHash = contentHash;
+		header.indexCount  = (uint32_t)data.indices.size();
+		header.vertexCount = (uint32_t)data.vertices.size();
+		header.normalCount = (uint32_t)data.normals.size();
+		header.uvCount     = (uint32_t)data.uvs.size();
+		header.lodCount    = (uint32_t)std::min(data.lodIndexCounts.size(), (size_t)Geometry::MAX_LODS - 1);
+		uint64_t lodIndexCount = 0;
+		for(uint32_t i = 0; i < header.lodCount; i++)
+		{
+			header.lodIndexCounts[i] = data.lodIndexCounts[i];
+			lodIndexCount += data.lodIndexCounts[i];
+		}
+		if(lodIndexCount > data.lodIndices.size())
+		{
+			*error = "LOD counts don't match their indices";
+			return false;
+		}
+
+		Vec3  min = data.boundsMin, max = data.boundsMax, center = data.sphereCenter;
+		float radius = data.sphereRadius;
+		if(!data.hasBounds) computeBounds(data.vertices, &min, &max, &center, &radius);
+		for(int i = 0; i < 3; i++)
+		{
+			header.boundsMin[i]    = min[i];
+			header.boundsMax[i]    = max[i];
+			header.sphereCenter[i] = center[i];
+		}
+		header.sphereRadius = radius;
+
+		const uint64_t indexBytes  = (uint64_t)header.indexCount * sizeof(uint32_t);
+		const uint64_t vertexBytes = (uint64_t)header.vertexCount * sizeof(Vec3);
+		const uint64_t normalBytes = (uint64_t)header.normalCount * sizeof(Vec3);
+		const uint64_t uvBytes     = (uint64_t)header.uvCount * sizeof(Vec2);
+		const uint64_t lodBytes    = lodIndexCount * sizeof(uint32_t);
+		header.indexOffset  = sizeof(Header);
+		header.vertexOffset = align(header.indexOffset + indexBytes);
+		header.normalOffset = align(header.vertexOffset + vertexBytes);
+		header.uvOffset     = align(header.normalOffset + normalBytes);
+		header.lodOffset    = align(header.uvOffset + uvBytes);
+
+		// Written next to the old file first so a failed write never loses it
+		std::string temporary = std::string(filename) + ".tmp";
+		FILE* file = fopen(temporary.c_str(), "wb");
+		if(!file)
+		{
+			*error = "File could not be created";
+			return false;
+		}
+		uint64_t offset  = sizeof(Header);
+		bool     success = fwrite(&header, sizeof(Header), 1, file) == 1      &&
+						   writeStream(file, data.indices.data(), indexBytes, &offset)   &&
+						   writeStream(file, data.vertices.data(), vertexBytes, &offset) &&
+						   writeStream(file, data.normals.data(), normalBytes, &offset)  &&
+						   writeStream(file, data.uvs.data(), uvBytes, &offset)          &&
+						   writeStream(file, data.lodIndices.data(), lodBytes, &offset);
+		if(!success) *error = "Could not write " + temporary;
+		success = fclose(file) == 0 && success;
+		if(success && rename(temporary.c_str(), filename) != 0)
+		{
+			success = false;
+			*error  = "Could not replace " + std::string(filename);
+		}
+		if(!success) remove(temporary.c_str());
+		return success;
+	}
+
+	bool read(const void* data, size_t size, MeshView* view, std::string* error)
+	{
+		const char* bytes = (const char*)data;
+		if(!data || size < sizeof(Header))
+		{
+			*error = "File too small";
+			return false;
+		}
+		if((uintptr_t)data % sizeof(uint64_t) != 0)
+		{
+			*error = "File memory is not aligned";
+			return false;
+		}
+		const Header* header = (const Header*)bytes;
+		if(header->magic != MAGIC)
+		{
+			*error = "Not a cooked mesh";
+			return false;
+		}
+		if(header->version != VERSION)
+		{
+			*error = "Cooked with version " + std::to_string(header->version) + ", expected " + std::to_string(VERSION);
+			return false;
+		}
+		if(header->lodCount > Geometry::MAX_LODS - 1)
+		{
+			*error = "Too many LODs";
+			return false;
+		}
+		uint64_t lodIndexCount = 0;
+		for(uint32_t i = 0; i < header->lodCount; i++) lodIndexCount += header->lodIndexCounts[i];
+		if(!isValidStream(header->indexOffset,  (uint64_t)header->indexCount * sizeof(uint32_t), size) ||
+		   !isValidStream(header->vertexOffset, (uint64_t)header->vertexCount * sizeof(Vec3), size)    ||
+		   !isValidStream(header->normalOffset, (uint64_t)header->normalCount * sizeof(Vec3), size)    ||
+		   !isValidStream(header->uvOffset,     (uint64_t)header->uvCount * sizeof(Vec2), size)        ||
+		   !isValidStream(header->lodOffset,    lodIndexCount * sizeof(uint32_t), size))
+		{
+			*error = "Stream outside of the file";
+			return false;
+		}
+
+		view->header   = header;
+		view->indices  = (const uint32_t*)(bytes + header->indexOffset);
+		view->vertices = (const Vec3*)(bytes + header->vertexOffset);
+		view->normals  = (const Vec3*)(bytes + header->normalOffset);
+		view->uvs      = (const Vec2*)(bytes + header->uvOffset);
+		view->lodIndices = (const uint32_t*)(bytes + header->lodOffset);
+		for(uint32_t i = 0; i < header->indexCount; i++)
+		{
+			if(view->indices[i] >= header->vertexCount)
+			{
+				*error = "Index out of range";
+				return false;
+			}
+		}
+		for(uint64_t i = 0; i < lodIndexCount; i++)
+		{
+			if(view->lodIndices[i] >= header->vertexCount)
+			{
+				*error = "LOD index out of range";
+				return false;
+			}
+		}
+		return true;
+	}
+
+	void copy(const MeshView& view, Geometry::GeometryFileData* data)
+	{
+		const Header* header = view.header;
+		data->indices.assign(view.indices, view.indices + header->indexCount);
+		data->vertices.assign(view.vertices, view.vertices + header->vertexCount);
+		data->normals.assign(view.normals, view.normals + header->normalCount);
+		data->uvs.assign(view.uvs, view.uvs + header->uvCount);
+		data->lodIndexCounts.assign(header->lodIndexCounts, header->lodIndexCounts + header->lodCount);
+		size_t lodIndexCount = 0;
+		for(uint32_t count : data->lodIndexCounts) lodIndexCount += count;
+		data->lodIndices.assign(view.lodIndices, view.lodIndices + lodIndexCount);
+		data->boundsMin    = Vec3(header->boundsMin[0], header->boundsMin[1], header->boundsMin[2]);
+		data->boundsMax    = Vec3(header->boundsMax[0], header->boundsMax[1], header->boundsMax[2]);
+		data->sphereCenter = Vec3(header->sphereCenter[0], header->sphereCenter[1], header->sphereCenter[2]);
+		data->sphereRadius = header->sphereRadius;
+		data->hasBounds    = true;
+	}
+}
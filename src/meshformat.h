@@ -0,0 +1,81 @@
+#ifndef meshformat_H
+#define meshformat_H
+
+#include <string>
+#include <vector>
+#include <cinttypes>
+
+#include "geometry.h"
+
+// Mesh files. Sources are what the exporter writes (.pamesh: a uint32 index, vertex, normal
+// and uv count followed by those arrays) or Horde3D geometry (.geo). pa_cook turns them into
+// cooked files (.pamc) next to the source: a header with precomputed bounds and the hash of
+// the source, followed by the optimized streams and LODs, each on an ALIGNMENT boundary, so a mapped
+// file can be uploaded in place. Nothing here touches GL or shared state, tools use it as well.
+namespace MeshFormat
+{
+	const uint32_t MAGIC     = 0x434D4150; // "PAMC"
+	const uint32_t VERSION   = 2; // 2 added LODs
+	const uint32_t ALIGNMENT = 16;
+	const char     COOKED_EXTENSION[] = ".pamc";
+
+	enum Flags
+	{
+		MF_OPTIMIZED = 1 // Ran through MeshOptimizer
+	};
+
+	struct Header
+	{
+		uint32_t magic        = MAGIC;
+		uint32_t version      = VERSION;
+		uint32_t flags        = 0;
+		uint32_t reserved     = 0;
+		uint64_t contentHash  = 0; // Of the source file, pa_cook skips sources that did not change
+		uint32_t indexCount   = 0;
+		uint32_t vertexCount  = 0;
+		uint32_t normalCount  = 0;
+		uint32_t uvCount      = 0;
+		float    boundsMin[3]    = {0.f, 0.f, 0.f};
+		float    boundsMax[3]    = {0.f, 0.f, 0.f};
+		float    sphereCenter[3] = {0.f, 0.f, 0.f};
+		float    sphereRadius    = 0.f;
+		uint64_t indexOffset  = 0; // Streams, in bytes from the start of the file
+		uint64_t vertexOffset = 0;
+		uint64_t normalOffset = 0;
+		uint64_t uvOffset     = 0;
+		uint32_t lodCount     = 0; // Simplified levels, all in one stream after the full mesh's
+		uint32_t lodIndexCounts[Geometry::MAX_LODS - 1] = {0};
+		uint64_t lodOffset    = 0;
+		uint64_t padding      = 0; // To a multiple of ALIGNMENT
+	};
+
+	// Points into a cooked file's memory, valid for as long as that memory is
+	struct MeshView
+	{
+		const Header*   header   = NULL;
+		const uint32_t* indices  = NULL;
+		const Vec3*     vertices = NULL;
+		const Vec3*     normals  = NULL;
+		const Vec2*     uvs      = NULL;
+		const uint32_t* lodIndices = NULL;
+	};
+
+	// Picks the format from the extension and checks every index, false if anything is off
+	bool        readSource(const char* filename, Geometry::GeometryFileData* data);
+	// Box around the vertices and the origin, the sphere encloses the box
+	void        computeBounds(const std::vector<Vec3>& vertices, Vec3* min, Vec3* max, Vec3* center, float* radius);
+	uint64_t    hash(const void* data, size_t size, uint64_t seed = 0xcbf29ce484222325ULL); // FNV-1a
+	std::string getCookedPath(const char* source);
+	// True when cooked exists and the source is missing or not newer than it
+	bool        isCookedCurrent(const char* cooked, const char* source);
+
+	// Both return false and fill error when something is wrong. write computes the bounds
+	// unless data has them and replaces an existing file only once the new one is complete.
+	// read checks every count and offset so the view can be used without further checks.
+	bool write(const Geometry::GeometryFileData& data, uint32_t flags, uint64_t contentHash, const char* filename, std::string* error);
+	bool read(const void* data, size_t size, MeshView* view, std::string* error);
+	// Copies the streams and bounds of a cooked file into data
+	void copy(const MeshView& view, Geometry::GeometryFileData* data);
+}
+
+#endif
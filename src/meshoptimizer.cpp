@@ -0,0 +1,710 @@
+#include <algorithm>
+#include <unordered_map>
+#include <string.h>
+#include <math.h>
+#include <float.h>
+
+#include "meshoptimizer.h"
+#include "passert.h"
+
+namespace MeshOptimizer
+{
+	namespace
+	{
+		// Forsyth's constants, tuned for a 32 entry LRU cache
+		const int   CACHE_SIZE          = 32;
+		const float CACHE_DECAY_POWER   = 1.5f;
+		const float LAST_TRIANGLE_SCORE = 0.75f;
+		const float VALENCE_BOOST_SCALE = 2.f;
+		const float VALENCE_BOOST_POWER = 0.5f;
+		const int   OVERDRAW_CACHE_SIZE = 16;   // FIFO used to find where clusters may start
+		const float LOD_TRIANGLE_RATIO  = 0.5f;  // Of the level before
+		const float LOD_BASE_ERROR      = 0.01f; // Of the mesh size for the first level, doubles with every level
+		const float LOD_MIN_REDUCTION   = 0.85f; // Levels keeping more triangles of the one before are dropped
+		const double FLIP_THRESHOLD     = 0.25;  // Collapses turning a triangle's normal further than acos of it are refused
+		const double BOUNDARY_WEIGHT    = 10.0;  // Of the planes keeping borders and seams in place
+		const int    MAX_WEDGES         = 8;     // Corners split into more are never collapsed
+
+		struct VertexKey
+		{
+			float values[8]; // Position, normal and uv, -0 folded into 0 so they compare by bits
+
+			bool operator==(const VertexKey& other) const
+			{
+				return memcmp(values, other.values, sizeof(values)) == 0;
+			}
+		};
+
+		struct VertexKeyHash
+		{
+			size_t operator()(const VertexKey& key) const
+			{
+				// FNV-1a over the bits
+				const uint8_t* bytes = (const uint8_t*)key.values;
+				uint32_t hash = 2166136261u;
+				for(size_t i = 0; i < sizeof(key.values); i++) hash = (hash ^ bytes[i]) * 16777619u;
+				return hash;
+			}
+		};
+
+		VertexKey makeKey(const Geometry::GeometryFileData& data, uint32_t vertex)
+		{
+			VertexKey key;
+			Vec3 normal = vertex < data.normals.size() ? data.normals[vertex] : Vec3(0.f);
+			Vec2 uv     = vertex < data.uvs.size()     ? data.uvs[vertex]     : Vec2(0.f);
+			const Vec3& position = data.vertices[vertex];
+			float values[8] = {position.x, position.y, position.z, normal.x, normal.y, normal.z, uv.x, uv.y};
+			for(int i = 0; i < 8; i++) key.values[i] = values[i] == 0.f ? 0.f : values[i];
+			return key;
+		}
+
+		VertexKey makePositionKey(const Vec3& position)
+		{
+			VertexKey key;
+			memset(key.values, 0, sizeof(key.values));
+			for(int i = 0; i < 3; i++) key.values[i] = position[i] == 0.f ? 0.f : position[i];
+			return key;
+		}
+
+		struct Point
+		{
+			double x, y, z;
+		};
+
+		inline Point operator-(const Point& a, const Point& b) { return Point{a.x - b.x, a.y - b.y, a.z - b.z}; }
+		inline double dot(const Point& a, const Point& b)     { return a.x * b.x + a.y * b.y + a.z * b.z; }
+		inline Point cross(const Point& a, const Point& b)
+		{
+			return Point{a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x};
+		}
+
+		// Sum of squared distances to the planes of a vertex's triangles, weighted by their area
+		struct Quadric
+		{
+			double a00 = 0.0, a01 = 0.0, a02 = 0.0, a11 = 0.0, a12 = 0.0, a22 = 0.0;
+			double b0  = 0.0, b1  = 0.0, b2  = 0.0, c   = 0.0;
+			double weight = 0.0;
+
+			void addPlane(const Point& n, double d, double w)
+			{
+				a00 += w * n.x * n.x; a01 += w * n.x * n.y; a02 += w * n.x * n.z;
+				a11 += w * n.y * n.y; a12 += w * n.y * n.z; a22 += w * n.z * n.z;
+				b0  += w * n.x * d;   b1  += w * n.y * d;   b2  += w * n.z * d;
+				c   += w * d * d;
+				weight += w;
+			}
+
+			void add(const Quadric& other)
+			{
+				a00 += other.a00; a01 += other.a01; a02 += other.a02;
+				a11 += other.a11; a12 += other.a12; a22 += other.a22;
+				b0  += other.b0;  b1  += other.b1;  b2  += other.b2;
+				c   += other.c;
+				weight += other.weight;
+			}
+
+			// Mean squared distance of p to the planes
+			double error(const Point& p) const
+			{
+				double value = a00 * p.x * p.x + a11 * p.y * p.y + a22 * p.z * p.z +
+							   2.0 * (a01 * p.x * p.y + a02 * p.x * p.z + a12 * p.y * p.z) +
+							   2.0 * (b0 * p.x + b1 * p.y + b2 * p.z) + c;
+				return weight > 0.0 ? fabs(value) / weight : 0.0;
+			}
+		};
+
+		float vertexScore(int cachePosition, uint32_t remainingValence)
+		{
+			if(remainingValence == 0) return -1.f; // Nothing left to draw with it
+
+			float score = 0.f;
+			if(cachePosition >= 0)
+			{
+				// The last triangle's vertices get a fixed score so its neighbours don't
+				// always win, the rest decays with their age in the cache
+				if(cachePosition < 3)
+				{
+					score = LAST_TRIANGLE_SCORE;
+				}
+				else
+				{
+					const float scaler = 1.f / (CACHE_SIZE - 3);
+					score = powf(1.f - (cachePosition - 3) * scaler, CACHE_DECAY_POWER);
+				}
+			}
+			// Vertices with few triangles left are finished off before they become stragglers
+			score += VALENCE_BOOST_SCALE * powf((float)remainingValence, -VALENCE_BOOST_POWER);
+			return score;
+		}
+	}
+
+	void weld(Geometry::GeometryFileData* data)
+	{
+		PA_ASSERT(data);
+		uint32_t vertexCount = (uint32_t)data->vertices.size();
+		if(data->indices.empty())
+		{
+			data->indices.resize(vertexCount);
+			for(uint32_t i = 0; i < vertexCount; i++) data->indices[i] = i;
+		}
+
+		std::unordered_map<VertexKey, uint32_t, VertexKeyHash> unique;
+		unique.reserve(vertexCount);
+		std::vector<uint32_t> remap(vertexCount);
+		uint32_t welded = 0;
+		for(uint32_t i = 0; i < vertexCount; i++)
+		{
+			std::pair<std::unordered_map<VertexKey, uint32_t, VertexKeyHash>::iterator, bool> result =
+				unique.insert(std::make_pair(makeKey(*data, i), welded));
+			remap[i] = result.first->second;
+			if(!result.second) continue;
+
+			// Compact in place, the target slot is never ahead of the source
+			data->vertices[welded] = data->vertices[i];
+			if(i < data->normals.size()) data->normals[welded] = data->normals[i];
+			if(i < data->uvs.size())     data->uvs[welded]     = data->uvs[i];
+			welded++;
+		}
+		if(welded == vertexCount) return;
+
+		data->vertices.resize(welded);
+		if(data->normals.size() > welded) data->normals.resize(welded);
+		if(data->uvs.size() > welded)     data->uvs.resize(welded);
+		for(uint32_t& index : data->indices) index = remap[index];
+	}
+
+	void optimizeVertexCache(std::vector<uint32_t>* indices, uint32_t vertexCount)
+	{
+		PA_ASSERT(indices);
+		const size_t triangleCount = indices->size() / 3;
+		if(triangleCount == 0 || vertexCount == 0) return;
+		const std::vector<uint32_t>& input = *indices;
+
+		// Triangles using each vertex, packed into one array
+		std::vector<uint32_t> valence(vertexCount, 0);
+		for(size_t i = 0; i < triangleCount * 3; i++) valence[input[i]]++;
+		std::vector<uint32_t> adjacencyStart(vertexCount + 1, 0);
+		for(uint32_t v = 0; v < vertexCount; v++) adjacencyStart[v + 1] = adjacencyStart[v] + valence[v];
+		std::vector<uint32_t> adjacency(adjacencyStart[vertexCount]);
+		std::vector<uint32_t> fill(adjacencyStart.begin(), adjacencyStart.end() - 1);
+		for(size_t t = 0; t < triangleCount; t++)
+			for(int corner = 0; corner < 3; corner++)
+				adjacency[fill[input[t * 3 + corner]]++] = (uint32_t)t;
+
+		std::vector<int>   cachePosition(vertexCount, -1);
+		std::vector<float> vertexScores(vertexCount);
+		for(uint32_t v = 0; v < vertexCount; v++) vertexScores[v] = vertexScore(-1, valence[v]);
+
+		std::vector<float> triangleScores(triangleCount);
+		std::vector<bool>  emitted(triangleCount, false);
+		for(size_t t = 0; t < triangleCount; t++)
+			triangleScores[t] = vertexScores[input[t * 3]] + vertexScores[input[t * 3 + 1]] + vertexScores[input[t * 3 + 2]];
+
+		std::vector<uint32_t> output;
+		output.reserve(triangleCount * 3);
+		std::vector<uint32_t> cache;
+		std::vector<uint32_t> newCache;
+		cache.reserve(CACHE_SIZE + 3);
+		newCache.reserve(CACHE_SIZE + 3);
+		size_t scanCursor = 0;      // Everything before it was emitted
+		long   bestTriangle = -1;
+
+		for(size_t emittedCount = 0; emittedCount < triangleCount; emittedCount++)
+		{
+			if(bestTriangle < 0)
+			{
+				// Cache ran dry, continue with the next triangle in input order. Searching for
+				// the best one would go quadratic on meshes made of many separate pieces.
+				while(emitted[scanCursor]) scanCursor++;
+				bestTriangle = (long)scanCursor;
+			}
+
+			const uint32_t* triangle = &input[bestTriangle * 3];
+			output.insert(output.end(), triangle, triangle + 3);
+			emitted[bestTriangle] = true;
+
+			// The triangle's vertices move to the front, the rest keeps its order
+			newCache.assign(triangle, triangle + 3);
+			for(uint32_t vertex : cache)
+				if(vertex != triangle[0] && vertex != triangle[1] && vertex != triangle[2]) newCache.push_back(vertex);
+
+			for(int corner = 0; corner < 3; corner++)
+			{
+				uint32_t vertex = triangle[corner];
+				uint32_t* begin = &adjacency[adjacencyStart[vertex]];
+				uint32_t* end   = begin + valence[vertex];
+				uint32_t* found = std::find(begin, end, (uint32_t)bestTriangle);
+				*found = *(end - 1);
+				valence[vertex]--;
+			}
+
+			// Rescore everything that was or is in the cache, then pick the next triangle
+			// among those touching it
+			for(size_t i = 0; i < newCache.size(); i++)
+			{
+				uint32_t vertex = newCache[i];
+				cachePosition[vertex] = i < (size_t)CACHE_SIZE ? (int)i : -1;
+				vertexScores[vertex]  = vertexScore(cachePosition[vertex], valence[vertex]);
+			}
+			bestTriangle = -1;
+			float bestScore = -1.f;
+			for(uint32_t vertex : newCache)
+			{
+				const uint32_t* begin = &adjacency[adjacencyStart[vertex]];
+				for(uint32_t i = 0; i < valence[vertex]; i++)
+				{
+					uint32_t t = begin[i];
+					const uint32_t* corners = &input[t * 3];
+					triangleScores[t] = vertexScores[corners[0]] + vertexScores[corners[1]] + vertexScores[corners[2]];
+					if(triangleScores[t] > bestScore)
+					{
+						bestScore    = triangleScores[t];
+						bestTriangle = (long)t;
+					}
+				}
+			}
+			if(newCache.size() > (size_t)CACHE_SIZE) newCache.resize(CACHE_SIZE);
+			cache.swap(newCache);
+		}
+		indices->swap(output);
+	}
+
+	void optimizeOverdraw(std::vector<uint32_t>* indices, const std::vector<Vec3>& positions)
+	{
+		PA_ASSERT(indices);
+		const size_t triangleCount = indices->size() / 3;
+		if(triangleCount == 0) return;
+		const std::vector<uint32_t>& input = *indices;
+
+		// A cluster may start wherever a triangle misses the cache with all three vertices,
+		// moving clusters around then costs about nothing in vertex cache efficiency
+		std::vector<size_t>   clusterStarts;
+		std::vector<uint32_t> cacheTime(positions.size(), 0);
+		uint32_t time = OVERDRAW_CACHE_SIZE + 1;
+		for(size_t t = 0; t < triangleCount; t++)
+		{
+			int misses = 0;
+			for(int corner = 0; corner < 3; corner++)
+			{
+				uint32_t vertex = input[t * 3 + corner];
+				if(time - cacheTime[vertex] > (uint32_t)OVERDRAW_CACHE_SIZE)
+				{
+					cacheTime[vertex] = time++;
+					misses++;
+				}
+			}
+			if(misses == 3 || t == 0) clusterStarts.push_back(t);
+		}
+		if(clusterStarts.size() < 2) return;
+		clusterStarts.push_back(triangleCount);
+
+		Vec3  meshCenter(0.f);
+		float meshArea = 0.f;
+		struct Cluster
+		{
+			size_t start;
+			size_t end;
+			float  sortKey;
+		};
+		std::vector<Cluster> clusters(clusterStarts.size() - 1);
+		std::vector<Vec3>    clusterCenters(clusters.size());
+		std::vector<Vec3>    clusterNormals(clusters.size());
+		for(size_t c = 0; c < clusters.size(); c++)
+		{
+			Vec3  center(0.f);
+			Vec3  normal(0.f);
+			float area = 0.f;
+			for(size_t t = clusterStarts[c]; t < clusterStarts[c + 1]; t++)
+			{
+				const Vec3& a = positions[input[t * 3]];
+				const Vec3& b = positions[input[t * 3 + 1]];
+				const Vec3& d = positions[input[t * 3 + 2]];
+				Vec3  cross        = glm::cross(b - a, d - a);
+				float triangleArea = glm::length(cross) * 0.5f;
+				center += (a + b + d) * (triangleArea / 3.f);
+				normal += cross;
+				area   += triangleArea;
+			}
+			meshCenter += center;
+			meshArea   += area;
+			clusterCenters[c] = area > 0.f ? center / area : positions[input[clusterStarts[c] * 3]];
+			clusterNormals[c] = normal;
+			clusters[c].start = clusterStarts[c];
+			clusters[c].end   = clusterStarts[c + 1];
+		}
+		if(meshArea > 0.f) meshCenter /= meshArea;
+
+		for(size_t c = 0; c < clusters.size(); c++)
+		{
+			float length = glm::length(clusterNormals[c]);
+			Vec3  normal = length > 0.f ? clusterNormals[c] / length : Vec3(0.f);
+			clusters[c].sortKey = glm::dot(clusterCenters[c] - meshCenter, normal);
+		}
+		std::stable_sort(clusters.begin(), clusters.end(), [](const Cluster& a, const Cluster& b) { return a.sortKey > b.sortKey; });
+
+		std::vector<uint32_t> output;
+		output.reserve(input.size());
+		for(const Cluster& cluster : clusters)
+			output.insert(output.end(), input.begin() + cluster.start * 3, input.begin() + cluster.end * 3);
+		indices->swap(output);
+	}
+
+	void optimizeVertexFetch(Geometry::GeometryFileData* data)
+	{
+		PA_ASSERT(data);
+		const uint32_t vertexCount = (uint32_t)data->vertices.size();
+		std::vector<uint32_t> remap(vertexCount, UINT32_MAX);
+		uint32_t next = 0;
+		for(uint32_t& index : data->indices)
+		{
+			if(remap[index] == UINT32_MAX) remap[index] = next++;
+			index = remap[index];
+		}
+
+		// Vertices no index uses are dropped
+		std::vector<Vec3> vertices(next);
+		std::vector<Vec3> normals(data->normals.size() == vertexCount ? next : 0);
+		std::vector<Vec2> uvs(data->uvs.size() == vertexCount ? next : 0);
+		for(uint32_t v = 0; v < vertexCount; v++)
+		{
+			uint32_t target = remap[v];
+			if(target == UINT32_MAX) continue;
+			vertices[target] = data->vertices[v];
+			if(!normals.empty()) normals[target] = data->normals[v];
+			if(!uvs.empty())     uvs[target]     = data->uvs[v];
+		}
+		data->vertices.swap(vertices);
+		if(!normals.empty()) data->normals.swap(normals);
+		if(!uvs.empty())     data->uvs.swap(uvs);
+	}
+
+	float getACMR(const std::vector<uint32_t>& indices, uint32_t vertexCount, int cacheSize)
+	{
+		if(indices.size() < 3) return 0.f;
+		std::vector<uint32_t> cacheTime(vertexCount, 0);
+		uint32_t time   = (uint32_t)cacheSize + 1;
+		uint32_t misses = 0;
+		for(uint32_t index : indices)
+		{
+			if(time - cacheTime[index] > (uint32_t)cacheSize)
+			{
+				cacheTime[index] = time++;
+				misses++;
+			}
+		}
+		return (float)misses / (indices.size() / 3);
+	}
+
+	float simplify(const std::vector<uint32_t>& indices,
+				   const std::vector<Vec3>&     positions,
+				   size_t                       targetIndexCount,
+				   float                        maxError,
+				   std::vector<uint32_t>*       result)
+	{
+		PA_ASSERT(result);
+		const uint32_t vertexCount   = (uint32_t)positions.size();
+		const size_t   triangleCount = indices.size() / 3;
+		std::vector<uint32_t> triangles(indices.begin(), indices.begin() + triangleCount * 3);
+		result->clear();
+
+		Vec3 min(FLT_MAX), max(-FLT_MAX);
+		for(uint32_t index : triangles)
+		{
+			min = glm::min(min, positions[index]);
+			max = glm::max(max, positions[index]);
+		}
+		const float extent = triangleCount > 0 ? glm::max(max.x - min.x, glm::max(max.y - min.y, max.z - min.z)) : 0.f;
+		if(extent <= 0.f || triangleCount <= targetIndexCount / 3)
+		{
+			result->swap(triangles);
+			return 0.f;
+		}
+		// Errors are measured in units of the mesh size
+		std::vector<Point> points(vertexCount);
+		for(uint32_t v = 0; v < vertexCount; v++)
+		{
+			Vec3 scaled = (positions[v] - min) / extent;
+			points[v] = Point{scaled.x, scaled.y, scaled.z};
+		}
+
+		// Vertices sharing a position are wedges of one corner, split by a normal or uv seam.
+		// Corners collapse as a whole, each wedge onto the neighbour's wedge on the same side.
+		std::vector<uint32_t> corners(vertexCount);
+		std::unordered_map<VertexKey, uint32_t, VertexKeyHash> cornerByPosition;
+		cornerByPosition.reserve(vertexCount);
+		for(uint32_t v = 0; v < vertexCount; v++)
+			corners[v] = cornerByPosition.insert(std::make_pair(makePositionKey(positions[v]), v)).first->second;
+
+		// Edges of one triangle are borders, edges whose triangles use different wedges are seams.
+		// Both only collapse along themselves and put planes through them into the quadrics so they
+		// keep their shape. More than two triangles on an edge lock its corners.
+		struct EdgeUse
+		{
+			uint32_t count;
+			uint32_t wedges; // Sum of the wedge indices of the first triangle, enough to tell them apart
+			bool     seam;
+		};
+		std::unordered_map<uint64_t, EdgeUse> edges;
+		edges.reserve(triangles.size());
+		for(size_t t = 0; t < triangleCount; t++)
+		{
+			for(int k = 0; k < 3; k++)
+			{
+				uint32_t a = triangles[t * 3 + k];
+				uint32_t b = triangles[t * 3 + (k + 1) % 3];
+				uint64_t key = (uint64_t)std::min(corners[a], corners[b]) << 32 | std::max(corners[a], corners[b]);
+				std::pair<std::unordered_map<uint64_t, EdgeUse>::iterator, bool> inserted =
+					edges.insert(std::make_pair(key, EdgeUse{1, a + b, false}));
+				if(inserted.second) continue;
+				inserted.first->second.count++;
+				inserted.first->second.seam |= inserted.first->second.wedges != a + b;
+			}
+		}
+
+		std::vector<uint8_t> border(vertexCount, 0);
+		std::vector<uint8_t> locked(vertexCount, 0);
+		std::vector<Quadric> quadrics(vertexCount); // By corner
+		std::vector<std::vector<uint32_t>> adjacency(vertexCount); // Triangles by corner
+		for(size_t t = 0; t < triangleCount; t++)
+		{
+			const uint32_t* triangle = &triangles[t * 3];
+			for(int k = 0; k < 3; k++) adjacency[corners[triangle[k]]].push_back((uint32_t)t);
+			const Point& a      = points[triangle[0]];
+			Point        normal = cross(points[triangle[1]] - a, points[triangle[2]] - a);
+			double       length = sqrt(dot(normal, normal));
+			if(length == 0.0) continue;
+			normal = Point{normal.x / length, normal.y / length, normal.z / length};
+			for(int k = 0; k < 3; k++) quadrics[corners[triangle[k]]].addPlane(normal, -dot(normal, a), length * 0.5);
+
+			for(int k = 0; k < 3; k++)
+			{
+				uint32_t       first  = corners[triangle[k]];
+				uint32_t       second = corners[triangle[(k + 1) % 3]];
+				const EdgeUse& edge   = edges[(uint64_t)std::min(first, second) << 32 | std::max(first, second)];
+				if(edge.count > 2) locked[first] = locked[second] = 1;
+				if(edge.count == 1) border[first] = border[second] = 1;
+				if(edge.count != 1 && !edge.seam) continue;
+				// Plane through the edge at a right angle to the triangle
+				Point  direction  = points[second] - points[first];
+				Point  edgeNormal = cross(direction, normal);
+				double edgeLength = sqrt(dot(edgeNormal, edgeNormal));
+				if(edgeLength == 0.0) continue;
+				edgeNormal = Point{edgeNormal.x / edgeLength, edgeNormal.y / edgeLength, edgeNormal.z / edgeLength};
+				double weight = dot(direction, direction) * BOUNDARY_WEIGHT;
+				quadrics[first].addPlane(edgeNormal, -dot(edgeNormal, points[first]), weight);
+				quadrics[second].addPlane(edgeNormal, -dot(edgeNormal, points[first]), weight);
+			}
+		}
+
+		std::vector<bool> removed(triangleCount, false);
+		uint32_t wedgeFrom[MAX_WEDGES];
+		uint32_t wedgeTo[MAX_WEDGES];
+		int      wedgeCount = 0;
+
+		// Fills the wedge mapping for collapsing corner from onto corner to, false if that would
+		// tear a seam or border, merge wedges or isn't an edge of the mesh as it is now
+		auto mapWedges = [&](uint32_t from, uint32_t to)
+		{
+			wedgeCount = 0;
+			int edgeTriangles = 0;
+			for(uint32_t t : adjacency[from])
+			{
+				if(removed[t]) continue;
+				const uint32_t* triangle = &triangles[t * 3];
+				uint32_t fromWedge = UINT32_MAX, toWedge = UINT32_MAX;
+				for(int k = 0; k < 3; k++)
+				{
+					if(corners[triangle[k]] == from) fromWedge = triangle[k];
+					if(corners[triangle[k]] == to)   toWedge   = triangle[k];
+				}
+				if(toWedge == UINT32_MAX) continue;
+				edgeTriangles++;
+				int w = 0;
+				while(w < wedgeCount && wedgeFrom[w] != fromWedge) w++;
+				if(w < wedgeCount)
+				{
+					if(wedgeTo[w] != toWedge) return false;
+					continue;
+				}
+				if(wedgeCount == MAX_WEDGES) return false;
+				for(int other = 0; other < wedgeCount; other++)
+					if(wedgeTo[other] == toWedge) return false;
+				wedgeFrom[wedgeCount] = fromWedge;
+				wedgeTo[wedgeCount]   = toWedge;
+				wedgeCount++;
+			}
+			if(edgeTriangles != (border[from] ? 1 : 2)) return false;
+			// Every wedge of from needs a partner, or it has no side of the edge to go to
+			for(uint32_t t : adjacency[from])
+			{
+				if(removed[t]) continue;
+				const uint32_t* triangle = &triangles[t * 3];
+				for(int k = 0; k < 3; k++)
+				{
+					if(corners[triangle[k]] != from) continue;
+					int w = 0;
+					while(w < wedgeCount && wedgeFrom[w] != triangle[k]) w++;
+					if(w == wedgeCount) return false;
+				}
+			}
+			return true;
+		};
+
+		// Refuses collapses that turn a triangle around or squash it
+		auto flips = [&](uint32_t from, uint32_t to)
+		{
+			for(uint32_t t : adjacency[from])
+			{
+				const uint32_t* triangle = &triangles[t * 3];
+				if(removed[t] || corners[triangle[0]] == to || corners[triangle[1]] == to || corners[triangle[2]] == to)
+					continue;
+				Point before[3], after[3];
+				for(int k = 0; k < 3; k++)
+				{
+					before[k] = points[triangle[k]];
+					after[k]  = corners[triangle[k]] == from ? points[to] : before[k];
+				}
+				Point  normalBefore = cross(before[1] - before[0], before[2] - before[0]);
+				Point  normalAfter  = cross(after[1] - after[0], after[2] - after[0]);
+				double lengths      = sqrt(dot(normalBefore, normalBefore) * dot(normalAfter, normalAfter));
+				if(dot(normalBefore, normalAfter) <= FLIP_THRESHOLD * lengths) return true;
+			}
+			return false;
+		};
+
+		struct Collapse
+		{
+			uint32_t from;
+			uint32_t to;
+			double   cost;
+		};
+		std::vector<Collapse> collapses;
+		std::vector<uint8_t>  touched(vertexCount);
+		size_t       liveTriangles   = triangleCount;
+		const size_t targetTriangles = targetIndexCount / 3;
+		const double maxCost         = (double)maxError * maxError;
+		double       reachedCost     = 0.0;
+
+		// Every pass collapses the cheapest corners, each corner at most once so the costs
+		// computed at the start stay close to the truth
+		while(liveTriangles > targetTriangles)
+		{
+			collapses.clear();
+			for(uint32_t corner = 0; corner < vertexCount; corner++)
+			{
+				if(corners[corner] != corner || locked[corner] || adjacency[corner].empty()) continue;
+				Collapse best = {corner, corner, DBL_MAX};
+				for(uint32_t t : adjacency[corner])
+				{
+					for(int k = 0; k < 3; k++)
+					{
+						uint32_t other = corners[triangles[t * 3 + k]];
+						if(other == corner) continue;
+						double cost = quadrics[corner].error(points[other]);
+						if(cost < best.cost && cost <= maxCost && mapWedges(corner, other))
+							best = Collapse{corner, other, cost};
+					}
+				}
+				if(best.to != corner) collapses.push_back(best);
+			}
+			std::sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b) { return a.cost < b.cost; });
+
+			std::fill(touched.begin(), touched.end(), 0);
+			size_t collapsed = 0;
+			for(const Collapse& collapse : collapses)
+			{
+				if(liveTriangles <= targetTriangles) break;
+				const uint32_t from = collapse.from;
+				const uint32_t to   = collapse.to;
+				if(touched[from] || touched[to] || !mapWedges(from, to) || flips(from, to)) continue;
+
+				// Triangles along the edge disappear, the others move their wedge of from to the
+				// matching wedge of to
+				for(uint32_t t : adjacency[from])
+				{
+					if(removed[t]) continue;
+					uint32_t* triangle = &triangles[t * 3];
+					if(corners[triangle[0]] == to || corners[triangle[1]] == to || corners[triangle[2]] == to)
+					{
+						removed[t] = true;
+						liveTriangles--;
+						continue;
+					}
+					for(int k = 0; k < 3; k++)
+					{
+						if(corners[triangle[k]] != from) continue;
+						int w = 0;
+						while(wedgeFrom[w] != triangle[k]) w++;
+						triangle[k] = wedgeTo[w];
+					}
+					adjacency[to].push_back(t);
+				}
+				adjacency[from].clear();
+				quadrics[to].add(quadrics[from]);
+				touched[from] = touched[to] = 1;
+				reachedCost = std::max(reachedCost, collapse.cost);
+				collapsed++;
+			}
+			if(collapsed == 0) break;
+
+			for(std::vector<uint32_t>& triangleList : adjacency)
+			{
+				triangleList.erase(std::remove_if(triangleList.begin(), triangleList.end(),
+												  [&removed](uint32_t t) { return removed[t]; }),
+								   triangleList.end());
+			}
+		}
+
+		result->reserve(liveTriangles * 3);
+		for(size_t t = 0; t < triangleCount; t++)
+			if(!removed[t]) result->insert(result->end(), &triangles[t * 3], &triangles[t * 3] + 3);
+		return (float)sqrt(reachedCost);
+	}
+
+	void generateLods(Geometry::GeometryFileData* data, int levels)
+	{
+		PA_ASSERT(data);
+		data->lodIndices.clear();
+		data->lodIndexCounts.clear();
+		const uint32_t vertexCount = (uint32_t)data->vertices.size();
+		std::vector<uint32_t> previous(data->indices);
+		std::vector<uint32_t> level;
+		float maxError = LOD_BASE_ERROR;
+		for(int i = 0; i < levels && i < Geometry::MAX_LODS - 1; i++, maxError *= 2.f)
+		{
+			// Each level starts from the one before, that keeps them consistent and is faster
+			size_t target = (size_t)(previous.size() / 3 * LOD_TRIANGLE_RATIO) * 3;
+			simplify(previous, data->vertices, target, maxError, &level);
+			if(level.size() < 3 || level.size() > previous.size() * LOD_MIN_REDUCTION) break;
+			optimizeVertexCache(&level, vertexCount);
+			data->lodIndices.insert(data->lodIndices.end(), level.begin(), level.end());
+			data->lodIndexCounts.push_back((uint32_t)level.size());
+			previous.swap(level);
+		}
+	}
+
+	void optimize(Geometry::GeometryFileData* data, Stats* stats)
+	{
+		PA_ASSERT(data);
+		if(stats)
+		{
+			stats->verticesBefore = (uint32_t)data->vertices.size();
+			if(data->indices.empty())
+				stats->acmrBefore = data->vertices.size() >= 3 ? 3.f : 0.f;
+			else
+				stats->acmrBefore = getACMR(data->indices, (uint32_t)data->vertices.size());
+		}
+
+		weld(data);
+		optimizeVertexCache(&data->indices, (uint32_t)data->vertices.size());
+		optimizeOverdraw(&data->indices, data->vertices);
+		optimizeVertexFetch(data);
+
+		if(stats)
+		{
+			stats->verticesAfter = (uint32_t)data->vertices.size();
+			stats->indexCount    = (uint32_t)data->indices.size();
+			stats->acmrAfter     = getACMR(data->indices, (uint32_t)data->vertices.size());
+		}
+	}
+}
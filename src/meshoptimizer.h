@@ -0,0 +1,51 @@
+#ifndef meshoptimizer_H
+#define meshoptimizer_H
+
+#include <vector>
+#include <stdint.h>
+
+#include "geometry.h"
+
+// Mesh preparation for the GPU, used when geometry is loaded and by the content tools.
+// Everything works on GeometryFileData and touches no GL or shared state, so it is safe
+// on loader threads. Indices stay 32 bit here, Geometry narrows them when uploading.
+namespace MeshOptimizer
+{
+	struct Stats
+	{
+		uint32_t verticesBefore = 0;
+		uint32_t verticesAfter  = 0;
+		uint32_t indexCount     = 0;
+		float    acmrBefore     = 0.f; // Post transform cache misses per triangle
+		float    acmrAfter      = 0.f;
+	};
+
+	// Weld, vertex cache order, overdraw order and vertex fetch order in that sequence
+	void  optimize(Geometry::GeometryFileData* data, Stats* stats = NULL);
+	// Merges vertices whose position, normal and uv are identical, unindexed meshes get indices
+	void  weld(Geometry::GeometryFileData* data);
+	// Forsyth's linear speed triangle order for an LRU cache
+	void  optimizeVertexCache(std::vector<uint32_t>* indices, uint32_t vertexCount);
+	// Splits the cache ordered triangles where the cache starts over anyway and draws the
+	// clusters facing away from the mesh center first, so they occlude the rest
+	void  optimizeOverdraw(std::vector<uint32_t>* indices, const std::vector<Vec3>& positions);
+	// Renumbers vertices in the order the indices first use them
+	void  optimizeVertexFetch(Geometry::GeometryFileData* data);
+	// Simulates a FIFO cache like most hardware has
+	float getACMR(const std::vector<uint32_t>& indices, uint32_t vertexCount, int cacheSize = 16);
+	// Quadric error simplification (Garland and Heckbert). Vertices collapse onto a neighbour
+	// instead of moving, so the result indexes the same vertices as the input and levels can
+	// share one vertex buffer. Borders and normal or uv seams stay where they are. Stops at
+	// targetIndexCount or before the surface would move more than maxError, relative to the
+	// largest side of the bounds, and returns the error reached in the same unit.
+	float simplify(const std::vector<uint32_t>& indices,
+				   const std::vector<Vec3>&     positions,
+				   size_t                       targetIndexCount,
+				   float                        maxError,
+				   std::vector<uint32_t>*       result);
+	// Simplified levels of the welded mesh in data, each with half the triangles of the one
+	// before and twice the error, see Geometry::selectLod for the screen sizes they are made for
+	void  generateLods(Geometry::GeometryFileData* data, int levels = Geometry::MAX_LODS - 1);
+}
+
+#endif
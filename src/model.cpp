@@ -15,28 +15,89 @@
 #include "geometry.h"
 #include "boundingvolumes.h"
 #include "editor.h"
+#include "componentpool.h"
+#include "spatialindex.h"
+#include "cullbatch.h"
 
 namespace Model
 {
 	namespace
 	{
-		std::vector<CModel>        modelList;
-		std::vector<unsigned int>  emptyIndices;
+		ComponentPool<CModel>      modelList;
 		int                        culled      = 0;
 		int                        rendered    = 0;
 		int                        lightCount  = 0;
 		int                        totalVertCount   = 0;
+		CullBounds                 worldBounds;     // Indexed by model index, kept current by updateWorldBounds
+		std::vector<uint32_t>      visibleModels;   // Bit per model index, set by cullModels for the pass being drawn
+
+		// Tests the packed bounds of every model, several at a time, instead of one box per draw
+		void cullModels(const Frustum& frustum)
+		{
+			const int cullingMode = Geometry::getCullingMode();
+			if(worldBounds.count < modelList.size()) CullBatch::resize(&worldBounds, modelList.size());
+			if(cullingMode == CM_NONE)
+				visibleModels.assign((modelList.size() + 31) / 32, ~0u);
+			else
+				CullBatch::cull(frustum, worldBounds, cullingMode == CM_SPHERE, &visibleModels);
+		}
+
+		bool isVisible(int modelIndex)
+		{
+			return CullBatch::isVisible(visibleModels, modelIndex);
+		}
+
+		void setPositionDecode(int shaderIndex, int geometryIndex)
+		{
+			Vec3 positionScale, positionBias;
+			Geometry::getPositionDecode(geometryIndex, &positionScale, &positionBias);
+			Shader::setUniformVec3(shaderIndex, "positionScale", positionScale);
+			Shader::setUniformVec3(shaderIndex, "positionBias",  positionBias);
+		}
+
+		// Moves a registered model to another material's list
+		bool changeMaterial(int modelIndex, Mat_Type material)
+		{
+			CModel* model = &modelList[modelIndex];
+			if(model->material == material) return true;
+			if(!Material::unRegisterModel(modelIndex, (Mat_Type)model->material))
+			{
+				Log::error("Model::changeMaterial", "Model could not be unregistered");
+				return false;
+			}
+			model->material = material;
+			// Just taken out of the old list, so it can't be in the new one
+			Material::registerNewModel(modelIndex, material);
+			return true;
+		}
+
+		// Largest factor the matrix scales any axis by, what a local bounding sphere's radius grows by
+		float getMaxScale(const Mat4& matrix)
+		{
+			return glm::max(glm::length(Vec3(matrix[0])), glm::max(glm::length(Vec3(matrix[1])), glm::length(Vec3(matrix[2]))));
+		}
+
+		// Diameter of the geometry's bounding sphere over the viewport height, what Geometry::selectLod takes
+		float getScreenSize(const CCamera* camera, const Mat4& modelMat, int geometryIndex)
+		{
+			const BoundingSphere* boundingSphere = Geometry::getBoundingSphere(geometryIndex);
+			if(!boundingSphere) return 1.f;
+			const float radius = boundingSphere->radius * getMaxScale(modelMat);
+			if(camera->isOrthographic) return radius * camera->projMat[1][1];
+			const Vec4  center   = camera->viewMat * modelMat * Vec4(boundingSphere->center, 1.f);
+			const float distance = glm::length(Vec3(center));
+			if(distance <= radius) return 1.f; // Inside the sphere
+			return radius * camera->projMat[1][1] / distance;
+		}
   	}
 
 	int setLights(int shaderIndex, CCamera* camera)
 	{
-		std::vector<uint32_t>* activeLights = Light::getActiveLights();
 		uint32_t count = 0;
-		for(uint32_t lightIndex : *activeLights)
+		for(auto entry : SceneManager::view<Component::TRANSFORM, Component::LIGHT>())
 		{
-			CLight*     light      = Light::getLightAtIndex(lightIndex);
-			GameObject* gameObject = SceneManager::find(light->node);
-			CTransform* transform  = GO::getTransform(gameObject);
+			CLight*     light     = Light::getLightAtIndex(entry[Component::LIGHT]);
+			CTransform* transform = Transform::getTransformAtIndex(entry[Component::TRANSFORM]);
 
 			if(light->type != LT_DIR &&
 			   !BoundingVolume::isIntersecting(&camera->frustum, &light->boundingSphere, transform))
@@ -66,10 +127,10 @@ namespace Model
 								   light->color);
 			Shader::setUniformVec3(shaderIndex,
 								   std::string(arrayIndex + "direction").c_str(),
-								   transform->forward);
+								   Transform::getWorldForward(transform));
 			Shader::setUniformVec3(shaderIndex,
 								   std::string(arrayIndex + "position").c_str(),
-								   transform->position);
+								   Transform::getWorldPosition(transform));
 			count++;
 			if(count > (Light::MAX_LIGHTS - 1))
 			{
@@ -103,29 +164,41 @@ namespace Model
 			//camera->projMat = glm::ortho(-limit, limit, -limit, limit, -camera->farZ / 2.f, camera->farZ);
 		    camera->projMat = glm::ortho(-limit, limit, -limit, limit, -limit / 2.f, limit);
 
-			if(cameraTransform->position != viewerTransform->position)
-				Transform::setPosition(cameraTransform, viewerTransform->position);
+			Vec3 viewerPosition = Transform::getWorldPosition(viewerTransform);
+			if(Transform::getWorldPosition(cameraTransform) != viewerPosition)
+			{
+				// Shadow camera view is needed right away, don't wait for the next flush
+				Transform::setWorldPosition(cameraTransform, viewerPosition);
+				Transform::updateTransformMatrix(cameraTransform);
+			}
 
 			Camera::updateViewProjection(camera);
 		}
 
-		for(CModel& model : modelList)
+		cullModels(camera->frustum);
+		for(auto entry : SceneManager::view<Component::TRANSFORM, Component::MODEL>())
 		{
-			if(model.node == -1 || model.materialUniforms.castShadow == false)
+			int           modelIndex = entry[Component::MODEL];
+			const CModel& model      = modelList[modelIndex];
+			if(model.materialUniforms.castShadow == false || !isVisible(modelIndex))
 				continue;
-			GameObject* gameObject = SceneManager::find(model.node);
-			CTransform* transform  = GO::getTransform(gameObject);
-			Mat4        transMat   = transform->transMat;
-			Mat4        mvp        = camera->viewProjMat * transform->transMat;
+			// The shadow shader takes positions as they are, fold their decode into the matrix
+			Vec3 positionScale, positionBias;
+			Geometry::getPositionDecode(model.geometryIndex, &positionScale, &positionBias);
+			CTransform* transform = Transform::getTransformAtIndex(entry[Component::TRANSFORM]);
+			Mat4        decode    = glm::translate(positionBias) * glm::scale(positionScale);
+			Mat4        mvp       = camera->viewProjMat * Transform::getRenderMatrix(transform) * decode;
 			Shader::setUniformMat4(shader, "mvp", mvp);
-			Geometry::render(model.geometryIndex, &camera->frustum, transform);
+			Geometry::render(model.geometryIndex, model.lod); // The level the camera passes picked last
 		}
+		Geometry::unbind();
 	}
 
 	void renderAllModels(CCamera* camera, RenderParams* renderParams, CLight* light, int iteration)
 	{
 		GameObject* viewer          = SceneManager::find(camera->node);
 		CTransform* viewerTransform = GO::getTransform(viewer);
+		cullModels(camera->frustum);
 		
 		for(Mat_Type material : Material::MATERIAL_LIST)
 		{
@@ -149,8 +222,8 @@ namespace Model
 				Shader::setUniformInt(shaderIndex,   "light.castShadow", light->castShadow);
 				Shader::setUniformInt(shaderIndex,   "light.pcfEnabled", light->pcfEnabled);
 				Shader::setUniformVec4(shaderIndex,  "light.color", 	 light->color);
-				Shader::setUniformVec3(shaderIndex,  "light.direction",  lightTransform->forward);
-				Shader::setUniformVec3(shaderIndex,  "light.position",   lightTransform->position);
+				Shader::setUniformVec3(shaderIndex,  "light.direction",  Transform::getWorldForward(lightTransform));
+				Shader::setUniformVec3(shaderIndex,  "light.position",   Transform::getWorldPosition(lightTransform));
 
 				if(light->castShadow)
 				{
@@ -170,7 +243,7 @@ namespace Model
 			}
 			
 			// Setup uniforms for material
-			Shader::setUniformVec3(shaderIndex, "eyePos", viewerTransform->position);
+			Shader::setUniformVec3(shaderIndex, "eyePos", Transform::getWorldPosition(viewerTransform));
 			Shader::setUniformFloat(shaderIndex, "fog.density",  renderParams->fog.density);
 			Shader::setUniformFloat(shaderIndex, "fog.start",    renderParams->fog.start);
 			Shader::setUniformFloat(shaderIndex, "fog.max",      renderParams->fog.max);
@@ -188,23 +261,28 @@ namespace Model
 				
 			for(int modelIndex : *registeredMeshes)
 			{
-				const CModel* model      = &modelList[modelIndex];
+				if(!isVisible(modelIndex))
+				{
+					culled++;
+					continue;
+				}
+				CModel*       model      = &modelList[modelIndex];
 				GameObject*   gameObject = SceneManager::find(model->node);
-				CTransform*   transform  = GO::getTransform(gameObject);					
-				Mat4          mvp        = camera->viewProjMat * transform->transMat;
+				CTransform*   transform  = GO::getTransform(gameObject);
+				const Mat4&   modelMat   = Transform::getRenderMatrix(transform);
+				Mat4          mvp        = camera->viewProjMat * modelMat;
 
 				Shader::setUniformMat4(shaderIndex, "mvp", mvp);
-				Shader::setUniformMat4(shaderIndex, "modelMat", transform->transMat);
+				Shader::setUniformMat4(shaderIndex, "modelMat", modelMat);
+				setPositionDecode(shaderIndex, model->geometryIndex);
 				Material::setMaterialUniforms(&model->materialUniforms, (Mat_Type)model->material);
-				int vertCount = Geometry::render(model->geometryIndex, &camera->frustum, transform);
-				totalVertCount += vertCount;
-				if(vertCount > 0)
-					rendered++;
-				else
-					culled++;
+				model->lod      = Geometry::selectLod(model->geometryIndex, getScreenSize(camera, modelMat, model->geometryIndex), model->lod);
+				totalVertCount += Geometry::render(model->geometryIndex, model->lod);
+				rendered++;
 				if(model->material == MAT_UNSHADED_TEXTURED || model->material == MAT_PHONG_TEXTURED)
 					if(model->materialUniforms.texture != -1) Texture::unbind(4);
 			}
+			Geometry::unbind();
 
 			if(material == MAT_PHONG || material == MAT_PHONG_TEXTURED)
 			{
@@ -233,6 +311,7 @@ namespace Model
 	{
 		GameObject* viewer = SceneManager::find(camera->node);
 		CTransform* viewerTransform = GO::getTransform(viewer);
+		cullModels(camera->frustum);
 		
 		for(Mat_Type material : Material::MATERIAL_LIST)
 		{
@@ -247,7 +326,7 @@ namespace Model
 				lightCount = setLights(shaderIndex, camera);					
 			}
 			// Setup uniforms for material
-			Shader::setUniformVec3(shaderIndex, "eyePos", viewerTransform->position);
+			Shader::setUniformVec3(shaderIndex, "eyePos", Transform::getWorldPosition(viewerTransform));
 			Shader::setUniformFloat(shaderIndex, "fog.density",  renderParams->fog.density);
 			Shader::setUniformFloat(shaderIndex, "fog.start",    renderParams->fog.start);
 			Shader::setUniformFloat(shaderIndex, "fog.max",      renderParams->fog.max);
@@ -258,23 +337,28 @@ namespace Model
 				
 			for(int modelIndex : *registeredMeshes)
 			{
-				const CModel* model      = &modelList[modelIndex];
+				if(!isVisible(modelIndex))
+				{
+					culled++;
+					continue;
+				}
+				CModel*       model      = &modelList[modelIndex];
 				GameObject*   gameObject = SceneManager::find(model->node);
-				CTransform*   transform  = GO::getTransform(gameObject);					
-				Mat4          mvp        = camera->viewProjMat * transform->transMat;
+				CTransform*   transform  = GO::getTransform(gameObject);
+				const Mat4&   modelMat   = Transform::getRenderMatrix(transform);
+				Mat4          mvp        = camera->viewProjMat * modelMat;
 
 				Shader::setUniformMat4(shaderIndex, "mvp", mvp);
-				Shader::setUniformMat4(shaderIndex, "modelMat", transform->transMat);
+				Shader::setUniformMat4(shaderIndex, "modelMat", modelMat);
+				setPositionDecode(shaderIndex, model->geometryIndex);
 				Material::setMaterialUniforms(&model->materialUniforms, (Mat_Type)model->material);
-				int vertCount = Geometry::render(model->geometryIndex, &camera->frustum, transform);
-				totalVertCount += vertCount;
-				if(vertCount > 0)
-					rendered++;
-				else
-					culled++;
+				model->lod      = Geometry::selectLod(model->geometryIndex, getScreenSize(camera, modelMat, model->geometryIndex), model->lod);
+				totalVertCount += Geometry::render(model->geometryIndex, model->lod);
+				rendered++;
 				if(model->material == MAT_UNSHADED_TEXTURED || model->material == MAT_PHONG_TEXTURED)
 					Texture::unbind(4);
 			}
+			Geometry::unbind();
 			Shader::unbind();
 		}
 		Editor::addDebugInt("Vertices", totalVertCount);
@@ -296,19 +380,8 @@ namespace Model
 		int geometryIndex = Geometry::create(filename);
 		if(geometryIndex != -1)
 		{
-			if(emptyIndices.empty())
-			{
-				modelList.push_back(model);
-				index = modelList.size() - 1;
-			}
-			else
-			{
-				index = emptyIndices.back();
-				modelList[index] = model;
-				emptyIndices.pop_back();
-			}
-			if(!Material::registerModel(index, (Mat_Type)model.material))
-				Log::warning("Model already registered with material");
+			index = modelList.create();
+			Material::registerNewModel(index, (Mat_Type)model.material);
 			modelList[index].materialUniforms.texture = Texture::create("default.png");
 			modelList[index].geometryIndex = geometryIndex;
 		}
@@ -319,10 +392,26 @@ namespace Model
 		return index;
 	}
 
+	void updateWorldBounds(GameObject* gameObject, const BoundingBox* worldBox)
+	{
+		PA_ASSERT(gameObject);
+		const int modelIndex = gameObject->compIndices[Component::MODEL];
+		if(!modelList.isValid(modelIndex)) return;
+		if(modelIndex >= worldBounds.count) CullBatch::resize(&worldBounds, modelList.size());
+		const BoundingSphere* localSphere = Geometry::getBoundingSphere(modelList[modelIndex].geometryIndex);
+		if(!worldBox || !localSphere)
+		{
+			CullBatch::clear(&worldBounds, modelIndex);
+			return;
+		}
+		const Mat4& worldMatrix = Transform::getWorldMatrix(GO::getTransform(gameObject));
+		CullBatch::set(&worldBounds, modelIndex, *worldBox, localSphere->radius * getMaxScale(worldMatrix));
+	}
+
 	CModel* getModelAtIndex(int modelIndex)
 	{
 		CModel* model = NULL;
-		if(modelIndex > -1 && modelIndex < (int)modelList.size())
+		if(modelIndex > -1 && modelIndex < modelList.size())
 			model = &modelList[modelIndex];
 		else
 			Log::error("Model::getModelAtindex", "Invalid modelIndex");
@@ -332,11 +421,11 @@ namespace Model
 
 	void cleanup()
 	{
-		for(unsigned int i = 0; i < modelList.size(); i++)
-			remove(i);
+		while(!modelList.getLive().empty())
+			remove(modelList.getLive().back());
 
 		modelList.clear();
-		emptyIndices.clear();
+		CullBatch::resize(&worldBounds, 0);
 	}
 
     bool writeToJSON(CModel* model, rapidjson::Writer<rapidjson::StringBuffer>& writer)
@@ -364,6 +453,65 @@ namespace Model
 		writer.EndObject();
 		return success;
 	}
+
+	void writeToBinary(CModel* model, SceneFormat::ModelRecord* record, SceneFormat::SceneData* scene)
+	{
+		PA_ASSERT(model);
+		PA_ASSERT(record);
+		const Mat_Uniforms& uniforms = model->materialUniforms;
+		record->geometry         = scene->addString(Geometry::getName(model->geometryIndex));
+		record->texture          = uniforms.texture != -1 ? scene->addString(Texture::getFilename(uniforms.texture))
+			                                              : SceneFormat::NONE;
+		record->material         = model->material;
+		record->diffuse          = uniforms.diffuse;
+		record->specular         = uniforms.specular;
+		record->specularStrength = uniforms.specularStrength;
+		record->castShadow       = uniforms.castShadow ? 1 : 0;
+		for(int i = 0; i < 4; i++) record->diffuseColor[i] = uniforms.diffuseColor[i];
+	}
+
+	bool createFromBinary(int                             modelIndex,
+						  const SceneFormat::ModelRecord& record,
+						  const SceneFormat::SceneView&   scene)
+	{
+		PA_ASSERT(modelList.isValid(modelIndex));
+		bool          success  = true;
+		CModel*       model    = &modelList[modelIndex];
+		Mat_Uniforms& uniforms = model->materialUniforms;
+		// Models are usually created with their geometry already, see SceneManager::loadSceneBinary
+		const char* geometry = scene.getString(record.geometry);
+		if(!geometry || (Geometry::getName(model->geometryIndex) != geometry && !setGeometry(model, geometry)))
+		{
+			success = false;
+			Log::error("Model::createFromBinary", "Error loading Geometry");
+		}
+		const char* texture = scene.getString(record.texture);
+		if(texture)
+		{
+			int index = Texture::create(texture);
+			if(index > -1)
+			{
+				if(uniforms.texture != -1) Texture::remove(uniforms.texture);
+				uniforms.texture = index;
+			}
+		}
+		for(int i = 0; i < 4; i++) uniforms.diffuseColor[i] = record.diffuseColor[i];
+		uniforms.diffuse          = glm::clamp(record.diffuse, 0.f, 1.f);
+		uniforms.specular         = glm::clamp(record.specular, 0.f, 1.f);
+		uniforms.specularStrength = glm::max(record.specularStrength, 0.f);
+		uniforms.castShadow       = record.castShadow != 0;
+		if(record.material > -1 && record.material < 4)
+		{
+			// The loader knows the index, no need to search the model list for it
+			success = changeMaterial(modelIndex, (Mat_Type)record.material) && success;
+		}
+		else
+		{
+			success = false;
+			Log::error("Model::createFromBinary", "Error loading Material");
+		}
+		return success;
+	}
 		
 	void generateBindings()
 	{
@@ -391,13 +539,45 @@ namespace Model
 
 	void remove(int modelIndex)
 	{
+		if(!modelList.isValid(modelIndex))
+		{
+			Log::warning("Model at index " + std::to_string(modelIndex) + " already removed");
+			return;
+		}
 		CModel* model = &modelList[modelIndex];
 		model->node   = -1;
 		Material::removeMaterialUniforms(&model->materialUniforms, (Mat_Type)model->material);
 		if(!Material::unRegisterModel(modelIndex, (Mat_Type)model->material))
 			Log::warning("Model at index " + std::to_string(modelIndex) + " not unregistered");
 		Geometry::remove(model->geometryIndex);
-		emptyIndices.push_back(modelIndex);
+		modelList.remove(modelIndex);
+		if(modelIndex < worldBounds.count) CullBatch::clear(&worldBounds, modelIndex);
+	}
+
+	void reserve(int count)
+	{
+		modelList.reserve(count);
+	}
+
+	void remove(const std::vector<int>& modelIndices)
+	{
+		std::vector<bool> removedModels(modelList.size(), false);
+		for(int modelIndex : modelIndices)
+		{
+			if(!modelList.isValid(modelIndex))
+			{
+				Log::warning("Model at index " + std::to_string(modelIndex) + " already removed");
+				continue;
+			}
+			CModel* model = &modelList[modelIndex];
+			model->node = -1;
+			Material::removeMaterialUniforms(&model->materialUniforms, (Mat_Type)model->material);
+			Geometry::remove(model->geometryIndex);
+			modelList.remove(modelIndex);
+			if(modelIndex < worldBounds.count) CullBatch::clear(&worldBounds, modelIndex);
+			removedModels[modelIndex] = true;
+		}
+		Material::unRegisterModels(removedModels);
 	}
 		
 	void initialize()
@@ -418,20 +598,8 @@ namespace Model
 		}
 		if(index != -1)
 		{
-			if(Material::unRegisterModel(index, (Mat_Type)model->material))
-			{
-				model->material = material;
-				if(!Material::registerModel(index, material))
-				{
-					Log::error("Model::setMaterialType", "Model could not be registered");
-					success = false;
-				}
-			}
-			else
-			{
-				Log::error("Model::setMaterialType", "Model could not be unregistered");
-				success = false;
-			}
+			success = changeMaterial(index, material);
+			SceneManager::markDirty(model->node);
 		}
 		else
 		{
@@ -441,135 +609,189 @@ namespace Model
 		return success;
 	}
 
-	bool createFromJSON(CModel* model, const rapidjson::Value& value)
+	namespace
 	{
-		using namespace rapidjson;
-		bool success = true;
-		const char* error = "Invalid value in a field";
-		PA_ASSERT(model);
-
-		if(value.IsObject())
+		// Shared by createFromJSON and createTemplateFromJSON. The material type is returned
+		// instead of applied because templates are not registered with a material.
+		bool readFromJSON(CModel* model, const rapidjson::Value& value, int* materialType)
 		{
-			if(value.HasMember("Geometry") && value["Geometry"].IsString())
-			{
-				const Value& geometryNode = value["Geometry"];
-				const std::string& filename = geometryNode.GetString();
-				setGeometry(model, filename.c_str());
-			}
-			else
-			{
-				success = false;
-				Log::error("Model::createFromJSON", "Error loading Geometry");
-			}
+			using namespace rapidjson;
+			bool success = true;
+			const char* error = "Invalid value in a field";
+			PA_ASSERT(model);
 
-			if(value.HasMember("Material") && value["Material"].IsInt())
+			if(value.IsObject())
 			{
-				const Value& materialNode = value["Material"];
-				int material = materialNode.GetInt();
-				if(material > -1 && material < 4)
-					setMaterialType(model, (Mat_Type)material);
-				else
-					success = false;
-			}
-			else
-			{
-				success = false;
-				Log::error("Model::createFromJSON", "Error loading Material");
-			}
-
-			if(value.HasMember("MaterialUniforms") && value["MaterialUniforms"].IsObject())
-			{
-				const Value& matUniforms = value["MaterialUniforms"];
-				if(matUniforms.HasMember("DiffuseColor") && matUniforms["DiffuseColor"].IsArray())
+				if(value.HasMember("Geometry") && value["Geometry"].IsString())
 				{
-					const Value& diffuseColorNode = matUniforms["DiffuseColor"];
-					int items = diffuseColorNode.Size() < 4 ? diffuseColorNode.Size() : 4;
-					for(int i = 0; i < items; i++)
-					{
-						if(diffuseColorNode[i].IsNumber())
-							model->materialUniforms.diffuseColor[i] = (float)diffuseColorNode[i].GetDouble();
-						else
-							success = false;
-					}
+					const Value& geometryNode = value["Geometry"];
+					const std::string& filename = geometryNode.GetString();
+					setGeometry(model, filename.c_str());
 				}
 				else
 				{
 					success = false;
-					Log::error("Model::createFromJSON", "Error loading MaterialUniforms.DiffuseColor");
-				}
-
-				if(matUniforms.HasMember("Texture") && matUniforms["Texture"].IsString())
-				{
-					const Value& textureNode = matUniforms["Texture"];
-					const std::string& filename = textureNode.GetString();
-					int index = Texture::create(filename.c_str());
-					if(index > -1) model->materialUniforms.texture = index;
-				}
-
-				if(matUniforms.HasMember("CastShadow") && matUniforms["CastShadow"].IsBool())
-				{
-					const Value& castShadowNode = matUniforms["CastShadow"];
-					model->materialUniforms.castShadow = castShadowNode.GetBool();
+					Log::error("Model::createFromJSON", "Error loading Geometry");
 				}
 
-				if(matUniforms.HasMember("Diffuse") && matUniforms["Diffuse"].IsNumber())
+				if(value.HasMember("Material") && value["Material"].IsInt())
 				{
-					const Value& diffuseNode = matUniforms["Diffuse"];
-					float diffuse = (float)diffuseNode.GetDouble();
-					if(diffuse >= 0)
-						model->materialUniforms.diffuse = glm::clamp(diffuse, 0.f, 1.f);
+					const Value& materialNode = value["Material"];
+					int material = materialNode.GetInt();
+					if(material > -1 && material < 4)
+						*materialType = material;
 					else
 						success = false;
 				}
 				else
 				{
 					success = false;
-					Log::error("Model::createFromJSON", "Error loading Diffuse");
+					Log::error("Model::createFromJSON", "Error loading Material");
 				}
 
-				if(matUniforms.HasMember("Specular") && matUniforms["Specular"].IsNumber())
+				if(value.HasMember("MaterialUniforms") && value["MaterialUniforms"].IsObject())
 				{
-					const Value& specularNode = matUniforms["Specular"];
-					float specular = (float)specularNode.GetDouble();
-					if(specular >= 0)
-						model->materialUniforms.specular = glm::clamp(specular, 0.f, 1.f);
+					const Value& matUniforms = value["MaterialUniforms"];
+					if(matUniforms.HasMember("DiffuseColor") && matUniforms["DiffuseColor"].IsArray())
+					{
+						const Value& diffuseColorNode = matUniforms["DiffuseColor"];
+						int items = diffuseColorNode.Size() < 4 ? diffuseColorNode.Size() : 4;
+						for(int i = 0; i < items; i++)
+						{
+							if(diffuseColorNode[i].IsNumber())
+								model->materialUniforms.diffuseColor[i] = (float)diffuseColorNode[i].GetDouble();
+							else
+								success = false;
+						}
+					}
 					else
+					{
 						success = false;
-				}
-				else
-				{
-					success = false;
-					Log::error("Model::createFromJSON", "Error loading Specular");
-				}
+						Log::error("Model::createFromJSON", "Error loading MaterialUniforms.DiffuseColor");
+					}
 
-				if(matUniforms.HasMember("SpecularStrength") && matUniforms["SpecularStrength"].IsNumber())
-				{
-					const Value& specularStrengthNode = matUniforms["SpecularStrength"];
-					float specularStrength = (float)specularStrengthNode.GetDouble();
-					if(specularStrength >= 0)
-						model->materialUniforms.specularStrength = specularStrength;
+					if(matUniforms.HasMember("Texture") && matUniforms["Texture"].IsString())
+					{
+						const Value& textureNode = matUniforms["Texture"];
+						const std::string& filename = textureNode.GetString();
+						int index = Texture::create(filename.c_str());
+						if(index > -1) model->materialUniforms.texture = index;
+					}
+
+					if(matUniforms.HasMember("CastShadow") && matUniforms["CastShadow"].IsBool())
+					{
+						const Value& castShadowNode = matUniforms["CastShadow"];
+						model->materialUniforms.castShadow = castShadowNode.GetBool();
+					}
+
+					if(matUniforms.HasMember("Diffuse") && matUniforms["Diffuse"].IsNumber())
+					{
+						const Value& diffuseNode = matUniforms["Diffuse"];
+						float diffuse = (float)diffuseNode.GetDouble();
+						if(diffuse >= 0)
+							model->materialUniforms.diffuse = glm::clamp(diffuse, 0.f, 1.f);
+						else
+							success = false;
+					}
 					else
+					{
 						success = false;
+						Log::error("Model::createFromJSON", "Error loading Diffuse");
+					}
+
+					if(matUniforms.HasMember("Specular") && matUniforms["Specular"].IsNumber())
+					{
+						const Value& specularNode = matUniforms["Specular"];
+						float specular = (float)specularNode.GetDouble();
+						if(specular >= 0)
+							model->materialUniforms.specular = glm::clamp(specular, 0.f, 1.f);
+						else
+							success = false;
+					}
+					else
+					{
+						success = false;
+						Log::error("Model::createFromJSON", "Error loading Specular");
+					}
+
+					if(matUniforms.HasMember("SpecularStrength") && matUniforms["SpecularStrength"].IsNumber())
+					{
+						const Value& specularStrengthNode = matUniforms["SpecularStrength"];
+						float specularStrength = (float)specularStrengthNode.GetDouble();
+						if(specularStrength >= 0)
+							model->materialUniforms.specularStrength = specularStrength;
+						else
+							success = false;
+					}
+					else
+					{
+						success = false;
+						Log::error("Model::createFromJSON", "Error loading SpecularStrength");
+					}
 				}
 				else
 				{
 					success = false;
-					Log::error("Model::createFromJSON", "Error loading SpecularStrength");
+					Log::error("Model::createFromJSON", "Error loading MaterialUniforms");
 				}
 			}
 			else
 			{
+				error   = "'Model' must be an object";
 				success = false;
-				Log::error("Model::createFromJSON", "Error loading MaterialUniforms");
 			}
+			if(!success) Log::error("Model::createFromJSON", error);
+			return success;
 		}
-		else
+	}
+
+	bool createFromJSON(CModel* model, const rapidjson::Value& value)
+	{
+		int  material = -1;
+		bool success  = readFromJSON(model, value, &material);
+		if(material != -1) setMaterialType(model, (Mat_Type)material);
+		return success;
+	}
+
+	bool createTemplateFromJSON(CModel* model, const rapidjson::Value& value)
+	{
+		PA_ASSERT(model);
+		model->node = -1;
+		int  material = -1;
+		bool success  = readFromJSON(model, value, &material);
+		if(material != -1) model->material = material;
+		if(model->materialUniforms.texture == -1)
+			model->materialUniforms.texture = Texture::create("default.png");
+		return success;
+	}
+
+	void removeTemplate(CModel* model)
+	{
+		PA_ASSERT(model);
+		if(model->geometryIndex != -1) Geometry::remove(model->geometryIndex);
+		if(model->materialUniforms.texture != -1) Texture::remove(model->materialUniforms.texture);
+		model->geometryIndex = -1;
+		model->materialUniforms.texture = -1;
+	}
+
+	int createFromTemplate(const CModel* source)
+	{
+		PA_ASSERT(source);
+		int index = -1;
+		if(source->geometryIndex == -1)
 		{
-			error   = "'Model' must be an object";
-			success = false;
+			Log::error("Model::createFromTemplate", "Template has no geometry");
+			return index;
 		}
-		if(!success) Log::error("Model::createFromJSON", error);
-		return success;
+		index = modelList.create();
+		CModel* model           = &modelList[index];
+		model->material         = source->material;
+		model->materialUniforms = source->materialUniforms; // Takes its own texture reference
+		model->geometryIndex    = source->geometryIndex;
+		Geometry::increaseRefCount(model->geometryIndex);
+		// A slot that was just handed out can't be in any material list, nothing to look for
+		Material::registerNewModel(index, (Mat_Type)model->material);
+		return index;
 	}
 
 	bool setGeometry(CModel* model, const std::string& filename)
@@ -578,9 +800,16 @@ namespace Model
 		bool success = true;
 		int geometryIndex = Geometry::create(filename.c_str());
 		if(geometryIndex > -1)
+		{
 			model->geometryIndex = geometryIndex;
+			GameObject* gameObject = SceneManager::find(model->node);
+			if(gameObject) SpatialIndex::update(gameObject); // Bounds come from the geometry
+			SceneManager::markDirty(model->node);
+		}
 		else
+		{
 			success = false;
+		}
 		return success; 
 	}
 }
@@ -6,17 +6,20 @@
 #include "material.h"
 #include "datatypes.h"
 #include "jsondefs.h"
+#include "sceneformat.h"
 
 struct CCamera;
 struct CLight;
 struct GameObject;
 struct RenderParams;
+struct BoundingBox;
 
 struct CModel
 {
 	Node         node          = -1;
 	int          material      = 0;
 	int          geometryIndex = -1;
+	int          lod           = 0; // Level drawn last frame, selection keeps it near thresholds
 	Mat_Uniforms materialUniforms;
 };
 
@@ -30,12 +33,24 @@ namespace Model
 	CModel* findModel(const char* filename);
 	int     create(const char* filename);
 	bool    createFromJSON(CModel* model, const rapidjson::Value& value);
+	// Templates are models outside the model list, used by prefabs. They hold a reference to
+	// their geometry and texture so instances made from them skip the file and name lookups.
+	bool    createTemplateFromJSON(CModel* model, const rapidjson::Value& value);
+	void    removeTemplate(CModel* model);
+	int     createFromTemplate(const CModel* source);
 	void    remove(int modelIndex);
+	void    remove(const std::vector<int>& modelIndices); // Batch version, unregisters from materials in one pass
+	void    reserve(int count); // Makes room for count more models
 	void    generateBindings();
+	// Called by SpatialIndex whenever the object's world box changed, NULL when it has none.
+	// Models are culled against these, several at a time.
+	void    updateWorldBounds(GameObject* gameObject, const BoundingBox* worldBox);
 	void    cleanup();
 	bool    setMaterialType(CModel* model, Mat_Type material);
 	bool    setGeometry(CModel* model, const std::string& filename);
 	bool    writeToJSON(CModel* model, rapidjson::Writer<rapidjson::StringBuffer>& writer);
+	bool    createFromBinary(int modelIndex, const SceneFormat::ModelRecord& record, const SceneFormat::SceneView& scene);
+	void    writeToBinary(CModel* model, SceneFormat::ModelRecord* record, SceneFormat::SceneData* scene);
 }
 	
 #endif
@@ -16,13 +16,13 @@ void MotionState::getWorldTransform(btTransform& worldTrans) const
 {
 	GameObject* gameobject = SceneManager::find(node);
 	CTransform* transform  = GO::getTransform(gameobject);
-	worldTrans.setFromOpenGLMatrix(glm::value_ptr(transform->transMat));
+	worldTrans.setFromOpenGLMatrix(glm::value_ptr(Transform::getWorldMatrix(transform)));
 }
 
 void MotionState::setWorldTransform(const btTransform& worldTrans)
 {
 	GameObject* gameobject = SceneManager::find(node);
 	CTransform* transform  = GO::getTransform(gameobject);
-	Transform::setPosition(transform, Utils::toGlm(worldTrans.getOrigin()), false);
-	Transform::setRotation(transform, Utils::toGlm(worldTrans.getRotation()), false);
+	Transform::setWorldPosition(transform, Utils::toGlm(worldTrans.getOrigin()), false);
+	Transform::setWorldRotation(transform, Utils::toGlm(worldTrans.getRotation()), false);
 }
@@ -1,3 +1,5 @@
+#include <cmath>
+
 #include "physics.h"
 #include "camera.h"
 #include "transform.h"
@@ -21,11 +23,53 @@ namespace Physics
 		btSequentialImpulseConstraintSolver* solver;
 		std::vector<CollisionShape*>         collisionShapes;
 		btVector3                            gravity;				  
-		const float  						 fixedStep = 1.f / 60.f;
+		float        						 fixedStep   = 1.f / 60.f;
+		float        						 accumulator = 0.f; // Frame time not simulated yet, less than fixedStep between frames
+		int          						 maxSubSteps = 5;
 		DebugDrawer* 						 debugDrawer;		 
 		DBG_Mode     						 currentDebugMode;		 
 		bool         						 physicsEnabled;		 
 		bool         						 debugDrawEnabled;
+
+		void processCollisions()
+		{
+			int numManifolds = world->getDispatcher()->getNumManifolds();
+			for (int i=0;i<numManifolds;i++)
+			{
+				btPersistentManifold* contactManifold = world->getDispatcher()->getManifoldByIndexInternal(i);
+				const btCollisionObject* obA = contactManifold->getBody0();
+				const btCollisionObject* obB = contactManifold->getBody1();
+
+				int numContacts = contactManifold->getNumContacts();
+				for (int j = 0; j < numContacts; j++)
+				{
+					btManifoldPoint& pt = contactManifold->getContactPoint(j);
+					if (pt.getDistance()<0.f)
+					{
+						const btVector3& ptA       = pt.getPositionWorldOnA();
+						const btVector3& ptB       = pt.getPositionWorldOnB();
+						const btVector3& normalOnB = pt.m_normalWorldOnB;
+
+						intptr_t tempA = (intptr_t)obA->getUserPointer();
+						intptr_t tempB = (intptr_t)obB->getUserPointer();
+						Node nodeA = (Node)tempA;
+						Node nodeB = (Node)tempB;
+			    
+						CollisionData collisionData;
+						collisionData.collidingObjNode = nodeB;
+						collisionData.normal           = Utils::toGlm(normalOnB);
+						collisionData.worldPosA        = Utils::toGlm(ptA);
+						collisionData.worldPosB        = Utils::toGlm(ptB);
+
+						GameObject* gameObjectA = SceneManager::find(nodeA);
+						GO::processCollision(gameObjectA, &collisionData);
+						GameObject* gameObjectB = SceneManager::find(nodeB);
+						collisionData.collidingObjNode = nodeA;
+						GO::processCollision(gameObjectB, &collisionData);
+					}
+				}
+			}
+		}
 	}
 
 	void initialize(Vec3 worldGravity)
@@ -70,47 +114,65 @@ namespace Physics
 	
 	void update(float deltaTime)
 	{
-		if(physicsEnabled)
+		if(!physicsEnabled)
 		{
-			world->stepSimulation(deltaTime, 1, fixedStep);
-			// Process collisions
-			int numManifolds = world->getDispatcher()->getNumManifolds();
-			for (int i=0;i<numManifolds;i++)
-			{
-				btPersistentManifold* contactManifold = world->getDispatcher()->getManifoldByIndexInternal(i);
-				const btCollisionObject* obA = contactManifold->getBody0();
-				const btCollisionObject* obB = contactManifold->getBody1();
+			accumulator = 0.f;
+			return;
+		}
 
-				int numContacts = contactManifold->getNumContacts();
-				for (int j = 0; j < numContacts; j++)
-				{
-					btManifoldPoint& pt = contactManifold->getContactPoint(j);
-					if (pt.getDistance()<0.f)
-					{
-						const btVector3& ptA       = pt.getPositionWorldOnA();
-						const btVector3& ptB       = pt.getPositionWorldOnB();
-						const btVector3& normalOnB = pt.m_normalWorldOnB;
+		// Simulate in fixed steps for whatever time the frames have added up. Each step is
+		// one bullet step without its own interpolation, Transform keeps the state before
+		// the last step so rendering can blend it with the current one.
+		accumulator += deltaTime;
+		int steps = 0;
+		while(accumulator >= fixedStep && steps < maxSubSteps)
+		{
+			Transform::beginFixedStep();
+			world->stepSimulation(fixedStep, 0);
+			processCollisions();
+			Transform::flush();
+			Transform::endFixedStep();
+			accumulator -= fixedStep;
+			steps++;
+		}
+		// Frames too slow to keep up drop the rest instead of owing ever more steps
+		if(accumulator >= fixedStep) accumulator = fmodf(accumulator, fixedStep);
+	}
 
-						intptr_t tempA = (intptr_t)obA->getUserPointer();
-						intptr_t tempB = (intptr_t)obB->getUserPointer();
-						Node nodeA = (Node)tempA;
-						Node nodeB = (Node)tempB;
-				    
-						CollisionData collisionData;
-						collisionData.collidingObjNode = nodeB;
-						collisionData.normal           = Utils::toGlm(normalOnB);
-						collisionData.worldPosA        = Utils::toGlm(ptA);
-						collisionData.worldPosB        = Utils::toGlm(ptB);
+	float getInterpolation()
+	{
+		return physicsEnabled ? accumulator / fixedStep : 1.f;
+	}
 
-						GameObject* gameObjectA = SceneManager::find(nodeA);
-						GO::processCollision(gameObjectA, &collisionData);
-						GameObject* gameObjectB = SceneManager::find(nodeB);
-						collisionData.collidingObjNode = nodeA;
-						GO::processCollision(gameObjectB, &collisionData);
-					}
-				}
-			}
+	void setFixedStep(float seconds)
+	{
+		if(seconds <= 0.f)
+		{
+			Log::error("Physics::setFixedStep", "Step has to be longer than zero");
+			return;
 		}
+		fixedStep   = seconds;
+		accumulator = 0.f;
+	}
+
+	float getFixedStep()
+	{
+		return fixedStep;
+	}
+
+	void setMaxSubSteps(int subSteps)
+	{
+		if(subSteps < 1)
+		{
+			Log::error("Physics::setMaxSubSteps", "At least one step per frame is needed");
+			return;
+		}
+		maxSubSteps = subSteps;
+	}
+
+	int getMaxSubSteps()
+	{
+		return maxSubSteps;
 	}
 
 	void draw()
@@ -120,7 +182,7 @@ namespace Physics
 		{
 			GameObject* gameObject = SceneManager::find(camera->node);
 			CTransform* transform  = GO::getTransform(gameObject);
-			Mat4 camTranMat = transform->transMat;
+			Mat4 camTranMat = Transform::getWorldMatrix(transform);
 			Mat4 camProjMat = camera->projMat;
 
 			glPushAttrib(GL_ALL_ATTRIB_BITS);
@@ -353,6 +415,16 @@ namespace Physics
 		engine->SetDefaultNamespace("Physics");
 		rc = engine->RegisterGlobalFunction("void setGravity(const Vec3)", asFUNCTION(setGravity), asCALL_CDECL);
 		PA_ASSERT(rc >= 0);
+		rc = engine->RegisterGlobalFunction("void setFixedStep(float)", asFUNCTION(setFixedStep), asCALL_CDECL);
+		PA_ASSERT(rc >= 0);
+		rc = engine->RegisterGlobalFunction("float getFixedStep()", asFUNCTION(getFixedStep), asCALL_CDECL);
+		PA_ASSERT(rc >= 0);
+		rc = engine->RegisterGlobalFunction("void setMaxSubSteps(int)", asFUNCTION(setMaxSubSteps), asCALL_CDECL);
+		PA_ASSERT(rc >= 0);
+		rc = engine->RegisterGlobalFunction("int getMaxSubSteps()", asFUNCTION(getMaxSubSteps), asCALL_CDECL);
+		PA_ASSERT(rc >= 0);
+		rc = engine->RegisterGlobalFunction("float getInterpolation()", asFUNCTION(getInterpolation), asCALL_CDECL);
+		PA_ASSERT(rc >= 0);
 		engine->SetDefaultNamespace("");
 	}
 }
@@ -43,7 +43,7 @@ namespace Physics
 		MAX              = btIDebugDraw::DBG_MAX_DEBUG_DRAW_MODE
 	};
 	void initialize(Vec3 gravity);
-	void update(float deltaTime);
+	void update(float deltaTime); // Runs as many fixed steps as deltaTime adds up to, at most maxSubSteps
     void draw();
 	void cleanup();
 	void setGravity(Vec3 gravity);
@@ -57,6 +57,11 @@ namespace Physics
 	void enable(bool enable);
 	void enableDebugDraw(bool enable);
 	Vec3 getGravity();
+	void  setFixedStep(float seconds);
+	float getFixedStep();
+	void  setMaxSubSteps(int subSteps);
+	int   getMaxSubSteps();
+	float getInterpolation(); // How far rendering is from the previous to the current step, 0 to 1
 	btDiscreteDynamicsWorld* getWorld();
 	CollisionShape* getCollisionShapeAtIndex(int index);
 }
@@ -0,0 +1,405 @@
+#include <unordered_map>
+#include <algorithm>
+
+#include "prefab.h"
+#include "scenemanager.h"
+#include "gameobject.h"
+#include "transform.h"
+#include "model.h"
+#include "light.h"
+#include "camera.h"
+#include "rigidbody.h"
+#include "scriptengine.h"
+#include "utilities.h"
+#include "jsondefs.h"
+#include "passert.h"
+#include "loadprofiler.h"
+
+#include "../include/angelscript/add_on/scriptarray/scriptarray.h"
+
+namespace Prefab
+{
+	namespace
+	{
+		struct PrefabData
+		{
+			std::string              filename;
+			std::string              name;
+			std::string              tag;
+			bool                     hasTag       = false;
+			bool                     valid        = false;
+			Vec3                     position     = Vec3(0.f);
+			Quat                     rotation     = Quat();
+			Vec3                     scale        = Vec3(1.f);
+			bool                     hasModel     = false;
+			CModel                   model;                   // Template holding geometry and texture references
+			bool                     hasLight     = false;
+			bool                     hasCamera    = false;
+			bool                     hasRigidBody = false;
+			std::vector<std::string> scripts;
+			// Light, camera and rigidbody are cheap to build from JSON and need per instance
+			// resources anyway, so only those subtrees are kept, NULL if there are none
+			rapidjson::Document*     document     = NULL;
+		};
+
+		std::vector<PrefabData>              prefabList;
+		std::vector<unsigned int>            emptyIndices;
+		std::unordered_map<std::string, int> prefabIndices;
+		asIObjectType*                       gameObjectArrayType = NULL;
+
+		PrefabData* getPrefab(int prefabIndex)
+		{
+			PrefabData* prefab = NULL;
+			if(prefabIndex >= 0 && prefabIndex < (int)prefabList.size() && prefabList[prefabIndex].valid)
+				prefab = &prefabList[prefabIndex];
+			else
+				Log::error("Prefab::getPrefab", "Invalid prefab index " + std::to_string(prefabIndex));
+			return prefab;
+		}
+
+		bool readFloats(const rapidjson::Value& value, const char* key, float* out, int maxCount)
+		{
+			bool success = true;
+			if(value.HasMember(key) && value[key].IsArray())
+			{
+				const rapidjson::Value& array = value[key];
+				int items = (int)array.Size() < maxCount ? (int)array.Size() : maxCount;
+				for(int i = 0; i < items; i++)
+				{
+					if(array[i].IsNumber())
+						out[i] = (float)array[i].GetDouble();
+					else
+						success = false;
+				}
+			}
+			else
+			{
+				success = false;
+			}
+			return success;
+		}
+
+		// Returns the node instead of the object since scripts added here may create
+		// other objects and move the one just made
+		Node spawn(int prefabIndex, const Vec3& position, const Quat& rotation)
+		{
+			LoadProfiler::ScopedTimer timer(LoadProfiler::LP_OBJECTS, prefabList[prefabIndex].filename.c_str());
+			const PrefabData& prefab     = prefabList[prefabIndex];
+			GameObject*       gameObject = SceneManager::create(prefab.name);
+			if(!gameObject) return -1;
+			Node node = gameObject->node;
+			if(prefab.hasTag) SceneManager::setTag(gameObject, prefab.tag);
+
+			CTransform* transform = GO::getTransform(gameObject);
+			Transform::setScale(transform, prefab.scale);
+			Transform::setRotation(transform, rotation);
+			Transform::setPosition(transform, position);
+
+			if(prefab.document)
+			{
+				const rapidjson::Value& components = (*prefab.document)["Components"];
+				if(prefab.hasLight)
+				{
+					CLight* light = GO::addLight(gameObject);
+					if(!Light::createFromJSON(light, components["Light"]))
+						Log::warning("Errors while initializing Light from " + prefab.filename);
+				}
+				if(prefab.hasCamera)
+				{
+					CCamera* camera = GO::addCamera(gameObject);
+					if(!Camera::createFromJSON(camera, components["Camera"]))
+						Log::warning("Errors while initializing Camera from " + prefab.filename);
+				}
+			}
+			if(prefab.hasModel) GO::addModelCopy(gameObject, &prefab.model);
+			if(prefab.hasRigidBody)
+			{
+				const rapidjson::Value& components = (*prefab.document)["Components"];
+				CRigidBody rigidbody = GO::addRigidbody(gameObject, NULL);
+				if(!RigidBody::createFromJSON(rigidbody, components["RigidBody"]))
+					Log::warning("Errors while initializing Rigidbody from " + prefab.filename);
+			}
+			// Copy the names, a script constructor could load another prefab and move this one
+			std::vector<std::string> scripts = prefab.scripts;
+			for(const std::string& script : scripts) ScriptEngine::addScript(gameObject, script);
+			return node;
+		}
+
+		GameObject* instantiateScript(int prefabIndex)
+		{
+			return instantiate(prefabIndex);
+		}
+
+		GameObject* instantiateAtScript(int prefabIndex, const Vec3& position, const Quat& rotation)
+		{
+			return instantiate(prefabIndex, position, rotation);
+		}
+
+		CScriptArray* instantiateArrayScript(int                 prefabIndex,
+											 const CScriptArray& positionArray,
+											 const CScriptArray& rotationArray)
+		{
+			if(!gameObjectArrayType)
+			{
+				asIScriptEngine* engine = ScriptEngine::getEngine();
+				gameObjectArrayType = engine->GetObjectTypeById(engine->GetTypeIdByDecl("array<GameObject@>"));
+			}
+			int count = (int)positionArray.GetSize();
+			if(rotationArray.GetSize() > 0 && (int)rotationArray.GetSize() != count)
+			{
+				Log::error("Prefab::instantiate", "Positions and rotations differ in size");
+				count = std::min(count, (int)rotationArray.GetSize());
+			}
+			std::vector<Vec3> positions(count);
+			std::vector<Quat> rotations(rotationArray.GetSize() > 0 ? count : 0);
+			for(int i = 0; i < count; i++) positions[i] = *((const Vec3*)positionArray.At(i));
+			for(int i = 0; i < (int)rotations.size(); i++) rotations[i] = *((const Quat*)rotationArray.At(i));
+
+			std::vector<GameObject*> instances;
+			instantiate(prefabIndex, count, positions.data(), rotations.empty() ? NULL : rotations.data(), &instances);
+			CScriptArray* array = CScriptArray::Create(gameObjectArrayType, (asUINT)instances.size());
+			for(asUINT i = 0; i < (asUINT)instances.size(); i++)
+				*((GameObject**)array->At(i)) = instances[i];
+			return array;
+		}
+
+		CScriptArray* instantiatePositionsScript(int prefabIndex, const CScriptArray& positionArray)
+		{
+			asIScriptEngine* engine = ScriptEngine::getEngine();
+			CScriptArray* noRotations = CScriptArray::Create(engine->GetObjectTypeById(engine->GetTypeIdByDecl("array<Quat>")));
+			CScriptArray* array = instantiateArrayScript(prefabIndex, positionArray, *noRotations);
+			noRotations->Release();
+			return array;
+		}
+	}
+
+	int find(const std::string& filename)
+	{
+		auto it = prefabIndices.find(filename);
+		return it != prefabIndices.end() ? it->second : -1;
+	}
+
+	int load(const std::string& filename)
+	{
+		using namespace rapidjson;
+		int index = find(filename);
+		if(index != -1) return index;
+
+		// Declared in this order so the timer stops before the profile reports
+		LoadProfiler::ScopedProfile profile(filename);
+		LoadProfiler::ScopedTimer   timer(LoadProfiler::LP_PARSE, filename.c_str());
+		char* json = Utils::loadFileIntoCString(filename.c_str());
+		if(!json)
+		{
+			Log::error("Prefab::load", "Could not read " + filename);
+			return -1;
+		}
+		Document* document = new Document();
+		document->Parse(json);
+		free(json);
+		if(!document->IsObject() || !document->HasMember("Name") || !(*document)["Name"].IsString())
+		{
+			Log::error("Prefab::load", filename + " is not a valid gameobject file");
+			delete document;
+			return -1;
+		}
+
+		if(emptyIndices.empty())
+		{
+			prefabList.push_back(PrefabData());
+			index = prefabList.size() - 1;
+		}
+		else
+		{
+			index = emptyIndices.back();
+			emptyIndices.pop_back();
+			prefabList[index] = PrefabData();
+		}
+		PrefabData& prefab = prefabList[index];
+		prefab.valid    = true;
+		prefab.filename = filename;
+		prefab.name     = (*document)["Name"].GetString();
+		if(document->HasMember("Tag") && (*document)["Tag"].IsString())
+		{
+			prefab.hasTag = true;
+			prefab.tag    = (*document)["Tag"].GetString();
+		}
+
+		if(document->HasMember("Components") && (*document)["Components"].IsObject())
+		{
+			const Value& components = (*document)["Components"];
+			if(components.HasMember("Transform") && components["Transform"].IsObject())
+			{
+				const Value& transformNode = components["Transform"];
+				if(!readFloats(transformNode, "Position", &prefab.position[0], 3) ||
+				   !readFloats(transformNode, "Rotation", &prefab.rotation[0], 4) ||
+				   !readFloats(transformNode, "Scale",    &prefab.scale[0],    3))
+					Log::warning("Errors while reading Transform from " + filename);
+			}
+			if(components.HasMember("Model"))
+			{
+				prefab.hasModel = Model::createTemplateFromJSON(&prefab.model, components["Model"]) &&
+					              prefab.model.geometryIndex != -1;
+				if(!prefab.hasModel)
+				{
+					Log::warning("Errors while initializing Model from " + filename);
+					// Partially loaded templates are still usable as long as there is geometry
+					prefab.hasModel = prefab.model.geometryIndex != -1;
+				}
+			}
+			prefab.hasLight     = components.HasMember("Light");
+			prefab.hasCamera    = components.HasMember("Camera");
+			prefab.hasRigidBody = components.HasMember("RigidBody");
+		}
+		else
+		{
+			Log::warning("'Components' is not an object. No components in " + filename);
+		}
+
+		if(document->HasMember("Scripts"))
+		{
+			const Value& scripts = (*document)["Scripts"];
+			if(scripts.IsArray())
+			{
+				for(SizeType i = 0; i < scripts.Size(); i++)
+				{
+					if(scripts[i].IsString())
+						prefab.scripts.push_back(scripts[i].GetString());
+					else
+						Log::warning("Invalid script name in " + filename);
+				}
+			}
+			else if(scripts.IsString())
+			{
+				prefab.scripts.push_back(scripts.GetString());
+			}
+			else
+			{
+				Log::warning("Invalid value for 'Scripts' in " + filename);
+			}
+		}
+
+		if(prefab.hasLight || prefab.hasCamera || prefab.hasRigidBody)
+			prefab.document = document;
+		else
+			delete document;
+		prefabIndices[filename] = index;
+		Log::message("Prefab loaded from " + filename);
+		return index;
+	}
+
+	bool remove(int prefabIndex)
+	{
+		PrefabData* prefab = getPrefab(prefabIndex);
+		if(!prefab) return false;
+		if(prefab->hasModel) Model::removeTemplate(&prefab->model);
+		if(prefab->document) delete prefab->document;
+		prefab->document = NULL;
+		prefab->valid    = false;
+		prefab->scripts.clear();
+		prefabIndices.erase(prefab->filename);
+		prefab->filename.clear();
+		emptyIndices.push_back(prefabIndex);
+		return true;
+	}
+
+	GameObject* instantiate(int prefabIndex)
+	{
+		GameObject* gameObject = NULL;
+		PrefabData* prefab     = getPrefab(prefabIndex);
+		if(prefab) gameObject = SceneManager::find(spawn(prefabIndex, prefab->position, prefab->rotation));
+		return gameObject;
+	}
+
+	GameObject* instantiate(int prefabIndex, Vec3 position, Quat rotation)
+	{
+		GameObject* gameObject = NULL;
+		if(getPrefab(prefabIndex)) gameObject = SceneManager::find(spawn(prefabIndex, position, rotation));
+		return gameObject;
+	}
+
+	int instantiate(int                       prefabIndex,
+					int                       count,
+					const Vec3*               positions,
+					const Quat*               rotations,
+					std::vector<GameObject*>* instances)
+	{
+		PrefabData* prefab = getPrefab(prefabIndex);
+		if(!prefab || count <= 0) return 0;
+
+		// Grow the scene and transform storage once instead of once per object
+		SceneManager::reserve(count);
+		Transform::reserve(count);
+		if(prefab->hasModel)  Model::reserve(count);
+		if(prefab->hasLight)  Light::reserve(count);
+		if(prefab->hasCamera) Camera::reserve(count);
+		std::vector<Node> nodes;
+		nodes.reserve(count);
+		for(int i = 0; i < count; i++)
+		{
+			const PrefabData& current = prefabList[prefabIndex];
+			Node node = spawn(prefabIndex,
+							  positions ? positions[i] : current.position,
+							  rotations ? rotations[i] : current.rotation);
+			if(node != -1) nodes.push_back(node);
+		}
+
+		if(instances)
+		{
+			instances->reserve(instances->size() + nodes.size());
+			for(Node node : nodes)
+			{
+				GameObject* gameObject = SceneManager::find(node);
+				if(gameObject) instances->push_back(gameObject);
+			}
+		}
+		return (int)nodes.size();
+	}
+
+	void cleanup()
+	{
+		for(int i = 0; i < (int)prefabList.size(); i++)
+		{
+			if(prefabList[i].valid) remove(i);
+		}
+		prefabList.clear();
+		emptyIndices.clear();
+		prefabIndices.clear();
+	}
+
+	void generateBindings()
+	{
+		asIScriptEngine* engine = ScriptEngine::getEngine();
+		engine->SetDefaultNamespace("Prefab");
+		int rc = -1;
+		rc = engine->RegisterGlobalFunction("int load(const string &in)",
+											asFUNCTION(load),
+											asCALL_CDECL);
+		PA_ASSERT(rc >= 0);
+		rc = engine->RegisterGlobalFunction("int find(const string &in)",
+											asFUNCTION(find),
+											asCALL_CDECL);
+		PA_ASSERT(rc >= 0);
+		rc = engine->RegisterGlobalFunction("bool remove(int)",
+											asFUNCTION(remove),
+											asCALL_CDECL);
+		PA_ASSERT(rc >= 0);
+		rc = engine->RegisterGlobalFunction("GameObject@ instantiate(int)",
+											asFUNCTION(instantiateScript),
+											asCALL_CDECL);
+		PA_ASSERT(rc >= 0);
+		rc = engine->RegisterGlobalFunction("GameObject@ instantiate(int, const Vec3 &in, const Quat &in)",
+											asFUNCTION(instantiateAtScript),
+											asCALL_CDECL);
+		PA_ASSERT(rc >= 0);
+		rc = engine->RegisterGlobalFunction("array<GameObject@>@ instantiate(int, const array<Vec3> &in)",
+											asFUNCTION(instantiatePositionsScript),
+											asCALL_CDECL);
+		PA_ASSERT(rc >= 0);
+		rc = engine->RegisterGlobalFunction("array<GameObject@>@ instantiate(int, const array<Vec3> &in, const array<Quat> &in)",
+											asFUNCTION(instantiateArrayScript),
+											asCALL_CDECL);
+		PA_ASSERT(rc >= 0);
+		engine->SetDefaultNamespace("");
+	}
+}
@@ -0,0 +1,33 @@
+#ifndef prefab_H
+#define prefab_H
+
+#include <string>
+#include <vector>
+
+#include "mathdefs.h"
+#include "datatypes.h"
+
+struct GameObject;
+
+namespace Prefab
+{
+	// Parses a gameobject file once and keeps it as a template. Loading a file that
+	// is already cached returns the existing prefab. Returns -1 on failure.
+	int         load(const std::string& filename);
+	int         find(const std::string& filename); // -1 if the file was never loaded
+	bool        remove(int prefabIndex);           // Existing instances are not affected
+	GameObject* instantiate(int prefabIndex);
+	GameObject* instantiate(int prefabIndex, Vec3 position, Quat rotation);
+	// Creates count instances in one go. positions and rotations hold count entries each
+	// and can be NULL to use the values stored in the prefab. Created objects are appended
+	// to instances when it is not NULL. Returns the number of objects created.
+	int         instantiate(int                       prefabIndex,
+							int                       count,
+							const Vec3*               positions,
+							const Quat*               rotations,
+							std::vector<GameObject*>* instances = NULL);
+	void        generateBindings();
+	void        cleanup();
+}
+
+#endif
@@ -10,6 +10,7 @@
 #include "settings.h"
 #include "passert.h"
 #include "geometry.h"
+#include "geometryarena.h"
 #include "framebuffer.h"
 #include "light.h"
 #include "scenemanager.h"
@@ -501,9 +502,10 @@ namespace Renderer
 	void renderFrame()
 	{
 		checkGLError("Renderer::renderFrame");
+		GeometryArena::defragment();
 		static int quad         = Shader::create("fbo.vert", "fbo.frag");
 		static int shadowShader = Shader::create("shadow.vert", "shadow.frag");
-		std::vector<uint32_t>* activeLights = Light::getActiveLights();
+		const std::vector<int>* activeLights = Light::getActiveLights();
 		int count = 0;
 		Framebuffer::bind(shadowOutput);
 		{
@@ -511,13 +513,12 @@ namespace Renderer
 			glDrawBuffer(GL_NONE);
 			glDepthFunc(GL_LEQUAL);
 			glCullFace(GL_FRONT);
-			for(uint32_t lightIndex : *activeLights)
+			for(auto entry : SceneManager::view<Component::LIGHT, Component::CAMERA>())
 			{
-				CLight* light = Light::getLightAtIndex(lightIndex);
+				CLight* light = Light::getLightAtIndex(entry[Component::LIGHT]);
 				if(light->castShadow)
 				{
-					GameObject* gameobject = SceneManager::find(light->node);
-					CCamera*    camera     = GO::getCamera(gameobject);
+					CCamera* camera = Camera::getCameraAtIndex(entry[Component::CAMERA]);
 
 					Shader::bind(shadowShader);
 					int shadowMaps = light->type == LT_DIR ? MAX_SHADOWMAPS : 1;
@@ -543,7 +544,7 @@ namespace Renderer
 			glBlendEquation(GL_FUNC_ADD);
 			glViewport(0, 0, Framebuffer::getWidth(renderOutput), Framebuffer::getHeight(renderOutput));
 			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-			for(uint32_t lightIndex : *activeLights)
+			for(int lightIndex : *activeLights)
 			{
 				if(count == 0)	// On first pass ignore what's already on the texture
 					glBlendFunc(GL_ONE, GL_ZERO);
@@ -566,11 +567,16 @@ namespace Renderer
 		Shader::bind(quad);
 		Texture::bind(defaultRenderTexture, 0);
 		Geometry::render(quadGeo);
+		Geometry::unbind();
 		Texture::unbind(0);
 		Shader::unbind();
 		
 		Editor::addDebugTexture("Default Render", defaultRenderTexture);
 		Editor::addDebugTexture("DefaultDepthTexture", defaultDepthTexture);
+		Editor::addDebugInt("VAO Binds", GeometryArena::getBindCount());
+		Editor::addDebugInt("Geometry KB", (int)(GeometryArena::getUsedBytes() / 1024));
+		Editor::addDebugInt("Geometry CPU KB", (int)(Geometry::getCPUBytes() / 1024));
+		GeometryArena::resetBindCount();
 	}
 
 	Vec4 getClearColor()
@@ -0,0 +1,210 @@
+#include <unordered_map>
+
+#include "resourceregistry.h"
+#include "scriptengine.h"
+#include "log.h"
+#include "passert.h"
+
+namespace ResourceRegistry
+{
+	namespace
+	{
+		struct Entry
+		{
+			std::string path;
+			uint64_t    hash     = 0;
+			int         refCount = 0;
+			bool        used     = false;
+			bool        indexed  = false; // Found by path, false when another resource had the path first
+		};
+
+		struct Table
+		{
+			std::vector<Entry>                entries; // By slot
+			std::unordered_map<uint64_t, int> slots;   // By path hash
+		};
+
+		Table       tables[RT_COUNT];
+		const char* typeNames[RT_COUNT] = {"Geometry", "Texture", "Shader", "Script"};
+
+		Entry* getEntry(Type type, int slot)
+		{
+			PA_ASSERT(type >= 0 && type < RT_COUNT);
+			Table& table = tables[type];
+			if(slot >= 0 && slot < (int)table.entries.size() && table.entries[slot].used)
+				return &table.entries[slot];
+			return NULL;
+		}
+
+		void logUnknown(const char* context, Type type, int slot)
+		{
+			Log::error(context, std::string(typeNames[type]) + " " + std::to_string(slot) + " is not registered");
+		}
+
+		void print(int type)
+		{
+			if(type < 0 || type >= RT_COUNT)
+			{
+				Log::error("ResourceRegistry::print", "Invalid type " + std::to_string(type));
+				return;
+			}
+			std::vector<Resource> resources;
+			getResources((Type)type, &resources);
+			Log::message(std::string(typeNames[type]) + " : " + std::to_string(resources.size()) + " loaded");
+			for(const Resource& resource : resources)
+			{
+				Log::message("  " + std::to_string(resource.slot) + " " + resource.path +
+							 " (" + std::to_string(resource.refCount) + " refs)");
+			}
+		}
+
+		int getCountScript(int type)
+		{
+			return type >= 0 && type < RT_COUNT ? getCount((Type)type) : 0;
+		}
+	}
+
+	uint64_t hashPath(const char* path)
+	{
+		PA_ASSERT(path);
+		uint64_t hash = 0xcbf29ce484222325ULL;
+		for(const char* character = path; *character; character++)
+		{
+			hash ^= (uint8_t)*character;
+			hash *= 0x100000001b3ULL;
+		}
+		return hash;
+	}
+
+	int findSlot(Type type, const char* path)
+	{
+		PA_ASSERT(type >= 0 && type < RT_COUNT);
+		const Table& table = tables[type];
+		auto found = table.slots.find(hashPath(path));
+		if(found == table.slots.end()) return -1;
+		// Two paths sharing a hash are not worth a chain, the second one simply isn't cached
+		return table.entries[found->second].path == path ? found->second : -1;
+	}
+
+	void insert(Type type, int slot, const char* path)
+	{
+		PA_ASSERT(type >= 0 && type < RT_COUNT);
+		PA_ASSERT(slot >= 0);
+		Table& table = tables[type];
+		if(slot >= (int)table.entries.size()) table.entries.resize(slot + 1);
+		Entry& entry = table.entries[slot];
+		if(entry.used)
+		{
+			Log::error("ResourceRegistry::insert", std::string(typeNames[type]) + " " +
+					   std::to_string(slot) + " is already registered as " + entry.path);
+			remove(type, slot);
+		}
+		entry.path     = path;
+		entry.hash     = hashPath(path);
+		entry.refCount = 1;
+		entry.used     = true;
+		entry.indexed  = table.slots.emplace(entry.hash, slot).second;
+	}
+
+	void remove(Type type, int slot)
+	{
+		Entry* entry = getEntry(type, slot);
+		if(!entry)
+		{
+			logUnknown("ResourceRegistry::remove", type, slot);
+			return;
+		}
+		if(entry->indexed) tables[type].slots.erase(entry->hash);
+		*entry = Entry();
+	}
+
+	int addRef(Type type, int slot)
+	{
+		Entry* entry = getEntry(type, slot);
+		if(!entry)
+		{
+			logUnknown("ResourceRegistry::addRef", type, slot);
+			return -1;
+		}
+		return ++entry->refCount;
+	}
+
+	int release(Type type, int slot)
+	{
+		Entry* entry = getEntry(type, slot);
+		if(!entry || entry->refCount == 0)
+		{
+			logUnknown("ResourceRegistry::release", type, slot);
+			return -1;
+		}
+		return --entry->refCount;
+	}
+
+	int getRefCount(Type type, int slot)
+	{
+		Entry* entry = getEntry(type, slot);
+		return entry ? entry->refCount : 0;
+	}
+
+	const char* getPath(Type type, int slot)
+	{
+		Entry* entry = getEntry(type, slot);
+		return entry ? entry->path.c_str() : NULL;
+	}
+
+	void getResources(Type type, std::vector<Resource>* resources)
+	{
+		PA_ASSERT(type >= 0 && type < RT_COUNT);
+		PA_ASSERT(resources);
+		resources->clear();
+		const std::vector<Entry>& entries = tables[type].entries;
+		for(int slot = 0; slot < (int)entries.size(); slot++)
+		{
+			const Entry& entry = entries[slot];
+			if(!entry.used) continue;
+			Resource resource;
+			resource.path     = entry.path.c_str();
+			resource.hash     = entry.hash;
+			resource.slot     = slot;
+			resource.refCount = entry.refCount;
+			resources->push_back(resource);
+		}
+	}
+
+	int getCount(Type type)
+	{
+		PA_ASSERT(type >= 0 && type < RT_COUNT);
+		int count = 0;
+		for(const Entry& entry : tables[type].entries)
+			if(entry.used) count++;
+		return count;
+	}
+
+	void clear(Type type)
+	{
+		PA_ASSERT(type >= 0 && type < RT_COUNT);
+		tables[type].entries.clear();
+		tables[type].slots.clear();
+	}
+
+	void generateBindings()
+	{
+		asIScriptEngine* engine = ScriptEngine::getEngine();
+		engine->SetDefaultNamespace("ResourceRegistry");
+		int rc = engine->RegisterEnum("ResourceType");
+		PA_ASSERT(rc >= 0);
+		rc = engine->RegisterEnumValue("ResourceType", "GEOMETRY", RT_GEOMETRY); PA_ASSERT(rc >= 0);
+		rc = engine->RegisterEnumValue("ResourceType", "TEXTURE",  RT_TEXTURE);  PA_ASSERT(rc >= 0);
+		rc = engine->RegisterEnumValue("ResourceType", "SHADER",   RT_SHADER);   PA_ASSERT(rc >= 0);
+		rc = engine->RegisterEnumValue("ResourceType", "SCRIPT",   RT_SCRIPT);   PA_ASSERT(rc >= 0);
+		rc = engine->RegisterGlobalFunction("void print(int)",
+											asFUNCTION(print),
+											asCALL_CDECL);
+		PA_ASSERT(rc >= 0);
+		rc = engine->RegisterGlobalFunction("int getCount(int)",
+											asFUNCTION(getCountScript),
+											asCALL_CDECL);
+		PA_ASSERT(rc >= 0);
+		engine->SetDefaultNamespace("");
+	}
+}
@@ -0,0 +1,70 @@
+#ifndef resourceregistry_H
+#define resourceregistry_H
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+// Paths and reference counts of every loaded resource, shared by the modules that own them.
+// Each type has its own table. Entries are indexed by the slot the owning module keeps the
+// resource in and found by the hash of their path, so lookups cost the same however many
+// resources are loaded. Paths are interned here, modules don't keep copies of their own.
+// Main thread only, loader threads just decode files.
+namespace ResourceRegistry
+{
+	enum Type
+	{
+		RT_GEOMETRY = 0,
+		RT_TEXTURE,
+		RT_SHADER,
+		RT_SCRIPT,
+		RT_COUNT
+	};
+
+	// A slot in the list of the module owning the resource, the type keeps handles of
+	// different modules apart at compile time
+	template<Type T>
+	struct Handle
+	{
+		int  slot = -1;
+		bool isValid() const { return slot >= 0; }
+	};
+
+	typedef Handle<RT_GEOMETRY> GeometryHandle;
+	typedef Handle<RT_TEXTURE>  TextureHandle;
+	typedef Handle<RT_SHADER>   ShaderHandle;
+	typedef Handle<RT_SCRIPT>   ScriptHandle;
+
+	struct Resource
+	{
+		const char* path;
+		uint64_t    hash;
+		int         slot;
+		int         refCount;
+	};
+
+	uint64_t    hashPath(const char* path); // FNV-1a
+	int         findSlot(Type type, const char* path); // -1 if nothing is registered under path
+	// Modules register a resource once they created it in slot, the count starts at one. A path
+	// that is taken already stays with the first resource, the new one is counted but not found.
+	void        insert(Type type, int slot, const char* path);
+	void        remove(Type type, int slot); // Called by the module once it freed the resource
+	int         addRef(Type type, int slot);
+	int         release(Type type, int slot); // What is left, the module frees the resource at 0. -1 if unknown.
+	int         getRefCount(Type type, int slot);
+	const char* getPath(Type type, int slot); // NULL if unknown
+	void        getResources(Type type, std::vector<Resource>* resources); // Ordered by slot
+	int         getCount(Type type);
+	void        clear(Type type);
+	void        generateBindings();
+
+	template<Type T>
+	Handle<T> find(const char* path)
+	{
+		Handle<T> handle;
+		handle.slot = findSlot(T, path);
+		return handle;
+	}
+}
+
+#endif
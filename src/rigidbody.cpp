@@ -8,6 +8,7 @@
 #include "transform.h"
 #include "geometry.h"
 #include "collisionshapes.h"
+#include "scenemanager.h"
 
 #include "../include/bullet/btBulletDynamicsCommon.h"
 
@@ -26,6 +27,13 @@ namespace RigidBody
 			if(body && body->getMotionState()) delete body->getMotionState();
 			body == NULL ? Log::message("RB is NULL") : delete body;
 		}
+
+		// Bodies carry the node of their object as user pointer
+		void markDirty(CRigidBody body)
+		{
+			intptr_t node = (intptr_t)rigidBodies[body]->getUserPointer();
+			SceneManager::markDirty((Node)node);
+		}
 	}
 
 	void initialize()
@@ -72,7 +80,7 @@ namespace RigidBody
 				rbHandle = (int32_t) (rigidBodies.size() - 1);
 			}
 			CTransform* transform = GO::getTransform(gameObject);
-			setTransform(rbHandle, transform->transMat);
+			setTransform(rbHandle, Transform::getWorldMatrix(transform));
 		}
 		else
 		{
@@ -142,6 +150,7 @@ namespace RigidBody
 		}
 
 		world->addRigidBody(temp);
+		markDirty(body);
 	}
 
 	void setMass(CRigidBody body, float mass)
@@ -151,6 +160,7 @@ namespace RigidBody
 		if(mass <  0.f) mass = 0.f;
 		if(mass != 0.f) shape->calculateLocalInertia(mass, inertia);
 		rigidBodies[body]->setMassProps(mass, inertia);
+		markDirty(body);
 	}
 
 	float getMass(CRigidBody body)
@@ -169,6 +179,7 @@ namespace RigidBody
 	{
 		if(restitution < 0.f) restitution *= -1.f;
 		rigidBodies[body]->setRestitution(restitution);
+		markDirty(body);
 	}
 		
 	float getFriction(CRigidBody body)
@@ -180,6 +191,7 @@ namespace RigidBody
 	{
 		if(friction < 0.f) friction *= -1.f;
 		rigidBodies[body]->setFriction(friction);
+		markDirty(body);
 	}
 
 	void applyForce(CRigidBody body, Vec3 force, Vec3 relPos)
@@ -235,9 +247,14 @@ namespace RigidBody
 	{
 		if(!shape) shape = defaultShape;
 		if(shape->isValid())
+		{
 			rigidBodies[body]->setCollisionShape(shape->getCollisionShape());
+			markDirty(body);
+		}
 		else
+		{
 			Log::error("RigidBody::setCollisionShape", "Invalid collision shape");
+		}
 	}
 
 	const char* getCollisionShapeName(CRigidBody body)
@@ -621,6 +638,103 @@ namespace RigidBody
 		return success;
 	}
 
+	void writeToBinary(CRigidBody body, SceneFormat::RigidBodyRecord* record, SceneFormat::SceneData* scene)
+	{
+		PA_ASSERT(record);
+		record->mass        = getMass(body);
+		record->friction    = getFriction(body);
+		record->restitution = getRestitution(body);
+		record->isKinematic = isKinematic(body) ? 1 : 0;
+
+		int type = getCollisionShapeType(body);
+		btCollisionShape* bulletShape = rigidBodies[body]->getCollisionShape();
+		intptr_t index = (intptr_t)bulletShape->getUserPointer();
+		CollisionShape* shape = Physics::getCollisionShapeAtIndex((int)index);
+		float* params = record->shape;
+		record->shapeType = type;
+		switch(type)
+		{
+		case CS_SPHERE:
+			params[0] = ((Sphere*)shape)->radius;
+			break;
+		case CS_BOX:
+			for(int i = 0; i < 3; i++) params[i] = ((Box*)shape)->halfExtent[i];
+			break;
+		case CS_CAPSULE:
+			params[0] = ((Capsule*)shape)->radius;
+			params[1] = ((Capsule*)shape)->height;
+			break;
+		case CS_PLANE:
+			for(int i = 0; i < 3; i++) params[i] = ((Plane*)shape)->normal[i];
+			params[3] = ((Plane*)shape)->margin;
+			break;
+		case CS_CONE:
+			params[0] = ((Cone*)shape)->radius;
+			params[1] = ((Cone*)shape)->height;
+			break;
+		case CS_CYLINDER:
+			for(int i = 0; i < 3; i++) params[i]     = ((Cylinder*)shape)->halfExtent[i];
+			for(int i = 0; i < 3; i++) params[i + 3] = ((Cylinder*)shape)->axis[i];
+			break;
+		case CS_CONVEX_MESH:
+		case CS_CONCAVE_MESH:
+			record->geometry = scene->addString(Geometry::getName(((CollisionMesh*)shape)->geometryIndex));
+			break;
+		}
+	}
+
+	bool createFromBinary(CRigidBody                          body,
+						  const SceneFormat::RigidBodyRecord& record,
+						  const SceneFormat::SceneView&       scene)
+	{
+		bool success = true;
+		const char* error = "Invalid value in a field";
+		if(record.mass        >= 0) setMass(body, record.mass);               else success = false;
+		if(record.friction    >= 0) setFriction(body, record.friction);       else success = false;
+		if(record.restitution >= 0) setRestitution(body, record.restitution); else success = false;
+		setKinematic(body, record.isKinematic != 0);
+
+		const float*    params = record.shape;
+		CollisionShape* shape  = NULL;
+		switch(record.shapeType)
+		{
+		case CS_SPHERE:
+			shape = new Sphere(params[0]);
+			break;
+		case CS_BOX:
+			shape = new Box(Vec3(params[0], params[1], params[2]));
+			break;
+		case CS_CAPSULE:
+			shape = new Capsule(params[0], params[1]);
+			break;
+		case CS_PLANE:
+			shape = new Plane(Vec3(params[0], params[1], params[2]), params[3]);
+			break;
+		case CS_CONE:
+			shape = new Cone(params[0], params[1]);
+			break;
+		case CS_CYLINDER:
+			shape = new Cylinder(Vec3(params[0], params[1], params[2]), Vec3(params[3], params[4], params[5]));
+			break;
+		case CS_CONCAVE_MESH:
+		case CS_CONVEX_MESH:
+		{
+			// Matches createFromJSON, concave meshes are not built as triangle meshes
+			const char* filename = scene.getString(record.geometry);
+			shape = new CollisionMesh(filename ? filename : "default.pamesh", record.shapeType == CS_CONVEX_MESH);
+		}
+		break;
+		default:
+			error   = "Invalid collision shape type";
+			success = false;
+			break;
+		}
+		if(shape) setCollisionShape(body, shape);
+		setActivation(body, true);
+		if(!success) Log::error("RigidBody::createFromBinary", error);
+		return success;
+	}
+
 	bool isKinematic(CRigidBody body)
 	{
 		return rigidBodies[body]->isKinematicObject();
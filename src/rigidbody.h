@@ -4,6 +4,7 @@
 #include "datatypes.h"
 #include "mathdefs.h"
 #include "jsondefs.h"
+#include "sceneformat.h"
 
 class  CollisionShape;
 struct GameObject;
@@ -35,6 +36,8 @@ namespace RigidBody
 	void  setFriction(CRigidBody body, float friction);
 	bool  createFromJSON(CRigidBody body, const rapidjson::Value& value);
 	bool  writeToJSON(CRigidBody body, rapidjson::Writer<rapidjson::StringBuffer>& writer);
+	bool  createFromBinary(CRigidBody body, const SceneFormat::RigidBodyRecord& record, const SceneFormat::SceneView& scene);
+	void  writeToBinary(CRigidBody body, SceneFormat::RigidBodyRecord* record, SceneFormat::SceneData* scene);
 	bool  isKinematic(CRigidBody body);
 	void  cleanup();
 	int   getCollisionShapeType(CRigidBody body);
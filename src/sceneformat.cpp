@@ -0,0 +1,480 @@
+#include <stdio.h>
+#include <string.h>
+#include <stddef.h>
+
+#include "sceneformat.h"
+
+namespace SceneFormat
+{
+	namespace
+	{
+		const size_t RECORD_SIZES[ST_COUNT] = { sizeof(ObjectRecord),
+												sizeof(TransformRecord),
+												sizeof(ModelRecord),
+												sizeof(LightRecord),
+												sizeof(CameraRecord),
+												sizeof(RigidBodyRecord),
+												sizeof(int32_t),
+												sizeof(char),
+												sizeof(SettingsRecord) };
+
+		inline uint64_t align(uint64_t offset)
+		{
+			return (offset + ALIGNMENT - 1) & ~(uint64_t)(ALIGNMENT - 1);
+		}
+
+		bool writePadding(FILE* file, uint64_t* offset)
+		{
+			static const char zeros[ALIGNMENT] = {0};
+			uint64_t padding = align(*offset) - *offset;
+			*offset += padding;
+			return padding == 0 || fwrite(zeros, 1, (size_t)padding, file) == padding;
+		}
+
+		inline bool isValidIndex(int32_t index, uint32_t count)
+		{
+			return index == NONE || (index >= 0 && (uint32_t)index < count);
+		}
+
+		inline bool isValidString(int32_t offset, uint32_t size)
+		{
+			return offset == NONE || (offset >= 0 && (uint32_t)offset < size);
+		}
+
+		int32_t copyString(SceneData* data, const SceneView& scene, int32_t offset)
+		{
+			return offset == NONE ? NONE : data->addString(scene.getString(offset));
+		}
+
+		// Whole file in memory, 8 byte aligned so scenes can be read in place
+		bool readAligned(const char* filename, std::vector<uint64_t>* buffer, size_t* size)
+		{
+			FILE* file = fopen(filename, "rb");
+			if(!file) return false;
+			fseek(file, 0L, SEEK_END);
+			long length = ftell(file);
+			rewind(file);
+			*size = length > 0 ? (size_t)length : 0;
+			buffer->assign(*size / sizeof(uint64_t) + 1, 0);
+			bool success = *size == 0 || fread(buffer->data(), *size, 1, file) == 1;
+			fclose(file);
+			return success;
+		}
+
+		// Writes at the current position of file, which has to be aligned, size is set to the bytes written
+		bool writeScene(const SceneData& scene, FILE* file, uint64_t* size, std::string* error)
+		{
+			const void* sources[ST_COUNT] = { scene.objects.data(),
+											  scene.transforms.data(),
+											  scene.models.data(),
+											  scene.lights.data(),
+											  scene.cameras.data(),
+											  scene.rigidBodies.data(),
+											  scene.scripts.data(),
+											  scene.strings.data(),
+											  &scene.settings };
+			uint32_t counts[ST_COUNT] = { (uint32_t)scene.objects.size(),
+										  (uint32_t)scene.transforms.size(),
+										  (uint32_t)scene.models.size(),
+										  (uint32_t)scene.lights.size(),
+										  (uint32_t)scene.cameras.size(),
+										  (uint32_t)scene.rigidBodies.size(),
+										  (uint32_t)scene.scripts.size(),
+										  (uint32_t)scene.strings.size(),
+										  1 };
+			if(counts[ST_TRANSFORMS] != counts[ST_OBJECTS])
+			{
+				*error = "Every object needs a transform";
+				return false;
+			}
+
+			Header  header;
+			Section sections[ST_COUNT];
+			uint64_t offset = align(sizeof(Header) + sizeof(sections));
+			for(int i = 0; i < ST_COUNT; i++)
+			{
+				sections[i].type   = (uint32_t)i;
+				sections[i].count  = counts[i];
+				sections[i].offset = offset;
+				sections[i].size   = (uint64_t)counts[i] * RECORD_SIZES[i];
+				offset = align(offset + sections[i].size);
+			}
+
+			bool success = fwrite(&header, sizeof(Header), 1, file) == 1 &&
+				           fwrite(sections, sizeof(sections), 1, file) == 1;
+			offset = sizeof(Header) + sizeof(sections);
+			for(int i = 0; i < ST_COUNT && success; i++)
+			{
+				success = writePadding(file, &offset);
+				if(success && sections[i].size > 0)
+					success = fwrite(sources[i], (size_t)sections[i].size, 1, file) == 1;
+				offset += sections[i].size;
+			}
+			success = success && writePadding(file, &offset);
+			*size = offset;
+			if(!success) *error = "Error writing file";
+			return success;
+		}
+	}
+
+	int32_t SceneData::addString(const std::string& str)
+	{
+		auto it = stringOffsets.find(str);
+		if(it != stringOffsets.end()) return it->second;
+		int32_t offset = (int32_t)strings.size();
+		strings.insert(strings.end(), str.begin(), str.end());
+		strings.push_back('\0');
+		stringOffsets[str] = offset;
+		return offset;
+	}
+
+	void SceneData::getView(SceneView* view) const
+	{
+		view->objects     = objects.data();
+		view->transforms  = transforms.data();
+		view->models      = models.data();
+		view->lights      = lights.data();
+		view->cameras     = cameras.data();
+		view->rigidBodies = rigidBodies.data();
+		view->scripts     = scripts.data();
+		view->strings     = strings.data();
+		view->settings    = &settings;
+		view->counts[ST_OBJECTS]     = (uint32_t)objects.size();
+		view->counts[ST_TRANSFORMS]  = (uint32_t)transforms.size();
+		view->counts[ST_MODELS]      = (uint32_t)models.size();
+		view->counts[ST_LIGHTS]      = (uint32_t)lights.size();
+		view->counts[ST_CAMERAS]     = (uint32_t)cameras.size();
+		view->counts[ST_RIGIDBODIES] = (uint32_t)rigidBodies.size();
+		view->counts[ST_SCRIPTS]     = (uint32_t)scripts.size();
+		view->counts[ST_STRINGS]     = (uint32_t)strings.size();
+		view->counts[ST_SETTINGS]    = 1;
+	}
+
+	void SceneData::addObject(const SceneView& scene, uint32_t objectIndex)
+	{
+		const ObjectRecord& source = scene.objects[objectIndex];
+		ObjectRecord        object = source;
+		object.name        = copyString(this, scene, source.name);
+		object.tag         = copyString(this, scene, source.tag);
+		object.firstScript = (uint32_t)scripts.size();
+		for(uint32_t i = 0; i < source.scriptCount; i++)
+			scripts.push_back(copyString(this, scene, scene.scripts[source.firstScript + i]));
+		if(source.model != NONE)
+		{
+			ModelRecord model = scene.models[source.model];
+			model.geometry = copyString(this, scene, model.geometry);
+			model.texture  = copyString(this, scene, model.texture);
+			object.model   = (int32_t)models.size();
+			models.push_back(model);
+		}
+		if(source.light != NONE)
+		{
+			object.light = (int32_t)lights.size();
+			lights.push_back(scene.lights[source.light]);
+		}
+		if(source.camera != NONE)
+		{
+			object.camera = (int32_t)cameras.size();
+			cameras.push_back(scene.cameras[source.camera]);
+		}
+		if(source.rigidBody != NONE)
+		{
+			RigidBodyRecord rigidBody = scene.rigidBodies[source.rigidBody];
+			rigidBody.geometry = copyString(this, scene, rigidBody.geometry);
+			object.rigidBody   = (int32_t)rigidBodies.size();
+			rigidBodies.push_back(rigidBody);
+		}
+		objects.push_back(object);
+		transforms.push_back(scene.transforms[objectIndex]);
+	}
+
+	void SceneData::clear()
+	{
+		objects.clear();
+		transforms.clear();
+		models.clear();
+		lights.clear();
+		cameras.clear();
+		rigidBodies.clear();
+		scripts.clear();
+		strings.clear();
+		stringOffsets.clear();
+	}
+
+	const char* SceneView::getString(int32_t offset) const
+	{
+		return offset == NONE ? NULL : strings + offset;
+	}
+
+	bool write(const SceneData& scene, const char* filename, std::string* error)
+	{
+		// Written next to the old file first so a failed write never loses the scene
+		std::string temporary = std::string(filename) + ".tmp";
+		FILE* file = fopen(temporary.c_str(), "wb");
+		if(!file)
+		{
+			*error = "File could not be created";
+			return false;
+		}
+		uint64_t size    = 0;
+		bool     success = writeScene(scene, file, &size, error);
+		success = fclose(file) == 0 && success;
+		if(success && rename(temporary.c_str(), filename) != 0)
+		{
+			success = false;
+			*error  = "Could not replace " + std::string(filename);
+		}
+		if(!success) remove(temporary.c_str());
+		return success;
+	}
+
+	bool read(const void* data, size_t size, SceneView* view, std::string* error)
+	{
+		const char* bytes = (const char*)data;
+		if(!data || size < sizeof(Header) + sizeof(Section) * ST_COUNT)
+		{
+			*error = "File too small";
+			return false;
+		}
+		if((uintptr_t)data % ALIGNMENT != 0)
+		{
+			*error = "File memory is not aligned";
+			return false;
+		}
+		const Header* header = (const Header*)bytes;
+		if(header->magic != MAGIC)
+		{
+			*error = "Not a scene file";
+			return false;
+		}
+		if(header->version != VERSION)
+		{
+			*error = "Unsupported version " + std::to_string(header->version);
+			return false;
+		}
+		if(header->sectionCount != ST_COUNT)
+		{
+			*error = "Unexpected section count";
+			return false;
+		}
+
+		const Section* sections = (const Section*)(bytes + sizeof(Header));
+		const void*    starts[ST_COUNT];
+		for(int i = 0; i < ST_COUNT; i++)
+		{
+			const Section& section = sections[i];
+			if(section.type != (uint32_t)i ||
+			   section.offset % ALIGNMENT != 0 ||
+			   section.size != (uint64_t)section.count * RECORD_SIZES[i] ||
+			   section.offset > size || section.size > size - section.offset)
+			{
+				*error = "Invalid section " + std::to_string(i);
+				return false;
+			}
+			starts[i]         = bytes + section.offset;
+			view->counts[i]   = section.count;
+		}
+		view->objects     = (const ObjectRecord*)starts[ST_OBJECTS];
+		view->transforms  = (const TransformRecord*)starts[ST_TRANSFORMS];
+		view->models      = (const ModelRecord*)starts[ST_MODELS];
+		view->lights      = (const LightRecord*)starts[ST_LIGHTS];
+		view->cameras     = (const CameraRecord*)starts[ST_CAMERAS];
+		view->rigidBodies = (const RigidBodyRecord*)starts[ST_RIGIDBODIES];
+		view->scripts     = (const int32_t*)starts[ST_SCRIPTS];
+		view->strings     = (const char*)starts[ST_STRINGS];
+		view->settings    = (const SettingsRecord*)starts[ST_SETTINGS];
+
+		// From here on the records are trusted by the loaders, so check every reference
+		uint32_t stringsSize = view->counts[ST_STRINGS];
+		if(view->counts[ST_SETTINGS] != 1 ||
+		   view->counts[ST_TRANSFORMS] != view->counts[ST_OBJECTS] ||
+		   (stringsSize > 0 && view->strings[stringsSize - 1] != '\0'))
+		{
+			*error = "Invalid section contents";
+			return false;
+		}
+		for(uint32_t i = 0; i < view->counts[ST_OBJECTS]; i++)
+		{
+			const ObjectRecord& object = view->objects[i];
+			if(object.name == NONE ||
+			   !isValidString(object.name, stringsSize) ||
+			   !isValidString(object.tag, stringsSize) ||
+			   !isValidIndex(object.model, view->counts[ST_MODELS]) ||
+			   !isValidIndex(object.light, view->counts[ST_LIGHTS]) ||
+			   !isValidIndex(object.camera, view->counts[ST_CAMERAS]) ||
+			   !isValidIndex(object.rigidBody, view->counts[ST_RIGIDBODIES]) ||
+			   object.firstScript > view->counts[ST_SCRIPTS] ||
+			   object.scriptCount > view->counts[ST_SCRIPTS] - object.firstScript)
+			{
+				*error = "Invalid object record " + std::to_string(i);
+				return false;
+			}
+		}
+		for(uint32_t i = 0; i < view->counts[ST_SCRIPTS]; i++)
+		{
+			if(view->scripts[i] == NONE || !isValidString(view->scripts[i], stringsSize))
+			{
+				*error = "Invalid script name " + std::to_string(i);
+				return false;
+			}
+		}
+		for(uint32_t i = 0; i < view->counts[ST_MODELS]; i++)
+		{
+			if(!isValidString(view->models[i].geometry, stringsSize) ||
+			   !isValidString(view->models[i].texture, stringsSize))
+			{
+				*error = "Invalid model record " + std::to_string(i);
+				return false;
+			}
+		}
+		for(uint32_t i = 0; i < view->counts[ST_RIGIDBODIES]; i++)
+		{
+			if(!isValidString(view->rigidBodies[i].geometry, stringsSize))
+			{
+				*error = "Invalid rigidbody record " + std::to_string(i);
+				return false;
+			}
+		}
+		return true;
+	}
+
+	bool appendToJournal(const SceneData&            changes,
+						 const std::vector<int32_t>& removed,
+						 const char*                 journal,
+						 std::string*                error)
+	{
+		// Not opened for appending since the scene size is filled in once the scene is written
+		FILE* file = fopen(journal, "r+b");
+		if(!file) file = fopen(journal, "wb");
+		if(!file)
+		{
+			*error = "Journal could not be created";
+			return false;
+		}
+		fseek(file, 0L, SEEK_END);
+		long start = ftell(file);
+		if(start < 0 || start % ALIGNMENT != 0)
+		{
+			fclose(file);
+			*error = "Journal is damaged";
+			return false;
+		}
+
+		// A zero scene size marks the entry as incomplete until the very last write
+		JournalEntry entry;
+		entry.removedCount = (uint32_t)removed.size();
+		uint64_t offset  = sizeof(JournalEntry) + removed.size() * sizeof(int32_t);
+		bool     success = fwrite(&entry, sizeof(JournalEntry), 1, file) == 1 &&
+			               (removed.empty() || fwrite(removed.data(), removed.size() * sizeof(int32_t), 1, file) == 1) &&
+			               writePadding(file, &offset) &&
+			               writeScene(changes, file, &entry.sceneSize, error);
+		if(success)
+		{
+			success = fseek(file, start + (long)offsetof(JournalEntry, sceneSize), SEEK_SET) == 0 &&
+				      fwrite(&entry.sceneSize, sizeof(entry.sceneSize), 1, file) == 1;
+		}
+		success = fclose(file) == 0 && success;
+		if(!success && error->empty()) *error = "Error writing journal";
+		return success;
+	}
+
+	bool readWithJournal(const char* filename, const char* journal, SceneData* scene, std::string* error)
+	{
+		std::vector<uint64_t> sceneBuffer, journalBuffer;
+		size_t                sceneSize = 0, journalSize = 0;
+		std::vector<SceneView> views(1);
+		if(!readAligned(filename, &sceneBuffer, &sceneSize))
+		{
+			*error = "Could not read " + std::string(filename);
+			return false;
+		}
+		if(!read(sceneBuffer.data(), sceneSize, &views[0], error)) return false;
+
+		// Latest version of every object, view -1 once it is removed
+		struct Source
+		{
+			int32_t  view;
+			uint32_t object;
+		};
+		std::vector<Source>                  sources;
+		std::unordered_map<int32_t, size_t>  positions;
+		for(uint32_t i = 0; i < views[0].counts[ST_OBJECTS]; i++)
+		{
+			int32_t node = views[0].objects[i].node;
+			if(node != -1) positions[node] = sources.size();
+			sources.push_back(Source{0, i});
+		}
+
+		if(readAligned(journal, &journalBuffer, &journalSize))
+		{
+			const char* bytes  = (const char*)journalBuffer.data();
+			uint64_t    offset = 0;
+			while(offset + sizeof(JournalEntry) <= journalSize)
+			{
+				const JournalEntry* entry = (const JournalEntry*)(bytes + offset);
+				if(entry->magic != JOURNAL_MAGIC)
+				{
+					*error = "Journal is damaged";
+					return false;
+				}
+				const int32_t* removed     = (const int32_t*)(entry + 1);
+				uint64_t       sceneOffset = align(offset + sizeof(JournalEntry) + (uint64_t)entry->removedCount * sizeof(int32_t));
+				if(entry->sceneSize == 0 || sceneOffset > journalSize || entry->sceneSize > journalSize - sceneOffset)
+					break;
+
+				SceneView view;
+				if(!read(bytes + sceneOffset, (size_t)entry->sceneSize, &view, error)) return false;
+				int32_t viewIndex = (int32_t)views.size();
+				views.push_back(view);
+				for(uint32_t i = 0; i < entry->removedCount; i++)
+				{
+					auto it = positions.find(removed[i]);
+					if(it == positions.end()) continue;
+					sources[it->second].view = -1;
+					positions.erase(it);
+				}
+				for(uint32_t i = 0; i < view.counts[ST_OBJECTS]; i++)
+				{
+					int32_t node = view.objects[i].node;
+					auto    it   = node != -1 ? positions.find(node) : positions.end();
+					if(it != positions.end())
+					{
+						sources[it->second] = Source{viewIndex, i};
+					}
+					else
+					{
+						if(node != -1) positions[node] = sources.size();
+						sources.push_back(Source{viewIndex, i});
+					}
+				}
+				offset = align(sceneOffset + entry->sceneSize);
+			}
+		}
+
+		scene->clear();
+		scene->objects.reserve(sources.size());
+		scene->transforms.reserve(sources.size());
+		for(const Source& source : sources)
+			if(source.view != -1) scene->addObject(views[source.view], source.object);
+		scene->settings = *views.back().settings;
+		return true;
+	}
+
+	bool compact(const char* filename, const char* journal, std::string* error)
+	{
+		SceneData scene;
+		if(!readWithJournal(filename, journal, &scene, error) || !write(scene, filename, error)) return false;
+		remove(journal);
+		return true;
+	}
+
+	long fileSize(const char* filename)
+	{
+		FILE* file = fopen(filename, "rb");
+		if(!file) return -1;
+		fseek(file, 0L, SEEK_END);
+		long size = ftell(file);
+		fclose(file);
+		return size;
+	}
+}
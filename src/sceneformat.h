@@ -0,0 +1,209 @@
+#ifndef sceneformat_H
+#define sceneformat_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <cinttypes>
+
+// Layout of binary scene files (.pascene). A header and a section table are followed by
+// one section per record type. Every section starts on an 8 byte boundary and holds
+// tightly packed records, so a mapped file can be read in place without parsing.
+// Strings are stored once in the string section and referenced by byte offset, -1 is none.
+// Only plain data lives here so tools can use it without the rest of the engine.
+namespace SceneFormat
+{
+	const uint32_t MAGIC     = 0x43534150; // "PASC"
+	const uint32_t VERSION   = 1;
+	const uint32_t ALIGNMENT = 8;
+	const int32_t  NONE      = -1;
+
+	enum SectionType
+	{
+		ST_OBJECTS = 0,
+		ST_TRANSFORMS,  // One per object, same order as the objects
+		ST_MODELS,
+		ST_LIGHTS,
+		ST_CAMERAS,
+		ST_RIGIDBODIES,
+		ST_SCRIPTS,     // String offsets, objects reference a range of them
+		ST_STRINGS,
+		ST_SETTINGS,    // Exactly one record
+		ST_COUNT
+	};
+
+	struct Header
+	{
+		uint32_t magic        = MAGIC;
+		uint32_t version      = VERSION;
+		uint32_t sectionCount = ST_COUNT;
+		uint32_t reserved     = 0;
+	};
+
+	struct Section
+	{
+		uint32_t type   = 0;
+		uint32_t count  = 0; // Records, bytes for the string section
+		uint64_t offset = 0; // From the start of the file
+		uint64_t size   = 0; // In bytes
+	};
+
+	struct ObjectRecord
+	{
+		int32_t  name        = NONE;
+		int32_t  tag         = NONE;
+		int32_t  node        = -1; // Node the object had when saved, parents refer to it
+		int32_t  parent      = -1;
+		int32_t  model       = NONE;
+		int32_t  light       = NONE;
+		int32_t  camera      = NONE;
+		int32_t  rigidBody   = NONE;
+		uint32_t firstScript = 0;
+		uint32_t scriptCount = 0;
+	};
+
+	struct TransformRecord
+	{
+		float position[3] = {0.f, 0.f, 0.f};
+		float rotation[4] = {0.f, 0.f, 0.f, 1.f}; // x, y, z, w
+		float scale[3]    = {1.f, 1.f, 1.f};
+	};
+
+	struct ModelRecord
+	{
+		int32_t geometry         = NONE;
+		int32_t texture          = NONE;
+		int32_t material         = 0;
+		float   diffuseColor[4]  = {1.f, 1.f, 1.f, 1.f};
+		float   diffuse          = 1.f;
+		float   specular         = 1.f;
+		float   specularStrength = 50.f;
+		uint8_t castShadow       = 1;
+		uint8_t padding[3]       = {0, 0, 0};
+	};
+
+	struct LightRecord
+	{
+		int32_t type        = 2;
+		float   innerAngle  = 0.3490659f; // 20 degrees
+		float   outerAngle  = 0.5235988f; // 30 degrees
+		float   falloff     = 1.5f;
+		float   radius      = 30.f;
+		float   intensity   = 1.f;
+		float   depthBias   = 0.0005f;
+		float   color[4]    = {1.f, 1.f, 1.f, 1.f};
+		uint8_t castShadow  = 0;
+		uint8_t pcfEnabled  = 0;
+		uint8_t padding[2]  = {0, 0};
+	};
+
+	struct CameraRecord
+	{
+		float   nearZ          = 0.1f;
+		float   farZ           = 1000.f;
+		float   fov            = 1.3089969f; // 75 degrees
+		float   aspectRatio    = 4.f / 3.f;
+		uint8_t isOrthographic = 0;
+		uint8_t isActive       = 0;
+		uint8_t padding[2]     = {0, 0};
+	};
+
+	// Shape parameters depend on shapeType, in the order the json format lists them:
+	// sphere radius, box half extents, capsule and cone radius and height,
+	// plane normal and margin, cylinder half extents and axis
+	struct RigidBodyRecord
+	{
+		float   mass        = 1.f;
+		float   friction    = 0.5f;
+		float   restitution = 0.f;
+		int32_t shapeType   = 0;
+		float   shape[6]    = {0.f, 0.f, 0.f, 0.f, 0.f, 0.f};
+		int32_t geometry    = NONE; // Mesh shapes only
+		uint8_t isKinematic = 0;
+		uint8_t padding[3]  = {0, 0, 0};
+	};
+
+	struct SettingsRecord
+	{
+		float   ambientLight[4] = {0.1f, 0.1f, 0.12f, 1.f};
+		float   clearColor[4]   = {0.f, 0.f, 0.f, 1.f};
+		int32_t fogMode         = 0;
+		float   fogDensity      = 0.f;
+		float   fogStart        = 0.f;
+		float   fogMax          = 0.f;
+		float   fogColor[4]     = {0.f, 0.f, 0.f, 1.f};
+		float   gravity[3]      = {0.f, -9.8f, 0.f};
+		float   padding         = 0.f;
+	};
+
+	struct SceneView;
+
+	// A scene as plain arrays, filled before writing
+	struct SceneData
+	{
+		std::vector<ObjectRecord>    objects;
+		std::vector<TransformRecord> transforms;
+		std::vector<ModelRecord>     models;
+		std::vector<LightRecord>     lights;
+		std::vector<CameraRecord>    cameras;
+		std::vector<RigidBodyRecord> rigidBodies;
+		std::vector<int32_t>         scripts;
+		std::vector<char>            strings;
+		SettingsRecord               settings;
+		std::unordered_map<std::string, int32_t> stringOffsets;
+
+		int32_t addString(const std::string& str); // Returns the offset, equal strings are stored once
+		void    getView(SceneView* view) const;    // Valid until the data changes
+		void    addObject(const SceneView& scene, uint32_t objectIndex); // Copies the object with its components
+		void    clear();                           // Keeps the settings and the capacity
+	};
+
+	// Points into a file's memory, valid for as long as that memory is
+	struct SceneView
+	{
+		const ObjectRecord*    objects     = NULL;
+		const TransformRecord* transforms  = NULL;
+		const ModelRecord*     models      = NULL;
+		const LightRecord*     lights      = NULL;
+		const CameraRecord*    cameras     = NULL;
+		const RigidBodyRecord* rigidBodies = NULL;
+		const int32_t*         scripts     = NULL;
+		const char*            strings     = NULL;
+		const SettingsRecord*  settings    = NULL;
+		uint32_t               counts[ST_COUNT];
+
+		const char* getString(int32_t offset) const; // NULL for NONE
+	};
+
+	// Both return false and fill error when something is wrong. read checks every
+	// offset and index in the file so the view can be used without further checks.
+	// write replaces an existing file only once the new one is complete.
+	bool write(const SceneData& scene, const char* filename, std::string* error);
+	bool read(const void* data, size_t size, SceneView* view, std::string* error);
+
+	// A journal records what changed in a scene file since it was last written in full, so saving
+	// only costs as much as the changes. Entries are appended one after the other, each is a
+	// JournalEntry, the nodes of removed objects and a complete scene holding the new and changed
+	// objects and the current settings. Objects are matched by ObjectRecord::node, later entries win.
+	const uint32_t JOURNAL_MAGIC = 0x4A435350; // "PSCJ"
+
+	struct JournalEntry
+	{
+		uint32_t magic        = JOURNAL_MAGIC;
+		uint32_t removedCount = 0; // int32_t nodes, padded to ALIGNMENT
+		uint64_t sceneSize    = 0; // In bytes, follows the removed nodes
+	};
+
+	bool appendToJournal(const SceneData&            changes,
+						 const std::vector<int32_t>& removed,
+						 const char*                 journal,
+						 std::string*                error);
+	// Reads filename with every entry of journal applied, a missing journal is not an error.
+	// An entry cut short by a crash while it was appended is ignored.
+	bool readWithJournal(const char* filename, const char* journal, SceneData* scene, std::string* error);
+	// Replaces filename with the merged scene and deletes the journal
+	bool compact(const char* filename, const char* journal, std::string* error);
+	long fileSize(const char* filename); // -1 if it can't be opened
+}
+
+#endif
@@ -10,55 +10,557 @@
 #include "model.h"
 #include "renderer.h"
 #include "physics.h"
+#include "prefab.h"
+#include "geometry.h"
+#include "texture.h"
+#include "sceneformat.h"
+#include "scenereader.h"
+#include "loadprofiler.h"
+
+#include <unordered_map>
+#include <unordered_set>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+#include "../include/SDL2/SDL_surface.h"
+
+#include "../include/angelscript/add_on/scriptarray/scriptarray.h"
 
 namespace SceneManager
 {
+	void        updateSceneLoad();
+	GameObject* createFromBinary(const SceneFormat::SceneView& scene, uint32_t objectIndex, const std::string& filename);
+
 	namespace
 	{
+		// Nodes are generational handles, the low bits index into sceneObjects and the
+		// high bits hold the generation of that slot at the time the node was handed out.
+		// Bit 31 is never set so a valid node is always positive and -1 remains invalid.
+		const int32_t  NODE_INDEX_BITS      = 20;
+		const int32_t  NODE_INDEX_MASK      = (1 << NODE_INDEX_BITS) - 1;
+		const uint32_t NODE_GENERATION_MASK = 0x7FF;
+
+		struct NodeSlot
+		{
+			uint32_t generation = 0;
+			int32_t  denseIndex = -1; // Location in validNodes, -1 if slot is free
+			int32_t  nameSlot   = -1; // Location in the name and tag index buckets
+			int32_t  tagSlot    = -1;
+			int32_t  dirtySlot  = -1; // Location in dirtyNodes, -1 if unchanged since the last autosave
+		};
+		
 		std::vector<Node>         validNodes;
+		std::vector<ComponentRow> componentRows;  // Parallel to validNodes
 		std::vector<Node>         removableNodes;
+		std::vector<Node>         drainingNodes;  // Removals being processed by update
+		std::vector<GameObject*>  drainingObjects;
+		std::vector<bool>         removalMarks;   // One bit per slot, set while its node waits for removal
 		std::vector<GameObject>   sceneObjects;
+		std::vector<NodeSlot>     nodeSlots;
 		std::vector<unsigned int> emptyIndices;
-		
-		void removeGameObject(GameObject* gameObject)
+
+		// Names and tags are interned to a dense id on first use, the indices below are
+		// indexed by that id so a lookup is one string hash followed by an array access
+		std::unordered_map<std::string, uint32_t> internedStrings;
+		std::vector<std::vector<Node>>            nameIndex;
+		std::vector<std::vector<Node>>            tagIndex;
+		asIObjectType*                            gameObjectArrayType = NULL;
+
+		// Parent links are saved as the nodes the objects had when they were written,
+		// they are resolved once every object of the file exists
+		std::unordered_map<Node, Node>    loadedNodes;    // Saved node -> new node
+		std::vector<std::pair<Node, Node>> pendingParents; // New node of child, saved node of parent
+
+		// Asynchronous loading. The worker streams the scene file into records and decodes every
+		// geometry and texture it references. The main thread uploads whatever the worker has
+		// queued and then creates the objects, spending at most loadBudget ms per update on both.
+		struct DecodedResource
+		{
+			std::string                filename;
+			bool                       valid   = false;
+			SDL_Surface*               surface = NULL; // Set for textures, geometry is used otherwise
+			Geometry::GeometryFileData geometry;
+		};
+
+		struct SceneLoad
+		{
+			std::string                  filename;
+			std::thread                  worker;
+			std::atomic<bool>            done{false};       // Worker finished, records and counts are final
+			std::atomic<bool>            cancelled{false};
+			std::atomic<int>             resourceCount{-1}; // Set once the file is parsed
+			std::atomic<int>             objectCount{0};
+			SceneFormat::SceneData       scene;
+			SceneReader::Result          result;
+			bool                         valid      = false;
+			std::mutex                   queueMutex;
+			std::deque<DecodedResource*> queue;             // Decoded, waiting for upload
+			// Main thread only from here on
+			std::vector<int>             geometries;        // Uploads are held until every object exists
+			std::vector<int>             textures;
+			int                          uploaded   = 0;
+			int                          nextObject = 0;
+			bool                         reserved   = false;
+			std::unordered_map<Node, Node>     loadedNodes;    // Swapped in while objects are created
+			std::vector<std::pair<Node, Node>> pendingParents;
+		};
+
+		SceneLoad* sceneLoad  = NULL;
+		float      loadBudget = 4.f;
+
+		// Autosave only writes objects marked dirty since the previous autosave and the ones removed
+		// since. Their records are copied on the main thread and appended to the file's journal on a
+		// worker, see SceneFormat. With verify set every object is also hashed to catch missed marks.
+		struct AutosaveWrite
+		{
+			std::string            filename;
+			SceneFormat::SceneData changes;          // Every object when full is set
+			std::vector<int32_t>   removed;
+			bool                   full    = false;
+			std::thread            worker;
+			std::atomic<bool>      done{false};
+			bool                   success = false;  // Worker only until done is set
+			std::string            error;
+		};
+
+		AutosaveWrite*                        autosaveWrite    = NULL;
+		std::string                           autosaveFile;
+		float                                 autosaveInterval = 0.f;  // Seconds, 0 is off
+		bool                                  autosaveFull     = true; // Next autosave rewrites the file
+		std::chrono::steady_clock::time_point lastAutosave;
+		bool                                  autosaveVerify   = false;
+		std::vector<Node>                     dirtyNodes;              // Created or changed since the last autosave
+		std::vector<Node>                     removedNodes;            // Removed since, only those in the file
+		std::unordered_set<Node>              savedNodes;              // Objects in the file
+		std::unordered_map<Node, uint64_t>    savedHashes;             // Only kept while verifying
+		SceneFormat::SettingsRecord           savedSettings;
+		SceneFormat::SceneData                objectRecords;           // One object at a time
+
+		inline int32_t nodeIndex(Node node)
+		{
+			return node & NODE_INDEX_MASK;
+		}
+
+		inline uint32_t nodeGeneration(Node node)
+		{
+			return ((uint32_t)node >> NODE_INDEX_BITS) & NODE_GENERATION_MASK;
+		}
+
+		inline Node makeNode(int32_t index, uint32_t generation)
+		{
+			return (Node)((generation & NODE_GENERATION_MASK) << NODE_INDEX_BITS) | index;
+		}
+
+		uint32_t intern(const std::string& str)
+		{
+			auto it = internedStrings.find(str);
+			if(it != internedStrings.end()) return it->second;
+			
+			uint32_t id = (uint32_t)internedStrings.size();
+			internedStrings[str] = id;
+			nameIndex.push_back(std::vector<Node>());
+			tagIndex.push_back(std::vector<Node>());
+			return id;
+		}
+
+		// Returns NULL if the string was never interned, which means nothing uses it
+		const std::vector<Node>* getIndexBucket(std::vector<std::vector<Node>>& index,
+												const std::string& str)
+		{
+			auto it = internedStrings.find(str);
+			return it != internedStrings.end() ? &index[it->second] : NULL;
+		}
+
+		// Every node remembers where it sits in its buckets so removal is a swap with the last entry
+		void addToIndex(std::vector<std::vector<Node>>& index,
+						int32_t NodeSlot::*             bucketSlot,
+						const std::string&              str,
+						Node                            node)
+		{
+			std::vector<Node>& bucket = index[intern(str)];
+			nodeSlots[nodeIndex(node)].*bucketSlot = (int32_t)bucket.size();
+			bucket.push_back(node);
+		}
+
+		void removeFromIndex(std::vector<std::vector<Node>>& index,
+							 int32_t NodeSlot::*             bucketSlot,
+							 const std::string&              str,
+							 Node                            node)
+		{
+			auto it = internedStrings.find(str);
+			if(it == internedStrings.end()) return;
+			std::vector<Node>& bucket   = index[it->second];
+			int32_t&           position = nodeSlots[nodeIndex(node)].*bucketSlot;
+			if(position < 0 || position >= (int32_t)bucket.size() || bucket[position] != node) return;
+
+			Node moved = bucket.back();
+			bucket[position] = moved;
+			nodeSlots[nodeIndex(moved)].*bucketSlot = position;
+			bucket.pop_back();
+			position = -1;
+		}
+
+		void clearDirty(Node node)
 		{
-			//remove components
-			for(int i = 1; i < (int)Component::NUM_COMPONENTS; i++)
+			NodeSlot& slot = nodeSlots[nodeIndex(node)];
+			if(slot.dirtySlot == -1) return;
+			Node moved = dirtyNodes.back();
+			dirtyNodes[slot.dirtySlot] = moved;
+			nodeSlots[nodeIndex(moved)].dirtySlot = slot.dirtySlot;
+			dirtyNodes.pop_back();
+			slot.dirtySlot = -1;
+		}
+
+		GameObject* lookup(Node node)
+		{
+			GameObject* gameObject = NULL;
+			int32_t index = nodeIndex(node);
+			if(node >= 0 && index < (int32_t)nodeSlots.size())
 			{
-				if(gameObject->compIndices[i] != -1)
-					GO::removeComponent(gameObject, (Component)i);
+				const NodeSlot& slot = nodeSlots[index];
+				if(slot.denseIndex != -1 && slot.generation == nodeGeneration(node))
+					gameObject = &sceneObjects[index];
 			}
-			//remove scripts
-			ScriptEngine::unRegisterGameObject(gameObject);
+			return gameObject;
+		}
+		
+		// Last step of removal, components and scripts are already gone at this point
+		void retireGameObject(GameObject* gameObject)
+		{
+			removeFromIndex(nameIndex, &NodeSlot::nameSlot, gameObject->name, gameObject->node);
+			removeFromIndex(tagIndex,  &NodeSlot::tagSlot,  gameObject->tag,  gameObject->node);
+			clearDirty(gameObject->node);
+			if(savedNodes.erase(gameObject->node)) removedNodes.push_back(gameObject->node);
 			
-			// remove the node from valid list and mark it's location in list as empty
-			int index = -1;
-			for(size_t i = 0; i < validNodes.size(); i++)
+			// Swap the last live node into the hole, retire the generation and mark the slot as empty
+			int32_t   index = nodeIndex(gameObject->node);
+			NodeSlot& slot  = nodeSlots[index];
+			if(slot.denseIndex != -1)
+			{
+				Node moved = validNodes.back();
+				validNodes[slot.denseIndex]    = moved;
+				componentRows[slot.denseIndex] = componentRows.back();
+				nodeSlots[nodeIndex(moved)].denseIndex = slot.denseIndex;
+				validNodes.pop_back();
+				componentRows.pop_back();
+				slot.denseIndex = -1;
+				slot.generation = (slot.generation + 1) & NODE_GENERATION_MASK;
+				emptyIndices.push_back(index);
+			}
+			else
+			{
+				Log::error("SceneManager::retireGameObject", "Could not remove node");
+			}
+			removalMarks[index] = false;
+		}
+
+		// Only called with live nodes, returns false if the node is already marked
+		bool markForDeletion(Node nodeToMark)
+		{
+			int32_t index = nodeIndex(nodeToMark);
+			if(removalMarks[index]) return false;
+			removalMarks[index] = true;
+			removableNodes.push_back(nodeToMark);
+			return true;
+		}
+
+		// Children are removed along with their parent
+		void markChildrenForDeletion(GameObject* gameObject)
+		{
+			int childCount = GO::getChildCount(gameObject);
+			for(int i = 0; i < childCount; i++)
+			{
+				GameObject* child = GO::getChild(gameObject, i);
+				if(child && markForDeletion(child->node)) markChildrenForDeletion(child);
+			}
+		}
+
+		// Sizes every pool for the objects about to be loaded so none of them grows mid load
+		void reserveForScene(const SceneFormat::SceneView& scene)
+		{
+			using namespace SceneFormat;
+			reserve((int)scene.counts[ST_OBJECTS]);
+			Transform::reserve((int)scene.counts[ST_OBJECTS]);
+			Model::reserve((int)scene.counts[ST_MODELS]);
+			Light::reserve((int)scene.counts[ST_LIGHTS]);
+			Camera::reserve((int)scene.counts[ST_CAMERAS]);
+		}
+
+		void linkLoadedParents()
+		{
+			for(const std::pair<Node, Node>& link : pendingParents)
+			{
+				GameObject* child  = lookup(link.first);
+				GameObject* parent = NULL;
+				auto it = loadedNodes.find(link.second);
+				if(it != loadedNodes.end()) parent = lookup(it->second);
+				if(!child) continue;
+				// Saved transforms are already relative to the parent
+				if(parent)
+					Transform::setParent(GO::getTransform(child), GO::getTransform(parent), false);
+				else
+					Log::warning("Parent of " + child->name + " not found, added as a root");
+			}
+			pendingParents.clear();
+			loadedNodes.clear();
+		}
+
+		void writeObjectToBinary(GameObject* gameObject, SceneFormat::SceneData* scene)
+		{
+			using namespace SceneFormat;
+			ObjectRecord object;
+			object.name = scene->addString(gameObject->name);
+			object.tag  = scene->addString(gameObject->tag);
+			object.node = gameObject->node;
+			GameObject* parent = GO::getParent(gameObject);
+			if(parent) object.parent = parent->node;
+
+			int scriptCount = ScriptEngine::getAttachedScriptsCount(gameObject);
+			object.firstScript = (uint32_t)scene->scripts.size();
+			object.scriptCount = (uint32_t)scriptCount;
+			for(int i = 0; i < scriptCount; i++)
+				scene->scripts.push_back(scene->addString(ScriptEngine::getAttachedScriptName(gameObject, i)));
+
+			scene->transforms.push_back(TransformRecord());
+			Transform::writeToBinary(GO::getTransform(gameObject), &scene->transforms.back());
+			if(GO::hasComponent(gameObject, Component::MODEL))
+			{
+				object.model = (int32_t)scene->models.size();
+				scene->models.push_back(ModelRecord());
+				Model::writeToBinary(GO::getModel(gameObject), &scene->models.back(), scene);
+			}
+			if(GO::hasComponent(gameObject, Component::CAMERA))
+			{
+				object.camera = (int32_t)scene->cameras.size();
+				scene->cameras.push_back(CameraRecord());
+				Camera::writeToBinary(GO::getCamera(gameObject), &scene->cameras.back());
+			}
+			if(GO::hasComponent(gameObject, Component::LIGHT))
+			{
+				object.light = (int32_t)scene->lights.size();
+				scene->lights.push_back(LightRecord());
+				Light::writeToBinary(GO::getLight(gameObject), &scene->lights.back());
+			}
+			if(GO::hasComponent(gameObject, Component::RIGIDBODY))
+			{
+				object.rigidBody = (int32_t)scene->rigidBodies.size();
+				scene->rigidBodies.push_back(RigidBodyRecord());
+				RigidBody::writeToBinary(GO::getRigidBody(gameObject), &scene->rigidBodies.back(), scene);
+			}
+			scene->objects.push_back(object);
+		}
+
+		void writeSettingsToBinary(SceneFormat::SettingsRecord* settings)
+		{
+			RenderParams* renderParams = Renderer::getRenderParams();
+			Vec4          clearColor   = Renderer::getClearColor();
+			Vec3          gravity      = Physics::getGravity();
+			for(int i = 0; i < 4; i++)
 			{
-				if(validNodes[i] == gameObject->node)
+				settings->ambientLight[i] = renderParams->ambientLight[i];
+				settings->clearColor[i]   = clearColor[i];
+				settings->fogColor[i]     = renderParams->fog.color[i];
+			}
+			for(int i = 0; i < 3; i++) settings->gravity[i] = gravity[i];
+			settings->fogMode    = renderParams->fog.fogMode;
+			settings->fogDensity = renderParams->fog.density;
+			settings->fogStart   = renderParams->fog.start;
+			settings->fogMax     = renderParams->fog.max;
+		}
+
+		// FNV-1a over the records of scene. Strings are only referenced by offset, which is
+		// the same for the same content as long as scene holds a single object.
+		uint64_t hashRecords(const SceneFormat::SceneData& scene)
+		{
+			uint64_t hash = 14695981039346656037ULL;
+			auto add = [&hash](const void* data, size_t size)
+			{
+				const uint8_t* bytes = (const uint8_t*)data;
+				for(size_t i = 0; i < size; i++) hash = (hash ^ bytes[i]) * 1099511628211ULL;
+			};
+			add(scene.objects.data(),     scene.objects.size()     * sizeof(SceneFormat::ObjectRecord));
+			add(scene.transforms.data(),  scene.transforms.size()  * sizeof(SceneFormat::TransformRecord));
+			add(scene.models.data(),      scene.models.size()      * sizeof(SceneFormat::ModelRecord));
+			add(scene.lights.data(),      scene.lights.size()      * sizeof(SceneFormat::LightRecord));
+			add(scene.cameras.data(),     scene.cameras.size()     * sizeof(SceneFormat::CameraRecord));
+			add(scene.rigidBodies.data(), scene.rigidBodies.size() * sizeof(SceneFormat::RigidBodyRecord));
+			add(scene.scripts.data(),     scene.scripts.size()     * sizeof(int32_t));
+			add(scene.strings.data(),     scene.strings.size());
+			return hash;
+		}
+
+		// Copies the records of the object into the autosave. With skipUnchanged the object is
+		// left out, returning false, if its hash matches the one saved while verifying.
+		bool addToAutosave(Node node, bool skipUnchanged, AutosaveWrite* write)
+		{
+			objectRecords.clear();
+			writeObjectToBinary(lookup(node), &objectRecords);
+			if(autosaveVerify)
+			{
+				uint64_t hash  = hashRecords(objectRecords);
+				auto     saved = savedHashes.find(node);
+				if(skipUnchanged && saved != savedHashes.end() && saved->second == hash) return false;
+				savedHashes[node] = hash;
+			}
+			SceneFormat::SceneView view;
+			objectRecords.getView(&view);
+			write->changes.addObject(view, 0);
+			savedNodes.insert(node);
+			return true;
+		}
+
+		// Runs on the worker thread and only touches the files and the write itself
+		void writeAutosave(AutosaveWrite* write)
+		{
+			std::string journal = write->filename + ".journal";
+			if(write->full)
+			{
+				write->success = SceneFormat::write(write->changes, write->filename.c_str(), &write->error);
+				if(write->success) std::remove(journal.c_str());
+			}
+			else
+			{
+				write->success = SceneFormat::appendToJournal(write->changes, write->removed, journal.c_str(), &write->error);
+				// Once replaying the journal costs more than reading the scene it is merged back in
+				if(write->success &&
+				   SceneFormat::fileSize(journal.c_str()) > SceneFormat::fileSize(write->filename.c_str()))
 				{
-					index = (int)i;
-					emptyIndices.push_back(index);
-					break;
+					write->success = SceneFormat::compact(write->filename.c_str(), journal.c_str(), &write->error);
 				}
 			}
+			write->done = true;
+		}
+
+		// Waits for the write in progress. If it failed the next autosave rewrites the whole file.
+		void finishAutosave()
+		{
+			AutosaveWrite* write = autosaveWrite;
+			if(!write) return;
+			if(write->worker.joinable()) write->worker.join();
+			if(!write->success)
+			{
+				Log::error("SceneManager::autosave", write->error + " while saving " + write->filename);
+				autosaveFull = true;
+			}
+			delete write;
+			autosaveWrite = NULL;
+		}
+
+		void collectResources(const SceneFormat::SceneData& scene,
+							  std::vector<std::string>*     geometries,
+							  std::vector<std::string>*     textures)
+		{
+			using namespace SceneFormat;
+			for(const ModelRecord& model : scene.models)
+			{
+				if(model.geometry != NONE) geometries->push_back(&scene.strings[model.geometry]);
+				if(model.texture  != NONE) textures->push_back(&scene.strings[model.texture]);
+			}
+			// Many objects share a mesh, each file is only read once
+			std::sort(geometries->begin(), geometries->end());
+			geometries->erase(std::unique(geometries->begin(), geometries->end()), geometries->end());
+			std::sort(textures->begin(), textures->end());
+			textures->erase(std::unique(textures->begin(), textures->end()), textures->end());
+		}
+
+		// Called by the json reader for every object, userData is the scene's filename
+		void createStreamedObject(const SceneFormat::SceneData& scene, uint32_t objectIndex, void* userData)
+		{
+			SceneFormat::SceneView view;
+			scene.getView(&view);
+			createFromBinary(view, objectIndex, *(const std::string*)userData);
+		}
+
+		void queueResource(SceneLoad* load, DecodedResource* resource)
+		{
+			std::lock_guard<std::mutex> lock(load->queueMutex);
+			load->queue.push_back(resource);
+		}
+
+		// Runs on the worker thread, nothing here may touch GL, scripts or the scene
+		void readScene(SceneLoad* load)
+		{
+			std::vector<std::string> geometries;
+			std::vector<std::string> textures;
+			FILE* file = fopen(load->filename.c_str(), "rb");
+			if(file)
+			{
+				LoadProfiler::ScopedTimer timer(LoadProfiler::LP_PARSE, load->filename.c_str());
+				load->valid = SceneReader::read(file, &load->scene, &load->result);
+				fclose(file);
+			}
+			else
+			{
+				load->result.error = "File not found";
+			}
+			if(load->valid)
+			{
+				load->objectCount = (int)load->scene.objects.size();
+				collectResources(load->scene, &geometries, &textures);
+			}
+			load->resourceCount = (int)(geometries.size() + textures.size());
 
-			if(index != -1)
-				validNodes.erase(validNodes.begin() + index);
+			for(const std::string& filename : geometries)
+			{
+				if(load->cancelled) break;
+				DecodedResource* resource = new DecodedResource();
+				resource->filename = filename;
+				resource->valid    = Geometry::readFile(filename.c_str(), &resource->geometry);
+				queueResource(load, resource);
+			}
+			for(const std::string& filename : textures)
+			{
+				if(load->cancelled) break;
+				DecodedResource* resource = new DecodedResource();
+				resource->filename = filename;
+				resource->surface  = Texture::decode(filename.c_str());
+				resource->valid    = resource->surface != NULL;
+				queueResource(load, resource);
+			}
+			load->done = true;
+		}
+
+		void uploadResource(SceneLoad* load, DecodedResource* resource)
+		{
+			if(!resource->valid)
+			{
+				Log::error("SceneManager::loadSceneAsync", "Could not read " + resource->filename);
+			}
+			else if(resource->surface)
+			{
+				int texture = Texture::create(resource->filename.c_str(), resource->surface);
+				resource->surface = NULL;
+				if(texture != -1) load->textures.push_back(texture);
+			}
 			else
-				Log::error("SceneManager::removeGameObject", "Could not remove node");
+			{
+				int geometry = Geometry::create(resource->filename.c_str(), &resource->geometry);
+				if(geometry != -1) load->geometries.push_back(geometry);
+			}
 		}
 
-		bool markForDeletion(Node nodeToMark)
+		// Joins the worker and drops the references the load held, objects created so far stay
+		void finishSceneLoad()
 		{
-			// Check for doubles
-			for(Node node : removableNodes)
+			SceneLoad* load = sceneLoad;
+			if(!load) return;
+			if(load->worker.joinable()) load->worker.join();
+			LoadProfiler::end();
+			for(DecodedResource* resource : load->queue)
 			{
-				if(node == nodeToMark)
-					return false;
+				if(resource->surface) SDL_FreeSurface(resource->surface);
+				Geometry::freeFileData(&resource->geometry);
+				delete resource;
 			}
-			removableNodes.push_back(nodeToMark);
-			return true;
+			for(int geometry : load->geometries) Geometry::remove(geometry);
+			for(int texture : load->textures)    Texture::remove(texture);
+			delete load;
+			sceneLoad = NULL;
 		}
 	}
 	
@@ -68,7 +570,10 @@ namespace SceneManager
 		if(gameObject)
 		{
 			if(markForDeletion(node))
+			{
+				markChildrenForDeletion(gameObject);
 				Log::message(gameObject->name + " marked for removal");
+			}
 			else
 				Log::message(gameObject->name + " already marked for removal");
 			
@@ -85,7 +590,10 @@ namespace SceneManager
 		if(gameObject)
 		{
 			if(markForDeletion(gameObject->node))
+			{
+				markChildrenForDeletion(gameObject);
 				Log::message(name + " marked for removal");
+			}
 			else
 				Log::message(name + " already marked for removal");
 			
@@ -100,76 +608,182 @@ namespace SceneManager
 	GameObject* find(const std::string& name)
 	{
 		GameObject* gameObject = NULL;
-		for(Node node : validNodes)
-		{
-			GameObject* temp = &sceneObjects[node];
-			if(name == temp->name)
-			{
-				gameObject = temp;
-				break;
-			}
-		}
+		const std::vector<Node>* bucket = getIndexBucket(nameIndex, name);
+		if(bucket && !bucket->empty()) gameObject = lookup(bucket->front());
 		if(!gameObject) Log::warning("Gameobject '" + name + "' not found in scene");
 		return gameObject;
 	}
 
-	GameObject* find(Node nodeToFind)
+	GameObject* findByTag(const std::string& tag)
 	{
-		GameObject* gameObject = NULL;		
-		for(Node node : validNodes)
+		GameObject* gameObject = NULL;
+		const std::vector<Node>* bucket = getIndexBucket(tagIndex, tag);
+		if(bucket && !bucket->empty()) gameObject = lookup(bucket->front());
+		return gameObject;
+	}
+
+	int findAllByTag(const std::string& tag, std::vector<GameObject*>* gameObjects)
+	{
+		PA_ASSERT(gameObjects);
+		int count = 0;
+		const std::vector<Node>* bucket = getIndexBucket(tagIndex, tag);
+		if(bucket)
 		{
-			if(node == nodeToFind)
+			gameObjects->reserve(gameObjects->size() + bucket->size());
+			for(Node node : *bucket)
 			{
-				gameObject = &sceneObjects[node];
-				break;
+				GameObject* gameObject = lookup(node);
+				if(gameObject)
+				{
+					gameObjects->push_back(gameObject);
+					count++;
+				}
 			}
 		}
-		if(!gameObject) Log::warning("GO " + std::to_string(nodeToFind) + " not found in scene");
-		return gameObject;
+		return count;
+	}
+
+	void rename(GameObject* gameObject, const std::string& name)
+	{
+		PA_ASSERT(gameObject);
+		if(name.size() > 0)
+		{
+			removeFromIndex(nameIndex, &NodeSlot::nameSlot, gameObject->name, gameObject->node);
+			gameObject->name = name;
+			addToIndex(nameIndex, &NodeSlot::nameSlot, gameObject->name, gameObject->node);
+			markDirty(gameObject->node);
+		}
+		else
+		{
+			Log::error("SceneManager::rename", "Invalid name");
+		}
+	}
+
+	void setTag(GameObject* gameObject, const std::string& tag)
+	{
+		PA_ASSERT(gameObject);
+		removeFromIndex(tagIndex, &NodeSlot::tagSlot, gameObject->tag, gameObject->node);
+		gameObject->tag = tag;
+		addToIndex(tagIndex, &NodeSlot::tagSlot, gameObject->tag, gameObject->node);
+		markDirty(gameObject->node);
+	}
+
+	void markDirty(Node node)
+	{
+		int32_t index = nodeIndex(node);
+		if(node < 0 || index >= (int32_t)nodeSlots.size()) return;
+		NodeSlot& slot = nodeSlots[index];
+		if(slot.dirtySlot != -1 || slot.denseIndex == -1 || slot.generation != nodeGeneration(node)) return;
+		slot.dirtySlot = (int32_t)dirtyNodes.size();
+		dirtyNodes.push_back(node);
+	}
+
+	GameObject* find(Node nodeToFind)
+	{
+		return lookup(nodeToFind);
 	}
 
 	void update()
 	{
+		if(sceneLoad) updateSceneLoad();
+		if(autosaveWrite && autosaveWrite->done) finishAutosave();
+		if(autosaveInterval > 0.f &&
+		   std::chrono::steady_clock::now() - lastAutosave >= std::chrono::duration<float>(autosaveInterval))
+		{
+			autosave(autosaveFile);
+		}
+		
 		//Remove Marked GOs, if any
-		if(removableNodes.size() > 0)
+		if(removableNodes.empty()) return;
+
+		// Objects marked while this runs, e.g. by script destructors, are left for the next update
+		drainingNodes.swap(removableNodes);
+		// Each component type is removed as one batch. Component removal doesn't run scripts
+		// so the objects can't move until scripts are released, after that they are looked up again.
+		drainingObjects.clear();
+		for(Node node : drainingNodes)
+		{
+			GameObject* gameObject = lookup(node);
+			if(gameObject) drainingObjects.push_back(gameObject);
+		}
+		for(int i = 1; i < (int)Component::NUM_COMPONENTS; i++)
+			GO::removeComponents(drainingObjects, (Component)i);
+		drainingObjects.clear();
+		for(Node node : drainingNodes)
 		{
-			for(Node node : removableNodes)
-		    {
-				GameObject* gameObject = find(node);
-				removeGameObject(gameObject);
-			}			
-			removableNodes.clear();
+			GameObject* gameObject = lookup(node);
+			if(gameObject) ScriptEngine::unRegisterGameObject(gameObject);
 		}
+		for(Node node : drainingNodes)
+		{
+			GameObject* gameObject = lookup(node);
+			if(gameObject) retireGameObject(gameObject);
+		}
+		drainingNodes.clear();
 	}
 
 	void cleanup()
 	{
+		if(sceneLoad)
+		{
+			sceneLoad->cancelled = true;
+			finishSceneLoad();
+		}
 		for(Node node : validNodes)
 			markForDeletion(node);
 		
 		update();
 		sceneObjects.clear();
 		removableNodes.clear();
+		drainingNodes.clear();
+		removalMarks.assign(removalMarks.size(), false);
 		validNodes.clear();
+		componentRows.clear();
 		emptyIndices.clear();
+		internedStrings.clear();
+		nameIndex.clear();
+		tagIndex.clear();
+		// Nodes are not reused across scenes, the next autosave writes the file from scratch
+		finishAutosave();
+		dirtyNodes.clear();
+		removedNodes.clear();
+		savedNodes.clear();
+		savedHashes.clear();
+		autosaveFull = true;
 	}
 
-	unsigned int createNewIndex()
+	Node createNewNode()
 	{
-		unsigned int index = 0;
+		int32_t index = 0;
 		if(!emptyIndices.empty())
 		{
 			index = emptyIndices.back();
 			emptyIndices.pop_back();
-			validNodes.push_back(index);
 		}
 		else
 		{
 			sceneObjects.push_back(GameObject());
 			index = sceneObjects.size() - 1;
-			validNodes.push_back(index);
+			PA_ASSERT(index <= NODE_INDEX_MASK);
+			// Slots survive cleanup so generations keep increasing and old nodes stay stale
+			if(index >= (int32_t)nodeSlots.size())
+			{
+				nodeSlots.push_back(NodeSlot());
+				removalMarks.push_back(false);
+			}
 		}
-		return index;
+		NodeSlot& slot = nodeSlots[index];
+		slot.denseIndex = (int32_t)validNodes.size();
+		Node node = makeNode(index, slot.generation);
+		validNodes.push_back(node);
+		componentRows.push_back(ComponentRow());
+		
+		sceneObjects[index] = GameObject();
+		sceneObjects[index].node = node;
+		addToIndex(nameIndex, &NodeSlot::nameSlot, sceneObjects[index].name, node);
+		addToIndex(tagIndex,  &NodeSlot::tagSlot,  sceneObjects[index].tag,  node);
+		markDirty(node);
+		return node;
 	}
 
 	bool writeToJSON(GameObject* gameobject, rapidjson::Writer<rapidjson::StringBuffer>& writer)
@@ -181,6 +795,12 @@ namespace SceneManager
 		writer.StartObject();
 		writer.Key("Name");	writer.String(gameobject->name.c_str(), gameobject->name.size());
 		writer.Key("Tag");  writer.String(gameobject->tag.c_str(), gameobject->tag.size());
+		writer.Key("Node"); writer.Int(gameobject->node);
+		GameObject* parent = GO::getParent(gameobject);
+		if(parent)
+		{
+			writer.Key("Parent"); writer.Int(parent->node);
+		}
 		// Scripts
 		int scriptCount = ScriptEngine::getAttachedScriptsCount(gameobject);
 		if(scriptCount > 0)
@@ -255,7 +875,7 @@ namespace SceneManager
 		{
 			writer.Key("SceneObjects");
 			writer.StartArray();
-			for(int i = 0; i < (int)validNodes.size(); i++)	writeToJSON(&sceneObjects[validNodes[i]], writer);
+			for(int i = 0; i < (int)validNodes.size(); i++)	writeToJSON(lookup(validNodes[i]), writer);
 			writer.EndArray();
 			// Renderer
 			RenderParams* renderParams = Renderer::getRenderParams();
@@ -332,6 +952,111 @@ namespace SceneManager
 		return success;
 	}
 
+	bool saveSceneBinary(const std::string& filename)
+	{
+		using namespace SceneFormat;
+		SceneData scene;
+		scene.objects.reserve(validNodes.size());
+		scene.transforms.reserve(validNodes.size());
+		for(Node node : validNodes) writeObjectToBinary(lookup(node), &scene);
+		writeSettingsToBinary(&scene.settings);
+
+		// The journal next to the file describes the old contents, autosave starts over as well
+		if(filename == autosaveFile)
+		{
+			finishAutosave();
+			autosaveFull = true;
+		}
+		std::string error;
+		bool success = SceneFormat::write(scene, filename.c_str(), &error);
+		if(success)
+		{
+			std::remove((filename + ".journal").c_str());
+			Log::message("Scene saved to '" + filename + "'");
+		}
+		else
+		{
+			Log::error("SceneManager::saveSceneBinary", error);
+		}
+		return success;
+	}
+
+	bool autosave(const std::string& filename)
+	{
+		using namespace SceneFormat;
+		if(autosaveWrite)
+		{
+			if(!autosaveWrite->done) return false;
+			finishAutosave();
+		}
+		if(filename != autosaveFile)
+		{
+			autosaveFile = filename;
+			autosaveFull = true;
+		}
+		lastAutosave = std::chrono::steady_clock::now();
+
+		AutosaveWrite* write = new AutosaveWrite();
+		write->filename = filename;
+		write->full     = autosaveFull;
+		if(write->full)
+		{
+			savedNodes.clear();
+			savedHashes.clear();
+			for(Node node : validNodes) addToAutosave(node, false, write);
+		}
+		else
+		{
+			for(Node node : dirtyNodes) addToAutosave(node, false, write);
+			write->removed.assign(removedNodes.begin(), removedNodes.end());
+			if(autosaveVerify)
+			{
+				int missed = 0;
+				for(Node node : validNodes)
+					if(nodeSlots[nodeIndex(node)].dirtySlot == -1 && addToAutosave(node, true, write)) missed++;
+				if(missed > 0)
+					Log::warning("SceneManager::autosave: " + std::to_string(missed) + " objects changed without being marked dirty");
+			}
+		}
+		// Snapshot taken, changes from here on go into the next autosave
+		for(Node node : dirtyNodes) nodeSlots[nodeIndex(node)].dirtySlot = -1;
+		dirtyNodes.clear();
+		removedNodes.clear();
+		writeSettingsToBinary(&write->changes.settings);
+		if(!write->full && write->changes.objects.empty() && write->removed.empty() &&
+		   memcmp(&write->changes.settings, &savedSettings, sizeof(SettingsRecord)) == 0)
+		{
+			delete write;
+			return true;
+		}
+
+		savedSettings = write->changes.settings;
+		autosaveFull  = false;
+		autosaveWrite = write;
+		write->worker = std::thread(writeAutosave, write);
+		return true;
+	}
+
+	void setAutosave(const std::string& filename, float seconds)
+	{
+		if(filename != autosaveFile)
+		{
+			if(autosaveWrite) finishAutosave();
+			autosaveFile = filename;
+			autosaveFull = true;
+		}
+		autosaveInterval = seconds > 0.f ? seconds : 0.f;
+		lastAutosave     = std::chrono::steady_clock::now();
+	}
+
+	void setAutosaveVerify(bool verify)
+	{
+		// Hashes are only kept while verifying, the next autosave starts them over
+		if(verify && !autosaveVerify) autosaveFull = true;
+		if(!verify) savedHashes.clear();
+		autosaveVerify = verify;
+	}
+
 	bool saveGameObject(GameObject* gameobject,const std::string& filename)
 	{
 		PA_ASSERT(gameobject);
@@ -341,6 +1066,9 @@ namespace SceneManager
 		PrettyWriter<StringBuffer> writer(buffer);
 		writer.SetIndent('\t', 1);
 		success = writeToJSON(gameobject, writer);
+		// Drop a cached copy of the old file so the next createFromFile sees the changes
+		int prefab = Prefab::find(filename);
+		if(prefab != -1) Prefab::remove(prefab);
 		
 		FILE* newFile = fopen(filename.c_str(), "w+");
 		if(newFile)
@@ -365,350 +1093,303 @@ namespace SceneManager
 		return success;
 	}
 
-	GameObject* createFromJSON(const rapidjson::Value& gameobjectNode, const std::string& filename)
+	GameObject* createFromFile(const std::string& filename)
 	{
-		using namespace rapidjson;
-		bool success = true;
-		const char* error = "NONE";
-	    GameObject* gameobject = NULL;
-		if(gameobjectNode.IsObject())
-		{
-			if(gameobjectNode.HasMember("Name") && gameobjectNode["Name"].IsString())
-			{
-				const Value& name = gameobjectNode["Name"];
-				int index = createNewIndex();
-				sceneObjects[index] = GameObject();
-				gameobject = &sceneObjects[index];
-				gameobject->node = index;
-				gameobject->name = name.GetString();
-				if(gameobjectNode.HasMember("Tag") && gameobjectNode["Tag"].IsString())
-					gameobject->tag = gameobjectNode["Tag"].GetString();
-				GO::addTransform(gameobject);
-				ScriptEngine::registerGameObject(gameobject);
-				Log::message(gameobject->name + " added to scene");
-				if(gameobjectNode.HasMember("Components"))
-				{
-					const Value& componentNode = gameobjectNode["Components"];
-					if(componentNode.IsObject())
-					{
-						if(componentNode.HasMember("Transform"))
-						{
-							CTransform* transform = GO::getTransform(gameobject);
-							if(!Transform::createFromJSON(transform, componentNode["Transform"]))
-								Log::warning("Errors while initializing Transform from " + filename);
-						}
-
-						if(componentNode.HasMember("Light"))
-						{
-							CLight* light = GO::addLight(gameobject);
-							if(!Light::createFromJSON(light, componentNode["Light"]))
-								Log::warning("Errors while initializing Light from " + filename);
-						}
-
-						if(componentNode.HasMember("Camera"))
-						{
-							CCamera* camera = GO::addCamera(gameobject);
-							if(!Camera::createFromJSON(camera, componentNode["Camera"]))
-								Log::warning("Errors while initializing Camera from " + filename);
-						}
-
-						if(componentNode.HasMember("Model"))
-						{
-							CModel* model = GO::addModel(gameobject, "default.pamesh");
-							if(!Model::createFromJSON(model, componentNode["Model"]))
-								Log::warning("Errors while initializing Model from " + filename);
-						}
-
-						if(componentNode.HasMember("RigidBody"))
-						{
-							CRigidBody rigidbody = GO::addRigidbody(gameobject, NULL);
-							if(!RigidBody::createFromJSON(rigidbody, componentNode["RigidBody"]))
-								Log::warning("Errors while initializing Rigidbody from " + filename);
-						}
-					}
-					else
-					{
-						Log::warning("'Components' is not an object. No components added to " + gameobject->name);
-					}
-				}
+		// Parsed files stay cached, spawning the same object again skips the json entirely
+		int prefab = Prefab::load(filename);
+		return prefab != -1 ? Prefab::instantiate(prefab) : NULL;
+	}
 
-				if(gameobjectNode.HasMember("Scripts"))
-				{
-					const Value& scripts = gameobjectNode["Scripts"];
-					if(scripts.IsArray())
-					{
-						for(SizeType i = 0; i < scripts.Size(); i++)
-						{
-							if(scripts[i].IsString())
-								ScriptEngine::addScript(gameobject, scripts[i].GetString());
-							else
-								Log::warning("Invalid script name in " + filename);
-						}
-					}
-					else if(scripts.IsString())
-					{
-						ScriptEngine::addScript(gameobject, scripts.GetString());
-					}
-					else
-					{
-						Log::warning("Invalid value for 'Scripts' in " + filename);
-					}
-				}
-			}
-			else
+	GameObject* createFromBinary(const SceneFormat::SceneView& scene, uint32_t objectIndex, const std::string& filename)
+	{
+		using namespace SceneFormat;
+		LoadProfiler::ScopedTimer timer(LoadProfiler::LP_OBJECTS, filename.c_str());
+		const ObjectRecord& object = scene.objects[objectIndex];
+		Node        node       = createNewNode();
+		GameObject* gameobject = &sceneObjects[nodeIndex(node)];
+		rename(gameobject, scene.getString(object.name));
+		if(object.tag != NONE) setTag(gameobject, scene.getString(object.tag));
+		if(object.node != -1) loadedNodes[object.node] = node;
+		if(object.parent != -1) pendingParents.push_back(std::make_pair(node, (Node)object.parent));
+		GO::addTransform(gameobject);
+		Transform::createFromBinary(GO::getTransform(gameobject), scene.transforms[objectIndex]);
+		ScriptEngine::registerGameObject(gameobject);
+		Log::message(gameobject->name + " added to scene");
+
+		if(object.light != NONE)
+		{
+			if(!Light::createFromBinary(GO::addLight(gameobject), scene.lights[object.light]))
+				Log::warning("Errors while initializing Light from " + filename);
+		}
+		if(object.camera != NONE)
+		{
+			if(!Camera::createFromBinary(GO::addCamera(gameobject), scene.cameras[object.camera]))
+				Log::warning("Errors while initializing Camera from " + filename);
+		}
+		if(object.model != NONE)
+		{
+			// Created with its final geometry instead of a placeholder that is replaced right after
+			const ModelRecord& record   = scene.models[object.model];
+			const char*        geometry = scene.getString(record.geometry);
+			CModel* model = GO::addModel(gameobject, geometry ? geometry : "default.pamesh");
+			if(!model || !Model::createFromBinary(gameobject->compIndices[Component::MODEL], record, scene))
+				Log::warning("Errors while initializing Model from " + filename);
+		}
+		if(object.rigidBody != NONE)
+		{
+			CRigidBody rigidbody = GO::addRigidbody(gameobject, NULL);
+			if(!RigidBody::createFromBinary(rigidbody, scene.rigidBodies[object.rigidBody], scene))
+				Log::warning("Errors while initializing Rigidbody from " + filename);
+		}
+		for(uint32_t i = 0; i < object.scriptCount; i++)
+			ScriptEngine::addScript(gameobject, scene.getString(scene.scripts[object.firstScript + i]));
+		return gameobject;
+	}
+
+	// Json scenes may leave out either section, the current settings are kept for it then
+	void applySceneSettings(const SceneFormat::SettingsRecord& settings, bool renderer, bool physics)
+	{
+		if(renderer)
+		{
+			RenderParams* renderParams = Renderer::getRenderParams();
+			Vec4          clearColor;
+			for(int i = 0; i < 4; i++)
 			{
-				success = false;
-				error   = "Gameobject does not have a name";
+				renderParams->ambientLight[i] = settings.ambientLight[i];
+				renderParams->fog.color[i]    = settings.fogColor[i];
+				clearColor[i]                 = settings.clearColor[i];
 			}
+			if(settings.fogMode > -1 && settings.fogMode < 4) renderParams->fog.fogMode = settings.fogMode;
+			if(settings.fogDensity >= 0.f) renderParams->fog.density = settings.fogDensity;
+			if(settings.fogStart   >= 0.f) renderParams->fog.start   = settings.fogStart;
+			if(settings.fogMax     >= 0.f) renderParams->fog.max     = settings.fogMax;
+			Renderer::setClearColor(clearColor);
 		}
-		else
+		if(physics)
 		{
-			success = false;
-			error   = "'GameObject' should be an object";
+			Vec3 gravity;
+			for(int i = 0; i < 3; i++) gravity[i] = settings.gravity[i];
+			Physics::setGravity(gravity);
 		}
-		
-		if(!success) Log::error("SceneManager::createFromFile", error);
-		return gameobject;
 	}
 
-	GameObject* createFromFile(const std::string& filename)
+	// Logs what the json reader skipped or could not find, returns false if anything is missing
+	bool reportSceneRead(const SceneReader::Result& result, const char* function, const std::string& filename)
 	{
-		using namespace rapidjson;
+		if(!result.error.empty())
+		{
+			Log::error(function, result.error + " in " + filename);
+			return false;
+		}
 		bool success = true;
-		const char* error = "NONE";
-	    GameObject* gameobject = NULL;
-		Document document;
-		char* json = Utils::loadFileIntoCString(filename.c_str());
-		if(json)
+		if(result.skipped > 0)
 		{
-			document.Parse(json);
-			//if(document.IsObject() && document.HasMember("GameObject") && document["GameObject"].IsObject())
-			if(document.IsObject())
+			success = false;
+			Log::error(function, std::to_string(result.skipped) + " gameobjects without a name in " + filename);
+		}
+		if(!result.hasRenderer)
+		{
+			success = false;
+			Log::error(function, "Error while loading Renderer");
+		}
+		if(!result.hasPhysics)
+		{
+			success = false;
+			Log::error(function, "Error while loading Physics settings");
+		}
+		return success;
+	}
+
+	bool loadScene(const std::string& filename)
+	{
+		FILE* file = fopen(filename.c_str(), "rb");
+		if(!file)
+		{
+			Log::error("SceneManager::loadScene", "File not found");
+			return false;
+		}
+
+		// Each object is created as soon as the reader reaches its end, so only one object's
+		// records are held at a time instead of the whole file and a document built from it.
+		// Object creation runs inside the parse timer but is only counted as objects.
+		LoadProfiler::ScopedProfile profile(filename);
+		SceneFormat::SceneData scene;
+		SceneReader::Result    result;
+		{
+			LoadProfiler::ScopedTimer timer(LoadProfiler::LP_PARSE, filename.c_str());
+			SceneReader::read(file, &scene, &result, createStreamedObject, (void*)&filename);
+		}
+		fclose(file);
+		linkLoadedParents();
+		Log::message(std::to_string(result.objects) + " gameobjects loaded from " + filename);
+		if(result.error.empty()) applySceneSettings(scene.settings, result.hasRenderer, result.hasPhysics);
+		return reportSceneRead(result, "SceneManager::loadScene", filename);
+	}
+
+	void createScene(const SceneFormat::SceneView& scene, const std::string& filename)
+	{
+		uint32_t objectCount = scene.counts[SceneFormat::ST_OBJECTS];
+		reserveForScene(scene);
+		for(uint32_t i = 0; i < objectCount; i++)
+			createFromBinary(scene, i, filename);
+		linkLoadedParents();
+		applySceneSettings(*scene.settings, true, true);
+		Log::message(std::to_string(objectCount) + " gameobjects loaded from " + filename);
+	}
+
+	bool loadSceneBinary(const std::string& filename)
+	{
+		using namespace SceneFormat;
+		if(filename == autosaveFile) finishAutosave();
+		LoadProfiler::ScopedProfile profile(filename);
+		std::string error;
+		std::string journal = filename + ".journal";
+		if(Utils::fileExists(journal.c_str()))
+		{
+			// Autosaved scenes are merged with their journal in memory first
+			SceneData merged;
+			bool      success = false;
+			{
+				LoadProfiler::ScopedTimer timer(LoadProfiler::LP_PARSE, filename.c_str());
+				success = readWithJournal(filename.c_str(), journal.c_str(), &merged, &error);
+			}
+			if(success)
 			{
-				gameobject = createFromJSON(document, filename);
+				SceneView scene;
+				merged.getView(&scene);
+				createScene(scene, filename);
 			}
 			else
 			{
-				success = false;
-				error   = "Invalid document";
+				Log::error("SceneManager::loadSceneBinary", error);
 			}
-			free(json);
+			return success;
+		}
+
+		size_t      size    = 0;
+		const void* data    = NULL;
+		SceneView   scene;
+		bool        success = false;
+		{
+			// The records are used straight from the mapping, nothing is parsed or copied up front
+			LoadProfiler::ScopedTimer timer(LoadProfiler::LP_PARSE, filename.c_str());
+			data = Utils::mapFile(filename.c_str(), &size);
+			if(data) success = SceneFormat::read(data, size, &scene, &error);
 		}
+		if(!data) return false;
+		if(success)
+			createScene(scene, filename);
 		else
+			Log::error("SceneManager::loadSceneBinary", error);
+		Utils::unmapFile(data, size);
+		return success;
+	}
+
+	bool loadSceneAsync(const std::string& filename)
+	{
+		if(sceneLoad)
 		{
-			success = false;
-			error   = "File not found";
+			Log::error("SceneManager::loadSceneAsync", "Already loading " + sceneLoad->filename);
+			return false;
 		}
-		if(!success) Log::error("SceneManager::createFromFile", error);
-		return gameobject;
+		if(!Utils::fileExists(filename.c_str()))
+		{
+			Log::error("SceneManager::loadSceneAsync", "File not found");
+			return false;
+		}
+		// Ended by finishSceneLoad, the worker's timers count towards it as well
+		LoadProfiler::begin(filename);
+		sceneLoad = new SceneLoad();
+		sceneLoad->filename = filename;
+		sceneLoad->worker   = std::thread(readScene, sceneLoad);
+		Log::message("Loading " + filename + " in the background");
+		return true;
 	}
 
-	bool loadScene(const std::string& filename)
+	void updateSceneLoad()
 	{
-		using namespace rapidjson;
-		bool success = true;
-		const char* error = "Invalid field";
-		char* json = Utils::loadFileIntoCString(filename.c_str());
-		if(json)
+		typedef std::chrono::steady_clock Clock;
+		SceneLoad*        load     = sceneLoad;
+		Clock::time_point deadline = Clock::now() + std::chrono::microseconds((long long)(loadBudget * 1000.f));
+		// Read before draining, everything the worker queued is in the queue once done is set
+		bool workerDone = load->done;
+		while(true)
 		{
-			Document document;
-			document.Parse(json);
-			if(document.IsObject() && document.HasMember("Scene") && document["Scene"].IsObject())
+			DecodedResource* resource = NULL;
 			{
-				const Value& sceneNode = document["Scene"];
-				// Load all gameobjects
-				if(sceneNode.HasMember("SceneObjects") && sceneNode["SceneObjects"].IsArray())
-				{
-					const Value& sceneObjects = sceneNode["SceneObjects"];
-					int loaded = 0;
-					for(unsigned int i = 0; i < sceneObjects.Size(); i++)
-					{
-						if(sceneObjects[i].IsObject())
-						{
-							if(createFromJSON(sceneObjects[i], filename))
-								loaded++;
-						}
-						else
-						{
-							success = false;
-						}
-					}
-					Log::message(std::to_string(loaded) + " gameobjects loaded from " + filename);
-				}
-
-				// Set Renderer settings
-				if(sceneNode.HasMember("Renderer") && sceneNode["Renderer"].IsObject())
+				std::lock_guard<std::mutex> lock(load->queueMutex);
+				if(!load->queue.empty())
 				{
-					RenderParams* renderParams = Renderer::getRenderParams();
-					const Value&  rendererNode = sceneNode["Renderer"];
-
-					if(rendererNode.HasMember("AmbientLight") && rendererNode["AmbientLight"].IsArray())
-					{
-						const Value& colorNode = rendererNode["AmbientLight"];
-						int items = colorNode.Size() < 4 ? colorNode.Size() : 4;
-						for(int i = 0; i < items; i++)
-						{
-							if(colorNode[i].IsNumber())
-								renderParams->ambientLight[i] = (float)colorNode[i].GetDouble();
-							else
-								success = false;
-						}
-					}
-					else
-					{
-						success = false;
-						Log::error("SceneManger::loadScene", "Error while loading Renderer.AmbientLight");
-					}
-
-					if(rendererNode.HasMember("ClearColor") && rendererNode["ClearColor"].IsArray())
-					{
-						const Value& clearColorNode = rendererNode["ClearColor"];
-						int items = clearColorNode.Size() < 4 ? clearColorNode.Size() : 4;
-						Vec4 clearColor = Renderer::getClearColor();
-						for(int i = 0; i < items; i++)
-						{
-							if(clearColorNode[i].IsNumber())
-								clearColor[i] = (float)clearColorNode[i].GetDouble();
-							else
-								success = false;
-						}
-						Renderer::setClearColor(clearColor);
-					}
-					else
-					{
-						success = false;
-						Log::error("SceneManger::loadScene", "Error while loading Renderer.ClearColor");
-					}
-					
-					if(rendererNode.HasMember("Fog") && rendererNode["Fog"].IsObject())
-					{
-						const Value& fogNode = rendererNode["Fog"];
-						if(fogNode.HasMember("FogMode") && fogNode["FogMode"].IsInt())
-						{
-							int mode = fogNode["FogMode"].GetInt();
-							if(mode > -1 && mode < 4)
-								renderParams->fog.fogMode = mode;
-							else
-								success = false;
-						}
-						else
-						{
-							success = false;
-							Log::error("SceneManger::loadScene", "Error while loading Fog.FogMode");
-						}
-
-						if(fogNode.HasMember("Density") && fogNode["Density"].IsDouble())
-						{
-							float density = (float)fogNode["Density"].GetDouble();
-							if(density >= 0.f)
-								renderParams->fog.density = density;
-							else
-								success = false;
-						}
-						else
-						{
-							success = false;
-							Log::error("SceneManger::loadScene", "Error while loading Fog.Density");
-						}
-
-						if(fogNode.HasMember("Start") && fogNode["Start"].IsDouble())
-						{
-							float start = (float)fogNode["Start"].GetDouble();
-							if(start >= 0)
-								renderParams->fog.start = start;
-							else
-								success = false;
-						}
-						else
-						{
-							success = false;
-							Log::error("SceneManger::loadScene", "Error while loading Fog.Start");
-						}
-
-						if(fogNode.HasMember("Max") && fogNode["Max"].IsDouble())
-						{
-							float max = (float)fogNode["Max"].GetDouble();
-							if(max >= 0)
-								renderParams->fog.max = max;
-							else
-								success = false;
-						}
-						else
-						{
-							success = false;
-							Log::error("SceneManger::loadScene", "Error while loading Fog.max");
-						}
-
-						if(fogNode.HasMember("Color") && fogNode["Color"].IsArray())
-						{
-							const Value& colorNode = fogNode["Color"];
-							int items = colorNode.Size() < 4 ? colorNode.Size() : 4;
-							for(int i = 0; i < items; i++)
-							{
-								if(colorNode[i].IsNumber())
-									renderParams->fog.color[i] = (float)colorNode[i].GetDouble();
-								else
-									success = false;
-							}
-						}
-						else
-						{
-							success = false;
-							Log::error("SceneManger::loadScene", "Error while loading Fog.Color");
-						}
-					}
+					resource = load->queue.front();
+					load->queue.pop_front();
 				}
-				else
-				{
-					success = false;
-					Log::error("SceneManger::loadScene", "Error while loading Renderer");
-				}
-				
-				// Physics settings
-				if(sceneNode.HasMember("Physics") && sceneNode["Physics"].IsObject())
-				{
-					const Value& physicsNode = sceneNode["Physics"];
-					if(physicsNode.HasMember("Gravity") && physicsNode["Gravity"].IsArray())
-					{
-						const Value& gravityNode = physicsNode["Gravity"];
-						int items = gravityNode.Size() < 3 ? gravityNode.Size() : 3;
-						Vec3 gravity = Physics::getGravity();
-						for(int i = 0; i < items; i++)
-						{
-							if(gravityNode[i].IsNumber())
-								gravity[i] = (float)gravityNode[i].GetDouble();
-							else
-								success = false;
-						}
-						Physics::setGravity(gravity);
-					}
-					else
-					{
-						success = false;
-						Log::error("SceneManger::loadScene", "Error while loading gravity");
-					}
-				}
-				else
-				{
-					success = false;
-					Log::error("SceneManger::loadScene", "Error while loading Physics settings");
-				}
-			}
-			else
-			{
-				success = false;
-				error   = "Invalid document format";
 			}
-			free(json);
+			if(!resource) break;
+			uploadResource(load, resource);
+			delete resource;
+			load->uploaded++;
+			if(Clock::now() >= deadline) return;
 		}
-		else
+		if(!workerDone) return;
+
+		if(!load->valid)
 		{
-			success = false;
-			error   = "File not found";
+			reportSceneRead(load->result, "SceneManager::loadSceneAsync", load->filename);
+			finishSceneLoad();
+			return;
 		}
-	
-		if(!success) Log::error("SceneManager::loadScene", error);
-		return success;
+
+		// Objects are created in order, scripts are compiled here as well since the script
+		// engine only runs on this thread. Parent links wait until every object exists.
+		SceneFormat::SceneView scene;
+		load->scene.getView(&scene);
+		int objectCount = (int)load->scene.objects.size();
+		if(!load->reserved)
+		{
+			reserveForScene(scene);
+			load->reserved = true;
+		}
+		loadedNodes.swap(load->loadedNodes);
+		pendingParents.swap(load->pendingParents);
+		bool outOfTime = false;
+		while(load->nextObject < objectCount && !outOfTime)
+		{
+			createFromBinary(scene, (uint32_t)load->nextObject++, load->filename);
+			outOfTime = Clock::now() >= deadline;
+		}
+		if(load->nextObject < objectCount)
+		{
+			loadedNodes.swap(load->loadedNodes);
+			pendingParents.swap(load->pendingParents);
+			return;
+		}
+		linkLoadedParents();
+		Log::message(std::to_string(objectCount) + " gameobjects loaded from " + load->filename);
+
+		applySceneSettings(load->scene.settings, load->result.hasRenderer, load->result.hasPhysics);
+		reportSceneRead(load->result, "SceneManager::loadSceneAsync", load->filename);
+		finishSceneLoad();
+	}
+
+	bool isLoading()
+	{
+		return sceneLoad != NULL;
+	}
+
+	float getLoadProgress()
+	{
+		if(!sceneLoad) return 1.f;
+		// Until the worker has parsed the file the amount of work is unknown
+		int resources = sceneLoad->resourceCount;
+		if(resources < 0) return 0.f;
+		int total = resources + sceneLoad->objectCount;
+		if(total == 0) return 0.f;
+		return (float)(sceneLoad->uploaded + sceneLoad->nextObject) / (float)total;
+	}
+
+	void setLoadBudget(float milliseconds)
+	{
+		loadBudget = milliseconds > 0.f ? milliseconds : 0.f;
 	}
 
 	GameObject* create(const std::string& name)
@@ -716,10 +1397,9 @@ namespace SceneManager
 		GameObject* newObj = NULL;
 		if(name.size() > 0)
 		{
-			unsigned int index = createNewIndex();
-			newObj = &sceneObjects[index];
-			newObj->name = name;
-			newObj->node = index;
+			Node node = createNewNode();
+			newObj = &sceneObjects[nodeIndex(node)];
+			rename(newObj, name);
 			GO::addTransform(newObj);
 			ScriptEngine::registerGameObject(newObj);
 			Log::message(name + " added to scene");
@@ -731,11 +1411,64 @@ namespace SceneManager
 		return newObj;
 	}
 
+	void reserve(int count)
+	{
+		if(count <= 0) return;
+		// Grow at least geometrically so many small reservations stay linear overall
+		if(validNodes.size() + count > validNodes.capacity())
+		{
+			size_t capacity = std::max(validNodes.size() + count, validNodes.capacity() * 2);
+			validNodes.reserve(capacity);
+			componentRows.reserve(capacity);
+		}
+		// Recycled slots don't need room
+		int newSlots = count - (int)emptyIndices.size();
+		if(newSlots <= 0) return;
+		if(sceneObjects.size() + newSlots > sceneObjects.capacity())
+		{
+			size_t capacity = std::max(sceneObjects.size() + newSlots, sceneObjects.capacity() * 2);
+			sceneObjects.reserve(capacity);
+			nodeSlots.reserve(capacity);
+			removalMarks.reserve(capacity);
+		}
+	}
+
 	std::vector<Node>* getSceneObjects()
 	{
 		return &validNodes;
 	}
 
+	const ComponentRow* getComponentRows()
+	{
+		return componentRows.data();
+	}
+
+	void updateSignature(GameObject* gameObject)
+	{
+		PA_ASSERT(gameObject);
+		int32_t denseIndex = nodeSlots[nodeIndex(gameObject->node)].denseIndex;
+		if(denseIndex == -1) return;
+		ComponentRow& row = componentRows[denseIndex];
+		row.signature = gameObject->signature;
+		for(int i = 0; i < (int)Component::NUM_COMPONENTS; i++)
+			row.indices[i] = gameObject->compIndices[i];
+	}
+
+	int findAllWith(ComponentMask mask, std::vector<GameObject*>* gameObjects)
+	{
+		PA_ASSERT(gameObjects);
+		int count = 0;
+		for(size_t i = 0; i < componentRows.size(); i++)
+		{
+			if((componentRows[i].signature & mask) == mask)
+			{
+				gameObjects->push_back(&sceneObjects[nodeIndex(validNodes[i])]);
+				count++;
+			}
+		}
+		return count;
+	}
+
 	bool removeByName(const std::string& name)
 	{
 		return remove(name);
@@ -756,6 +1489,39 @@ namespace SceneManager
 		return find(node);
 	}
 
+	CScriptArray* findAllByTagScript(const std::string& tag)
+	{
+		if(!gameObjectArrayType)
+		{
+			asIScriptEngine* engine = ScriptEngine::getEngine();
+			gameObjectArrayType = engine->GetObjectTypeById(engine->GetTypeIdByDecl("array<GameObject@>"));
+		}
+		std::vector<GameObject*> gameObjects;
+		findAllByTag(tag, &gameObjects);
+		CScriptArray* array = CScriptArray::Create(gameObjectArrayType, (asUINT)gameObjects.size());
+		for(asUINT i = 0; i < (asUINT)gameObjects.size(); i++)
+			*((GameObject**)array->At(i)) = gameObjects[i];
+		return array;
+	}
+
+	CScriptArray* findAllWithScript(const CScriptArray& components)
+	{
+		if(!gameObjectArrayType)
+		{
+			asIScriptEngine* engine = ScriptEngine::getEngine();
+			gameObjectArrayType = engine->GetObjectTypeById(engine->GetTypeIdByDecl("array<GameObject@>"));
+		}
+		ComponentMask mask = 0;
+		for(asUINT i = 0; i < components.GetSize(); i++)
+			mask |= componentBit(*((const Component*)components.At(i)));
+		std::vector<GameObject*> gameObjects;
+		findAllWith(mask, &gameObjects);
+		CScriptArray* array = CScriptArray::Create(gameObjectArrayType, (asUINT)gameObjects.size());
+		for(asUINT i = 0; i < (asUINT)gameObjects.size(); i++)
+			*((GameObject**)array->At(i)) = gameObjects[i];
+		return array;
+	}
+
 	void generateBindings()
 	{
 		asIScriptEngine* engine = ScriptEngine::getEngine();
@@ -777,6 +1543,18 @@ namespace SceneManager
 											asFUNCTIONPR(find, (Node), GameObject*),
 											asCALL_CDECL);
 		PA_ASSERT(rc >= 0);
+		rc = engine->RegisterGlobalFunction("GameObject@ findByTag(const string &in)",
+											asFUNCTION(findByTag),
+											asCALL_CDECL);
+		PA_ASSERT(rc >= 0);
+		rc = engine->RegisterGlobalFunction("array<GameObject@>@ findAllByTag(const string &in)",
+											asFUNCTION(findAllByTagScript),
+											asCALL_CDECL);
+		PA_ASSERT(rc >= 0);
+		rc = engine->RegisterGlobalFunction("array<GameObject@>@ findAllWith(const array<Component> &in)",
+											asFUNCTION(findAllWithScript),
+											asCALL_CDECL);
+		PA_ASSERT(rc >= 0);
 		rc = engine->RegisterGlobalFunction("GameObject@ create(const string)",
 											asFUNCTION(create),
 											asCALL_CDECL);
@@ -789,6 +1567,46 @@ namespace SceneManager
 											asFUNCTION(loadScene),
 											asCALL_CDECL);
 		PA_ASSERT(rc >= 0);
+		rc = engine->RegisterGlobalFunction("bool loadSceneBinary(const string &in)",
+											asFUNCTION(loadSceneBinary),
+											asCALL_CDECL);
+		PA_ASSERT(rc >= 0);
+		rc = engine->RegisterGlobalFunction("bool saveSceneBinary(const string &in)",
+											asFUNCTION(saveSceneBinary),
+											asCALL_CDECL);
+		PA_ASSERT(rc >= 0);
+		rc = engine->RegisterGlobalFunction("bool autosave(const string &in)",
+											asFUNCTION(autosave),
+											asCALL_CDECL);
+		PA_ASSERT(rc >= 0);
+		rc = engine->RegisterGlobalFunction("void setAutosave(const string &in, float)",
+											asFUNCTION(setAutosave),
+											asCALL_CDECL);
+		PA_ASSERT(rc >= 0);
+		rc = engine->RegisterGlobalFunction("void setAutosaveVerify(bool)",
+											asFUNCTION(setAutosaveVerify),
+											asCALL_CDECL);
+		PA_ASSERT(rc >= 0);
+		rc = engine->RegisterGlobalFunction("void markDirty(int32)",
+											asFUNCTION(markDirty),
+											asCALL_CDECL);
+		PA_ASSERT(rc >= 0);
+		rc = engine->RegisterGlobalFunction("bool loadSceneAsync(const string &in)",
+											asFUNCTION(loadSceneAsync),
+											asCALL_CDECL);
+		PA_ASSERT(rc >= 0);
+		rc = engine->RegisterGlobalFunction("bool isLoading()",
+											asFUNCTION(isLoading),
+											asCALL_CDECL);
+		PA_ASSERT(rc >= 0);
+		rc = engine->RegisterGlobalFunction("float getLoadProgress()",
+											asFUNCTION(getLoadProgress),
+											asCALL_CDECL);
+		PA_ASSERT(rc >= 0);
+		rc = engine->RegisterGlobalFunction("void setLoadBudget(float)",
+											asFUNCTION(setLoadBudget),
+											asCALL_CDECL);
+		PA_ASSERT(rc >= 0);
 		rc = engine->RegisterGlobalFunction("bool saveGameObject(GameObject@, const string &in)",
 											asFUNCTION(saveGameObject),
 											asCALL_CDECL);
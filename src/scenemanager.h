@@ -5,20 +5,54 @@
 #include <vector>
 
 #include "datatypes.h"
+#include "componentTypes.h"
 
 struct GameObject;
 
 namespace SceneManager
 {
+	// Copy of a live object's signature and component indices. Rows are packed in the
+	// same order as getSceneObjects so systems can scan them without touching GameObjects.
+	struct ComponentRow
+	{
+		ComponentMask signature = 0;
+		int32_t       indices[NUM_COMPONENTS] = {-1, -1, -1, -1, -1, -1};
+	};
+
 	bool remove(const std::string& name);
 	bool remove(Node node);
 	bool loadScene(const std::string& filename);
+	// Reads the file and its geometry and textures on a worker thread, update then uploads them
+	// and creates the objects within the load budget. Only one scene loads at a time.
+	bool  loadSceneAsync(const std::string& filename);
+	bool  isLoading();
+	float getLoadProgress();                   // 0 to 1, 1 when nothing is loading
+	void  setLoadBudget(float milliseconds);   // Main thread time per update, default 4
 	bool saveScene(const std::string& filename);
+	// Same scene in the .pascene format, see sceneformat.h. Loading maps the file and
+	// creates objects straight from its records.
+	bool loadSceneBinary(const std::string& filename);
+	bool saveSceneBinary(const std::string& filename);
+	// Incremental .pascene saving. Only objects marked dirty since the previous autosave to the
+	// same file are copied, a worker appends them to filename.journal and merges the journal
+	// back into the file once it outgrows it. loadSceneBinary applies a journal it finds.
+	// Returns false if the previous autosave is still being written.
+	bool autosave(const std::string& filename);
+	void setAutosave(const std::string& filename, float seconds); // Autosave from update, 0 turns it off
+	void setAutosaveVerify(bool verify); // Also hash every object to catch changes that were not marked, off by default
+	// Transform flushes, component add and remove, component setters and editor edits call this,
+	// code changing saved fields directly has to as well. Stale nodes are ignored.
+	void markDirty(Node node);
 	bool saveGameObject(GameObject* gameobject, const std::string& filename);
 	
 	GameObject* find(const std::string& name);
 	GameObject* find(Node node);
+	GameObject* findByTag(const std::string& tag);
+	int         findAllByTag(const std::string& tag, std::vector<GameObject*>* gameObjects); // Appends matches, returns count
+	void        rename(GameObject* gameObject, const std::string& name);
+	void        setTag(GameObject* gameObject, const std::string& tag);
 	GameObject* create(const std::string& name);
+	void        reserve(int count); // Makes room for count more objects, existing GameObject pointers may move
 	GameObject* createFromFile(const std::string& name);
 		
 	void update();
@@ -26,6 +60,57 @@ namespace SceneManager
 	void generateBindings();
 
 	std::vector<Node>* getSceneObjects();
+	const ComponentRow* getComponentRows(); // One per entry of getSceneObjects
+	void        updateSignature(GameObject* gameObject); // Called by GO whenever a component is added or removed
+	int         findAllWith(ComponentMask mask, std::vector<GameObject*>* gameObjects); // Appends matches, returns count
+
+	// Walks the packed rows of every object that has at least the given components:
+	//     for(auto entry : SceneManager::view<Component::TRANSFORM, Component::MODEL>())
+	// entry[Component::MODEL] is then the model index of that object. Removals are deferred
+	// so removing objects while iterating is fine, creating them is not since the rows may move.
+	template<Component... Types>
+	class View
+	{
+	public:
+		static const ComponentMask mask = componentMask(Types...);
+
+		struct Entry
+		{
+			Node                node;
+			const ComponentRow* row;
+			int32_t operator[](Component type) const { return row->indices[type]; }
+		};
+
+		class Iterator
+		{
+		public:
+			Iterator(const Node* node, const ComponentRow* row, const ComponentRow* end)
+				: node(node), row(row), end(end) { skip(); }
+			Entry     operator*() const                  { return Entry{*node, row};    }
+			Iterator& operator++()                       { node++; row++; skip(); return *this; }
+			bool      operator!=(const Iterator& other) const { return row != other.row; }
+		private:
+			void skip() { while(row != end && (row->signature & mask) != mask) { node++; row++; } }
+			const Node*         node;
+			const ComponentRow* row;
+			const ComponentRow* end;
+		};
+
+		View() : nodes(getSceneObjects()->data()), rows(getComponentRows()), count((int)getSceneObjects()->size()) {}
+		Iterator begin() const { return Iterator(nodes, rows, rows + count);                 }
+		Iterator end()   const { return Iterator(nodes + count, rows + count, rows + count); }
+
+	private:
+		const Node*         nodes;
+		const ComponentRow* rows;
+		int                 count;
+	};
+
+	template<Component... Types>
+	View<Types...> view()
+	{
+		return View<Types...>();
+	}
 }
 
 #endif
@@ -0,0 +1,521 @@
+#include "scenereader.h"
+
+#include "../include/rapidjson/reader.h"
+#include "../include/rapidjson/filereadstream.h"
+#include "../include/rapidjson/error/en.h"
+
+namespace SceneReader
+{
+	namespace
+	{
+		using namespace SceneFormat;
+
+		const size_t BUFFER_SIZE = 64 * 1024;
+
+		// What the object being read is, decided by the key it was found under
+		enum Context
+		{
+			CX_DOCUMENT = 0,
+			CX_SCENE,
+			CX_OBJECT,
+			CX_COMPONENTS,
+			CX_TRANSFORM,
+			CX_MODEL,
+			CX_UNIFORMS,
+			CX_LIGHT,
+			CX_CAMERA,
+			CX_RIGIDBODY,
+			CX_SHAPE,
+			CX_RENDERER,
+			CX_FOG,
+			CX_PHYSICS,
+			CX_IGNORED   // Unknown keys, everything below them is skipped
+		};
+
+		enum ArrayType
+		{
+			AT_NONE = 0, // Frame is an object
+			AT_OBJECTS,
+			AT_SCRIPTS,
+			AT_FLOATS,
+			AT_IGNORED
+		};
+
+		struct Frame
+		{
+			Context   context  = CX_IGNORED;
+			ArrayType array    = AT_NONE;
+			float*    values   = NULL; // AT_FLOATS only
+			int       capacity = 0;
+			int       count    = 0;
+		};
+
+		// The meaning of the shape parameters depends on the type, which may come after them,
+		// so they are collected here first. Defaults match the collision shape constructors.
+		struct ShapeFields
+		{
+			int32_t type       = 0;
+			float   radius     = 1.f;
+			float   height     = 2.f;
+			float   margin     = 0.001f;
+			float   halfExt[3] = {0.5f, 0.5f, 0.5f};
+			float   normal[3]  = {0.f, 1.f, 0.f};
+			float   axis[3]    = {0.f, 1.f, 0.f};
+			int32_t geometry   = NONE;
+		};
+
+		class SceneHandler : public rapidjson::BaseReaderHandler<rapidjson::UTF8<>, SceneHandler>
+		{
+		public:
+			SceneHandler(SceneData* scene, Result* result, ObjectCallback callback, void* userData)
+				: scene(scene), result(result), callback(callback), userData(userData) {}
+
+			bool Null()              { return value(); }
+			bool Bool(bool b)        { return value() && boolean(b); }
+			bool Int(int i)          { return value() && number((double)i, true); }
+			bool Uint(unsigned u)    { return value() && number((double)u, u <= INT32_MAX); }
+			bool Int64(int64_t i)    { return value() && number((double)i, false); }
+			bool Uint64(uint64_t u)  { return value() && number((double)u, false); }
+			bool Double(double d)    { return value() && number(d, false); }
+
+			bool String(const char* str, rapidjson::SizeType length, bool)
+			{
+				return value() && string(str, length);
+			}
+
+			bool Key(const char* str, rapidjson::SizeType length, bool)
+			{
+				key.assign(str, length);
+				return true;
+			}
+
+			bool StartObject()
+			{
+				Frame frame;
+				if(frames.empty())
+				{
+					frame.context = CX_DOCUMENT;
+				}
+				else if(frames.back().array != AT_NONE)
+				{
+					if(frames.back().array == AT_OBJECTS)
+					{
+						frame.context = CX_OBJECT;
+						beginObject();
+					}
+				}
+				else
+				{
+					frame.context = childContext(frames.back().context);
+				}
+				frames.push_back(frame);
+				return true;
+			}
+
+			bool EndObject(rapidjson::SizeType)
+			{
+				Context context = frames.back().context;
+				frames.pop_back();
+				if(context == CX_SHAPE)  endShape();
+				if(context == CX_OBJECT) endObject();
+				return true;
+			}
+
+			bool StartArray()
+			{
+				if(frames.empty()) return fail("Invalid document format");
+				Frame frame;
+				frame.array = AT_IGNORED;
+				if(frames.back().array == AT_NONE)
+				{
+					Context context = frames.back().context;
+					if(context == CX_SCENE && key == "SceneObjects")
+						frame.array = AT_OBJECTS;
+					else if(context == CX_OBJECT && key == "Scripts")
+						frame.array = AT_SCRIPTS;
+					else if((frame.values = floatArray(context, &frame.capacity)) != NULL)
+						frame.array = AT_FLOATS;
+				}
+				frames.push_back(frame);
+				return true;
+			}
+
+			bool EndArray(rapidjson::SizeType)
+			{
+				frames.pop_back();
+				return true;
+			}
+
+			bool        hasScene = false;
+			std::string error;
+
+		private:
+			SceneData*         scene;
+			Result*            result;
+			ObjectCallback     callback;
+			void*              userData;
+			std::vector<Frame> frames;
+			std::string        key;
+			// The object being read
+			ObjectRecord       object;
+			TransformRecord    transform;
+			ModelRecord        model;
+			LightRecord        light;
+			CameraRecord       camera;
+			RigidBodyRecord    rigidBody;
+			ShapeFields        shape;
+			bool               hasName, hasModel, hasLight, hasCamera, hasRigidBody;
+
+			bool fail(const char* message)
+			{
+				error = message;
+				return false;
+			}
+
+			// Scalars are only valid inside a container
+			bool value()
+			{
+				return !frames.empty() || fail("Invalid document format");
+			}
+
+			Context childContext(Context parent)
+			{
+				switch(parent)
+				{
+				case CX_DOCUMENT:
+					if(key == "Scene")
+					{
+						hasScene = true;
+						return CX_SCENE;
+					}
+					break;
+				case CX_SCENE:
+					if(key == "Renderer")
+					{
+						result->hasRenderer = true;
+						return CX_RENDERER;
+					}
+					if(key == "Physics")
+					{
+						result->hasPhysics = true;
+						return CX_PHYSICS;
+					}
+					break;
+				case CX_OBJECT:
+					if(key == "Components") return CX_COMPONENTS;
+					break;
+				case CX_COMPONENTS:
+					if(key == "Transform") return CX_TRANSFORM;
+					if(key == "Model")     { hasModel     = true; return CX_MODEL; }
+					if(key == "Light")     { hasLight     = true; return CX_LIGHT; }
+					if(key == "Camera")    { hasCamera    = true; return CX_CAMERA; }
+					if(key == "RigidBody") { hasRigidBody = true; return CX_RIGIDBODY; }
+					break;
+				case CX_MODEL:
+					if(key == "MaterialUniforms") return CX_UNIFORMS;
+					break;
+				case CX_RIGIDBODY:
+					if(key == "Shape") return CX_SHAPE;
+					break;
+				case CX_RENDERER:
+					if(key == "Fog") return CX_FOG;
+					break;
+				default:
+					break;
+				}
+				return CX_IGNORED;
+			}
+
+			float* floats(float* values, int count, int* capacity)
+			{
+				*capacity = count;
+				return values;
+			}
+
+			float* floatArray(Context context, int* capacity)
+			{
+				SettingsRecord& settings = scene->settings;
+				switch(context)
+				{
+				case CX_TRANSFORM:
+					if(key == "Position") return floats(transform.position, 3, capacity);
+					if(key == "Rotation") return floats(transform.rotation, 4, capacity);
+					if(key == "Scale")    return floats(transform.scale, 3, capacity);
+					break;
+				case CX_UNIFORMS:
+					if(key == "DiffuseColor") return floats(model.diffuseColor, 4, capacity);
+					break;
+				case CX_LIGHT:
+					if(key == "Color") return floats(light.color, 4, capacity);
+					break;
+				case CX_SHAPE:
+					if(key == "HalfExt") return floats(shape.halfExt, 3, capacity);
+					if(key == "Normal")  return floats(shape.normal, 3, capacity);
+					if(key == "Axis")    return floats(shape.axis, 3, capacity);
+					break;
+				case CX_RENDERER:
+					if(key == "AmbientLight") return floats(settings.ambientLight, 4, capacity);
+					if(key == "ClearColor")   return floats(settings.clearColor, 4, capacity);
+					break;
+				case CX_FOG:
+					if(key == "Color") return floats(settings.fogColor, 4, capacity);
+					break;
+				case CX_PHYSICS:
+					if(key == "Gravity") return floats(settings.gravity, 3, capacity);
+					break;
+				default:
+					break;
+				}
+				return NULL;
+			}
+
+			bool number(double value, bool isInt)
+			{
+				Frame& frame = frames.back();
+				if(frame.array == AT_FLOATS)
+				{
+					if(frame.count < frame.capacity) frame.values[frame.count] = (float)value;
+					frame.count++;
+					return true;
+				}
+				if(frame.array != AT_NONE) return true;
+
+				float*   floatField = NULL;
+				int32_t* intField   = NULL;
+				switch(frame.context)
+				{
+				case CX_OBJECT:
+					if(key == "Node")   intField = &object.node;
+					if(key == "Parent") intField = &object.parent;
+					break;
+				case CX_MODEL:
+					if(key == "Material") intField = &model.material;
+					break;
+				case CX_UNIFORMS:
+					if(key == "Diffuse")          floatField = &model.diffuse;
+					if(key == "Specular")         floatField = &model.specular;
+					if(key == "SpecularStrength") floatField = &model.specularStrength;
+					break;
+				case CX_LIGHT:
+					if(key == "Type")       intField   = &light.type;
+					if(key == "InnerAngle") floatField = &light.innerAngle;
+					if(key == "OuterAngle") floatField = &light.outerAngle;
+					if(key == "Falloff")    floatField = &light.falloff;
+					if(key == "Radius")     floatField = &light.radius;
+					if(key == "Intensity")  floatField = &light.intensity;
+					if(key == "DepthBias")  floatField = &light.depthBias;
+					break;
+				case CX_CAMERA:
+					if(key == "NearZ")       floatField = &camera.nearZ;
+					if(key == "FarZ")        floatField = &camera.farZ;
+					if(key == "Fov")         floatField = &camera.fov;
+					if(key == "AspectRatio") floatField = &camera.aspectRatio;
+					break;
+				case CX_RIGIDBODY:
+					if(key == "Mass")        floatField = &rigidBody.mass;
+					if(key == "Friction")    floatField = &rigidBody.friction;
+					if(key == "Restitution") floatField = &rigidBody.restitution;
+					break;
+				case CX_SHAPE:
+					if(key == "Type")   intField   = &shape.type;
+					if(key == "Radius") floatField = &shape.radius;
+					if(key == "Height") floatField = &shape.height;
+					if(key == "Margin") floatField = &shape.margin;
+					break;
+				case CX_FOG:
+					if(key == "FogMode") intField   = &scene->settings.fogMode;
+					if(key == "Density") floatField = &scene->settings.fogDensity;
+					if(key == "Start")   floatField = &scene->settings.fogStart;
+					if(key == "Max")     floatField = &scene->settings.fogMax;
+					break;
+				default:
+					break;
+				}
+				if(floatField) *floatField = (float)value;
+				if(intField && isInt) *intField = (int32_t)value;
+				return true;
+			}
+
+			bool boolean(bool value)
+			{
+				const Frame& frame = frames.back();
+				if(frame.array != AT_NONE) return true;
+
+				uint8_t* field = NULL;
+				switch(frame.context)
+				{
+				case CX_UNIFORMS:
+					if(key == "CastShadow") field = &model.castShadow;
+					break;
+				case CX_LIGHT:
+					if(key == "CastShadow") field = &light.castShadow;
+					if(key == "PcfEnabled") field = &light.pcfEnabled;
+					break;
+				case CX_CAMERA:
+					if(key == "IsOrthographic") field = &camera.isOrthographic;
+					if(key == "IsActive")       field = &camera.isActive;
+					break;
+				case CX_RIGIDBODY:
+					if(key == "IsKinematic") field = &rigidBody.isKinematic;
+					break;
+				default:
+					break;
+				}
+				if(field) *field = value ? 1 : 0;
+				return true;
+			}
+
+			bool string(const char* str, rapidjson::SizeType length)
+			{
+				const Frame& frame = frames.back();
+				if(frame.array == AT_SCRIPTS)
+				{
+					scene->scripts.push_back(scene->addString(std::string(str, length)));
+					return true;
+				}
+				if(frame.array != AT_NONE) return true;
+
+				int32_t* field = NULL;
+				switch(frame.context)
+				{
+				case CX_OBJECT:
+					if(key == "Name")
+					{
+						field   = &object.name;
+						hasName = true;
+					}
+					if(key == "Tag") field = &object.tag;
+					if(key == "Scripts")
+					{
+						scene->scripts.push_back(scene->addString(std::string(str, length)));
+						return true;
+					}
+					break;
+				case CX_MODEL:
+					if(key == "Geometry") field = &model.geometry;
+					break;
+				case CX_UNIFORMS:
+					if(key == "Texture") field = &model.texture;
+					break;
+				case CX_SHAPE:
+					if(key == "GeometryName") field = &shape.geometry;
+					break;
+				default:
+					break;
+				}
+				if(field) *field = scene->addString(std::string(str, length));
+				return true;
+			}
+
+			void beginObject()
+			{
+				object    = ObjectRecord();
+				transform = TransformRecord();
+				model     = ModelRecord();
+				light     = LightRecord();
+				camera    = CameraRecord();
+				rigidBody = RigidBodyRecord();
+				shape     = ShapeFields();
+				hasName   = hasModel = hasLight = hasCamera = hasRigidBody = false;
+				object.firstScript = (uint32_t)scene->scripts.size();
+			}
+
+			void endShape()
+			{
+				float* params = rigidBody.shape;
+				rigidBody.shapeType = shape.type;
+				switch(shape.type)
+				{
+				case 0: // Sphere
+					params[0] = shape.radius;
+					break;
+				case 1: // Box
+					for(int i = 0; i < 3; i++) params[i] = shape.halfExt[i];
+					break;
+				case 2: // Capsule
+				case 4: // Cone
+					params[0] = shape.radius;
+					params[1] = shape.height;
+					break;
+				case 3: // Plane
+					for(int i = 0; i < 3; i++) params[i] = shape.normal[i];
+					params[3] = shape.margin;
+					break;
+				case 5: // Cylinder
+					for(int i = 0; i < 3; i++)
+					{
+						params[i]     = shape.halfExt[i];
+						params[i + 3] = shape.axis[i];
+					}
+					break;
+				default: // Meshes
+					rigidBody.geometry = shape.geometry;
+					break;
+				}
+			}
+
+			void endObject()
+			{
+				if(!hasName)
+				{
+					scene->scripts.resize(object.firstScript);
+					result->skipped++;
+					return;
+				}
+				object.scriptCount = (uint32_t)scene->scripts.size() - object.firstScript;
+				if(hasModel)
+				{
+					object.model = (int32_t)scene->models.size();
+					scene->models.push_back(model);
+				}
+				if(hasLight)
+				{
+					object.light = (int32_t)scene->lights.size();
+					scene->lights.push_back(light);
+				}
+				if(hasCamera)
+				{
+					object.camera = (int32_t)scene->cameras.size();
+					scene->cameras.push_back(camera);
+				}
+				if(hasRigidBody)
+				{
+					object.rigidBody = (int32_t)scene->rigidBodies.size();
+					scene->rigidBodies.push_back(rigidBody);
+				}
+				scene->objects.push_back(object);
+				scene->transforms.push_back(transform);
+				result->objects++;
+				if(!callback) return;
+
+				// Capacity is kept so steady state streaming doesn't allocate for records
+				callback(*scene, (uint32_t)scene->objects.size() - 1, userData);
+				scene->clear();
+			}
+		};
+	}
+
+	bool read(FILE* file, SceneData* scene, Result* result, ObjectCallback callback, void* userData)
+	{
+		char                      buffer[BUFFER_SIZE];
+		rapidjson::FileReadStream stream(file, buffer, sizeof(buffer));
+		rapidjson::Reader         reader;
+		SceneHandler              handler(scene, result, callback, userData);
+		rapidjson::ParseResult    parseResult = reader.Parse(stream, handler);
+		if(parseResult.IsError())
+		{
+			if(!handler.error.empty())
+				result->error = handler.error;
+			else
+				result->error = std::string(rapidjson::GetParseError_En(parseResult.Code())) +
+					" at offset " + std::to_string(parseResult.Offset());
+			return false;
+		}
+		if(!handler.hasScene)
+		{
+			result->error = "Invalid document format";
+			return false;
+		}
+		return true;
+	}
+}
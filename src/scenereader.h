@@ -0,0 +1,36 @@
+#ifndef scenereader_H
+#define scenereader_H
+
+#include <cstdio>
+
+#include "sceneformat.h"
+
+// Streams json scene files, as written by SceneManager::saveScene, into scene records without
+// building a document. Objects are turned into records as their tokens arrive, so with an object
+// callback only the object being read is held in memory no matter how large the file is.
+// Like sceneformat this only depends on rapidjson so tools can use it.
+namespace SceneReader
+{
+	struct Result
+	{
+		uint32_t    objects     = 0;
+		uint32_t    skipped     = 0;     // Objects without a name, they are left out
+		bool        hasRenderer = false; // Settings sections found, the settings record keeps
+		bool        hasPhysics  = false; // its defaults for whatever is missing
+		std::string error;               // Set when the file is not a valid scene
+	};
+
+	// scene holds only the object that was just read, at objectIndex, together with its
+	// components and strings. It is cleared once the callback returns.
+	typedef void (*ObjectCallback)(const SceneFormat::SceneData& scene, uint32_t objectIndex, void* userData);
+
+	// Without a callback every object is kept in scene. Returns false and fills result->error
+	// on a parse error or unexpected document layout, objects passed on before that stay created.
+	bool read(FILE*                  file,
+			  SceneFormat::SceneData* scene,
+			  Result*                 result,
+			  ObjectCallback          callback = NULL,
+			  void*                   userData = NULL);
+}
+
+#endif
@@ -5,7 +5,10 @@
 #include "scenemanager.h"
 #include "utilities.h"
 #include "datatypes.h"
+#include "loadprofiler.h"
+#include "resourceregistry.h"
 #include "../include/angelscript/add_on/scriptstdstring/scriptstdstring.h"
+#include "../include/angelscript/add_on/scriptarray/scriptarray.h"
 #include "../include/angelscript/add_on/scriptbuilder/scriptbuilder.h"
 #include "../include/angelscript/add_on/scripthelper/scripthelper.h"
 #include "passert.h"
@@ -13,6 +16,7 @@
 struct Script
 {
 	std::string        module;
+	int                moduleSlot    = -1; // In moduleList and the resource registry
 	bool               enabled       = false;
 	asIScriptFunction* updateFunc    = NULL;
 	asIScriptFunction* initFunc      = NULL;
@@ -25,6 +29,7 @@ struct ScriptContainer
 {
 	std::vector<Script> scripts;
 	Node gameObjectNode;
+	int  activeIndex = -1; // Location in activeScriptContainers
 };
 
 namespace ScriptEngine
@@ -41,6 +46,19 @@ namespace ScriptEngine
 		std::vector<int> activeScriptContainers;
 		std::string scriptDir = "../content/scripts/"; // TODO: Find a better way to do this
 		std::vector<std::string> scriptReloadQueue;
+
+		// Compiled once per script and looked up through the resource registry, spawning an
+		// object with a script that is loaded already doesn't search the module again
+		struct ScriptModule
+		{
+			asIScriptModule*   module        = NULL;
+			asIObjectType*     type          = NULL;
+			asIScriptFunction* initFunc      = NULL;
+			asIScriptFunction* updateFunc    = NULL;
+			asIScriptFunction* collisionFunc = NULL;
+		};
+
+		std::vector<ScriptModule> moduleList; // Never shrinks, see removeScript
 		
 		int execute(asIScriptContext* context)
 		{
@@ -55,6 +73,35 @@ namespace ScriptEngine
 			return rc;
 		}
 
+		// Finds the class implementing IScriptable and the functions called on its objects
+		bool resolveModule(asIScriptModule* module, ScriptModule* resolved)
+		{
+			*resolved = ScriptModule();
+			resolved->module = module;
+			int objectCount = module->GetObjectTypeCount();
+			for(int i = 0; i < objectCount && !resolved->type; i++)
+			{
+				asIObjectType* type = module->GetObjectTypeByIndex(i);
+				int interfaceCount = type->GetInterfaceCount();
+				for(int j = 0; j < interfaceCount; j++)
+				{
+					if(strcmp(type->GetInterface(j)->GetName(), "IScriptable") == 0)
+					{
+						resolved->type = type;
+						break;
+					}
+				}
+			}
+			if(!resolved->type) return false;
+
+			std::string typeName = std::string(resolved->type->GetName());
+			std::string initFuncDecl = typeName + "@ " + typeName + "(int32)";
+			resolved->initFunc      = resolved->type->GetFactoryByDecl(initFuncDecl.c_str());
+			resolved->updateFunc    = resolved->type->GetMethodByDecl("void update(float)");
+			resolved->collisionFunc = resolved->type->GetMethodByDecl("void onCollision(const CollisionData@)");
+			return true;
+		}
+
 		int findScriptLocation(ScriptContainer* container, const std::string& scriptName)
 		{
 			int scriptLocation = -1;
@@ -135,6 +182,7 @@ namespace ScriptEngine
 			engine->SetMessageCallback(asFUNCTION(MessageCallback), 0, asCALL_CDECL);
 			// context = engine->CreateContext();
 			RegisterStdString(engine); // Register string type
+			RegisterScriptArray(engine, true); // Register array<T> type, used by batch queries
 			// Bind functions for script reloading
 			engine->SetDefaultNamespace("ScriptEngine");
 			int rc = engine->RegisterGlobalFunction("void reloadScript(const string &in)",
@@ -166,6 +214,8 @@ namespace ScriptEngine
 		}
 		scriptContainerList.clear();
 		scriptContainerEmptyIndices.clear();
+		moduleList.clear();
+		ResourceRegistry::clear(ResourceRegistry::RT_SCRIPT);
 		scriptReloadQueue.clear();
 		activeScriptContainers.clear();
 	}
@@ -178,17 +228,10 @@ namespace ScriptEngine
 	void registerGameObject(GameObject* gameObject)
 	{
 		PA_ASSERT(gameObject);
-		bool found = false;
 		// Check that gameObject is not already registered
-		for(int activeContainerIndex : activeScriptContainers)
-		{
-			ScriptContainer& container = scriptContainerList[activeContainerIndex];
-			if(container.gameObjectNode == gameObject->node)
-			{
-				found = true;
-				break;
-			}
-		}
+		bool found = gameObject->scriptIndex >= 0 &&
+			         scriptContainerList[gameObject->scriptIndex].gameObjectNode == gameObject->node &&
+			         scriptContainerList[gameObject->scriptIndex].activeIndex != -1;
 
 		if(found) // No need to register, gameobject is already registered
 		{
@@ -208,6 +251,7 @@ namespace ScriptEngine
 			scriptContainerEmptyIndices.pop_back();
 		}
 		scriptContainerList[index].gameObjectNode = gameObject->node;
+		scriptContainerList[index].activeIndex    = (int)activeScriptContainers.size();
 		activeScriptContainers.push_back(index);
 		gameObject->scriptIndex = index;
 		Log::message(gameObject->name + " registered with scripting engine");
@@ -246,70 +290,56 @@ namespace ScriptEngine
 		return success;
 	}
 	
+	// Compiles the script and registers it with a count of one, -1 if it can't be used
+	int loadModule(const std::string& scriptName)
+	{
+		if(!createModule(scriptName)) return -1;
+		asIScriptModule* module = engine->GetModule(scriptName.c_str(), asGM_ONLY_IF_EXISTS);
+		ScriptModule     loaded;
+		if(!resolveModule(module, &loaded))
+		{
+			Log::error("ScriptEngine::loadModule",
+					   "No class implmenting IScriptable interface found in " + scriptName);
+			module->Discard();
+			return -1;
+		}
+
+		moduleList.push_back(loaded);
+		int slot = (int)(moduleList.size() - 1);
+		ResourceRegistry::insert(ResourceRegistry::RT_SCRIPT, slot, scriptName.c_str());
+		return slot;
+	}
+	
 	void addScript(GameObject* gameObject, const std::string& scriptName)
 	{
 		PA_ASSERT(gameObject);
+		LoadProfiler::ScopedTimer timer(LoadProfiler::LP_SCRIPT, scriptName.c_str());
 		ScriptContainer* container = &scriptContainerList[gameObject->scriptIndex];
 		// Check if module has already been created
-		asIScriptModule* module = engine->GetModule(scriptName.c_str(), asGM_ONLY_IF_EXISTS);
-		if(!module)
+		ResourceRegistry::ScriptHandle handle = ResourceRegistry::find<ResourceRegistry::RT_SCRIPT>(scriptName.c_str());
+		if(handle.isValid())
 		{
-			bool moduleCreated = createModule(scriptName);
-			if(moduleCreated)
-			{
-				module = engine->GetModule(scriptName.c_str(), asGM_ONLY_IF_EXISTS);
-			}
-			else
+			ResourceRegistry::addRef(ResourceRegistry::RT_SCRIPT, handle.slot);
+		}
+		else
+		{
+			handle.slot = loadModule(scriptName);
+			if(!handle.isValid())
 			{
 				Log::error("ScriptEngine::addScript", scriptName + " not added to " + gameObject->name);
 				return;
 			}
 		}
+		const ScriptModule& module = moduleList[handle.slot];
 		container->scripts.push_back(Script());
 		Script& newScript = container->scripts[container->scripts.size() - 1];
-		newScript.module = scriptName;
-		newScript.enabled = true;
-		
-		// Find object type that implements IScriptable interface
-		int objectCount = module->GetObjectTypeCount();
-		asIObjectType* type = NULL;
-		for(int i = 0; i < objectCount; i++)
-		{
-			bool found = false;
-			type = module->GetObjectTypeByIndex(i);
-			int interfaceCount = type->GetInterfaceCount();
-			for(int j = 0; j < interfaceCount; j++)
-			{
-				if(strcmp(type->GetInterface(i)->GetName(), "IScriptable") == 0)
-				{
-					found = true;
-					break;
-				}
-			}
-			if( found == true )
-			{
-				newScript.objType = type;
-				break;
-			}
-		}
-		if(type == NULL)
-		{
-			Log::error("ScriptEngine::addScript",
-					   "No class implmenting IScriptable interface found in " + scriptName);
-			Log::error("ScriptEngine::addScript", scriptName + " not added to " + gameObject->name);
-			container->scripts.pop_back();
-			module->Discard();
-			return;
-		}
-
-		// Find the update and init functions in the interface
-		std::string typeName = std::string(type->GetName());
-		std::string initFuncDecl = typeName + "@ " + typeName + "(int32)";
-		std::string updateFuncDecl = "void update(float)";
-		std::string onCollFuncDecl = "void onCollision(const CollisionData@)";
-		newScript.initFunc = type->GetFactoryByDecl(initFuncDecl.c_str());
-		newScript.updateFunc = type->GetMethodByDecl(updateFuncDecl.c_str());
-		newScript.collisionFunc = type->GetMethodByDecl(onCollFuncDecl.c_str());
+		newScript.module        = scriptName;
+		newScript.moduleSlot    = handle.slot;
+		newScript.enabled       = true;
+		newScript.objType       = module.type;
+		newScript.initFunc      = module.initFunc;
+		newScript.updateFunc    = module.updateFunc;
+		newScript.collisionFunc = module.collisionFunc;
 
 		// Create the script object
 		asIScriptContext* context = prepareContext(newScript.initFunc);
@@ -320,13 +350,15 @@ namespace ScriptEngine
 			// Get the newly created scriptobject and increase it's reference count
 			newScript.scriptObj = *((asIScriptObject**)context->GetAddressOfReturnValue());
 			newScript.scriptObj->AddRef();
+			SceneManager::markDirty(gameObject->node);
 			Log::message("Script '" + scriptName + "' added to " + gameObject->name);
 		}
 		else if(rc == asEXECUTION_EXCEPTION)
 		{
+			// The module stays, objects created earlier still run it
 			Log::error("ScriptEngine::addScript", scriptName + " not added to " + gameObject->name);
 			container->scripts.pop_back();
-			module->Discard();
+			ResourceRegistry::release(ResourceRegistry::RT_SCRIPT, handle.slot);
 		}
 		returnContext(context);
 	}
@@ -336,7 +368,7 @@ namespace ScriptEngine
 		//for(int activeContainer : activeScriptContainers)
 		for(int i = 0; i < (int)activeScriptContainers.size(); i++)
 		{
-			ScriptContainer* container = &scriptContainerList[i];
+			ScriptContainer* container = &scriptContainerList[activeScriptContainers[i]];
 			for(Script& script : container->scripts)
 			{
 				if(script.enabled)
@@ -380,7 +412,10 @@ namespace ScriptEngine
 		{
 			Script& script = container->scripts[scriptLocation];
 			script.scriptObj->Release();
+			// Modules stay compiled when unused, the next object with the script doesn't wait
+			ResourceRegistry::release(ResourceRegistry::RT_SCRIPT, script.moduleSlot);
 			container->scripts.erase(container->scripts.begin() + scriptLocation);
+			SceneManager::markDirty(gameobject->node);
 			Log::message("Script '" + scriptName + "' removed from " + gameobject->name);
 		}
 		else
@@ -402,21 +437,20 @@ namespace ScriptEngine
 			for(Script& script : container.scripts)
 			{
 				script.scriptObj->Release();
+				ResourceRegistry::release(ResourceRegistry::RT_SCRIPT, script.moduleSlot);
 			}
 			container.scripts.clear();
 			scriptContainerEmptyIndices.push_back(index);
-			int activeIndex = -1;
-			for(int i = 0; i < (int)activeScriptContainers.size(); i++)
-			{
-				if(activeScriptContainers[i] == index)
-				{
-					activeIndex = i;
-					break;
-				}
-			}
+			int activeIndex = container.activeIndex;
 			if(activeIndex != -1)
 			{
-				activeScriptContainers.erase(activeScriptContainers.begin() + activeIndex);
+				// Swap with the last active container, update order doesn't matter
+				int moved = activeScriptContainers.back();
+				activeScriptContainers[activeIndex] = moved;
+				scriptContainerList[moved].activeIndex = activeIndex;
+				activeScriptContainers.pop_back();
+				container.activeIndex = -1;
+				container.gameObjectNode = -1;
 				Log::message(gameObject->name + " unregistered from script engine");
 			}
 			else
@@ -454,28 +488,12 @@ namespace ScriptEngine
 		std::string moduleName = std::string(scriptName + "TEMP");
 		bool moduleCreated = createModule(scriptName.c_str(), true);
 		asIScriptModule* module = NULL;
-		asIObjectType*   type   = NULL;
+		ScriptModule     reloaded;
 		if(moduleCreated)
 		{
 			// Check if it has IScriptable interface implemented
 			module = engine->GetModule(moduleName.c_str(), asGM_ONLY_IF_EXISTS);
-			int objectCount = module->GetObjectTypeCount();
-			for(int i = 0; i < objectCount; i++)
-			{
-				bool found = false;
-				type = module->GetObjectTypeByIndex(i);
-				int interfaceCount = type->GetInterfaceCount();
-				for(int j = 0; j < interfaceCount; j++)
-				{
-					if(strcmp(type->GetInterface(i)->GetName(), "IScriptable") == 0)
-					{
-						found = true;
-						break;
-					}
-				}
-				if(found) break;
-			}
-			if(!type)
+			if(!resolveModule(module, &reloaded))
 			{
 				Log::error("ScriptEngine::reloadScript", "Could not reload script '" + scriptName + "'");
 				module->Discard();
@@ -483,13 +501,9 @@ namespace ScriptEngine
 			}
 			else
 			{
-				std::string typeName = std::string(type->GetName());
-				std::string initFuncDecl = typeName + "@ " + typeName + "(int32)";
-				std::string updateFuncDecl = "void update(float)";
-				std::string onCollFuncDecl = "void onCollision(const CollisionData@)";
-				asIScriptFunction* initFunc   = type->GetFactoryByDecl(initFuncDecl.c_str());
-				asIScriptFunction* updateFunc = type->GetMethodByDecl(updateFuncDecl.c_str());
-				asIScriptFunction* onCollFunc = type->GetMethodByDecl(onCollFuncDecl.c_str());
+				asIScriptFunction* initFunc   = reloaded.initFunc;
+				asIScriptFunction* updateFunc = reloaded.updateFunc;
+				asIScriptFunction* onCollFunc = reloaded.collisionFunc;
 				// Create new objects of script type and replace previous ones
 				if(initFunc && updateFunc && onCollFunc)
 				{
@@ -513,6 +527,8 @@ namespace ScriptEngine
 									// Get the newly created scriptobject and increase it's reference count
 									script.scriptObj = *((asIScriptObject**)context->GetAddressOfReturnValue());
 									script.scriptObj->AddRef();
+									script.objType = reloaded.type;
+									script.initFunc = initFunc;
 									script.updateFunc = updateFunc;
 									script.collisionFunc = onCollFunc;
 									Log::message("Script '" + scriptName + "' reloaded for " + gameObject->name);
@@ -532,6 +548,8 @@ namespace ScriptEngine
 						asIScriptModule* prevModule = engine->GetModule(scriptName.c_str(), asGM_ONLY_IF_EXISTS);
 						prevModule->Discard();
 						module->SetName(scriptName.c_str());
+						int slot = ResourceRegistry::findSlot(ResourceRegistry::RT_SCRIPT, scriptName.c_str());
+						if(slot != -1) moduleList[slot] = reloaded;
 					}
 					else
 					{
@@ -13,6 +13,10 @@ namespace Settings
 		int renderHeight;
 		int shadowMapWidth;
 		int shadowMapHeight;
+		int physicsRate        = 60; // Fixed steps per second, older files don't have it
+		int maxPhysicsSubSteps = 5;  // Steps per frame before simulation time is dropped
+		float lodBias          = 0.f;  // In levels, positive keeps detail further away
+		float lodHysteresis    = 0.1f; // Fraction of a LOD threshold a mesh has to cross before switching
 		const char* settingsFile = "../content/settings.json";
 	}
 	
@@ -80,6 +84,36 @@ namespace Settings
 					else
 						success = false;
 				}
+
+				if(document.HasMember("PhysicsRate") && document["PhysicsRate"].IsInt())
+				{
+					const int rate = document["PhysicsRate"].GetInt();
+					if(rate > 0)
+						physicsRate = rate;
+					else
+						success = false;
+				}
+
+				if(document.HasMember("MaxPhysicsSubSteps") && document["MaxPhysicsSubSteps"].IsInt())
+				{
+					const int subSteps = document["MaxPhysicsSubSteps"].GetInt();
+					if(subSteps > 0)
+						maxPhysicsSubSteps = subSteps;
+					else
+						success = false;
+				}
+
+				if(document.HasMember("LodBias") && document["LodBias"].IsNumber())
+					lodBias = (float)document["LodBias"].GetDouble();
+
+				if(document.HasMember("LodHysteresis") && document["LodHysteresis"].IsNumber())
+				{
+					const float hysteresis = (float)document["LodHysteresis"].GetDouble();
+					if(hysteresis >= 0.f && hysteresis < 1.f)
+						lodHysteresis = hysteresis;
+					else
+						success = false;
+				}
 			}
 			else
 			{
@@ -101,6 +135,10 @@ namespace Settings
 			renderWidth  = windowWidth  = 800;
 			renderHeight = windowHeight = 600;
 			shadowMapWidth = shadowMapHeight = 512;
+			physicsRate        = 60;
+			maxPhysicsSubSteps = 5;
+			lodBias            = 0.f;
+			lodHysteresis      = 0.1f;
 			success = saveSettingsToFile();
 		}
 		return success;
@@ -123,6 +161,10 @@ namespace Settings
 			writer.Key("RenderHeight");    writer.Int(renderHeight);
 			writer.Key("ShadowMapWidth");  writer.Int(shadowMapWidth);
 			writer.Key("ShadowMapHeight"); writer.Int(shadowMapHeight);
+			writer.Key("PhysicsRate");        writer.Int(physicsRate);
+			writer.Key("MaxPhysicsSubSteps"); writer.Int(maxPhysicsSubSteps);
+			writer.Key("LodBias");            writer.Double(lodBias);
+			writer.Key("LodHysteresis");      writer.Double(lodHysteresis);
 			writer.EndObject();
 
 			size_t bytes = fwrite((void*)buffer.GetString(), buffer.GetSize(), 1, newFile);
@@ -170,6 +212,26 @@ namespace Settings
 		return shadowMapHeight;
 	}
 
+	int getPhysicsRate()
+	{
+		return physicsRate;
+	}
+
+	int getMaxPhysicsSubSteps()
+	{
+		return maxPhysicsSubSteps;
+	}
+
+	float getLodBias()
+	{
+		return lodBias;
+	}
+
+	float getLodHysteresis()
+	{
+		return lodHysteresis;
+	}
+
 	void setWindowWidth(int width)
 	{
 		windowWidth = width;
@@ -199,5 +261,25 @@ namespace Settings
 	{
 		shadowMapHeight = height;
 	}
+
+	void setPhysicsRate(int stepsPerSecond)
+	{
+		physicsRate = stepsPerSecond;
+	}
+
+	void setMaxPhysicsSubSteps(int subSteps)
+	{
+		maxPhysicsSubSteps = subSteps;
+	}
+
+	void setLodBias(float bias)
+	{
+		lodBias = bias;
+	}
+
+	void setLodHysteresis(float hysteresis)
+	{
+		lodHysteresis = hysteresis;
+	}
 	
 }
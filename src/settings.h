@@ -11,12 +11,20 @@ namespace Settings
 	int  getShadowMapHeight();
 	int  getShadowMapWidth();
 	int  getWindowHeight();
+	int  getPhysicsRate();
+	int  getMaxPhysicsSubSteps();
+	float getLodBias();
+	float getLodHysteresis();
 	void setWindowWidth(int width);
 	void setWindowHeight(int height);
 	void setRenderWidth(int width);
 	void setRenderHeight(int height);
 	void setShadowMapWidth(int width);
 	void setShadowMapHeight(int height);
+	void setPhysicsRate(int stepsPerSecond);
+	void setMaxPhysicsSubSteps(int subSteps);
+	void setLodBias(float bias);
+	void setLodHysteresis(float hysteresis);
 }
 
 #endif
@@ -8,6 +8,8 @@
 #include "log.h"
 #include "renderer.h"
 #include "passert.h"
+#include "loadprofiler.h"
+#include "resourceregistry.h"
 
 namespace Shader
 {
@@ -93,8 +95,18 @@ namespace Shader
 		strcpy(shaderPath, path);
 	}
 	
+	// Programs are shared, materials using the same pair of sources get the same index
 	int create(const char* vertexShaderName, const char* fragmentShaderName)
 	{
+		const std::string name = std::string(vertexShaderName) + ", " + fragmentShaderName;
+		ResourceRegistry::ShaderHandle handle = ResourceRegistry::find<ResourceRegistry::RT_SHADER>(name.c_str());
+		if(handle.isValid())
+		{
+			ResourceRegistry::addRef(ResourceRegistry::RT_SHADER, handle.slot);
+			return handle.slot;
+		}
+
+		LoadProfiler::ScopedTimer timer(LoadProfiler::LP_SHADER, name.c_str());
 		char* vsPath = (char *)malloc(sizeof(char) *
 									  (strlen(shaderPath) + strlen(vertexShaderName)) + 1);
 		strcpy(vsPath, shaderPath);
@@ -217,6 +229,7 @@ namespace Shader
 			shaderList.push_back(newObject);
 			index = shaderList.size() - 1;
 		}
+		ResourceRegistry::insert(ResourceRegistry::RT_SHADER, index, name.c_str());
 		Log::message(std::string(vertexShaderName) + ", " + std::string(fragmentShaderName) +
 					 " compiled into shader program");
 		free(vsPath);
@@ -289,21 +302,32 @@ namespace Shader
 			glUniformMatrix4fv(location, 1, GL_FALSE, glm::value_ptr(value));
 	}
 
-	void remove(const int shaderIndex)
+	void destroy(const ShaderObject& shaderObject)
 	{
-		ShaderObject shaderObject = shaderList[shaderIndex];
 		glDeleteProgram(shaderObject.program);
 		glDeleteShader(shaderObject.vertexShader);
 		glDeleteShader(shaderObject.fragmentShader);
-		emptyIndices.push_back(shaderIndex);
+	}
+
+	void remove(const int shaderIndex)
+	{
+		if(ResourceRegistry::release(ResourceRegistry::RT_SHADER, shaderIndex) == 0)
+		{
+			destroy(shaderList[shaderIndex]);
+			ResourceRegistry::remove(ResourceRegistry::RT_SHADER, shaderIndex);
+			emptyIndices.push_back(shaderIndex);
+		}
 	}
 	
 	void cleanup()
 	{
 		free(shaderPath);
-		for(int i = 0; i < (int)shaderList.size(); i++)
-			remove(i);
+		std::vector<ResourceRegistry::Resource> shaders;
+		ResourceRegistry::getResources(ResourceRegistry::RT_SHADER, &shaders);
+		for(const ResourceRegistry::Resource& shader : shaders)
+			destroy(shaderList[shader.slot]);
 
+		ResourceRegistry::clear(ResourceRegistry::RT_SHADER);
 		shaderList.clear();
 		emptyIndices.clear();
 	}
@@ -0,0 +1,201 @@
+#include <unordered_map>
+
+#include "spatialindex.h"
+#include "aabbtree.h"
+#include "gameobject.h"
+#include "transform.h"
+#include "model.h"
+#include "camera.h"
+#include "geometry.h"
+#include "scenemanager.h"
+#include "scriptengine.h"
+#include "passert.h"
+
+#include "../include/angelscript/add_on/scriptarray/scriptarray.h"
+
+namespace SpatialIndex
+{
+	namespace
+	{
+		AABBTree                      tree;
+		std::unordered_map<Node, int> leaves;  // Leaf of every indexed object
+		std::vector<int32_t>          results; // Scratch for tree queries
+		asIObjectType*                gameObjectArrayType = NULL;
+
+		void appendNodes(std::vector<Node>* nodes)
+		{
+			nodes->insert(nodes->end(), results.begin(), results.end());
+			results.clear();
+		}
+
+		CScriptArray* toScriptArray(const std::vector<Node>& nodes)
+		{
+			if(!gameObjectArrayType)
+			{
+				asIScriptEngine* engine = ScriptEngine::getEngine();
+				gameObjectArrayType = engine->GetObjectTypeById(engine->GetTypeIdByDecl("array<GameObject@>"));
+			}
+			std::vector<GameObject*> gameObjects;
+			gameObjects.reserve(nodes.size());
+			for(Node node : nodes)
+			{
+				GameObject* gameObject = SceneManager::find(node);
+				if(gameObject) gameObjects.push_back(gameObject);
+			}
+			CScriptArray* array = CScriptArray::Create(gameObjectArrayType, (asUINT)gameObjects.size());
+			for(asUINT i = 0; i < (asUINT)gameObjects.size(); i++)
+				*((GameObject**)array->At(i)) = gameObjects[i];
+			return array;
+		}
+
+		CScriptArray* querySphereScript(const Vec3& center, float radius)
+		{
+			std::vector<Node> nodes;
+			querySphere(center, radius, &nodes);
+			return toScriptArray(nodes);
+		}
+
+		CScriptArray* queryBoxScript(const Vec3& min, const Vec3& max)
+		{
+			BoundingBox box;
+			box.min = glm::min(min, max);
+			box.max = glm::max(min, max);
+			std::vector<Node> nodes;
+			queryBox(box, &nodes);
+			return toScriptArray(nodes);
+		}
+
+		CScriptArray* queryCameraScript(CCamera* camera)
+		{
+			std::vector<Node> nodes;
+			if(camera) queryFrustum(camera->frustum, &nodes);
+			return toScriptArray(nodes);
+		}
+
+		GameObject* raycastScript(const Vec3& origin, const Vec3& direction, float maxDistance)
+		{
+			return SceneManager::find(raycast(origin, direction, maxDistance));
+		}
+	}
+
+	bool getWorldBounds(GameObject* gameObject, BoundingBox* box)
+	{
+		PA_ASSERT(gameObject);
+		PA_ASSERT(box);
+		if(!GO::hasComponent(gameObject, Component::TRANSFORM)) return false;
+
+		CTransform*        transform   = GO::getTransform(gameObject);
+		const Mat4&        worldMatrix = Transform::getWorldMatrix(transform);
+		const BoundingBox* localBox    = NULL;
+		if(GO::hasComponent(gameObject, Component::MODEL))
+			localBox = Geometry::getBoundingBox(GO::getModel(gameObject)->geometryIndex);
+		if(!localBox)
+		{
+			box->min = box->max = Vec3(worldMatrix[3]);
+			return true;
+		}
+
+		// Center moves with the matrix, the extents along each world axis are the absolute
+		// values of the rotated and scaled local axes they are made of
+		Vec3 center  = Vec3(worldMatrix * Vec4((localBox->min + localBox->max) * 0.5f, 1.f));
+		Vec3 halfExt = (localBox->max - localBox->min) * 0.5f;
+		Vec3 worldHalfExt = glm::abs(Vec3(worldMatrix[0])) * halfExt.x +
+			                glm::abs(Vec3(worldMatrix[1])) * halfExt.y +
+			                glm::abs(Vec3(worldMatrix[2])) * halfExt.z;
+		box->min = center - worldHalfExt;
+		box->max = center + worldHalfExt;
+		return true;
+	}
+
+	void update(GameObject* gameObject)
+	{
+		PA_ASSERT(gameObject);
+		BoundingBox box;
+		const bool  hasBounds = getWorldBounds(gameObject, &box);
+		if(GO::hasComponent(gameObject, Component::MODEL)) Model::updateWorldBounds(gameObject, hasBounds ? &box : NULL);
+		if(!hasBounds)
+		{
+			remove(gameObject->node);
+			return;
+		}
+
+		auto it = leaves.find(gameObject->node);
+		if(it != leaves.end())
+			tree.move(it->second, box);
+		else
+			leaves[gameObject->node] = tree.insert(box, gameObject->node);
+	}
+
+	void remove(Node node)
+	{
+		auto it = leaves.find(node);
+		if(it == leaves.end()) return;
+		tree.remove(it->second);
+		leaves.erase(it);
+	}
+
+	void cleanup()
+	{
+		tree.clear();
+		leaves.clear();
+		results.clear();
+	}
+
+	void queryFrustum(const Frustum& frustum, std::vector<Node>* nodes)
+	{
+		tree.query(frustum, &results);
+		appendNodes(nodes);
+	}
+
+	void queryBox(const BoundingBox& box, std::vector<Node>* nodes)
+	{
+		tree.query(box, &results);
+		appendNodes(nodes);
+	}
+
+	void querySphere(const Vec3& center, float radius, std::vector<Node>* nodes)
+	{
+		tree.query(center, radius, &results);
+		appendNodes(nodes);
+	}
+
+	Node raycast(const Vec3& origin, const Vec3& direction, float maxDistance, float* distance)
+	{
+		float length = glm::length(direction);
+		if(length <= 0.f) return -1;
+		return tree.raycast(origin, direction / length, maxDistance, distance);
+	}
+
+	int getCount()
+	{
+		return tree.getLeafCount();
+	}
+
+	void generateBindings()
+	{
+		asIScriptEngine* engine = ScriptEngine::getEngine();
+		engine->SetDefaultNamespace("SpatialIndex");
+		int rc = -1;
+		rc = engine->RegisterGlobalFunction("array<GameObject@>@ querySphere(const Vec3 &in, float)",
+											asFUNCTION(querySphereScript),
+											asCALL_CDECL);
+		PA_ASSERT(rc >= 0);
+		rc = engine->RegisterGlobalFunction("array<GameObject@>@ queryBox(const Vec3 &in, const Vec3 &in)",
+											asFUNCTION(queryBoxScript),
+											asCALL_CDECL);
+		PA_ASSERT(rc >= 0);
+		rc = engine->RegisterGlobalFunction("array<GameObject@>@ queryCamera(Camera@)",
+											asFUNCTION(queryCameraScript),
+											asCALL_CDECL);
+		PA_ASSERT(rc >= 0);
+		rc = engine->RegisterGlobalFunction("GameObject@ raycast(const Vec3 &in, const Vec3 &in, float)",
+											asFUNCTION(raycastScript),
+											asCALL_CDECL);
+		PA_ASSERT(rc >= 0);
+		rc = engine->RegisterGlobalFunction("int getCount()",
+											asFUNCTION(getCount),
+											asCALL_CDECL);
+		PA_ASSERT(rc >= 0);
+		engine->SetDefaultNamespace("");
+	}
+}
@@ -0,0 +1,35 @@
+#ifndef spatialindex_H
+#define spatialindex_H
+
+#include <vector>
+
+#include "datatypes.h"
+#include "mathdefs.h"
+#include "boundingvolumes.h"
+
+struct GameObject;
+
+// Where every object with a transform is in world space, kept in an AABBTree. Objects with a
+// model are indexed by their geometry's box, the rest by their position. GO keeps it current,
+// objects are updated when a transform or model is added or removed and when a transform is
+// synced after it changed, so queries are only exact after Transform::flush. Models get their
+// packed culling bounds from here as well.
+namespace SpatialIndex
+{
+	void update(GameObject* gameObject); // Inserts, moves or removes depending on the object's components
+	void remove(Node node);
+	void cleanup();
+	bool getWorldBounds(GameObject* gameObject, BoundingBox* box); // False without a transform
+
+	// Nodes are appended, nothing is cleared
+	void queryFrustum(const Frustum& frustum, std::vector<Node>* nodes);
+	void queryBox(const BoundingBox& box, std::vector<Node>* nodes);
+	void querySphere(const Vec3& center, float radius, std::vector<Node>* nodes);
+	// Closest object whose box is hit, -1 for none. Direction does not need to be normalized.
+	Node raycast(const Vec3& origin, const Vec3& direction, float maxDistance, float* distance = NULL);
+
+	int  getCount();
+	void generateBindings();
+}
+
+#endif
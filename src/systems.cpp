@@ -18,12 +18,20 @@
 #include "collisionshapes.h"
 #include "console.h"
 #include "rigidbody.h"
+#include "workerpool.h"
+#include "prefab.h"
+#include "spatialindex.h"
+#include "resourceregistry.h"
+#include "settings.h"
 
 namespace System
 {
 	void initialize()
 	{
+		WorkerPool::initialize();
 		Physics::initialize(Vec3(0.f, -9.8f, 0.f));
+		Physics::setFixedStep(1.f / Settings::getPhysicsRate());
+		Physics::setMaxSubSteps(Settings::getMaxPhysicsSubSteps());
 		RigidBody::initialize();
 		ScriptEngine::initialize();
 
@@ -39,8 +47,11 @@ namespace System
 		Physics::generateBindings();
 		RigidBody::generateBindings();
 		GO::generateBindings();
+		SpatialIndex::generateBindings();
 		SceneManager::generateBindings();
+		Prefab::generateBindings();
 		Gui::generateBindings();
+		ResourceRegistry::generateBindings();
 		ScriptEngine::registerScriptInterface();
 
 		Editor::initialize();
@@ -57,17 +68,25 @@ namespace System
 		ScriptEngine::updateAllScripts(deltaTime);
 		Editor::update(deltaTime, quit);
 		Console::update();
+		// Push transforms changed by scripts and the editor into physics before stepping,
+		// then rebuild the ones moved by the simulation and by collision callbacks
+		Transform::flush();
 		Physics::update(deltaTime);
+		Transform::flush();
 		SceneManager::update(); 
+		Transform::interpolate(Physics::getInterpolation());
 	}
 
 	void cleanup()
 	{
 		SceneManager::cleanup();
+		SpatialIndex::cleanup();
+		Prefab::cleanup();
 		Editor::cleanup();
 		Console::cleanup();
 		RigidBody::cleanup();
 		Physics::cleanup();
 		ScriptEngine::cleanup();
+		WorkerPool::cleanup();
 	}
 }
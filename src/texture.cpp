@@ -11,6 +11,8 @@
 #include "renderer.h"
 #include "scriptengine.h"
 #include "passert.h"
+#include "loadprofiler.h"
+#include "resourceregistry.h"
 
 #define STB_IMAGE_IMPLEMENTATION
 #include "../include/stb_image.h"
@@ -31,8 +33,6 @@ namespace Texture
 	{
 		SDL_Surface*  surface;
 		unsigned int  id;
-		char*         name;
-		uint32_t      refCount = 0;
 		int           target   = 0;
 	};
 	
@@ -45,20 +45,19 @@ namespace Texture
 
 		int isLoaded(const char* name)
 		{
-			int loaded = -1;
-			for(uint i = 0; i < textureList.size(); i++)
+			return ResourceRegistry::find<ResourceRegistry::RT_TEXTURE>(name).slot;
+		}
+
+		void destroy(TextureObj* textureObj)
+		{
+			glDeleteTextures(1, &textureObj->id);
+			textureObj->id = 0;
+			if(textureObj->surface != NULL)
 			{
-				if(!textureList[i].name)
-				{
-					continue;
-				}
-				else if(strcmp(name, textureList[i].name) == 0)
-				{
-					loaded = i;
-					break;
-				}
+				// free(textureObj->surface->pixels);
+				SDL_FreeSurface(textureObj->surface);
+				textureObj->surface = NULL;
 			}
-			return loaded;
 		}
 	}
 
@@ -134,83 +133,97 @@ namespace Texture
 		PA_ASSERT(flags == success);
 	}
 	
-	int create(const char* filename)
+	SDL_Surface* decode(const char* filename)
 	{
+		// texturePath is only written by initialize, the error of a failed load stays
+		// with the calling thread and can be fetched with IMG_GetError there
+		LoadProfiler::ScopedTimer timer(LoadProfiler::LP_TEXTURE, filename);
+		char* fullPath = (char *)malloc(sizeof(char) *
+									(strlen(texturePath) + strlen(filename)) + 1);
+		strcpy(fullPath, texturePath);
+		strcat(fullPath, filename);
+		SDL_Surface* surface = IMG_Load(fullPath);
+		free(fullPath);
+		return surface;
+	}
+
+	int create(const char* filename, SDL_Surface* newSurface)
+	{
+		PA_ASSERT(newSurface);
+		LoadProfiler::ScopedTimer timer(LoadProfiler::LP_TEXTURE, filename);
 		int index = isLoaded(filename);
-		if(index == -1)
+		if(index != -1)
 		{
-			char* fullPath = (char *)malloc(sizeof(char) *
-										(strlen(texturePath) + strlen(filename)) + 1);
-			strcpy(fullPath, texturePath);
-			strcat(fullPath, filename);
-		
-			SDL_Surface* newSurface = IMG_Load(fullPath);
-			free(fullPath);
+			SDL_FreeSurface(newSurface);
+			ResourceRegistry::addRef(ResourceRegistry::RT_TEXTURE, index);
+			return index;
+		}
 
-			if(newSurface)
+		int format         = GL_RGB;
+		int internalFormat = GL_RGB;
+		int textureType    = GL_UNSIGNED_BYTE;
+		if (newSurface->format->BytesPerPixel == 4)
+		{
+			if(newSurface->format->Rmask == 0xff)
 			{
-				int format         = GL_RGB;
-				int internalFormat = GL_RGB;
-				int textureType    = GL_UNSIGNED_BYTE;
-				if (newSurface->format->BytesPerPixel == 4)
-				{
-					if(newSurface->format->Rmask == 0xff)
-					{
-						format = GL_RGBA;
-						textureType = GL_UNSIGNED_INT_8_8_8_8_REV;
-					}
-					else
-					{
-						format = GL_BGRA;
-						textureType = GL_UNSIGNED_INT_8_8_8_8;
-					}
-					internalFormat = GL_RGBA8;
-				}
-				else if(newSurface->format->BytesPerPixel == 3)
-				{
-					if(newSurface->format->Rmask == 0xff)
-						format = GL_RGB;
-					else
-						format = GL_BGR;
-					internalFormat = GL_RGB8;
-				}
-
-				SDL_LockSurface(newSurface);
-				GLuint id = createTexture(GL_TEXTURE_2D,
-										  newSurface->w,
-										  newSurface->h,
-										  format,
-										  internalFormat,
-										  textureType,
-					                      newSurface->pixels);
-				SDL_UnlockSurface(newSurface);
-
-				index = createNewIndex();
-				TextureObj *newTexture = &textureList[index];
-				newTexture->id         = id;
-				newTexture->surface    = newSurface;
-				newTexture->target     = GL_TEXTURE_2D;
-				newTexture->refCount++;
-				setTextureParameter(index, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-				setTextureParameter(index, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-				setTextureParameter(index,GL_TEXTURE_WRAP_S,GL_REPEAT);
-				setTextureParameter(index,GL_TEXTURE_WRAP_T,GL_REPEAT);
-			
-				if(newTexture->name != NULL)
-					free(newTexture->name);
-		
-				newTexture->name = (char *)malloc(strlen(filename) + 1);
-				strcpy(newTexture->name, filename);
-				Log::message("Texture : " + std::string(filename) + " created.");
+				format = GL_RGBA;
+				textureType = GL_UNSIGNED_INT_8_8_8_8_REV;
 			}
 			else
 			{
-				Log::error("Texture::create", IMG_GetError());
+				format = GL_BGRA;
+				textureType = GL_UNSIGNED_INT_8_8_8_8;
 			}
+			internalFormat = GL_RGBA8;
+		}
+		else if(newSurface->format->BytesPerPixel == 3)
+		{
+			if(newSurface->format->Rmask == 0xff)
+				format = GL_RGB;
+			else
+				format = GL_BGR;
+			internalFormat = GL_RGB8;
+		}
+
+		SDL_LockSurface(newSurface);
+		GLuint id = createTexture(GL_TEXTURE_2D,
+								  newSurface->w,
+								  newSurface->h,
+								  format,
+								  internalFormat,
+								  textureType,
+								  newSurface->pixels);
+		SDL_UnlockSurface(newSurface);
+
+		index = createNewIndex();
+		TextureObj *newTexture = &textureList[index];
+		newTexture->id         = id;
+		newTexture->surface    = newSurface;
+		newTexture->target     = GL_TEXTURE_2D;
+		ResourceRegistry::insert(ResourceRegistry::RT_TEXTURE, index, filename);
+		setTextureParameter(index, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		setTextureParameter(index, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		setTextureParameter(index,GL_TEXTURE_WRAP_S,GL_REPEAT);
+		setTextureParameter(index,GL_TEXTURE_WRAP_T,GL_REPEAT);
+		Log::message("Texture : " + std::string(filename) + " created.");
+		return index;
+	}
+	
+	int create(const char* filename)
+	{
+		LoadProfiler::ScopedTimer timer(LoadProfiler::LP_TEXTURE, filename);
+		int index = isLoaded(filename);
+		if(index == -1)
+		{
+			SDL_Surface* newSurface = decode(filename);
+			if(newSurface)
+				index = create(filename, newSurface);
+			else
+				Log::error("Texture::create", IMG_GetError());
 		}
 		else
 		{
-			textureList[index].refCount++;
+			ResourceRegistry::addRef(ResourceRegistry::RT_TEXTURE, index);
 		}
 		return index;
 	}
@@ -238,9 +251,7 @@ namespace Texture
 		newTexture->id         = id;
 		newTexture->surface    = NULL;
 		newTexture->target     = target;
-		newTexture->name       = (char*)malloc(strlen(name) + 1);
-		strcpy(newTexture->name, name);
-		newTexture->refCount++;
+		ResourceRegistry::insert(ResourceRegistry::RT_TEXTURE, index, name);
 		Log::message("New custom texture created");
 		return index;
 	}
@@ -249,25 +260,12 @@ namespace Texture
 	{
 		if(textureIndex >=0 && textureIndex < (int)textureList.size())
 		{
-			TextureObj *textureObj = &textureList[textureIndex];
-			if(textureObj->refCount == 1)
+			if(ResourceRegistry::release(ResourceRegistry::RT_TEXTURE, textureIndex) == 0)
 			{
-				glDeleteTextures(1, &textureObj->id);
-				textureObj->id = 0;
-				if(textureObj->surface != NULL)
-				{
-					// free(textureObj->surface->pixels);
-					SDL_FreeSurface(textureObj->surface);
-					textureObj->surface = NULL;
-				}
-				if(textureObj->name != NULL)
-				{
-					free(textureObj->name);
-					textureObj->name = NULL;
-				}
+				destroy(&textureList[textureIndex]);
+				ResourceRegistry::remove(ResourceRegistry::RT_TEXTURE, textureIndex);
 				emptyIndices.push_back(textureIndex);
 			}
-			textureObj->refCount--;
 		}
 		else
 		{
@@ -295,8 +293,7 @@ namespace Texture
 	{		
 		if(textureIndex >= 0 && textureIndex < (int)textureList.size())
 		{
-			TextureObj* obj = &textureList[textureIndex];
-			return obj->name;
+			return ResourceRegistry::getPath(ResourceRegistry::RT_TEXTURE, textureIndex);
 		}
 		else
 		{
@@ -318,7 +315,7 @@ namespace Texture
 	{
 		if(textureIndex >= 0 && textureIndex < (int)textureList.size())
 		{
-			textureList[textureIndex].refCount++;
+			ResourceRegistry::addRef(ResourceRegistry::RT_TEXTURE, textureIndex);
 		}
 		else
 		{
@@ -329,23 +326,17 @@ namespace Texture
 
 	void decreaseRefCount(int textureIndex)
 	{
-		if(textureIndex >= 0 && textureIndex < (int)textureList.size())
-		{
-			if(--textureList[textureIndex].refCount == 0)
-				remove(textureIndex);
-		}
-		else
-		{
-			Log::error("Texture::decreaseRefcount",
-					   "Texture index " + std::to_string(textureIndex) + "is invalid");
-		}
+		remove(textureIndex);
 	}
 
 	void cleanup()
 	{
 		free(texturePath);
-		for(unsigned int i = 0; i < textureList.size(); i ++)
-			remove(i);
+		std::vector<ResourceRegistry::Resource> textures;
+		ResourceRegistry::getResources(ResourceRegistry::RT_TEXTURE, &textures);
+		for(const ResourceRegistry::Resource& texture : textures)
+			destroy(&textureList[texture.slot]);
+		ResourceRegistry::clear(ResourceRegistry::RT_TEXTURE);
 		textureList.clear();
 		emptyIndices.clear();
 		IMG_Quit();
@@ -1,6 +1,8 @@
 #ifndef texture_H
 #define texture_H
 
+struct SDL_Surface;
+
 enum TextureUnit
 {
 	TU_SHADOWMAP0 = 0,
@@ -13,6 +15,8 @@ enum TextureUnit
 namespace Texture
 {
 	int          create(const char* filename);
+	int          create(const char* filename, SDL_Surface* surface); // Uploads a decoded image and takes ownership of it
+	SDL_Surface* decode(const char* filename); // Safe to call from any thread, NULL on failure
     void         remove(int textureIndex);
 	void         setTextureParameter(int textureIndex, int parameter, int value);
 	void         initialize(const char* path);
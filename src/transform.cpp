@@ -1,6 +1,10 @@
 #include <vector>
+#include <algorithm>
 
 #include "transform.h"
+#include "transformbatch.h"
+#include "workerpool.h"
+#include "componentpool.h"
 #include "scriptengine.h"
 #include "gameobject.h"
 #include "scenemanager.h"
@@ -11,118 +15,624 @@ namespace Transform
 	namespace
 	{
 		const float epsilon = 0.005f;
-		std::vector<CTransform>   transformList;
-		std::vector<unsigned int> emptyIndices;
+		const int   parallelBatchSize = 256;   // Matrices per worker batch, smaller flushes stay on one thread
+		// Transform columns, every vector is indexed by CTransform::index.
+		// Position, rotation, scale, lookAt, up and forward are relative to the parent.
+		std::vector<Vec3>             positions;
+		std::vector<Quat>             rotations;
+		std::vector<Vec3>             scales;
+		std::vector<Mat4>             worldMatrices;
+		std::vector<Quat>             worldRotations;
+		std::vector<Vec3>             lookAts;
+		std::vector<Vec3>             ups;
+		std::vector<Vec3>             forwards;
+		std::vector<Node>             nodes;
+		std::vector<int>              parents;      // Transform index of the parent, -1 for roots
+		std::vector<int>              depths;       // Number of ancestors
+		std::vector<std::vector<int>> children;
+		std::vector<uint8_t>          dirtyFlags;
+		ComponentPool<CTransform, 12> proxies;      // Hands out the indices, handles given out never move
+		std::vector<int>              dirtyList;    // Transforms modified since last flush
+		std::vector<int>              composeList;  // Scratch list of matrices rebuilt by flush, sorted by depth
+
+		// World state a transform had before the last fixed step moved it, only kept for
+		// the few that did so rendering can blend it with the current one
+		struct PreviousState
+		{
+			int  index;
+			Vec3 position;
+			Quat rotation;
+			Vec3 scale;
+			Mat4 renderMatrix;
+		};
+		std::vector<int32_t>          previousSlots;  // Slot in previousStates, -1 renders the world matrix
+		std::vector<PreviousState>    previousStates;
+		bool                          inFixedStep = false;
+
+		enum DirtyFlag : uint8_t
+		{
+			DF_NONE    = 0,
+			DF_MATRIX  = 1 << 0,  // World matrix of this transform and its subtree needs to be rebuilt
+			DF_SYNC    = 1 << 1,  // Attached components need to be synced
+			DF_PHYSICS = 1 << 2,  // Sync should also push the transform into the rigidbody
+			DF_QUEUED  = 1 << 3   // Already in dirtyList
+		};
+
+		void resetSlot(int index, Node node)
+		{
+			positions[index]     = Vec3(0.f);
+			rotations[index]     = Quat();
+			scales[index]        = Vec3(1.f);
+			worldMatrices[index]  = Mat4();
+			worldRotations[index] = Quat();
+			lookAts[index]        = Vec3(0.f, 0.f, -5.f);
+			ups[index]            = Vec3(0.f, 1.f, 0.f);
+			forwards[index]       = Vec3(0.f, 0.f, -1.f);
+			nodes[index]          = node;
+			parents[index]        = -1;
+			depths[index]         = 0;
+			dirtyFlags[index]    &= DF_QUEUED; // A recycled slot may still be in dirtyList
+			previousSlots[index]  = -1;
+			proxies[index].index  = index;
+			children[index].clear();
+		}
+
+		// Expects the local matrix of index in worldMatrices and the parent's world data to be current
+		inline void applyParent(int index)
+		{
+			int parent = parents[index];
+			if(parent == -1)
+			{
+				worldRotations[index] = rotations[index];
+			}
+			else
+			{
+				worldMatrices[index]  = worldMatrices[parent] * worldMatrices[index];
+				worldRotations[index] = worldRotations[parent] * rotations[index];
+			}
+		}
+
+		void composeMatrix(int index)
+		{
+			TransformBatch::compose(positions.data(), rotations.data(), scales.data(), worldMatrices.data(), &index, 1);
+			applyParent(index);
+		}
+
+		// composeList is sorted by depth and every call only covers one depth level,
+		// so parents are always finished before their children are composed
+		void composeRange(int begin, int end)
+		{
+			TransformBatch::compose(positions.data(),
+									rotations.data(),
+									scales.data(),
+									worldMatrices.data(),
+									&composeList[begin],
+									end - begin);
+			for(int i = begin; i < end; i++)
+			{
+				int index = composeList[i];
+				applyParent(index);
+				dirtyFlags[index] &= ~DF_MATRIX;
+			}
+		}
+
+		// True if this transform or one of its ancestors changed since the last flush
+		bool isStale(int index)
+		{
+			for(int i = index; i != -1; i = parents[i])
+			{
+				if(dirtyFlags[i] & DF_MATRIX) return true;
+			}
+			return false;
+		}
+
+		// Rebuilds the world data of index from the root down without touching the dirty
+		// flags, so the next flush still propagates the change to the rest of the subtree
+		void composeChain(int index)
+		{
+			if(parents[index] != -1) composeChain(parents[index]);
+			composeMatrix(index);
+		}
+
+		inline void ensureWorld(int index)
+		{
+			if(isStale(index)) composeChain(index);
+		}
+
+		// The first change inside a fixed step saves the world state from before it. Changes
+		// outside of one are teleports and snap, the world matrix is drawn until the next step.
+		void trackPrevious(int index)
+		{
+			if(!inFixedStep)
+			{
+				previousSlots[index] = -1;
+				return;
+			}
+			if(previousSlots[index] != -1) return;
+
+			const Mat4& worldMatrix = worldMatrices[index];
+			PreviousState state;
+			state.index    = index;
+			state.position = Vec3(worldMatrix[3]);
+			state.rotation = worldRotations[index];
+			state.scale    = Vec3(glm::length(Vec3(worldMatrix[0])),
+								  glm::length(Vec3(worldMatrix[1])),
+								  glm::length(Vec3(worldMatrix[2])));
+			state.renderMatrix = worldMatrix;
+			previousSlots[index] = (int32_t)previousStates.size();
+			previousStates.push_back(state);
+		}
+
+		void queue(int index)
+		{
+			trackPrevious(index);
+			if(!(dirtyFlags[index] & DF_QUEUED))
+			{
+				dirtyList.push_back(index);
+				dirtyFlags[index] |= DF_QUEUED;
+			}
+		}
+
+		void markDirty(CTransform* transform, bool syncPhysics)
+		{
+			int index = transform->index;
+			queue(index);
+			dirtyFlags[index] |= DF_MATRIX | DF_SYNC;
+			if(syncPhysics) dirtyFlags[index] |= DF_PHYSICS;
+		}
+
+		void updateDepths(int index, int depth)
+		{
+			depths[index] = depth;
+			for(int child : children[index]) updateDepths(child, depth + 1);
+		}
+
+		void detachFromParent(int index)
+		{
+			int parent = parents[index];
+			if(parent == -1) return;
+			std::vector<int>& siblings = children[parent];
+			std::vector<int>::iterator it = std::find(siblings.begin(), siblings.end(), index);
+			if(it != siblings.end())
+			{
+				*it = siblings.back();
+				siblings.pop_back();
+			}
+			parents[index] = -1;
+		}
+
+		// Wrappers for scripts which can't pass the syncPhysics default argument
+		void setPositionScript(CTransform* transform, Vec3 position) { setPosition(transform, position); }
+		void setScaleScript(CTransform* transform, Vec3 scale)       { setScale(transform, scale);       }
+		void setRotationScript(CTransform* transform, Quat rotation) { setRotation(transform, rotation); }
+		void updateTransformMatrixScript(CTransform* transform)      { updateTransformMatrix(transform); }
+		void setWorldPositionScript(CTransform* transform, Vec3 position) { setWorldPosition(transform, position); }
+		void setWorldRotationScript(CTransform* transform, Quat rotation) { setWorldRotation(transform, rotation); }
 	}
 
 	int create(Node node)
 	{
-		CTransform newTransform;
-		newTransform.node = node;
-		Transform::updateTransformMatrix(&newTransform);
-		int index = 0;	
-		if(emptyIndices.empty())
+		int index = proxies.create();
+		if(index == (int)nodes.size())
 		{
-			transformList.push_back(newTransform);
-			index = transformList.size() - 1;
-		}
-		else
-		{
-			index = emptyIndices.back();
-			transformList[index] = newTransform;
-			emptyIndices.pop_back();
+			positions.push_back(Vec3());
+			rotations.push_back(Quat());
+			scales.push_back(Vec3());
+			worldMatrices.push_back(Mat4());
+			worldRotations.push_back(Quat());
+			lookAts.push_back(Vec3());
+			ups.push_back(Vec3());
+			forwards.push_back(Vec3());
+			nodes.push_back(-1);
+			parents.push_back(-1);
+			depths.push_back(0);
+			children.push_back(std::vector<int>());
+			dirtyFlags.push_back(DF_NONE);
+			previousSlots.push_back(-1);
 		}
+		resetSlot(index, node);
+		composeMatrix(index);
 		return index;
 	}
 
+	void reserve(int count)
+	{
+		if(count <= 0) return;
+		proxies.reserve(count);
+		// Recycled slots may cover part of it, reserving a little too much is harmless.
+		// Grow at least geometrically so many small reservations stay linear overall.
+		size_t capacity = std::max(nodes.size() + count, nodes.capacity() * 2);
+		if(nodes.size() + count <= nodes.capacity()) return;
+		positions.reserve(capacity);
+		rotations.reserve(capacity);
+		scales.reserve(capacity);
+		worldMatrices.reserve(capacity);
+		worldRotations.reserve(capacity);
+		lookAts.reserve(capacity);
+		ups.reserve(capacity);
+		forwards.reserve(capacity);
+		nodes.reserve(capacity);
+		parents.reserve(capacity);
+		depths.reserve(capacity);
+		children.reserve(capacity);
+		dirtyFlags.reserve(capacity);
+		previousSlots.reserve(capacity);
+	}
+
 	void cleanup()
 	{
-		transformList.clear();
-		emptyIndices.clear();
+		positions.clear();
+		rotations.clear();
+		scales.clear();
+		worldMatrices.clear();
+		worldRotations.clear();
+		lookAts.clear();
+		ups.clear();
+		forwards.clear();
+		nodes.clear();
+		parents.clear();
+		depths.clear();
+		children.clear();
+		dirtyFlags.clear();
+		proxies.clear();
+		dirtyList.clear();
+		composeList.clear();
+		previousSlots.clear();
+		previousStates.clear();
 	}
 
 	CTransform* getTransformAtIndex(int transformIndex)
 	{
 		CTransform* transform = NULL;
-		if(transformIndex >= 0 && transformIndex < (int)transformList.size())
-			transform = &transformList[transformIndex];
+		if(transformIndex >= 0 && transformIndex < proxies.size())
+			transform = &proxies[transformIndex];
 		return transform;
 	}
 
 	bool remove(unsigned int transformIndex)
 	{
-		bool alreadyRemoved = true;
-		for(unsigned int i = 0; i < emptyIndices.size(); i++)
+		bool alreadyRemoved = transformIndex >= nodes.size() || nodes[transformIndex] == -1;
+		if(!alreadyRemoved)
 		{
-			if(emptyIndices[i] == transformIndex)
-			{
-				alreadyRemoved = true;
-				break;
-			}
+			// Children stay where they are in the world and become roots
+			std::vector<int> orphans = children[transformIndex];
+			for(int child : orphans) setParent(&proxies[child], NULL, true);
+			detachFromParent(transformIndex);
+			nodes[transformIndex]         = -1;
+			dirtyFlags[transformIndex]   &= DF_QUEUED;
+			previousSlots[transformIndex] = -1;
+			proxies.remove(transformIndex);
 		}
-		if(!alreadyRemoved)
-			emptyIndices.push_back(transformIndex);
 		else
+		{
 			Log::warning("Transform at index " + std::to_string(transformIndex) + " already removed!");
+		}
 		return alreadyRemoved ? false : true;
 	}
 
+	int remove(const std::vector<int>& transformIndices)
+	{
+		// Clearing the node first marks what goes away so links inside the batch can simply
+		// be dropped. Only children outside of it have to be reparented and only parents
+		// outside of it need their child lists compacted.
+		std::vector<int> removed;
+		removed.reserve(transformIndices.size());
+		for(int index : transformIndices)
+		{
+			if(index >= 0 && index < (int)nodes.size() && nodes[index] != -1)
+			{
+				nodes[index] = -1;
+				removed.push_back(index);
+			}
+			else
+			{
+				Log::warning("Transform at index " + std::to_string(index) + " already removed!");
+			}
+		}
+		// Survivors need the world transforms of the chain above them, unlink only afterwards
+		for(int index : removed)
+		{
+			for(size_t i = 0; i < children[index].size(); )
+			{
+				int child = children[index][i];
+				if(nodes[child] != -1)
+					setParent(&proxies[child], NULL, true); // Takes child out of the list
+				else
+					i++;
+			}
+		}
+		std::vector<int> survivingParents;
+		for(int index : removed)
+		{
+			int parent = parents[index];
+			if(parent != -1 && nodes[parent] != -1) survivingParents.push_back(parent);
+			parents[index] = -1;
+			children[index].clear();
+			dirtyFlags[index] &= DF_QUEUED;
+			previousSlots[index] = -1;
+			proxies.remove(index);
+		}
+
+		std::sort(survivingParents.begin(), survivingParents.end());
+		survivingParents.erase(std::unique(survivingParents.begin(), survivingParents.end()), survivingParents.end());
+		for(int parent : survivingParents)
+		{
+			std::vector<int>& siblings = children[parent];
+			siblings.erase(std::remove_if(siblings.begin(), siblings.end(), [] (int child) { return nodes[child] == -1; }),
+						   siblings.end());
+		}
+		return (int)removed.size();
+	}
+
 	void updateTransformMatrix(CTransform* transform, bool syncPhysics)
 	{
-		Mat4 translationMat    = glm::translate(Mat4(1.0f), transform->position);
-		Mat4 scaleMat          = glm::scale(Mat4(1.0f), transform->scale);
-		Mat4 rotationMat       = glm::toMat4(glm::normalize(transform->rotation));
-		transform->transMat    = translationMat * rotationMat * scaleMat;
-		GameObject* gameObject = SceneManager::find(transform->node);
+		int index = transform->index;
+		trackPrevious(index);
+		composeChain(index);
+		// Children are left to the next flush, which needs the flag to find them
+		dirtyFlags[index] &= DF_QUEUED;
+		if(!children[index].empty())
+		{
+			queue(index);
+			dirtyFlags[index] |= DF_MATRIX;
+		}
+		GameObject* gameObject = SceneManager::find(nodes[index]);
 		GO::syncComponents(gameObject, syncPhysics);
 	}
 
+	void flush()
+	{
+		// Collect changed transforms and everything below them. DF_MATRIX doubles as the
+		// queued marker so a subtree reached from two dirty ancestors is only added once.
+		composeList.clear();
+		int maxDepth = 0;
+		for(int index : dirtyList)
+		{
+			if(dirtyFlags[index] & DF_MATRIX) composeList.push_back(index);
+		}
+		for(size_t i = 0; i < composeList.size(); i++)
+		{
+			int index = composeList[i];
+			maxDepth  = std::max(maxDepth, depths[index]);
+			for(int child : children[index])
+			{
+				if(!(dirtyFlags[child] & DF_MATRIX)) composeList.push_back(child);
+				queue(child);
+				dirtyFlags[child] |= DF_MATRIX | DF_SYNC | DF_PHYSICS;
+			}
+		}
+
+		// Transforms on the same depth only read their own slot and their parent's, which was
+		// finished on an earlier level, so each level is one batched pass over the worker pool
+		if(maxDepth > 0)
+		{
+			std::sort(composeList.begin(), composeList.end(), [](int a, int b) { return depths[a] < depths[b]; });
+		}
+		int levelStart = 0;
+		int count      = (int)composeList.size();
+		while(levelStart < count)
+		{
+			int depth    = depths[composeList[levelStart]];
+			int levelEnd = levelStart + 1;
+			while(levelEnd < count && depths[composeList[levelEnd]] == depth) levelEnd++;
+			WorkerPool::parallelFor(levelEnd - levelStart, parallelBatchSize, [levelStart](int begin, int end) {
+				composeRange(levelStart + begin, levelStart + end);
+			});
+			levelStart = levelEnd;
+		}
+
+		// Component sync touches bullet and the other modules, keep it on this thread
+		for(int index : dirtyList)
+		{
+			uint8_t flags = dirtyFlags[index];
+			dirtyFlags[index] = DF_NONE;
+			if(!(flags & DF_SYNC) || nodes[index] == -1) continue;
+			
+			GameObject* gameObject = SceneManager::find(nodes[index]);
+			if(gameObject) GO::syncComponents(gameObject, (flags & DF_PHYSICS) != 0);
+		}
+		dirtyList.clear();
+	}
+
+	void beginFixedStep()
+	{
+		// Only what the new step moves needs a previous state, everything else is at rest
+		for(size_t i = 0; i < previousStates.size(); i++)
+		{
+			int index = previousStates[i].index;
+			if(previousSlots[index] == (int32_t)i) previousSlots[index] = -1;
+		}
+		previousStates.clear();
+		inFixedStep = true;
+	}
+
+	void endFixedStep()
+	{
+		inFixedStep = false;
+	}
+
+	void interpolate(float alpha)
+	{
+		alpha = glm::clamp(alpha, 0.f, 1.f);
+		WorkerPool::parallelFor((int)previousStates.size(), parallelBatchSize, [alpha](int begin, int end) {
+			for(int i = begin; i < end; i++)
+			{
+				PreviousState& state = previousStates[i];
+				int index = state.index;
+				if(previousSlots[index] != i) continue; // Snapped or removed since the step
+
+				const Mat4& worldMatrix = worldMatrices[index];
+				Vec3 scale(glm::length(Vec3(worldMatrix[0])),
+						   glm::length(Vec3(worldMatrix[1])),
+						   glm::length(Vec3(worldMatrix[2])));
+				Mat4 matrix = glm::mat4_cast(glm::slerp(state.rotation, worldRotations[index], alpha));
+				matrix[0]  *= glm::mix(state.scale.x, scale.x, alpha);
+				matrix[1]  *= glm::mix(state.scale.y, scale.y, alpha);
+				matrix[2]  *= glm::mix(state.scale.z, scale.z, alpha);
+				matrix[3]   = Vec4(glm::mix(state.position, Vec3(worldMatrix[3]), alpha), 1.f);
+				state.renderMatrix = matrix;
+			}
+		});
+	}
+
+	const Mat4& getRenderMatrix(const CTransform* transform)
+	{
+		int slot = previousSlots[transform->index];
+		return slot != -1 ? previousStates[slot].renderMatrix : getWorldMatrix(transform);
+	}
+
+	bool setParent(CTransform* transform, CTransform* parent, bool keepWorldTransform)
+	{
+		PA_ASSERT(transform);
+		int index       = transform->index;
+		int parentIndex = parent ? parent->index : -1;
+		if(parents[index] == parentIndex) return true;
+		for(int i = parentIndex; i != -1; i = parents[i])
+		{
+			if(i == index)
+			{
+				Log::error("Transform::setParent", "Cannot parent a transform to itself or to one of its children");
+				return false;
+			}
+		}
+
+		Vec3 worldPosition;
+		Quat worldRotation;
+		Vec3 worldScale;
+		if(keepWorldTransform)
+		{
+			worldPosition = getWorldPosition(transform);
+			worldRotation = getWorldRotation(transform);
+			worldScale    = getWorldScale(transform);
+		}
+
+		detachFromParent(index);
+		if(parentIndex != -1)
+		{
+			parents[index] = parentIndex;
+			children[parentIndex].push_back(index);
+		}
+		updateDepths(index, parentIndex == -1 ? 0 : depths[parentIndex] + 1);
+
+		if(keepWorldTransform)
+		{
+			// Scale is divided per axis, shear from non-uniformly scaled and rotated parents is lost
+			if(parentIndex != -1)
+			{
+				worldScale    /= getWorldScale(parent);
+				worldRotation  = glm::inverse(getWorldRotation(parent)) * worldRotation;
+			}
+			scales[index] = worldScale;
+			setRotation(transform, worldRotation);
+			setWorldPosition(transform, worldPosition);
+		}
+		markDirty(transform, true);
+		return true;
+	}
+
+	CTransform* getParent(const CTransform* transform)
+	{
+		int parent = parents[transform->index];
+		return parent != -1 ? &proxies[parent] : NULL;
+	}
+
+	int getChildCount(const CTransform* transform)
+	{
+		return (int)children[transform->index].size();
+	}
+
+	CTransform* getChild(const CTransform* transform, int childIndex)
+	{
+		const std::vector<int>& childList = children[transform->index];
+		CTransform* child = NULL;
+		if(childIndex >= 0 && childIndex < (int)childList.size())
+			child = &proxies[childList[childIndex]];
+		return child;
+	}
+
+	void setWorldPosition(CTransform* transform, Vec3 position, bool syncPhysics)
+	{
+		PA_ASSERT(transform);
+		int parent = parents[transform->index];
+		if(parent != -1)
+		{
+			ensureWorld(parent);
+			position = Vec3(glm::inverse(worldMatrices[parent]) * Vec4(position, 1.f));
+		}
+		setPosition(transform, position, syncPhysics);
+	}
+
+	void setWorldRotation(CTransform* transform, Quat rotation, bool syncPhysics)
+	{
+		PA_ASSERT(transform);
+		int parent = parents[transform->index];
+		if(parent != -1)
+		{
+			ensureWorld(parent);
+			rotation = glm::inverse(worldRotations[parent]) * rotation;
+		}
+		setRotation(transform, rotation, syncPhysics);
+	}
+
 	void updateLookAt(CTransform* transform)
 	{
-		Vec3 newLookAt = transform->rotation * -UNIT_Z;
-		transform->lookAt = transform->position + newLookAt;
+		int  index     = transform->index;
+		Vec3 newLookAt = rotations[index] * -UNIT_Z;
+		lookAts[index] = positions[index] + newLookAt;
 	}
 
 	void updateUpVector(CTransform* transform)
 	{
-		transform->up = glm::normalize(transform->rotation * UNIT_Y);
+		int index  = transform->index;
+		ups[index] = glm::normalize(rotations[index] * UNIT_Y);
 	}
 
 	void updateForward(CTransform* transform)
 	{
-		transform->forward = glm::normalize(transform->rotation * -UNIT_Z);
+		int index       = transform->index;
+		forwards[index] = glm::normalize(rotations[index] * -UNIT_Z);
 	}
 
 	void setPosition(CTransform* transform, Vec3 position, bool syncPhysics)
 	{
 		PA_ASSERT(transform);
-		transform->position = position;
+		positions[transform->index] = position;
 		updateLookAt(transform);
-		updateTransformMatrix(transform, syncPhysics);
+		markDirty(transform, syncPhysics);
 	}
 
 	void translate(CTransform* transform, Vec3 offset, Space transformSpace)
 	{
 		PA_ASSERT(transform);
+		int index  = transform->index;
+		int parent = parents[index];
 		if(transformSpace == Space::TS_LOCAL)
-			offset = transform->rotation * offset;
-		transform->position += offset;
+		{
+			offset = rotations[index] * offset;
+		}
+		else if(parent != -1)
+		{
+			ensureWorld(parent);
+			offset = Vec3(glm::inverse(worldMatrices[parent]) * Vec4(offset, 0.f));
+		}
+		positions[index] += offset;
 		updateLookAt(transform);
-		updateTransformMatrix(transform);
+		markDirty(transform, true);
 	}
 
 	void setForward(CTransform* transform, Vec3 direction)
 	{
 		PA_ASSERT(transform);
 		//TODO: Fix this function by comparing with jDoom
-		Vec3  newForward = glm::normalize(direction);
-		float angle      = glm::dot(transform->forward, newForward);
+		const Vec3& forward    = forwards[transform->index];
+		Vec3        newForward = glm::normalize(direction);
+		float       angle      = glm::dot(forward, newForward);
 		//angle = glm::clamp(angle, -1.f, 1.f);
 		angle = glm::acos(angle);
 		angle = glm::degrees(-angle);
 		if(angle > epsilon || angle < -epsilon)
 		{
-			Vec3 rotationAxis = glm::cross(newForward, transform->forward);
+			Vec3 rotationAxis = glm::cross(newForward, forward);
 			rotate(transform, glm::normalize(rotationAxis), angle);
 		}
 	}
@@ -130,42 +640,56 @@ namespace Transform
 	void rotate(CTransform* transform, Vec3 axis, float angle, Space transformSpace)
 	{
 		PA_ASSERT(transform);
+		int   index    = transform->index;
+		int   parent   = parents[index];
+		Quat& rotation = rotations[index];
 		angle = glm::radians(angle);
 		if(transformSpace == Space::TS_LOCAL)
-			transform->rotation *= glm::normalize(glm::angleAxis(angle, axis));
+		{
+			rotation *= glm::normalize(glm::angleAxis(angle, axis));
+		}
 		else
-			transform->rotation  = glm::normalize(glm::angleAxis(angle, axis)) * transform->rotation;
+		{
+			// World axis expressed in the parent's space
+			if(parent != -1)
+			{
+				ensureWorld(parent);
+				axis = glm::inverse(worldRotations[parent]) * axis;
+			}
+			rotation  = glm::normalize(glm::angleAxis(angle, axis)) * rotation;
+		}
 		updateUpVector(transform);
 		updateLookAt(transform);
 		updateForward(transform);
-		updateTransformMatrix(transform);
+		markDirty(transform, true);
 	}
 
 	void setScale(CTransform* transform, Vec3 newScale, bool syncPhysics)
 	{
 		PA_ASSERT(transform);
-		transform->scale = newScale;
-		updateTransformMatrix(transform, syncPhysics);
+		scales[transform->index] = newScale;
+		markDirty(transform, syncPhysics);
 	}
 
 	void setLookAt(CTransform* transform, Vec3 lookAt)
 	{
 		PA_ASSERT(transform);
-		Vec3 direction = lookAt - transform->position;	
+		Vec3 direction = lookAt - positions[transform->index];
 		setForward(transform, glm::normalize(direction));
 	}
 
 	void setUpVector(CTransform* transform, Vec3 up)
 	{
 		PA_ASSERT(transform);
+		const Vec3& currentUp = ups[transform->index];
 		Vec3  newUp = glm::normalize(up);
-		float angle = glm::dot(transform->up, newUp);
+		float angle = glm::dot(currentUp, newUp);
 		angle = glm::acos(angle);
 		angle = glm::degrees(-angle);
 	
 		if(angle > epsilon || angle < -epsilon)
 		{
-			Vec3 rotationAxis = glm::cross(newUp, transform->up);
+			Vec3 rotationAxis = glm::cross(newUp, currentUp);
 			rotate(transform, glm::normalize(rotationAxis), angle);
 		}
 	}
@@ -173,11 +697,124 @@ namespace Transform
 	void setRotation(CTransform* transform, Quat newRotation, bool syncPhysics)
 	{
 		PA_ASSERT(transform);
-		transform->rotation = newRotation;
+		rotations[transform->index] = newRotation;
 		updateUpVector(transform);
 		updateLookAt(transform);
 		updateForward(transform);
-		updateTransformMatrix(transform, syncPhysics);
+		markDirty(transform, syncPhysics);
+	}
+
+	Node getNode(const CTransform* transform)
+	{
+		return nodes[transform->index];
+	}
+
+	const Vec3& getPosition(const CTransform* transform)
+	{
+		return positions[transform->index];
+	}
+
+	const Vec3& getScale(const CTransform* transform)
+	{
+		return scales[transform->index];
+	}
+
+	const Quat& getRotation(const CTransform* transform)
+	{
+		return rotations[transform->index];
+	}
+
+	const Vec3& getLookAt(const CTransform* transform)
+	{
+		return lookAts[transform->index];
+	}
+
+	const Vec3& getUp(const CTransform* transform)
+	{
+		return ups[transform->index];
+	}
+
+	const Vec3& getForward(const CTransform* transform)
+	{
+		return forwards[transform->index];
+	}
+
+	const Mat4& getWorldMatrix(const CTransform* transform)
+	{
+		// Rebuild on read so callers between a set and the next flush never see a stale matrix
+		int index = transform->index;
+		ensureWorld(index);
+		return worldMatrices[index];
+	}
+
+	const Quat& getWorldRotation(const CTransform* transform)
+	{
+		int index = transform->index;
+		ensureWorld(index);
+		return worldRotations[index];
+	}
+
+	Vec3 getWorldPosition(const CTransform* transform)
+	{
+		return Vec3(getWorldMatrix(transform)[3]);
+	}
+
+	Vec3 getWorldScale(const CTransform* transform)
+	{
+		const Mat4& worldMatrix = getWorldMatrix(transform);
+		return Vec3(glm::length(Vec3(worldMatrix[0])),
+					glm::length(Vec3(worldMatrix[1])),
+					glm::length(Vec3(worldMatrix[2])));
+	}
+
+	Vec3 getWorldForward(const CTransform* transform)
+	{
+		return glm::normalize(getWorldRotation(transform) * -UNIT_Z);
+	}
+
+	Vec3 getWorldUp(const CTransform* transform)
+	{
+		return glm::normalize(getWorldRotation(transform) * UNIT_Y);
+	}
+
+	Vec3 getWorldLookAt(const CTransform* transform)
+	{
+		return getWorldPosition(transform) + getWorldForward(transform);
+	}
+
+	int getCount()
+	{
+		return (int)nodes.size();
+	}
+
+	const Node* getNodes()
+	{
+		return nodes.data();
+	}
+
+	const Vec3* getPositions()
+	{
+		return positions.data();
+	}
+
+	const Quat* getRotations()
+	{
+		return rotations.data();
+	}
+
+	const Vec3* getScales()
+	{
+		return scales.data();
+	}
+
+	const Vec3* getForwards()
+	{
+		return forwards.data();
+	}
+
+	const Mat4* getWorldMatrices()
+	{
+		return worldMatrices.data();
 	}
 
 	void generateBindings()
@@ -189,17 +826,91 @@ namespace Transform
 		
 		engine->RegisterObjectType("Transform", sizeof(CTransform), asOBJ_REF | asOBJ_NOCOUNT);
 		PA_ASSERT(rc >= 0);
-		rc = engine->RegisterObjectProperty("Transform", "Vec3 position", asOFFSET(CTransform, position));
+		// Transform data lives in separate columns so fields are exposed as virtual properties
+		rc = engine->RegisterObjectMethod("Transform",
+										  "const Vec3& get_position() const",
+										  asFUNCTION(getPosition),
+										  asCALL_CDECL_OBJFIRST);
+		PA_ASSERT(rc >= 0);
+		rc = engine->RegisterObjectMethod("Transform",
+										  "void set_position(Vec3)",
+										  asFUNCTION(setPositionScript),
+										  asCALL_CDECL_OBJFIRST);
+		PA_ASSERT(rc >= 0);
+		rc = engine->RegisterObjectMethod("Transform",
+										  "const Vec3& get_forward() const",
+										  asFUNCTION(getForward),
+										  asCALL_CDECL_OBJFIRST);
+		PA_ASSERT(rc >= 0);
+		rc = engine->RegisterObjectMethod("Transform",
+										  "void set_forward(Vec3)",
+										  asFUNCTION(setForward),
+										  asCALL_CDECL_OBJFIRST);
+		PA_ASSERT(rc >= 0);
+		rc = engine->RegisterObjectMethod("Transform",
+										  "const Vec3& get_scale() const",
+										  asFUNCTION(getScale),
+										  asCALL_CDECL_OBJFIRST);
+		PA_ASSERT(rc >= 0);
+		rc = engine->RegisterObjectMethod("Transform",
+										  "void set_scale(Vec3)",
+										  asFUNCTION(setScaleScript),
+										  asCALL_CDECL_OBJFIRST);
+		PA_ASSERT(rc >= 0);
+		rc = engine->RegisterObjectMethod("Transform",
+										  "const Quat& get_rotation() const",
+										  asFUNCTION(getRotation),
+										  asCALL_CDECL_OBJFIRST);
+		PA_ASSERT(rc >= 0);
+		rc = engine->RegisterObjectMethod("Transform",
+										  "void set_rotation(Quat)",
+										  asFUNCTION(setRotationScript),
+										  asCALL_CDECL_OBJFIRST);
 		PA_ASSERT(rc >= 0);
-		rc = engine->RegisterObjectProperty("Transform", "Vec3 forward", asOFFSET(CTransform, forward));
+		rc = engine->RegisterObjectMethod("Transform",
+										  "const Vec3& get_lookAt() const",
+										  asFUNCTION(getLookAt),
+										  asCALL_CDECL_OBJFIRST);
 		PA_ASSERT(rc >= 0);
-		rc = engine->RegisterObjectProperty("Transform", "Vec3 scale", asOFFSET(CTransform, scale));
+		rc = engine->RegisterObjectMethod("Transform",
+										  "void set_lookAt(Vec3)",
+										  asFUNCTION(setLookAt),
+										  asCALL_CDECL_OBJFIRST);
 		PA_ASSERT(rc >= 0);
-		rc = engine->RegisterObjectProperty("Transform", "Quat rotation", asOFFSET(CTransform, rotation));
+		rc = engine->RegisterObjectMethod("Transform",
+										  "const Vec3& get_up() const",
+										  asFUNCTION(getUp),
+										  asCALL_CDECL_OBJFIRST);
 		PA_ASSERT(rc >= 0);
-		rc = engine->RegisterObjectProperty("Transform", "Vec3 lookAt", asOFFSET(CTransform, lookAt));
+		rc = engine->RegisterObjectMethod("Transform",
+										  "void set_up(Vec3)",
+										  asFUNCTION(setUpVector),
+										  asCALL_CDECL_OBJFIRST);
 		PA_ASSERT(rc >= 0);
-		rc = engine->RegisterObjectProperty("Transform", "Vec3 up", asOFFSET(CTransform, up));
+		rc = engine->RegisterObjectMethod("Transform",
+										  "Vec3 get_worldPosition() const",
+										  asFUNCTION(getWorldPosition),
+										  asCALL_CDECL_OBJFIRST);
+		PA_ASSERT(rc >= 0);
+		rc = engine->RegisterObjectMethod("Transform",
+										  "void set_worldPosition(Vec3)",
+										  asFUNCTION(setWorldPositionScript),
+										  asCALL_CDECL_OBJFIRST);
+		PA_ASSERT(rc >= 0);
+		rc = engine->RegisterObjectMethod("Transform",
+										  "const Quat& get_worldRotation() const",
+										  asFUNCTION(getWorldRotation),
+										  asCALL_CDECL_OBJFIRST);
+		PA_ASSERT(rc >= 0);
+		rc = engine->RegisterObjectMethod("Transform",
+										  "void set_worldRotation(Quat)",
+										  asFUNCTION(setWorldRotationScript),
+										  asCALL_CDECL_OBJFIRST);
+		PA_ASSERT(rc >= 0);
+		rc = engine->RegisterObjectMethod("Transform",
+										  "Vec3 get_worldForward() const",
+										  asFUNCTION(getWorldForward),
+										  asCALL_CDECL_OBJFIRST);
 		PA_ASSERT(rc >= 0);
 		rc = engine->RegisterObjectMethod("Transform",
 										  "void translate(Vec3, Space = Space::WORLD)",
@@ -213,17 +924,17 @@ namespace Transform
 		PA_ASSERT(rc >= 0);
 		rc = engine->RegisterObjectMethod("Transform",
 										  "void setScale(Vec3)",
-										  asFUNCTION(setScale),
+										  asFUNCTION(setScaleScript),
 										  asCALL_CDECL_OBJFIRST);
 		PA_ASSERT(rc >= 0);
 		rc = engine->RegisterObjectMethod("Transform",
 										  "void setRotation(Quat)",
-										  asFUNCTION(setRotation),
+										  asFUNCTION(setRotationScript),
 										  asCALL_CDECL_OBJFIRST);
 		PA_ASSERT(rc >= 0);
 		rc = engine->RegisterObjectMethod("Transform",
 										  "void setPosition(Vec3)",
-										  asFUNCTION(setPosition),
+										  asFUNCTION(setPositionScript),
 										  asCALL_CDECL_OBJFIRST);
 		PA_ASSERT(rc >= 0);
 		rc = engine->RegisterObjectMethod("Transform",
@@ -243,7 +954,7 @@ namespace Transform
 		PA_ASSERT(rc >= 0);
 		rc = engine->RegisterObjectMethod("Transform",
 										  "void updateTransformMatrix()",
-										  asFUNCTION(updateTransformMatrix),
+										  asFUNCTION(updateTransformMatrixScript),
 										  asCALL_CDECL_OBJFIRST);
 		PA_ASSERT(rc >= 0);		
 		rc = engine->RegisterGlobalProperty("const Vec3 UNIT_X", (void *)&UNIT_X); PA_ASSERT(rc >= 0);
@@ -261,17 +972,17 @@ namespace Transform
 
 		writer.Key("Position");
 		writer.StartArray();
-		for(int i = 0; i < 3; i++) writer.Double(transform->position[i]);
+		for(int i = 0; i < 3; i++) writer.Double(positions[transform->index][i]);
 		writer.EndArray();
 
 		writer.Key("Scale");
 		writer.StartArray();
-		for(int i = 0; i < 3; i++) writer.Double(transform->scale[i]);
+		for(int i = 0; i < 3; i++) writer.Double(scales[transform->index][i]);
 		writer.EndArray();
 
 		writer.Key("Rotation");
 		writer.StartArray();
-		for(int i = 0; i < 4; i++) writer.Double(transform->rotation[i]);
+		for(int i = 0; i < 4; i++) writer.Double(rotations[transform->index][i]);
 		writer.EndArray();
 		
 		writer.EndObject();
@@ -279,6 +990,30 @@ namespace Transform
 		return success;
 	}
 
+	void writeToBinary(CTransform* transform, SceneFormat::TransformRecord* record)
+	{
+		PA_ASSERT(transform);
+		PA_ASSERT(record);
+		int index = transform->index;
+		for(int i = 0; i < 3; i++) record->position[i] = positions[index][i];
+		for(int i = 0; i < 4; i++) record->rotation[i] = rotations[index][i];
+		for(int i = 0; i < 3; i++) record->scale[i]    = scales[index][i];
+	}
+
+	void createFromBinary(CTransform* transform, const SceneFormat::TransformRecord& record)
+	{
+		PA_ASSERT(transform);
+		// Same result as the three setters, but the derived vectors are updated once
+		int index = transform->index;
+		for(int i = 0; i < 3; i++) positions[index][i] = record.position[i];
+		for(int i = 0; i < 4; i++) rotations[index][i] = record.rotation[i];
+		for(int i = 0; i < 3; i++) scales[index][i]    = record.scale[i];
+		updateUpVector(transform);
+		updateLookAt(transform);
+		updateForward(transform);
+		markDirty(transform, true);
+	}
+
 	bool createFromJSON(CTransform* transform, const rapidjson::Value& value)
 	{
 		using namespace rapidjson;
@@ -1,23 +1,20 @@
 #ifndef _transform_H
 #define _transform_H
 
+#include <vector>
+
 #include "mathdefs.h"
 #include "componentTypes.h"
 #include "renderer.h"
 #include "datatypes.h"
 #include "jsondefs.h"
+#include "sceneformat.h"
 
+// Handle to a transform. The transform data itself is stored column-wise inside
+// Transform so systems that only need, for example, world matrices stream just that array.
 struct CTransform
 {
-    Vec3 position   = Vec3(0.f);
-    Vec3 scale      = Vec3(1.f);
-    Vec3 lookAt     = Vec3(0.f, 0.f, -5.f);
-    Vec3 up         = Vec3(0.f, 1.f, 0.f);
-    Vec3 forward    = Vec3(0.f, 0.f, -1.f);
-    Quat rotation   = Quat();
-	Node node       = 0;
-	Mat4 transMat   = Mat4();
-	bool valid      = true;
+	int32_t index = -1;
 };
 
 namespace Transform
@@ -38,14 +35,67 @@ namespace Transform
     void setLookAt(CTransform* transform, Vec3 lookAt);
 	void setUpVector(CTransform* transform, Vec3 up);
     void setForward(CTransform* transform, Vec3 direction);
-	void updateTransformMatrix(CTransform* transform, bool syncPhysics = true);
+	void setWorldPosition(CTransform* transform, Vec3 position, bool syncPhysics = true);
+	void setWorldRotation(CTransform* transform, Quat rotation, bool syncPhysics = true);
+	void updateTransformMatrix(CTransform* transform, bool syncPhysics = true); // Rebuilds immediately, children wait for flush
+	void flush(); // Rebuilds matrices of modified transforms and their subtrees, parents first, and syncs their components
+
+	// Fixed step interpolation. Transforms changed between beginFixedStep and endFixedStep,
+	// directly or through a parent, keep their world state from before the step and
+	// getRenderMatrix blends it with the current one by the alpha given to interpolate.
+	// Changes outside of a step are teleports, those render at their world matrix.
+	void        beginFixedStep();
+	void        endFixedStep();
+	void        interpolate(float alpha); // After the last flush of a frame
+	const Mat4& getRenderMatrix(const CTransform* transform);
 	void generateBindings();
 	void cleanup();
 	bool remove(unsigned int transformIndex);
+	int  remove(const std::vector<int>& transformIndices); // Batch version, returns the number removed
 	int  create(Node node);
+	void reserve(int count); // Makes room for count more transforms
 	bool createFromJSON(CTransform* transform, const rapidjson::Value& value);
 	bool writeToJSON(CTransform* transform, rapidjson::Writer<rapidjson::StringBuffer>& writer);
+	void createFromBinary(CTransform* transform, const SceneFormat::TransformRecord& record);
+	void writeToBinary(CTransform* transform, SceneFormat::TransformRecord* record);
 	CTransform* getTransformAtIndex(int transformIndex);
+
+	// Parent is NULL to make the transform a root. keepWorldTransform recomputes the local
+	// values so the transform stays where it is, otherwise they are used as is.
+	// Fails if parent is the transform itself or one of its descendants.
+	bool        setParent(CTransform* transform, CTransform* parent, bool keepWorldTransform = true);
+	CTransform* getParent(const CTransform* transform);
+	int         getChildCount(const CTransform* transform);
+	CTransform* getChild(const CTransform* transform, int childIndex);
+
+	// Position, scale, rotation, lookAt, up and forward are relative to the parent,
+	// same as world space for roots
+	Node        getNode(const CTransform* transform);
+	const Vec3& getPosition(const CTransform* transform);
+	const Vec3& getScale(const CTransform* transform);
+	const Quat& getRotation(const CTransform* transform);
+	const Vec3& getLookAt(const CTransform* transform);
+	const Vec3& getUp(const CTransform* transform);
+	const Vec3& getForward(const CTransform* transform);
+
+	const Mat4& getWorldMatrix(const CTransform* transform);
+	const Quat& getWorldRotation(const CTransform* transform);
+	Vec3        getWorldPosition(const CTransform* transform);
+	Vec3        getWorldScale(const CTransform* transform);
+	Vec3        getWorldForward(const CTransform* transform);
+	Vec3        getWorldUp(const CTransform* transform);
+	Vec3        getWorldLookAt(const CTransform* transform);
+
+	// Column access for systems that iterate all transforms. Every array has getCount()
+	// entries indexed by CTransform::index, slots whose node is -1 are unused.
+	// World matrices are only guaranteed current after flush().
+	int         getCount();
+	const Node* getNodes();
+	const Vec3* getPositions();
+	const Quat* getRotations();
+	const Vec3* getScales();
+	const Vec3* getForwards();
+	const Mat4* getWorldMatrices();
 }
 
 #endif
@@ -0,0 +1,150 @@
+#include <cmath>
+
+#include "transformbatch.h"
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define PA_TRANSFORM_SSE
+#include <xmmintrin.h>
+#endif
+
+namespace TransformBatch
+{
+	namespace
+	{
+		// Same result as translate(position) * toMat4(normalize(rotation)) * scale(scale),
+		// but every element is written directly instead of going through three matrix products
+		void composeOne(const Vec3& position, const Quat& rotation, const Vec3& scale, Mat4& out)
+		{
+			float lengthSq = rotation.x * rotation.x + rotation.y * rotation.y +
+				             rotation.z * rotation.z + rotation.w * rotation.w;
+			float invLength = lengthSq > 0.f ? 1.f / std::sqrt(lengthSq) : 0.f;
+			float x = rotation.x * invLength;
+			float y = rotation.y * invLength;
+			float z = rotation.z * invLength;
+			float w = lengthSq > 0.f ? rotation.w * invLength : 1.f;
+
+			float xx = x * x, yy = y * y, zz = z * z;
+			float xy = x * y, xz = x * z, yz = y * z;
+			float wx = w * x, wy = w * y, wz = w * z;
+
+			out[0][0] = (1.f - 2.f * (yy + zz)) * scale.x;
+			out[0][1] = (2.f * (xy + wz)) * scale.x;
+			out[0][2] = (2.f * (xz - wy)) * scale.x;
+			out[0][3] = 0.f;
+
+			out[1][0] = (2.f * (xy - wz)) * scale.y;
+			out[1][1] = (1.f - 2.f * (xx + zz)) * scale.y;
+			out[1][2] = (2.f * (yz + wx)) * scale.y;
+			out[1][3] = 0.f;
+
+			out[2][0] = (2.f * (xz + wy)) * scale.z;
+			out[2][1] = (2.f * (yz - wx)) * scale.z;
+			out[2][2] = (1.f - 2.f * (xx + yy)) * scale.z;
+			out[2][3] = 0.f;
+
+			out[3][0] = position.x;
+			out[3][1] = position.y;
+			out[3][2] = position.z;
+			out[3][3] = 1.f;
+		}
+
+#ifdef PA_TRANSFORM_SSE
+		// Lane i of x, y, z and w holds one matrix element of transform i, transposing turns
+		// the four lanes back into one column per transform
+		inline void storeColumn(__m128 x, __m128 y, __m128 z, __m128 w, int column,
+								Mat4* worldMatrices, const int* indices)
+		{
+			_MM_TRANSPOSE4_PS(x, y, z, w);
+			_mm_storeu_ps(&worldMatrices[indices[0]][column][0], x);
+			_mm_storeu_ps(&worldMatrices[indices[1]][column][0], y);
+			_mm_storeu_ps(&worldMatrices[indices[2]][column][0], z);
+			_mm_storeu_ps(&worldMatrices[indices[3]][column][0], w);
+		}
+
+		void composeFour(const Vec3* positions,
+						 const Quat* rotations,
+						 const Vec3* scales,
+						 Mat4*       worldMatrices,
+						 const int*  indices)
+		{
+			const Quat& q0 = rotations[indices[0]];
+			const Quat& q1 = rotations[indices[1]];
+			const Quat& q2 = rotations[indices[2]];
+			const Quat& q3 = rotations[indices[3]];
+			__m128 x = _mm_setr_ps(q0.x, q1.x, q2.x, q3.x);
+			__m128 y = _mm_setr_ps(q0.y, q1.y, q2.y, q3.y);
+			__m128 z = _mm_setr_ps(q0.z, q1.z, q2.z, q3.z);
+			__m128 w = _mm_setr_ps(q0.w, q1.w, q2.w, q3.w);
+
+			const __m128 zero = _mm_setzero_ps();
+			const __m128 one  = _mm_set1_ps(1.f);
+			const __m128 two  = _mm_set1_ps(2.f);
+
+			// Normalize, a zero quaternion becomes identity like in the scalar path
+			__m128 lengthSq  = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)),
+										  _mm_add_ps(_mm_mul_ps(z, z), _mm_mul_ps(w, w)));
+			__m128 valid     = _mm_cmpgt_ps(lengthSq, zero);
+			__m128 invLength = _mm_and_ps(valid, _mm_div_ps(one, _mm_sqrt_ps(lengthSq)));
+			x = _mm_mul_ps(x, invLength);
+			y = _mm_mul_ps(y, invLength);
+			z = _mm_mul_ps(z, invLength);
+			w = _mm_or_ps(_mm_and_ps(valid, _mm_mul_ps(w, invLength)), _mm_andnot_ps(valid, one));
+
+			__m128 xx = _mm_mul_ps(x, x), yy = _mm_mul_ps(y, y), zz = _mm_mul_ps(z, z);
+			__m128 xy = _mm_mul_ps(x, y), xz = _mm_mul_ps(x, z), yz = _mm_mul_ps(y, z);
+			__m128 wx = _mm_mul_ps(w, x), wy = _mm_mul_ps(w, y), wz = _mm_mul_ps(w, z);
+
+			const Vec3& s0 = scales[indices[0]];
+			const Vec3& s1 = scales[indices[1]];
+			const Vec3& s2 = scales[indices[2]];
+			const Vec3& s3 = scales[indices[3]];
+			__m128 sx = _mm_setr_ps(s0.x, s1.x, s2.x, s3.x);
+			__m128 sy = _mm_setr_ps(s0.y, s1.y, s2.y, s3.y);
+			__m128 sz = _mm_setr_ps(s0.z, s1.z, s2.z, s3.z);
+
+			__m128 m00 = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(yy, zz))), sx);
+			__m128 m01 = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xy, wz)), sx);
+			__m128 m02 = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xz, wy)), sx);
+			storeColumn(m00, m01, m02, zero, 0, worldMatrices, indices);
+
+			__m128 m10 = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xy, wz)), sy);
+			__m128 m11 = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, zz))), sy);
+			__m128 m12 = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(yz, wx)), sy);
+			storeColumn(m10, m11, m12, zero, 1, worldMatrices, indices);
+
+			__m128 m20 = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xz, wy)), sz);
+			__m128 m21 = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(yz, wx)), sz);
+			__m128 m22 = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, yy))), sz);
+			storeColumn(m20, m21, m22, zero, 2, worldMatrices, indices);
+
+			const Vec3& p0 = positions[indices[0]];
+			const Vec3& p1 = positions[indices[1]];
+			const Vec3& p2 = positions[indices[2]];
+			const Vec3& p3 = positions[indices[3]];
+			__m128 px = _mm_setr_ps(p0.x, p1.x, p2.x, p3.x);
+			__m128 py = _mm_setr_ps(p0.y, p1.y, p2.y, p3.y);
+			__m128 pz = _mm_setr_ps(p0.z, p1.z, p2.z, p3.z);
+			storeColumn(px, py, pz, one, 3, worldMatrices, indices);
+		}
+#endif
+	}
+
+	void compose(const Vec3* positions,
+				 const Quat* rotations,
+				 const Vec3* scales,
+				 Mat4*       worldMatrices,
+				 const int*  indices,
+				 int         count)
+	{
+		int i = 0;
+#ifdef PA_TRANSFORM_SSE
+		for(; i + 4 <= count; i += 4)
+			composeFour(positions, rotations, scales, worldMatrices, &indices[i]);
+#endif
+		for(; i < count; i++)
+		{
+			int index = indices[i];
+			composeOne(positions[index], rotations[index], scales[index], worldMatrices[index]);
+		}
+	}
+}
@@ -0,0 +1,19 @@
+#ifndef transformbatch_H
+#define transformbatch_H
+
+#include "mathdefs.h"
+
+namespace TransformBatch
+{
+	// Writes translation * rotation * scale into worldMatrices[i] for every i in indices.
+	// Rotations are normalized on the fly, entries not listed are neither read nor written.
+	// Uses SSE four transforms at a time when available, scalar code otherwise.
+	void compose(const Vec3* positions,
+				 const Quat* rotations,
+				 const Vec3* scales,
+				 Mat4*       worldMatrices,
+				 const int*  indices,
+				 int         count);
+}
+
+#endif
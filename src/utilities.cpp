@@ -2,6 +2,10 @@
 #include <stdlib.h>
 #include <fstream>
 #include <sstream>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include "utilities.h"
 #include "log.h"
@@ -168,4 +172,31 @@ namespace Utils
 		}
 		return exists;
 	}
+
+	const void* mapFile(const char* filename, size_t* size, bool logErrors)
+	{
+		void* data = NULL;
+		int fd = open(filename, O_RDONLY);
+		if(fd != -1)
+		{
+			struct stat fileStat;
+			if(fstat(fd, &fileStat) == 0 && fileStat.st_size > 0)
+			{
+				data = mmap(NULL, (size_t)fileStat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+				if(data != MAP_FAILED)
+					*size = (size_t)fileStat.st_size;
+				else
+					data = NULL;
+			}
+			// The mapping keeps its own reference to the file
+			close(fd);
+		}
+		if(!data && logErrors) Log::error("Utils::mapFile", "Couldn't map file " + std::string(filename));
+		return data;
+	}
+
+	void unmapFile(const void* data, size_t size)
+	{
+		if(data) munmap((void*)data, size);
+	}
 }
@@ -25,6 +25,10 @@ namespace Utils
 	std::string loadFileIntoString(const char* filename);
 	char*       loadFileIntoCString(const char* filename, bool addNull = true);
 	bool        fileExists(const char* filename);
+	// Maps a whole file read only, NULL on failure. The memory stays valid until unmapFile.
+	// Loader threads pass logErrors false, logging is not thread safe.
+	const void* mapFile(const char* filename, size_t* size, bool logErrors = true);
+	void        unmapFile(const void* data, size_t size);
 	
 }
 
@@ -0,0 +1,119 @@
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <algorithm>
+
+#include "workerpool.h"
+
+namespace WorkerPool
+{
+	namespace
+	{
+		typedef std::function<void(int, int)> Job;
+
+		std::vector<std::thread> workers;
+		std::mutex               mutex;
+		std::condition_variable  wakeCondition;
+		std::condition_variable  doneCondition;
+		const Job*               currentJob    = NULL;
+		std::atomic<int>         nextBatch(0);
+		int                      batchCount    = 0;
+		int                      batchSize     = 0;
+		int                      itemCount     = 0;
+		int                      busyWorkers   = 0;
+		unsigned int             jobGeneration = 0;
+		bool                     quit          = false;
+
+		void runBatches(const Job& job)
+		{
+			int batch = 0;
+			while((batch = nextBatch.fetch_add(1)) < batchCount)
+			{
+				int begin = batch * batchSize;
+				job(begin, std::min(begin + batchSize, itemCount));
+			}
+		}
+
+		void workerLoop()
+		{
+			unsigned int seenGeneration = 0;
+			while(true)
+			{
+				const Job* job = NULL;
+				{
+					std::unique_lock<std::mutex> lock(mutex);
+					wakeCondition.wait(lock, [&seenGeneration] { return quit || jobGeneration != seenGeneration; });
+					if(quit) return;
+					seenGeneration = jobGeneration;
+					job = currentJob;
+					// Woke up after the job already finished
+					if(!job) continue;
+					busyWorkers++;
+				}
+				runBatches(*job);
+				{
+					std::lock_guard<std::mutex> lock(mutex);
+					busyWorkers--;
+				}
+				doneCondition.notify_one();
+			}
+		}
+	}
+
+	void initialize(int threadCount)
+	{
+		if(!workers.empty()) cleanup();
+		if(threadCount <= 0) threadCount = (int)std::thread::hardware_concurrency() - 1;
+		quit = false;
+		for(int i = 0; i < threadCount; i++)
+			workers.push_back(std::thread(workerLoop));
+	}
+
+	void cleanup()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			quit = true;
+		}
+		wakeCondition.notify_all();
+		for(std::thread& worker : workers) worker.join();
+		workers.clear();
+	}
+
+	int getThreadCount()
+	{
+		return (int)workers.size();
+	}
+
+	void parallelFor(int count, int minBatch, const std::function<void(int, int)>& job)
+	{
+		if(count <= 0) return;
+		if(minBatch < 1) minBatch = 1;
+		if(workers.empty() || count <= minBatch)
+		{
+			job(0, count);
+			return;
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			// A few batches per thread so a worker that wakes up late doesn't stall the rest
+			int threads = (int)workers.size() + 1;
+			batchSize   = std::max(minBatch, (count + threads * 4 - 1) / (threads * 4));
+			batchCount  = (count + batchSize - 1) / batchSize;
+			itemCount   = count;
+			currentJob  = &job;
+			nextBatch   = 0;
+			jobGeneration++;
+		}
+		wakeCondition.notify_all();
+		runBatches(job);
+
+		// Every batch has been claimed at this point, wait for the ones still running
+		std::unique_lock<std::mutex> lock(mutex);
+		doneCondition.wait(lock, [] { return busyWorkers == 0; });
+		currentJob = NULL;
+	}
+}
@@ -0,0 +1,21 @@
+#ifndef workerpool_H
+#define workerpool_H
+
+#include <functional>
+
+namespace WorkerPool
+{
+	// threadCount of 0 uses one worker less than the hardware threads, the caller
+	// of parallelFor always works alongside the pool
+	void initialize(int threadCount = 0);
+	void cleanup();
+	int  getThreadCount();
+
+	// Splits [0, count) into ranges of at least minBatch items and calls job(begin, end)
+	// for each of them on the workers and the calling thread. Returns once every range
+	// is done. Runs inline when the pool is empty or count fits in a single batch.
+	// Not reentrant, job must not call parallelFor itself.
+	void parallelFor(int count, int minBatch, const std::function<void(int, int)>& job);
+}
+
+#endif
@@ -0,0 +1,98 @@
+// Runs MeshOptimizer over meshes and reports what it saves. Accepts the engine's own
+// geometry files and Horde3D .geo files (H3DG version 5). Both are expanded to one vertex
+// per triangle corner first, which is what the exporter writes, so the numbers show the
+// difference between the exported data and what ends up in the geometry arena.
+// Vertex bytes are given for float attributes (32 byte) and for the packed layout
+// Geometry uploads with quantized positions (16 byte). LODs are listed with the triangles
+// they keep, their indices come on top of the totals.
+// Usage: meshreport <mesh> [mesh ...]
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "../src/meshformat.h"
+#include "../src/meshoptimizer.h"
+
+namespace
+{
+	const uint32_t FLOAT_VERTEX_SIZE  = 32; // Vec3 position, Vec3 normal, Vec2 uv
+	const uint32_t PACKED_VERTEX_SIZE = 16; // Unorm16 position, 10:10:10:2 normal, half uv
+
+	bool readMesh(const char* filename, Geometry::GeometryFileData* data)
+	{
+		if(!MeshFormat::readSource(filename, data)) return false;
+		if(data->indices.empty()) return true;
+
+		// Back to one vertex per corner, like the exporter writes it
+		Geometry::GeometryFileData expanded;
+		for(uint32_t i = 0; i < data->indices.size(); i++)
+		{
+			uint32_t index = data->indices[i];
+			expanded.vertices.push_back(data->vertices[index]);
+			if(!data->normals.empty()) expanded.normals.push_back(data->normals[index]);
+			if(!data->uvs.empty())     expanded.uvs.push_back(data->uvs[index]);
+			expanded.indices.push_back(i);
+		}
+		*data = expanded;
+		return true;
+	}
+
+	void printBytes(const char* label, size_t before, size_t after)
+	{
+		printf("  %-22s %10zu -> %10zu  (%5.1f%% saved)\n",
+			   label, before, after, before ? 100.0 * (1.0 - (double)after / before) : 0.0);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	if(argc < 2)
+	{
+		printf("Usage: meshreport <mesh> [mesh ...]\n");
+		return 1;
+	}
+
+	size_t totalBefore = 0, totalAfter = 0;
+	for(int i = 1; i < argc; i++)
+	{
+		Geometry::GeometryFileData data;
+		if(!readMesh(argv[i], &data))
+		{
+			printf("Could not read %s\n", argv[i]);
+			return 1;
+		}
+
+		MeshOptimizer::Stats stats;
+		MeshOptimizer::optimize(&data, &stats);
+		uint32_t indexSize   = stats.verticesAfter <= 65536 ? sizeof(uint16_t) : sizeof(uint32_t);
+		size_t   vertexBefore = (size_t)stats.verticesBefore * FLOAT_VERTEX_SIZE;
+		size_t   indexBefore  = (size_t)stats.indexCount * sizeof(uint32_t);
+		size_t   vertexAfter  = (size_t)stats.verticesAfter * PACKED_VERTEX_SIZE;
+		size_t   indexAfter   = (size_t)stats.indexCount * indexSize;
+
+		printf("%s\n", argv[i]);
+		printf("  vertices %u -> %u, %u triangles, %u bit indices\n",
+			   stats.verticesBefore, stats.verticesAfter, stats.indexCount / 3, indexSize * 8);
+		printf("  ACMR (FIFO 16)         %10.3f -> %10.3f\n", stats.acmrBefore, stats.acmrAfter);
+		printBytes("vertex bytes, float",  vertexBefore, (size_t)stats.verticesAfter * FLOAT_VERTEX_SIZE);
+		printBytes("vertex bytes, packed", vertexBefore, vertexAfter);
+		printBytes("index bytes",          indexBefore, indexAfter);
+		printBytes("total",                vertexBefore + indexBefore, vertexAfter + indexAfter);
+		MeshOptimizer::generateLods(&data);
+		for(size_t level = 0; level < data.lodIndexCounts.size(); level++)
+		{
+			uint32_t count = data.lodIndexCounts[level];
+			printf("  LOD %zu                  %10u triangles (%5.1f%%), %zu index bytes\n",
+				   level + 1, count / 3, 100.0 * count / stats.indexCount, (size_t)count * indexSize);
+		}
+		totalBefore += vertexBefore + indexBefore;
+		totalAfter  += vertexAfter + indexAfter;
+	}
+	if(argc > 2)
+	{
+		printf("all meshes\n");
+		printBytes("total", totalBefore, totalAfter);
+	}
+	return 0;
+}
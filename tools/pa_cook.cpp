@@ -0,0 +1,101 @@
+// Cooks meshes for Geometry. Every source (.pamesh from the exporter or Horde3D .geo) is
+// welded and reordered by MeshOptimizer, gets its LODs and bounds computed and is written as a
+// .pamc file next to it, see MeshFormat. Sources whose hash matches the one in an existing
+// cooked file are skipped unless --force is given.
+// Usage: pa_cook [--force] <mesh> [mesh ...]
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "../src/meshformat.h"
+#include "../src/meshoptimizer.h"
+
+namespace
+{
+	bool readBytes(const char* filename, std::vector<char>* bytes)
+	{
+		FILE* file = fopen(filename, "rb");
+		if(!file) return false;
+		fseek(file, 0L, SEEK_END);
+		long length = ftell(file);
+		rewind(file);
+		bytes->resize(length > 0 ? (size_t)length : 0);
+		bool success = bytes->empty() || fread(bytes->data(), bytes->size(), 1, file) == 1;
+		fclose(file);
+		return success;
+	}
+
+	bool isUpToDate(const char* cooked, uint64_t contentHash)
+	{
+		std::vector<char> bytes;
+		if(!readBytes(cooked, &bytes) || bytes.size() < sizeof(MeshFormat::Header)) return false;
+		MeshFormat::Header header;
+		memcpy(&header, bytes.data(), sizeof(header));
+		return header.magic == MeshFormat::MAGIC && header.version == MeshFormat::VERSION && header.contentHash == contentHash;
+	}
+
+	bool cook(const char* source, bool force)
+	{
+		std::vector<char> bytes;
+		if(!readBytes(source, &bytes))
+		{
+			printf("%s: could not read\n", source);
+			return false;
+		}
+		uint64_t    contentHash = MeshFormat::hash(bytes.data(), bytes.size());
+		std::string cooked      = MeshFormat::getCookedPath(source);
+		if(!force && isUpToDate(cooked.c_str(), contentHash))
+		{
+			printf("%s: up to date\n", source);
+			return true;
+		}
+
+		Geometry::GeometryFileData data;
+		if(!MeshFormat::readSource(source, &data))
+		{
+			printf("%s: not a valid mesh\n", source);
+			return false;
+		}
+		MeshOptimizer::Stats stats;
+		MeshOptimizer::optimize(&data, &stats);
+		MeshOptimizer::generateLods(&data);
+		MeshFormat::computeBounds(data.vertices, &data.boundsMin, &data.boundsMax, &data.sphereCenter, &data.sphereRadius);
+		data.hasBounds = true;
+
+		std::string error;
+		if(!MeshFormat::write(data, MeshFormat::MF_OPTIMIZED, contentHash, cooked.c_str(), &error))
+		{
+			printf("%s: %s\n", cooked.c_str(), error.c_str());
+			return false;
+		}
+		std::string lods;
+		for(uint32_t count : data.lodIndexCounts) lods += " " + std::to_string(count / 3);
+		printf("%s -> %s: %u -> %u vertices, %u triangles, ACMR %.3f -> %.3f, LOD triangles%s\n",
+			   source, cooked.c_str(), stats.verticesBefore, stats.verticesAfter,
+			   stats.indexCount / 3, stats.acmrBefore, stats.acmrAfter, lods.empty() ? " none" : lods.c_str());
+		return true;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	bool force = false;
+	int  first = 1;
+	if(argc > 1 && strcmp(argv[1], "--force") == 0)
+	{
+		force = true;
+		first = 2;
+	}
+	if(first >= argc)
+	{
+		printf("Usage: pa_cook [--force] <mesh> [mesh ...]\n");
+		return 1;
+	}
+
+	int failed = 0;
+	for(int i = first; i < argc; i++)
+		if(!cook(argv[i], force)) failed++;
+	return failed > 0 ? 1 : 0;
+}
@@ -0,0 +1,339 @@
+// Converts scenes between the json format written by SceneManager::saveScene and the
+// binary .pascene format of SceneManager::saveSceneBinary. The direction is picked from
+// the input's extension. With --bench both files are read repeatedly and the time it takes
+// to get from file to records is reported for each format.
+// Usage: sceneconvert <input> <output>
+//        sceneconvert --bench <scene.json> <scene.pascene> [iterations]
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "../src/sceneformat.h"
+#include "../src/scenereader.h"
+#include "../include/rapidjson/prettywriter.h"
+#include "../include/rapidjson/stringbuffer.h"
+
+namespace
+{
+	typedef std::chrono::high_resolution_clock Clock;
+	using namespace SceneFormat;
+	using namespace rapidjson;
+
+	bool endsWith(const char* str, const char* suffix)
+	{
+		size_t length = strlen(str), suffixLength = strlen(suffix);
+		return length >= suffixLength && strcmp(str + length - suffixLength, suffix) == 0;
+	}
+
+	// Whole file in memory and 8 byte aligned so binary scenes can be read in place
+	bool readFile(const char* filename, std::vector<uint64_t>* buffer, size_t* size)
+	{
+		FILE* file = fopen(filename, "rb");
+		if(!file) return false;
+		fseek(file, 0L, SEEK_END);
+		*size = (size_t)ftell(file);
+		rewind(file);
+		buffer->assign(*size / sizeof(uint64_t) + 1, 0);
+		bool success = *size == 0 || fread(buffer->data(), *size, 1, file) == 1;
+		fclose(file);
+		return success;
+	}
+
+	bool fromJSON(const char* filename, SceneData* scene, std::string* error)
+	{
+		FILE* file = fopen(filename, "rb");
+		if(!file)
+		{
+			*error = "Could not read file";
+			return false;
+		}
+		SceneReader::Result result;
+		bool success = SceneReader::read(file, scene, &result);
+		fclose(file);
+		if(!success) *error = result.error;
+		return success;
+	}
+
+	void writeFloats(PrettyWriter<StringBuffer>& writer, const char* key, const float* values, int count)
+	{
+		writer.Key(key);
+		writer.StartArray();
+		for(int i = 0; i < count; i++) writer.Double(values[i]);
+		writer.EndArray();
+	}
+
+	void writeRigidBody(PrettyWriter<StringBuffer>& writer, const RigidBodyRecord& record, const SceneView& scene)
+	{
+		const float* params = record.shape;
+		writer.Key("RigidBody");
+		writer.StartObject();
+		writer.Key("Mass");        writer.Double(record.mass);
+		writer.Key("Friction");    writer.Double(record.friction);
+		writer.Key("Restitution"); writer.Double(record.restitution);
+		writer.Key("IsKinematic"); writer.Bool(record.isKinematic != 0);
+		writer.Key("Shape");
+		writer.StartObject();
+		writer.Key("Type"); writer.Int(record.shapeType);
+		switch(record.shapeType)
+		{
+		case 0:
+			writer.Key("Radius"); writer.Double(params[0]);
+			break;
+		case 1:
+			writeFloats(writer, "HalfExt", params, 3);
+			break;
+		case 2:
+		case 4:
+			writer.Key("Radius"); writer.Double(params[0]);
+			writer.Key("Height"); writer.Double(params[1]);
+			break;
+		case 3:
+			writer.Key("Margin"); writer.Double(params[3]);
+			writeFloats(writer, "Normal", params, 3);
+			break;
+		case 5:
+			writeFloats(writer, "Axis", params + 3, 3);
+			writeFloats(writer, "HalfExt", params, 3);
+			break;
+		default:
+			if(record.geometry != NONE)
+			{
+				writer.Key("GeometryName"); writer.String(scene.getString(record.geometry));
+			}
+			break;
+		}
+		writer.EndObject();
+		writer.EndObject();
+	}
+
+	// Same layout as SceneManager::writeSceneToJSON
+	void toJSON(const SceneView& scene, StringBuffer* buffer)
+	{
+		PrettyWriter<StringBuffer> writer(*buffer);
+		writer.SetIndent('\t', 1);
+		writer.StartObject();
+		writer.Key("Scene");
+		writer.StartObject();
+		writer.Key("SceneObjects");
+		writer.StartArray();
+		for(uint32_t i = 0; i < scene.counts[ST_OBJECTS]; i++)
+		{
+			const ObjectRecord&    object    = scene.objects[i];
+			const TransformRecord& transform = scene.transforms[i];
+			writer.StartObject();
+			writer.Key("Name"); writer.String(scene.getString(object.name));
+			writer.Key("Tag");  writer.String(object.tag != NONE ? scene.getString(object.tag) : "");
+			writer.Key("Node"); writer.Int(object.node);
+			if(object.parent != -1)
+			{
+				writer.Key("Parent"); writer.Int(object.parent);
+			}
+			if(object.scriptCount > 0)
+			{
+				writer.Key("Scripts");
+				writer.StartArray();
+				for(uint32_t j = 0; j < object.scriptCount; j++)
+					writer.String(scene.getString(scene.scripts[object.firstScript + j]));
+				writer.EndArray();
+			}
+			writer.Key("Components");
+			writer.StartObject();
+			writer.Key("Transform");
+			writer.StartObject();
+			writeFloats(writer, "Position", transform.position, 3);
+			writeFloats(writer, "Scale", transform.scale, 3);
+			writeFloats(writer, "Rotation", transform.rotation, 4);
+			writer.EndObject();
+			if(object.model != NONE)
+			{
+				const ModelRecord& model = scene.models[object.model];
+				writer.Key("Model");
+				writer.StartObject();
+				writer.Key("Geometry"); writer.String(model.geometry != NONE ? scene.getString(model.geometry) : "");
+				writer.Key("Material"); writer.Int(model.material);
+				writer.Key("MaterialUniforms");
+				writer.StartObject();
+				writer.Key("Diffuse");          writer.Double(model.diffuse);
+				writer.Key("Specular");         writer.Double(model.specular);
+				writer.Key("SpecularStrength"); writer.Double(model.specularStrength);
+				writer.Key("CastShadow");       writer.Bool(model.castShadow != 0);
+				writeFloats(writer, "DiffuseColor", model.diffuseColor, 4);
+				if(model.texture != NONE)
+				{
+					writer.Key("Texture"); writer.String(scene.getString(model.texture));
+				}
+				writer.EndObject();
+				writer.EndObject();
+			}
+			if(object.camera != NONE)
+			{
+				const CameraRecord& camera = scene.cameras[object.camera];
+				writer.Key("Camera");
+				writer.StartObject();
+				writer.Key("NearZ");          writer.Double(camera.nearZ);
+				writer.Key("FarZ");           writer.Double(camera.farZ);
+				writer.Key("Fov");            writer.Double(camera.fov);
+				writer.Key("AspectRatio");    writer.Double(camera.aspectRatio);
+				writer.Key("IsOrthographic"); writer.Bool(camera.isOrthographic != 0);
+				writer.Key("IsActive");       writer.Bool(camera.isActive != 0);
+				writer.EndObject();
+			}
+			if(object.light != NONE)
+			{
+				const LightRecord& light = scene.lights[object.light];
+				writer.Key("Light");
+				writer.StartObject();
+				writer.Key("Type");        writer.Int(light.type);
+				writer.Key("InnerAngle");  writer.Double(light.innerAngle);
+				writer.Key("OuterAngle");  writer.Double(light.outerAngle);
+				writer.Key("Falloff");     writer.Double(light.falloff);
+				writer.Key("Radius");      writer.Double(light.radius);
+				writer.Key("Intensity");   writer.Double(light.intensity);
+				writer.Key("CastShadow");  writer.Bool(light.castShadow != 0);
+				writer.Key("PcfEnabled");  writer.Bool(light.pcfEnabled != 0);
+				writer.Key("DepthBias");   writer.Double(light.depthBias);
+				writeFloats(writer, "Color", light.color, 4);
+				writer.EndObject();
+			}
+			if(object.rigidBody != NONE) writeRigidBody(writer, scene.rigidBodies[object.rigidBody], scene);
+			writer.EndObject();
+			writer.EndObject();
+		}
+		writer.EndArray();
+
+		const SettingsRecord& settings = *scene.settings;
+		writer.Key("Renderer");
+		writer.StartObject();
+		writeFloats(writer, "AmbientLight", settings.ambientLight, 4);
+		writeFloats(writer, "ClearColor", settings.clearColor, 4);
+		writer.Key("Fog");
+		writer.StartObject();
+		writer.Key("FogMode"); writer.Int(settings.fogMode);
+		writer.Key("Density"); writer.Double(settings.fogDensity);
+		writer.Key("Start");   writer.Double(settings.fogStart);
+		writer.Key("Max");     writer.Double(settings.fogMax);
+		writeFloats(writer, "Color", settings.fogColor, 4);
+		writer.EndObject();
+		writer.EndObject();
+		writer.Key("Physics");
+		writer.StartObject();
+		writeFloats(writer, "Gravity", settings.gravity, 3);
+		writer.EndObject();
+		writer.EndObject();
+		writer.EndObject();
+	}
+
+	double millisecondsSince(Clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	}
+
+	int convert(const char* input, const char* output)
+	{
+		std::string error;
+		if(endsWith(input, ".pascene"))
+		{
+			// An autosaved scene's journal is applied, the output is the scene as it would load
+			SceneData   merged;
+			SceneView   scene;
+			std::string journal = std::string(input) + ".journal";
+			if(!SceneFormat::readWithJournal(input, journal.c_str(), &merged, &error))
+			{
+				fprintf(stderr, "%s: %s\n", input, error.c_str());
+				return 1;
+			}
+			merged.getView(&scene);
+			StringBuffer json;
+			toJSON(scene, &json);
+			FILE* file = fopen(output, "w+");
+			if(!file || fwrite(json.GetString(), json.GetSize(), 1, file) != 1)
+			{
+				if(file) fclose(file);
+				fprintf(stderr, "Could not write %s\n", output);
+				return 1;
+			}
+			fclose(file);
+			printf("%u objects written to %s\n", scene.counts[ST_OBJECTS], output);
+		}
+		else
+		{
+			SceneData scene;
+			if(!fromJSON(input, &scene, &error) ||
+			   !SceneFormat::write(scene, output, &error))
+			{
+				fprintf(stderr, "%s: %s\n", input, error.c_str());
+				return 1;
+			}
+			printf("%zu objects written to %s\n", scene.objects.size(), output);
+		}
+		return 0;
+	}
+
+	// Only the file to records step is measured, creating objects needs the running engine
+	int bench(const char* jsonFile, const char* binaryFile, int iterations)
+	{
+		std::vector<uint64_t> jsonBuffer, binaryBuffer;
+		size_t      jsonSize = 0, binarySize = 0;
+		std::string error;
+		if(!readFile(jsonFile, &jsonBuffer, &jsonSize) || !readFile(binaryFile, &binaryBuffer, &binarySize))
+		{
+			fprintf(stderr, "Could not read the input files\n");
+			return 1;
+		}
+
+		// Json is streamed from the file like SceneManager::loadScene does, the file is in the
+		// page cache after the read above so this mostly measures the reader
+		Clock::time_point start = Clock::now();
+		size_t objects = 0;
+		for(int i = 0; i < iterations; i++)
+		{
+			SceneData scene;
+			if(!fromJSON(jsonFile, &scene, &error))
+			{
+				fprintf(stderr, "%s: %s\n", jsonFile, error.c_str());
+				return 1;
+			}
+			objects = scene.objects.size();
+		}
+		double jsonTime = millisecondsSince(start) / iterations;
+
+		start = Clock::now();
+		float checksum = 0.f;
+		for(int i = 0; i < iterations; i++)
+		{
+			SceneView scene;
+			if(!SceneFormat::read(binaryBuffer.data(), binarySize, &scene, &error))
+			{
+				fprintf(stderr, "%s: %s\n", binaryFile, error.c_str());
+				return 1;
+			}
+			// Touch every transform like the loader does so the comparison is fair
+			for(uint32_t j = 0; j < scene.counts[ST_TRANSFORMS]; j++) checksum += scene.transforms[j].position[0];
+		}
+		double binaryTime = millisecondsSince(start) / iterations;
+
+		printf("%zu objects, %d iterations (checksum %f)\n", objects, iterations, checksum);
+		printf("json   : %8zu bytes %10.4f ms\n", jsonSize, jsonTime);
+		printf("binary : %8zu bytes %10.4f ms\n", binarySize, binaryTime);
+		if(binaryTime > 0.0) printf("binary is %.1fx faster\n", jsonTime / binaryTime);
+		return 0;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	if(argc >= 4 && strcmp(argv[1], "--bench") == 0)
+	{
+		int iterations = argc > 4 ? atoi(argv[4]) : 100;
+		return bench(argv[2], argv[3], iterations > 0 ? iterations : 1);
+	}
+	if(argc == 3)
+		return convert(argv[1], argv[2]);
+	fprintf(stderr, "Usage: sceneconvert <input> <output>\n"
+			        "       sceneconvert --bench <scene.json> <scene.pascene> [iterations]\n");
+	return 1;
+}